@@ -104,6 +104,13 @@ uint16_t ipmi_get_oem_id(struct ipmi_intf *intf);
 #define ipmi_open_file_read(file)	ipmi_open_file(file, 0)
 #define ipmi_open_file_write(file)	ipmi_open_file(file, 1)
 
+/* result buffers returned by helpers are kept per thread */
+#if defined(__GNUC__)
+# define IPMI_TLS __thread
+#else
+# define IPMI_TLS
+#endif
+
 #ifndef __min
 # define __min(a, b)  ((a) < (b) ? (a) : (b))
 #endif
@@ -142,6 +142,9 @@ struct ipmi_v2_payload {
 	} payload;
 };
 
+/* rq_seq is a 6-bit field in the IPMI message header */
+#define IPMI_RQ_SEQ_MAX		64
+
 struct ipmi_rq_entry {
 	struct ipmi_rq req;
 	struct ipmi_intf *intf;
@@ -149,7 +152,8 @@ struct ipmi_rq_entry {
 	uint8_t *msg_data;
 	int msg_len;
 	int bridging_level;
-	struct ipmi_rq_entry *next;
+	int in_use;
+	uint32_t gen;	/* bumped each time the slot is handed out */
 };
 
 struct ipmi_rs {
@@ -61,9 +61,18 @@ enum LANPLUS_SESSION_STATE {
 #define IPMI_AUTHCODE_BUFFER_SIZE 20
 #define IPMI_SIK_BUFFER_SIZE      20
 #define IPMI_KG_BUFFER_SIZE       21 /* key plus null byte */
+#define IPMI_INTF_RTO_MIN         100 /* ms, lower bound of the retransmit timer */
+#define IPMI_LAN_RXQ_LEN          16  /* datagrams drained per recvmmsg() */
+
+struct lanplus_crypt_ctx;
+struct ipmi_stats;
+struct sdr_record_list;
+struct sdr_index;
+struct ipmi_sdr_iterator;
 
 struct ipmi_session {
 	char *hostname; /* Numeric IP adress or DNS name - see RFC 1034/RFC 1035 */
+	char *cachefile; /* lanplus session cache, see -F */
 	uint8_t username[17];
 	uint8_t authcode[IPMI_AUTHCODE_BUFFER_SIZE + 1];
 	uint8_t challenge[16];
@@ -83,11 +92,25 @@ struct ipmi_session {
 	int port;
 	int active;
 	int retry;
+	int window;	/* max requests in flight, see sendrecv_window */
+	uint8_t rq_seq;	/* last IPMI request sequence number handed out */
+	uint8_t bridge_possible;
 
 	uint32_t session_id;
 	uint32_t in_seq;
 	uint32_t out_seq;
 	uint32_t timeout;
+	uint32_t timeout_ms;	/* -N in milliseconds, see ipmi_intf_session_rto */
+
+	/*
+	 * Retransmission timer state for lan and lanplus (RFC 6298), in
+	 * milliseconds.  srtt is scaled by 8 and rttvar by 4.
+	 */
+	struct {
+		uint32_t srtt;
+		uint32_t rttvar;
+		uint32_t wait;	/* receive wait for the current try, 0 = timeout */
+	} rtt;
 
 	struct sockaddr_storage addr;
 	socklen_t addrlen;
@@ -129,6 +152,9 @@ struct ipmi_session {
 		uint8_t kg[IPMI_KG_BUFFER_SIZE];   /* BMC key */
 		uint8_t k1[20];   /* Used for Integrity checking? */
 		uint8_t k2[20];   /* First 16 bytes used for AES  */
+
+		/* K1/K2 keyed cipher and HMAC state, see lanplus_crypt_impl.c */
+		struct lanplus_crypt_ctx * crypt_ctx;
 	} v2_data;
 
 
@@ -146,12 +172,83 @@ struct ipmi_session {
 		uint8_t last_received_byte_count;
 		void (*sol_input_handler)(struct ipmi_rs * rsp);
 	} sol_data;
+
+	/*
+	 * Outstanding requests, indexed by IPMI request sequence number
+	 */
+	struct ipmi_rq_entry rq_entries[IPMI_RQ_SEQ_MAX];
+
+	/*
+	 * Receive buffer, responses handed back by the transport point here
+	 */
+	struct ipmi_rs rsp;
+
+	/*
+	 * Datagrams read ahead of time by the lanplus receive path
+	 */
+	struct {
+		uint8_t data[IPMI_LAN_RXQ_LEN][IPMI_BUF_SIZE];
+		int len[IPMI_LAN_RXQ_LEN];
+		int head;
+		int count;
+	} rxq;
+
+	/*
+	 * Transmit buffers for lan and lanplus: one per request table slot,
+	 * handed out as rq_entries[].msg_data, and a last one for messages
+	 * that are not kept in the table (session setup, SOL)
+	 */
+	uint8_t txbuf[IPMI_RQ_SEQ_MAX + 1][IPMI_BUF_SIZE];
+};
+
+/*
+ * IPMB addressing of a request, from the interface target fields
+ */
+struct ipmi_rq_target {
+	uint32_t target_addr;
+	uint8_t target_channel;
+	uint32_t transit_addr;
+	uint8_t transit_channel;
+};
+
+/*
+ * A request handed to ipmi_intf_submit()
+ */
+struct ipmi_async_rq {
+	struct ipmi_rq * req;
+	struct ipmi_rq_target to;	/* intf target at submit time */
+	void (*done)(struct ipmi_intf * intf, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx);
+	void * ctx;
+	int tries;	/* transmissions so far */
+	uint32_t sent;	/* ipmi_intf_msec() of the last transmission */
+	uint64_t start;	/* first transmission, for ipmi_stats_record() */
+	struct ipmi_async_rq * next;
+};
+
+/*
+ * Submitted requests of an interface, see ipmi_intf_poll().  Interfaces
+ * with a poll hook move requests from the queue into slot[], indexed by
+ * the 6-bit sequence number they were sent with.
+ */
+struct ipmi_async {
+	struct ipmi_async_rq * head;	/* submitted, not sent yet */
+	struct ipmi_async_rq ** tail;
+	struct ipmi_async_rq * free;	/* completed, for reuse */
+	struct ipmi_async_rq * slot[IPMI_RQ_SEQ_MAX];
+	int queued;
+	int inflight;
+	int aborting;
+	int timeout;	/* ms from stamp until poll is due again, -1 = none */
+	uint32_t stamp;
 };
 
 struct ipmi_cmd {
 	int (*func)(struct ipmi_intf * intf, int argc, char ** argv);
 	const char * name;
 	const char * desc;
+	/* non-zero if func() needs no BMC for these arguments, may be NULL */
+	int (*offline)(int argc, char ** argv);
 };
 
 struct ipmi_intf_support {
@@ -185,10 +282,48 @@ struct ipmi_intf {
 
 	uint8_t devnum;
 
+	struct ipmi_stats * stats;	/* NULL unless statistics are collected */
+	struct ipmi_async * async;	/* NULL until ipmi_intf_submit() */
+	struct ipmi_rs rsp;	/* response buffer of interfaces without a session */
+	void * priv;	/* state of the interface plugin, allocated and freed by it */
+
+	/*
+	 * SDR repository of this BMC as read by ipmi_sdr_list_cache(),
+	 * see ipmi_sdr_list_empty()
+	 */
+	struct {
+		struct sdr_record_list * head;
+		struct sdr_record_list * tail;
+		struct ipmi_sdr_iterator * itr;
+		struct sdr_index * index;	/* lookup tables over the list */
+		struct {
+			uint8_t * base;		/* SDR cache file in use */
+			size_t len;
+			struct sdr_record_list * nodes;	/* its list entries */
+			int count;
+		} map;
+		int max_read_len;
+		int use_built_in;	/* Uses DeviceSDRs instead of SDRR */
+		char * cache_dir;	/* automatic cache, NULL if disabled */
+		int extended;		/* sdr elist style status names */
+		/* BMC identity and repository info of the last ipmi_sdr_start() */
+		uint32_t manufacturer;
+		uint16_t product;
+		uint16_t firmware;	/* major and minor firmware revision */
+		uint16_t count;
+		uint32_t add_stamp;
+		uint32_t erase_stamp;
+	} sdr;
+
 	int (*setup)(struct ipmi_intf * intf);
 	int (*open)(struct ipmi_intf * intf);
 	void (*close)(struct ipmi_intf * intf);
 	struct ipmi_rs *(*sendrecv)(struct ipmi_intf * intf, struct ipmi_rq * req);
+	int (*sendrecv_window)(struct ipmi_intf * intf, struct ipmi_rq * reqs, int count,
+			void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+				struct ipmi_rs * rsp, void * ctx),
+			void * ctx);
+	int (*poll)(struct ipmi_intf * intf, int timeout);
 	int (*sendrsp)(struct ipmi_intf * intf, struct ipmi_rs * rsp);
 	struct ipmi_rs *(*recv_sol)(struct ipmi_intf * intf);
 	struct ipmi_rs *(*send_sol)(struct ipmi_intf * intf, struct ipmi_v2_payload * payload);
@@ -199,10 +334,13 @@ struct ipmi_intf {
 };
 
 struct ipmi_intf * ipmi_intf_load(char * name);
+struct ipmi_intf * ipmi_intf_new(const char * name);
+void ipmi_intf_free(struct ipmi_intf * intf);
 void ipmi_intf_print(struct ipmi_intf_support * intflist);
 
 void ipmi_intf_session_set_hostname(struct ipmi_intf * intf, char * hostname);
 void ipmi_intf_session_set_username(struct ipmi_intf * intf, char * username);
+void ipmi_intf_session_set_cachefile(struct ipmi_intf * intf, char * cachefile);
 void ipmi_intf_session_set_password(struct ipmi_intf * intf, char * password);
 void ipmi_intf_session_set_privlvl(struct ipmi_intf * intf, uint8_t privlvl);
 void ipmi_intf_session_set_lookupbit(struct ipmi_intf * intf, uint8_t lookupbit);
@@ -212,10 +350,51 @@ void ipmi_intf_session_set_kgkey(struct ipmi_intf * intf, char * kgkey);
 void ipmi_intf_session_set_port(struct ipmi_intf * intf, int port);
 void ipmi_intf_session_set_authtype(struct ipmi_intf * intf, uint8_t authtype);
 void ipmi_intf_session_set_timeout(struct ipmi_intf * intf, uint32_t timeout);
+void ipmi_intf_session_set_timeout_ms(struct ipmi_intf * intf, uint32_t timeout_ms);
 void ipmi_intf_session_set_retry(struct ipmi_intf * intf, int retry);
+void ipmi_intf_session_set_window(struct ipmi_intf * intf, int window);
 void ipmi_intf_session_cleanup(struct ipmi_intf *intf);
 void ipmi_cleanup(struct ipmi_intf * intf);
 
+int ipmi_intf_get_window(struct ipmi_intf * intf);
+
+uint32_t ipmi_intf_msec(void);
+uint32_t ipmi_intf_session_timeout_ms(struct ipmi_intf * intf);
+uint32_t ipmi_intf_session_wait(struct ipmi_intf * intf);
+uint32_t ipmi_intf_session_rto(struct ipmi_intf * intf, int try);
+void ipmi_intf_session_rtt_sample(struct ipmi_intf * intf, uint32_t rtt);
+
+struct ipmi_rq_entry * ipmi_req_add_entry(struct ipmi_intf * intf,
+		struct ipmi_rq * req, uint8_t req_seq);
+struct ipmi_rq_entry * ipmi_req_lookup_entry(struct ipmi_intf * intf,
+		uint8_t seq, uint8_t cmd);
+struct ipmi_rq_entry * ipmi_req_move_entry(struct ipmi_intf * intf,
+		struct ipmi_rq_entry * e, uint8_t seq);
+void ipmi_req_remove_entry(struct ipmi_intf * intf, uint8_t seq, uint8_t cmd);
+void ipmi_req_clear_entries(struct ipmi_intf * intf);
+int ipmi_intf_sendrecv_window(struct ipmi_intf * intf, struct ipmi_rq * reqs, int count,
+		void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx);
+
+int ipmi_intf_submit(struct ipmi_intf * intf, struct ipmi_rq * req,
+		void (*done)(struct ipmi_intf * intf, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx);
+int ipmi_intf_poll(struct ipmi_intf * intf, int timeout);
+void ipmi_intf_get_target(struct ipmi_intf * intf, struct ipmi_rq_target * to);
+void ipmi_intf_set_target(struct ipmi_intf * intf, struct ipmi_rq_target * to);
+int ipmi_intf_same_target(struct ipmi_rq_target * a, struct ipmi_rq_target * b);
+int ipmi_intf_pending(struct ipmi_intf * intf);
+int ipmi_intf_get_fd(struct ipmi_intf * intf);
+int ipmi_intf_get_timeout(struct ipmi_intf * intf);
+void ipmi_intf_async_cleanup(struct ipmi_intf * intf);
+struct ipmi_async_rq * ipmi_async_next(struct ipmi_intf * intf);
+void ipmi_async_done(struct ipmi_intf * intf, struct ipmi_async_rq * e,
+		struct ipmi_rs * rsp);
+int ipmi_async_abort(struct ipmi_intf * intf);
+void ipmi_async_set_timeout(struct ipmi_intf * intf, int timeout);
+
 #if defined(IPMI_INTF_LAN) || defined (IPMI_INTF_LANPLUS)
 int  ipmi_intf_socket_connect(struct ipmi_intf * intf);
 #endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#ifndef IPMI_PROXY_H
+#define IPMI_PROXY_H
+
+#include <inttypes.h>
+
+#define IPMI_PROXY_DIR		"/var/run/ipmiproxyd"
+#define IPMI_PROXY_LOCAL	"local"	/* socket name without -H */
+#define IPMI_PROXY_VERSION	1
+
+/* status of a proxied request */
+#define IPMI_PROXY_OK		0x00
+#define IPMI_PROXY_NORESP	0x01	/* no response from the BMC */
+
+/*
+ * ipmiproxyd and the proxy interface talk over a Unix stream socket in
+ * host byte order.  On connect the daemon sends a hello, after that
+ * the client sends requests and the daemon answers them.  Each header
+ * is followed by data_len bytes of message data.  A client may have
+ * several requests outstanding; responses carry the id of their
+ * request and may come back in any order.
+ */
+struct ipmi_proxy_hello {
+	uint32_t version;
+	uint16_t max_request_data_size;
+	uint16_t max_response_data_size;
+};
+
+struct ipmi_proxy_rq {
+	uint32_t id;
+	uint8_t netfn;
+	uint8_t lun;
+	uint8_t cmd;
+	uint8_t target_addr;
+	uint8_t target_channel;
+	uint8_t transit_addr;
+	uint8_t transit_channel;
+	uint8_t reserved;
+	uint16_t data_len;
+	uint16_t reserved2;
+};
+
+struct ipmi_proxy_rs {
+	uint32_t id;
+	uint8_t status;
+	uint8_t ccode;
+	uint16_t data_len;
+};
+
+#endif /* IPMI_PROXY_H */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#ifndef IPMI_SAMPLE_H
+#define IPMI_SAMPLE_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_sdr.h>
+
+/*
+ * Sensor sample files are append-only.  A 16 byte header ("ipmisamp",
+ * 16-bit version, 16-bit flags, 32 reserved bits) is followed by
+ * blocks made of a tag byte, the payload length and the payload:
+ *
+ *  'D'  dictionary: the column count, then per column the SDR record
+ *       type, length and body.  The record names the sensor and holds
+ *       its conversion factors.  Every writer starts with one,
+ *       unless the last one in the file has the same columns.
+ *  'S'  samples: the row and column counts, the time of each row in
+ *       ms since the epoch, then per column the raw readings followed
+ *       by the rest of the Get Sensor Reading responses.
+ *
+ * Integers are unsigned LEB128 varints.  Times and readings are zigzag
+ * deltas from the row before, starting from 0 in each block.  The rest
+ * of a response (its length and bytes 1 to 3) is run-length coded.
+ */
+#define IPMI_SAMPLE_MAGIC	"ipmisamp"
+#define IPMI_SAMPLE_VERSION	1
+#define IPMI_SAMPLE_HDR_LEN	16
+#define IPMI_SAMPLE_ROWS	60	/* rows buffered per sample block */
+
+#define IPMI_SAMPLE_DICT	'D'
+#define IPMI_SAMPLE_DATA	'S'
+
+struct ipmi_sample_file {
+	FILE * fp;
+	char * name;
+	struct sdr_sweep_entry * sw;	/* the columns */
+	int cols;
+	int rows;			/* buffered, not written yet */
+	uint64_t time[IPMI_SAMPLE_ROWS];
+	uint8_t * reading;		/* IPMI_SAMPLE_ROWS x cols */
+	uint32_t * state;		/* response length << 24 | bytes 1-3 */
+	uint8_t * buf;			/* encoded block */
+	size_t size;
+};
+
+struct ipmi_sample_file * ipmi_sample_open(const char * file,
+		struct sdr_sweep_entry * sw, int cols);
+int ipmi_sample_add(struct ipmi_sample_file * sf);
+int ipmi_sample_close(struct ipmi_sample_file * sf);
+int ipmi_sample_read(const char * file, int precision,
+		int (*row)(uint64_t msec, struct sdr_sweep_entry * sw,
+			int cols, int first, void * ctx),
+		void * ctx);
+
+#endif /* IPMI_SAMPLE_H */
@@ -745,6 +745,7 @@ struct ipmi_sdr_iterator {
 	int total;
 	int next;
 	int use_built_in;
+	struct sdr_get_rs header;	/* ipmi_sdr_get_next_header() result */
 };
 
 #ifdef HAVE_PRAGMA_PACK
@@ -832,6 +833,21 @@ struct sensor_reading {
 	double		s_a_val;		/* read value converted to analog */
 	char		s_a_str[16];		/* analog value as a string */
 	const char	*s_a_units;		/* analog value units string */
+	char		s_units[16];		/* s_a_units of analog sensors */
+};
+
+/*
+ * A sensor read by ipmi_sdr_sweep(): its reading and, if asked for,
+ * the data of its Get Sensor Thresholds response
+ */
+struct sdr_sweep_entry {
+	struct sdr_record_list	*entry;
+	struct sensor_reading	sr;
+	uint8_t			raw[4];		/* Get Sensor Reading data */
+	int			raw_len;	/* 0 if the request failed */
+	int			ccode;		/* -1 if there was no response */
+	uint8_t			thresh[7];	/* mask, then lnc..unr */
+	int			thresh_len;	/* 0 if not available */
 };
 
 /*
@@ -883,13 +899,28 @@ struct sensor_reading *
 ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
 		struct sdr_record_common_sensor *sensor,
 		uint8_t sdr_record_type, int precision);
-const char *ipmi_sdr_get_thresh_status(struct sensor_reading *sr,
+int ipmi_sdr_sweep(struct ipmi_intf *intf, struct sdr_sweep_entry *sw,
+		   int count, int precision, int thresholds);
+int ipmi_sdr_decode_sensor_reading(struct ipmi_intf *intf,
+				   struct sdr_record_common_sensor *sensor,
+				   uint8_t sdr_record_type,
+				   const uint8_t *data, int data_len,
+				   int precision, const double *value,
+				   struct sensor_reading *sr);
+int ipmi_sdr_print_sensor_reading(struct ipmi_intf *intf,
+				  struct sdr_record_common_sensor *sensor,
+				  uint8_t sdr_record_type,
+				  struct sensor_reading *sr);
+const char *ipmi_sdr_get_thresh_status(struct ipmi_intf *intf,
+					struct sensor_reading *sr,
 					const char *invalidstr);
 const char *ipmi_sdr_get_status(int, const char *, uint8_t stat);
 double sdr_convert_sensor_tolerance(struct sdr_record_full_sensor *sensor,
 				  uint8_t val);
 double sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor,
 				  uint8_t val);
+void sdr_convert_sensor_readings(struct sdr_record_full_sensor *sensor,
+				 const uint8_t *raw, double *out, int count);
 double sdr_convert_sensor_hysterisis(struct sdr_record_full_sensor *sensor,
 				  uint8_t val);
 uint8_t sdr_convert_sensor_value_to_raw(struct sdr_record_full_sensor *sensor,
@@ -907,7 +938,8 @@ struct ipmi_rs *ipmi_sdr_get_sensor_thresholds(struct ipmi_intf *intf,
 struct ipmi_rs *ipmi_sdr_get_sensor_hysteresis(struct ipmi_intf *intf,
 					       uint8_t sensor,
 					       uint8_t target, uint8_t lun, uint8_t channel);
-const char *ipmi_sdr_get_sensor_type_desc(const uint8_t type);
+const char *ipmi_sdr_get_sensor_type_desc(struct ipmi_intf *intf,
+					  const uint8_t type);
 int ipmi_sdr_get_reservation(struct ipmi_intf *intf, int use_builtin,
                              uint16_t * reserve_id);
 
@@ -935,6 +967,7 @@ struct sdr_record_list *ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf,
 						 uint8_t type);
 int ipmi_sdr_list_cache(struct ipmi_intf *intf);
 int ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile);
+int ipmi_sdr_cache_enable(struct ipmi_intf *intf, const char *dir);
 void ipmi_sdr_list_empty(struct ipmi_intf *intf);
 int ipmi_sdr_print_info(struct ipmi_intf *intf);
 void ipmi_sdr_print_discrete_state(const char *desc, uint8_t sensor_type,
@@ -100,6 +100,10 @@ int ipmi_sol_set_param_isvalid_uint8_t( const char *strval,
 					uint8_t *out_value);
 
 int ipmi_sol_main(struct ipmi_intf *, int, char **);
+int ipmi_sol_payload_access(struct ipmi_intf * intf, uint8_t channel,
+		uint8_t userid, int enable);
+int ipmi_sol_activate_payload(struct ipmi_intf * intf, int instance);
+int ipmi_sol_deactivate(struct ipmi_intf * intf, int instance);
 int ipmi_get_sol_info(struct ipmi_intf             * intf,
 					  uint8_t                  channel,
 					  struct sol_config_parameters * params);
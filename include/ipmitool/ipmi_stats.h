@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#ifndef IPMI_STATS_H
+#define IPMI_STATS_H
+
+#include <inttypes.h>
+#include <ipmitool/ipmi_intf.h>
+
+/*
+ * Latencies are kept in microseconds in a log-linear histogram with
+ * four buckets per power of two, so percentiles are accurate to
+ * within a quarter of an octave.
+ */
+#define IPMI_STATS_BUCKETS	128
+
+#define IPMI_STATS_TEXT		0
+#define IPMI_STATS_JSON		1
+
+struct ipmi_stats_hist {
+	uint32_t count;
+	uint32_t max;		/* usec */
+	uint64_t total;		/* usec */
+	uint32_t bucket[IPMI_STATS_BUCKETS];
+};
+
+struct ipmi_stats_cmd {
+	uint8_t netfn;
+	uint8_t cmd;
+	uint32_t errors;	/* responses with a non-zero completion code */
+	uint32_t noresp;	/* requests that were never answered */
+	struct ipmi_stats_hist lat;
+};
+
+struct ipmi_stats {
+	uint64_t start;		/* usec, when collection was enabled */
+
+	/* session setup, timed around intf->open() */
+	uint32_t setups;
+	uint64_t setup_us;
+
+	/* transport counters, maintained by the interface plugins */
+	uint32_t retransmits;
+	uint32_t timeouts;
+	uint32_t tx_packets;
+	uint32_t rx_packets;
+	uint64_t tx_bytes;
+	uint64_t rx_bytes;
+
+	/* request latency, overall and per netfn/cmd */
+	uint32_t errors;
+	uint32_t noresp;
+	struct ipmi_stats_hist lat;
+	struct ipmi_stats_cmd * cmd;
+	int cmd_count;
+	int cmd_size;
+
+	/* interface methods wrapped by ipmi_stats_enable() */
+	int (*open)(struct ipmi_intf * intf);
+	struct ipmi_rs *(*sendrecv)(struct ipmi_intf * intf, struct ipmi_rq * req);
+};
+
+/* bump a transport counter if statistics are being collected */
+#define IPMI_STATS_ADD(intf, field, n) \
+	do { \
+		if ((intf)->stats != NULL) \
+			(intf)->stats->field += (n); \
+	} while (0)
+
+uint64_t ipmi_stats_usec(void);
+int ipmi_stats_enable(struct ipmi_intf * intf);
+void ipmi_stats_reset(struct ipmi_intf * intf);
+void ipmi_stats_free(struct ipmi_intf * intf);
+void ipmi_stats_record(struct ipmi_intf * intf, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, uint64_t usec);
+void ipmi_stats_print(struct ipmi_intf * intf, int format);
+int ipmi_stats_main(struct ipmi_intf * intf, int argc, char ** argv);
+
+#endif /* IPMI_STATS_H */
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#ifndef LIBIPMITOOL_H
+#define LIBIPMITOOL_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Public interface of libipmitool.so.
+ *
+ * Every handle carries its own session and state.  Different handles
+ * may be used from different threads at the same time, one handle
+ * must only be used by one thread at a time.  ipmitool_init() must be
+ * called once before any other function and before threads are
+ * started.
+ */
+#define LIBIPMITOOL_VERSION	1
+
+struct ipmi_intf;
+
+/* options for ipmitool_set() */
+#define IPMITOOL_OPT_HOSTNAME	1	/* BMC address */
+#define IPMITOOL_OPT_PORT	2	/* UDP port */
+#define IPMITOOL_OPT_USERNAME	3
+#define IPMITOOL_OPT_PASSWORD	4
+#define IPMITOOL_OPT_KGKEY	5	/* lanplus BMC key */
+#define IPMITOOL_OPT_PRIVLVL	6	/* CALLBACK, USER, OPERATOR or ADMINISTRATOR */
+#define IPMITOOL_OPT_CIPHER	7	/* lanplus cipher suite id */
+#define IPMITOOL_OPT_TIMEOUT	8	/* per try, in milliseconds */
+#define IPMITOOL_OPT_RETRY	9
+#define IPMITOOL_OPT_WINDOW	10	/* requests in flight */
+#define IPMITOOL_OPT_DEVICE	11	/* open: device number, others: device path */
+#define IPMITOOL_OPT_TARGET	12	/* bridge to this IPMB address */
+#define IPMITOOL_OPT_CHANNEL	13	/* channel of the bridge target */
+
+int ipmitool_init(int verbose);
+struct ipmi_intf * ipmitool_new(const char * intfname);
+int ipmitool_set(struct ipmi_intf * intf, int opt, const char * value);
+int ipmitool_open(struct ipmi_intf * intf);
+void ipmitool_free(struct ipmi_intf * intf);
+
+/*
+ * Send one request and wait for the response.  The response is copied
+ * to @rsp, completion code first.  Returns the number of bytes copied,
+ * or -1 if there was no response.
+ */
+int ipmitool_raw(struct ipmi_intf * intf, uint8_t netfn, uint8_t cmd,
+		const uint8_t * data, int data_len, uint8_t * rsp, int rsp_size);
+
+/*
+ * Queue a request, done() is called from ipmitool_poll() with the
+ * response, completion code first, or with a NULL response.  The
+ * request data is copied.
+ */
+int ipmitool_submit(struct ipmi_intf * intf, uint8_t netfn, uint8_t cmd,
+		const uint8_t * data, int data_len,
+		void (*done)(void * ctx, const uint8_t * rsp, int rsp_len),
+		void * ctx);
+int ipmitool_poll(struct ipmi_intf * intf, int timeout);
+int ipmitool_pending(struct ipmi_intf * intf);
+int ipmitool_get_fd(struct ipmi_intf * intf);
+int ipmitool_get_timeout(struct ipmi_intf * intf);
+
+const char * ipmitool_ccode_str(uint8_t ccode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBIPMITOOL_H */
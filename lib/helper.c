@@ -75,7 +75,7 @@ uint16_t buf2short(uint8_t * buf)
 
 const char * buf2str(uint8_t * buf, int len)
 {
-	static char str[2049];
+	static IPMI_TLS char str[2049];
 	int i;
 
 	if (len <= 0 || len > 1024)
@@ -112,7 +112,7 @@ void printbuf(const uint8_t * buf, int len, const char * desc)
 
 const char * val2str(uint16_t val, const struct valstr *vs)
 {
-	static char un_str[32];
+	static IPMI_TLS char un_str[32];
 	int i;
 
 	for (i = 0; vs[i].str != NULL; i++) {
@@ -129,7 +129,7 @@ const char * val2str(uint16_t val, const struct valstr *vs)
 const char * oemval2str(uint32_t oem, uint16_t val,
                                              const struct oemvalstr *vs)
 {
-	static char un_str[32];
+	static IPMI_TLS char un_str[32];
 	int i;
 
 	for (i = 0; vs[i].oem != 0xffffff &&  vs[i].str != NULL; i++) {
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi_fanout.h>
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#define FANOUT_LINE_MAX		1024
+
+/*
+ * One worker runs the requested command against one host.  Its stdout
+ * and stderr are pipes that the parent drains line by line.
+ */
+struct fanout_worker {
+	const char * host;
+	pid_t pid;
+	int fd[2];			/* read ends of stdout, stderr */
+	char buf[2][FANOUT_LINE_MAX];
+	size_t len[2];
+};
+
+/* fanout_add_host  -  append a host name to the list, growing it as needed
+ *
+ * returns -1 on error
+ */
+static int
+fanout_add_host(char *** hosts, int * count, int * size, const char * name)
+{
+	char ** tmp;
+
+	while (*name && isspace((unsigned char)*name))
+		name++;
+	if (*name == '\0' || *name == '#')
+		return 0;
+
+	if (*count == *size) {
+		*size = *size ? *size * 2 : 64;
+		tmp = realloc(*hosts, *size * sizeof(char *));
+		if (tmp == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+		*hosts = tmp;
+	}
+
+	(*hosts)[*count] = strdup(name);
+	if ((*hosts)[*count] == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	(*count)++;
+	return 0;
+}
+
+/* ipmi_fanout_hosts  -  expand -H @hostfile or -H host1,host2,...
+ *
+ * A host file has one host per line, blank lines and lines starting
+ * with '#' are skipped.
+ *
+ * returns number of hosts, -1 on error
+ */
+int
+ipmi_fanout_hosts(const char * spec, char *** hosts)
+{
+	char line[256];
+	char * copy, * tok, * end;
+	FILE * fp;
+	int count = 0, size = 0, rc = 0;
+
+	*hosts = NULL;
+
+	if (spec[0] == '@') {
+		fp = ipmi_open_file_read(spec + 1);
+		if (fp == NULL)
+			return -1;
+		while (rc == 0 && fgets(line, sizeof(line), fp) != NULL) {
+			end = line + strlen(line);
+			while (end > line && isspace((unsigned char)end[-1]))
+				*--end = '\0';
+			rc = fanout_add_host(hosts, &count, &size, line);
+		}
+		fclose(fp);
+	} else {
+		copy = strdup(spec);
+		if (copy == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+		for (tok = strtok(copy, ","); rc == 0 && tok != NULL;
+				tok = strtok(NULL, ","))
+			rc = fanout_add_host(hosts, &count, &size, tok);
+		free(copy);
+	}
+
+	if (rc < 0) {
+		while (count > 0)
+			free((*hosts)[--count]);
+		free(*hosts);
+		*hosts = NULL;
+		return -1;
+	}
+	return count;
+}
+
+/* fanout_emit  -  print complete lines from a worker buffer with host prefix
+ *
+ * @flush:	also print a trailing partial line
+ */
+static void
+fanout_emit(struct fanout_worker * w, int i, int flush)
+{
+	FILE * out = i ? stderr : stdout;
+	char * start = w->buf[i];
+	char * nl;
+	size_t left = w->len[i];
+
+	while (left > 0 && (nl = memchr(start, '\n', left)) != NULL) {
+		fprintf(out, "%s: %.*s\n", w->host, (int)(nl - start), start);
+		left -= nl - start + 1;
+		start = nl + 1;
+	}
+
+	/* overlong line or end of stream */
+	if (left > 0 && (flush || left == FANOUT_LINE_MAX)) {
+		fprintf(out, "%s: %.*s\n", w->host, (int)left, start);
+		left = 0;
+	}
+
+	memmove(w->buf[i], start, left);
+	w->len[i] = left;
+	fflush(out);
+}
+
+/* fanout_start  -  fork a worker for a host
+ *
+ * returns 0 in the worker, pid in the parent, -1 on error
+ */
+static pid_t
+fanout_start(struct fanout_worker * workers, int jobs, struct fanout_worker * w)
+{
+	int out[2], err[2];
+	int i;
+
+	if (pipe(out) < 0) {
+		lperror(LOG_ERR, "pipe");
+		return -1;
+	}
+	if (pipe(err) < 0) {
+		lperror(LOG_ERR, "pipe");
+		close(out[0]);
+		close(out[1]);
+		return -1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	w->pid = fork();
+	if (w->pid < 0) {
+		lperror(LOG_ERR, "fork");
+		close(out[0]); close(out[1]);
+		close(err[0]); close(err[1]);
+		return -1;
+	}
+
+	if (w->pid == 0) {
+		/* worker: drop the other workers' pipes */
+		for (i = 0; i < jobs; i++) {
+			if (workers[i].pid <= 0 || &workers[i] == w)
+				continue;
+			if (workers[i].fd[0] >= 0)
+				close(workers[i].fd[0]);
+			if (workers[i].fd[1] >= 0)
+				close(workers[i].fd[1]);
+		}
+		close(out[0]);
+		close(err[0]);
+		dup2(out[1], STDOUT_FILENO);
+		dup2(err[1], STDERR_FILENO);
+		close(out[1]);
+		close(err[1]);
+		setvbuf(stdout, NULL, _IOLBF, 0);
+		return 0;
+	}
+
+	close(out[1]);
+	close(err[1]);
+	w->fd[0] = out[0];
+	w->fd[1] = err[0];
+	w->len[0] = w->len[1] = 0;
+	return w->pid;
+}
+
+/* ipmi_fanout  -  run the command once per host of a host list
+ *
+ * If *hostname is "@file" or a comma separated list, fork one worker
+ * per host with at most @jobs of them running at once.  Each worker
+ * returns to the caller with *hostname set to its own host and carries
+ * on as a normal single host invocation; the parent prefixes every
+ * line the workers print with the host name.
+ *
+ * Commands are blocking calls through intf->sendrecv() that print as
+ * they go, so hosts are not driven from one event loop.  Workers are
+ * forked from the already set up process and never exec; each opens
+ * its own session, which -F lets a later sweep resume.
+ *
+ * @hostname:	-H argument, replaced by the worker's host
+ * @jobs:	max workers running at once, 0 for the default
+ * @rc:		set in the parent, 0 if every worker succeeded
+ *
+ * returns 0 if the caller should go on with *hostname
+ * returns 1 in the parent once all workers have finished
+ * returns -1 on error
+ */
+int
+ipmi_fanout(char ** hostname, int jobs, int * rc)
+{
+	struct fanout_worker * workers = NULL;
+	struct pollfd * pfd = NULL;
+	struct fanout_worker ** pfw = NULL;
+	int * pfi = NULL;
+	char ** hosts = NULL;
+	char buf[FANOUT_LINE_MAX];
+	int count, next = 0, running = 0, failed = 0;
+	int i, j, n, status;
+	pid_t rv;
+	ssize_t len;
+	int ret = -1;
+
+	if ((*hostname)[0] != '@' && strchr(*hostname, ',') == NULL)
+		return 0;
+
+	count = ipmi_fanout_hosts(*hostname, &hosts);
+	if (count < 0)
+		goto out;
+	if (count == 0) {
+		lprintf(LOG_ERR, "No hosts found in '%s'", *hostname);
+		goto out;
+	}
+
+	if (jobs <= 0)
+		jobs = IPMI_FANOUT_JOBS;
+	if (jobs > count)
+		jobs = count;
+
+	workers = calloc(jobs, sizeof(struct fanout_worker));
+	pfd = calloc(jobs * 2, sizeof(struct pollfd));
+	pfw = calloc(jobs * 2, sizeof(struct fanout_worker *));
+	pfi = calloc(jobs * 2, sizeof(int));
+	if (workers == NULL || pfd == NULL || pfw == NULL || pfi == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		goto out;
+	}
+
+	while (next < count || running > 0) {
+		/* start workers up to the concurrency cap */
+		for (i = 0; i < jobs && next < count; i++) {
+			if (workers[i].pid > 0)
+				continue;
+			workers[i].host = hosts[next];
+			switch (fanout_start(workers, jobs, &workers[i])) {
+			case -1:
+				lprintf(LOG_ERR, "%s: unable to start worker",
+						hosts[next]);
+				workers[i].pid = 0;
+				failed++;
+				break;
+			case 0:
+				/* worker: hand our host back to the caller */
+				free(*hostname);
+				*hostname = hosts[next];
+				hosts[next] = NULL;
+				ret = 0;
+				goto out;
+			default:
+				running++;
+				break;
+			}
+			next++;
+		}
+
+		n = 0;
+		for (i = 0; i < jobs; i++) {
+			if (workers[i].pid <= 0)
+				continue;
+			for (j = 0; j < 2; j++) {
+				if (workers[i].fd[j] < 0)
+					continue;
+				pfd[n].fd = workers[i].fd[j];
+				pfd[n].events = POLLIN;
+				pfw[n] = &workers[i];
+				pfi[n] = j;
+				n++;
+			}
+		}
+
+		if (n > 0 && poll(pfd, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct fanout_worker * w = pfw[i];
+
+			if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+
+			j = pfi[i];
+			len = read(w->fd[j], buf,
+					FANOUT_LINE_MAX - w->len[j]);
+			if (len > 0) {
+				memcpy(w->buf[j] + w->len[j], buf, len);
+				w->len[j] += len;
+				fanout_emit(w, j, 0);
+				continue;
+			}
+			if (len < 0 && errno == EINTR)
+				continue;
+
+			fanout_emit(w, j, 1);
+			close(w->fd[j]);
+			w->fd[j] = -1;
+		}
+
+		/* reap workers whose output is fully drained */
+		for (i = 0; i < jobs; i++) {
+			struct fanout_worker * w = &workers[i];
+
+			if (w->pid <= 0 || w->fd[0] >= 0 || w->fd[1] >= 0)
+				continue;
+
+			while ((rv = waitpid(w->pid, &status, 0)) < 0 &&
+					errno == EINTR)
+				;
+			if (rv < 0) {
+				lperror(LOG_ERR, "%s: waitpid", w->host);
+				failed++;
+			} else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				lprintf(LOG_DEBUG, "%s: worker exited with status 0x%x",
+						w->host, status);
+				failed++;
+			}
+			w->pid = 0;
+			running--;
+		}
+	}
+
+	if (failed > 0)
+		lprintf(LOG_NOTICE, "%d of %d hosts failed", failed, count);
+	*rc = failed ? -1 : 0;
+	ret = 1;
+
+out:
+	if (hosts != NULL) {
+		for (i = 0; i < count; i++)
+			if (hosts[i] != NULL)
+				free(hosts[i]);
+		free(hosts);
+	}
+	if (workers != NULL)
+		free(workers);
+	if (pfd != NULL)
+		free(pfd);
+	if (pfw != NULL)
+		free(pfw);
+	if (pfi != NULL)
+		free(pfi);
+	return ret;
+}
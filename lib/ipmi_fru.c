@@ -582,6 +582,103 @@ write_fru_area(struct ipmi_intf * intf, struct fru_info *fru, uint8_t id,
 	return doffset >= finish;
 }
 
+/* fru_window_ctx  -  state shared with read_fru_window_done()
+*/
+struct fru_window_ctx {
+	struct fru_info * fru;
+	uint8_t * frubuf;	/* buffer position of the first chunk */
+	uint8_t * len;		/* requested length of each chunk */
+	uint8_t * ok;		/* set once a chunk has been copied in */
+};
+
+static void
+read_fru_window_done(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, void * ctx)
+{
+	struct fru_window_ctx * wc = (struct fru_window_ctx *)ctx;
+	uint32_t tmp;
+
+	if (rsp == NULL || rsp->ccode > 0 || rsp->data_len < 1)
+		return;
+
+	tmp = wc->fru->access ? rsp->data[0] << 1 : rsp->data[0];
+	if (tmp != wc->len[idx] || rsp->data_len < tmp + 1)
+		return;
+
+	memcpy(wc->frubuf + idx * wc->fru->max_read_size, rsp->data + 1, tmp);
+	wc->ok[idx] = 1;
+}
+
+/* read_fru_window  -  read FRU chunks with several requests in flight
+*
+* Issues one Get FRU Data request per max_read_size chunk of
+* [offset, finish) through ipmi_intf_sendrecv_window().  Only the
+* leading run of chunks that came back complete is kept; the caller
+* reads the remainder one request at a time, which also takes care
+* of shrinking the chunk size on C8h/CAh completion codes.
+*
+* returns number of bytes read into frubuf
+*/
+static uint32_t
+read_fru_window(struct ipmi_intf * intf, struct fru_info *fru, uint8_t id,
+			uint32_t offset, uint32_t finish, uint8_t *frubuf)
+{
+	struct fru_window_ctx wc;
+	struct ipmi_rq * reqs;
+	uint8_t * data;
+	uint32_t off, tmp;
+	int count, i;
+
+	count = (finish - offset + fru->max_read_size - 1) / fru->max_read_size;
+	if (count < 2)
+		return 0;
+
+	reqs = calloc(count, sizeof(struct ipmi_rq));
+	data = calloc(count, 4);
+	wc.len = calloc(count, 1);
+	wc.ok = calloc(count, 1);
+	if (reqs == NULL || data == NULL || wc.len == NULL || wc.ok == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		count = 0;
+		goto out;
+	}
+	wc.fru = fru;
+	wc.frubuf = frubuf;
+
+	for (i = 0, off = offset; i < count; i++, off += fru->max_read_size) {
+		tmp = fru->access ? off >> 1 : off;
+		data[i * 4] = id;
+		data[i * 4 + 1] = (uint8_t)(tmp & 0xff);
+		data[i * 4 + 2] = (uint8_t)(tmp >> 8);
+		tmp = finish - off;
+		if (tmp > fru->max_read_size)
+			tmp = fru->max_read_size;
+		data[i * 4 + 3] = wc.len[i] = (uint8_t)tmp;
+
+		reqs[i].msg.netfn = IPMI_NETFN_STORAGE;
+		reqs[i].msg.cmd = GET_FRU_DATA;
+		reqs[i].msg.data = &data[i * 4];
+		reqs[i].msg.data_len = 4;
+	}
+
+	ipmi_intf_sendrecv_window(intf, reqs, count,
+			read_fru_window_done, &wc);
+
+	for (i = 0, off = 0; i < count && wc.ok[i]; i++)
+		off += wc.len[i];
+	if (i < count)
+		lprintf(LOG_INFO, "Windowed FRU read stopped at chunk %d of %d",
+				i, count);
+	count = off;
+
+out:
+	free(reqs);
+	free(data);
+	free(wc.len);
+	free(wc.ok);
+	return count;
+}
+
 /* read_fru_area  -  fill in frubuf[offset:length] from the FRU[offset:length]
 *
 * @intf:   ipmi interface
@@ -650,6 +747,14 @@ read_fru_area(struct ipmi_intf * intf, struct fru_info *fru, uint8_t id,
 		}
 	}
 
+	if (ipmi_intf_get_window(intf) > 1) {
+		tmp = read_fru_window(intf, fru, id, off, finish, frubuf);
+		off += tmp;
+		frubuf += tmp;
+		if (off >= finish)
+			return 0;
+	}
+
 	do {
 		tmp = fru->access ? off >> 1 : off;
 		msg_data[0] = id;
@@ -68,13 +68,15 @@
 #include <ipmitool/ipmi_oem.h>
 #include <ipmitool/ipmi_ekanalyzer.h>
 #include <ipmitool/ipmi_picmg.h>
+#include <ipmitool/ipmi_fanout.h>
+#include <ipmitool/ipmi_stats.h>
 
 #ifdef HAVE_CONFIG_H
 # include <config.h>
 #endif
 
 #ifdef ENABLE_ALL_OPTIONS
-# define OPTION_STRING	"I:hVvcgsEKYao:H:d:P:f:U:p:C:L:A:t:T:m:z:S:l:b:B:e:k:y:O:R:N:D:"
+# define OPTION_STRING	"I:hVvcgsEKYao:H:d:P:f:U:p:C:L:A:t:T:m:z:S:l:b:B:e:k:y:O:R:N:D:W:j:F:Z:"
 #else
 # define OPTION_STRING	"I:hVvcH:f:U:p:d:S:D:"
 #endif
@@ -160,6 +162,29 @@ ipmi_cmd_print(struct ipmi_cmd * cmdlist)
 	lprintf(LOG_NOTICE, "");
 }
 
+/* ipmi_cmd_offline - check if a command from list needs no BMC
+ *
+ * @cmdlist:	command list
+ * @name:	command name
+ * @argc:	command argument count
+ * @argv:	command argument list
+ *
+ * returns offline() of that command if it has one
+ * returns 0 otherwise
+ */
+static int
+ipmi_cmd_offline(struct ipmi_cmd * cmdlist, char * name, int argc,
+		 char ** argv)
+{
+	struct ipmi_cmd * cmd;
+
+	for (cmd = cmdlist; cmd->func != NULL; cmd++) {
+		if (strcmp(name, cmd->name) == 0)
+			return cmd->offline != NULL && cmd->offline(argc, argv);
+	}
+	return 0;
+}
+
 /* ipmi_cmd_run - run a command from list based on parameters
  *                called from main()
  *
@@ -219,7 +244,8 @@ ipmi_option_usage(const char * progname, struct ipmi_cmd * cmdlist, struct ipmi_
 	lprintf(LOG_NOTICE, "       -c             Display output in comma separated format");
 	lprintf(LOG_NOTICE, "       -d N           Specify a /dev/ipmiN device to use (default=0)");
 	lprintf(LOG_NOTICE, "       -I intf        Interface to use");
-	lprintf(LOG_NOTICE, "       -H hostname    Remote host name for LAN interface");
+	lprintf(LOG_NOTICE, "       -H hostname    Remote host name for LAN interface,");
+	lprintf(LOG_NOTICE, "                      or host1,host2,... or @file to run on many hosts");
 	lprintf(LOG_NOTICE, "       -p port        Remote RMCP port [default=623]");
 	lprintf(LOG_NOTICE, "       -U username    Remote session username");
 	lprintf(LOG_NOTICE, "       -f file        Read remote session password from file");
@@ -248,8 +274,14 @@ ipmi_option_usage(const char * progname, struct ipmi_cmd * cmdlist, struct ipmi_
 	lprintf(LOG_NOTICE, "       -l lun         Set destination lun for raw commands");
 	lprintf(LOG_NOTICE, "       -o oemtype     Setup for OEM (use 'list' to see available OEM types)");
 	lprintf(LOG_NOTICE, "       -O seloem      Use file for OEM SEL event descriptions");
-	lprintf(LOG_NOTICE, "       -N seconds     Specify timeout for lan [default=2] / lanplus [default=1] interface");
+	lprintf(LOG_NOTICE, "       -N seconds     Specify timeout for lan [default=2] / lanplus [default=1] interface,");
+	lprintf(LOG_NOTICE, "                      append ms for milliseconds");
 	lprintf(LOG_NOTICE, "       -R retry       Set the number of retries for lan/lanplus interface [default=4]");
+	lprintf(LOG_NOTICE, "       -W window      Max requests in flight for lanplus bulk reads [default=1]");
+	lprintf(LOG_NOTICE, "       -j jobs        Max hosts handled at once with a host list [default=%d]",
+		IPMI_FANOUT_JOBS);
+	lprintf(LOG_NOTICE, "       -F file        Keep lanplus sessions open and resume them through file");
+	lprintf(LOG_NOTICE, "       -Z format      Print request and transport statistics at exit (text or json)");
 #endif
 	lprintf(LOG_NOTICE, "");
 
@@ -367,7 +399,12 @@ ipmi_main(int argc, char ** argv,
 	uint8_t my_long_packet_set=0;
 	uint8_t lookupbit = 0x10;	/* use name-only lookup by default */
 	int retry = 0;
-	uint32_t timeout = 0;
+	uint32_t timeout = 0;	/* milliseconds */
+	size_t timeout_len;
+	int window = 0;
+	int jobs = 0;
+	int stats = -1;
+	char * cachefile = NULL;
 	int authtype = -1;
 	char * tmp_pass = NULL;
 	char * tmp_env = NULL;
@@ -772,8 +809,58 @@ ipmi_main(int argc, char ** argv,
 			}
 			break;
 		case 'N':
-			if (str2uint(optarg, &timeout) != 0) {
-				lprintf(LOG_ERR, "Invalid parameter given or out of range for '-N'.");
+			/* seconds, or milliseconds with an "ms" suffix */
+			timeout_len = strlen(optarg);
+			if (timeout_len > 2 &&
+			    strcmp(optarg + timeout_len - 2, "ms") == 0) {
+				optarg[timeout_len - 2] = '\0';
+				if (str2uint(optarg, &timeout) != 0) {
+					lprintf(LOG_ERR, "Invalid parameter given or out of range for '-N'.");
+					rc = -1;
+					goto out_free;
+				}
+			} else {
+				if (str2uint(optarg, &timeout) != 0 ||
+				    timeout > UINT32_MAX / 1000) {
+					lprintf(LOG_ERR, "Invalid parameter given or out of range for '-N'.");
+					rc = -1;
+					goto out_free;
+				}
+				timeout *= 1000;
+			}
+			break;
+		case 'W':
+			if (str2int(optarg, &window) != 0 || window < 1) {
+				lprintf(LOG_ERR, "Invalid parameter given or out of range for '-W'.");
+				rc = -1;
+				goto out_free;
+			}
+			break;
+		case 'j':
+			if (str2int(optarg, &jobs) != 0 || jobs < 1) {
+				lprintf(LOG_ERR, "Invalid parameter given or out of range for '-j'.");
+				rc = -1;
+				goto out_free;
+			}
+			break;
+		case 'F':
+			if (cachefile) {
+				free(cachefile);
+				cachefile = NULL;
+			}
+			cachefile = strdup(optarg);
+			if (cachefile == NULL) {
+				lprintf(LOG_ERR, "%s: malloc failure", progname);
+				goto out_free;
+			}
+			break;
+		case 'Z':
+			if (strcmp(optarg, "text") == 0) {
+				stats = IPMI_STATS_TEXT;
+			} else if (strcmp(optarg, "json") == 0) {
+				stats = IPMI_STATS_JSON;
+			} else {
+				lprintf(LOG_ERR, "Invalid parameter given or out of range for '-Z'.");
 				rc = -1;
 				goto out_free;
 			}
@@ -799,9 +886,11 @@ ipmi_main(int argc, char ** argv,
 	 *
 	 * If no password was specified by any other method
 	 * and the authtype was not explicitly set to NONE
-	 * then prompt the user.
+	 * then prompt the user.  The proxy interface only names
+	 * the host, ipmiproxyd holds the session.
 	 */
 	if (hostname != NULL && password == NULL &&
+			(intfname == NULL || strcmp(intfname, "proxy") != 0) &&
 			(authtype != IPMI_SESSION_AUTHTYPE_NONE || authtype < 0)) {
 #ifdef HAVE_GETPASSPHRASE
 		tmp_pass = getpassphrase("Password: ");
@@ -843,6 +932,10 @@ ipmi_main(int argc, char ** argv,
 		}
 	} /* if (password != NULL && intfname != NULL) */
 
+	/* -H host1,host2,... or -H @file: continue in one worker per host */
+	if (hostname != NULL && ipmi_fanout(&hostname, jobs, &rc) != 0)
+		goto out_free;
+
 	/* load interface */
 	ipmi_main_intf = ipmi_intf_load(intfname);
 	if (ipmi_main_intf == NULL) {
@@ -865,6 +958,8 @@ ipmi_main(int argc, char ** argv,
 		ipmi_intf_session_set_hostname(ipmi_main_intf, hostname);
 	if (username != NULL)
 		ipmi_intf_session_set_username(ipmi_main_intf, username);
+	if (cachefile != NULL)
+		ipmi_intf_session_set_cachefile(ipmi_main_intf, cachefile);
 	if (password != NULL)
 		ipmi_intf_session_set_password(ipmi_main_intf, password);
 	if (kgkey != NULL)
@@ -882,7 +977,9 @@ ipmi_main(int argc, char ** argv,
 	if (retry > 0)
 		ipmi_intf_session_set_retry(ipmi_main_intf, retry);
 	if (timeout > 0)
-		ipmi_intf_session_set_timeout(ipmi_main_intf, timeout);
+		ipmi_intf_session_set_timeout_ms(ipmi_main_intf, timeout);
+	if (window > 0)
+		ipmi_intf_session_set_window(ipmi_main_intf, window);
 
 	ipmi_intf_session_set_lookupbit(ipmi_main_intf, lookupbit);
 	ipmi_intf_session_set_sol_escape_char(ipmi_main_intf, sol_escape_char);
@@ -890,11 +987,24 @@ ipmi_main(int argc, char ** argv,
 
 	ipmi_main_intf->devnum = devnum;
 
+	if (stats >= 0 && ipmi_stats_enable(ipmi_main_intf) < 0)
+		goto out_free;
+
 	/* setup device file if given */
 	ipmi_main_intf->devfile = devfile;
 
 	/* Open the interface with the specified or default IPMB address */
 	ipmi_main_intf->my_addr = arg_addr ? arg_addr : IPMI_BMC_SLAVE_ADDR;
+
+	/*
+	 * Commands which need no BMC skip the open and the address
+	 * discovery; should they send a request after all the interface
+	 * opens itself then.
+	 */
+	if (argc-optind > 0 && ipmi_cmd_offline(cmdlist, argv[optind],
+				argc-optind-1, &(argv[optind+1])))
+		goto cmd_setup;
+
 	if (ipmi_main_intf->open != NULL) {
 		if (ipmi_main_intf->open(ipmi_main_intf) < 0) {
 			goto out_free;
@@ -972,9 +1082,12 @@ ipmi_main(int argc, char ** argv,
 			ipmi_main_intf->target_channel,
 			ipmi_main_intf->target_ipmb_addr);
 
-	/* parse local SDR cache if given */
+cmd_setup:
+	/* parse local SDR cache if given, else keep one per BMC */
 	if (sdrcache != NULL) {
 		ipmi_sdr_list_cache_fromfile(ipmi_main_intf, sdrcache);
+	} else {
+		ipmi_sdr_cache_enable(ipmi_main_intf, NULL);
 	}
 	/* Parse SEL OEM file if given */
 	if (seloem != NULL) {
@@ -1018,6 +1131,10 @@ ipmi_main(int argc, char ** argv,
 		ipmi_main_intf->close(ipmi_main_intf);
 
 	out_free:
+	/* also reported when the session could not be opened */
+	if (stats >= 0 && ipmi_main_intf != NULL)
+		ipmi_stats_print(ipmi_main_intf, stats);
+
 	log_halt();
 
 	if (intfname != NULL) {
@@ -1056,6 +1173,10 @@ ipmi_main(int argc, char ** argv,
 		free(devfile);
 		devfile = NULL;
 	}
+	if (cachefile != NULL) {
+		free(cachefile);
+		cachefile = NULL;
+	}
 
 	return rc;
 }
@@ -33,6 +33,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include <ipmitool/ipmi.h>
 #include <ipmitool/log.h>
@@ -41,9 +44,41 @@
 #include <ipmitool/ipmi_raw.h>
 #include <ipmitool/ipmi_fru.h>
 #include <ipmitool/ipmi_strings.h>
+#include <ipmitool/ipmi_stats.h>
 
 #define IPMI_I2C_MASTER_MAX_SIZE	0x40 /* 64 bytes */
 
+/* requests read ahead of the oldest unprinted one in raw batch */
+#define IPMI_RAW_BATCH_DEPTH	64
+
+struct raw_batch_rq {
+	struct ipmi_rq req;
+	uint8_t data[256];
+	int line;
+	int state;
+#define RAW_BATCH_PENDING	0
+#define RAW_BATCH_DONE		1
+#define RAW_BATCH_FAILED	2	/* no response */
+#define RAW_BATCH_INVALID	3	/* could not parse the line */
+	uint64_t start;
+	uint32_t usec;
+	uint8_t ccode;
+	int rsp_len;
+	uint8_t rsp[IPMI_BUF_SIZE];
+};
+
+/*
+ * raw batch reads its input with read(2) rather than stdio, so that it
+ * can tell whether a line is waiting without a poll() that misses the
+ * lines already buffered.
+ */
+struct raw_batch_in {
+	int fd;
+	int eof;
+	size_t len;
+	char buf[2048];
+};
+
 static int is_valid_param(const char *input_param, uint8_t *uchr_ptr,
 		const char *label);
 
@@ -308,39 +343,43 @@ void
 ipmi_raw_help()
 {
 	lprintf(LOG_NOTICE, "RAW Commands:  raw <netfn> <cmd> [data]");
+	lprintf(LOG_NOTICE, "               raw batch <file|->");
 	print_valstr(ipmi_netfn_vals, "Network Function Codes", LOG_NOTICE);
 	lprintf(LOG_NOTICE, "(can also use raw hex values)");
+	lprintf(LOG_NOTICE, "In batch mode each line of the file holds one request "
+		"in the same form,");
+	lprintf(LOG_NOTICE, "blank lines and lines starting with '#' are skipped.");
 } /* ipmi_raw_help() */
 
-int
-ipmi_raw_main(struct ipmi_intf * intf, int argc, char ** argv)
+/* ipmi_raw_parse  -  build a request from <netfn> <cmd> [data]
+ *
+ * @intf:	ipmi interface
+ * @argc:	number of arguments
+ * @argv:	netfn, command and data bytes
+ * @req:	request to fill in, req->msg.data must hold 256 bytes
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_raw_parse(struct ipmi_intf * intf, int argc, char ** argv,
+		struct ipmi_rq * req)
 {
-	struct ipmi_rs * rsp;
-	struct ipmi_rq req;
-	uint8_t netfn, cmd, lun;
+	uint8_t netfn, cmd;
 	uint16_t netfn_tmp = 0;
+	uint8_t * data = req->msg.data;
 	int i;
-	uint8_t data[256];
 
-	if (argc == 1 && strncmp(argv[0], "help", 4) == 0) {
-		ipmi_raw_help();
-		return 0;
-	}
-	else if (argc < 2) {
+	if (argc < 2) {
 		lprintf(LOG_ERR, "Not enough parameters given.");
-		ipmi_raw_help();
 		return (-1);
 	}
-	else if (argc > sizeof(data))
+	else if (argc - 2 > 256)
 	{
 		lprintf(LOG_NOTICE, "Raw command input limit (256 bytes) exceeded");
 		return -1;
 	}
 
-	ipmi_intf_session_set_timeout(intf, 15);
-	ipmi_intf_session_set_retry(intf, 1);
-
-	lun = intf->target_lun;
 	netfn_tmp = str2val(argv[0], ipmi_netfn_vals);
 	if (netfn_tmp == 0xff) {
 		if (is_valid_param(argv[0], &netfn, "netfn") != 0)
@@ -356,12 +395,12 @@ ipmi_raw_main(struct ipmi_intf * intf, int argc, char ** argv)
 	if (is_valid_param(argv[1], &cmd, "command") != 0)
 		return (-1);
 
-	memset(data, 0, sizeof(data));
-	memset(&req, 0, sizeof(req));
-	req.msg.netfn = netfn;
-	req.msg.lun = lun;
-	req.msg.cmd = cmd;
-	req.msg.data = data;
+	memset(data, 0, 256);
+	memset(req, 0, sizeof(struct ipmi_rq));
+	req->msg.netfn = netfn;
+	req->msg.lun = intf->target_lun;
+	req->msg.cmd = cmd;
+	req->msg.data = data;
 
 	for (i=2; i<argc; i++) {
 		uint8_t val = 0;
@@ -369,10 +408,302 @@ ipmi_raw_main(struct ipmi_intf * intf, int argc, char ** argv)
 		if (is_valid_param(argv[i], &val, "data") != 0)
 			return (-1);
 
-		req.msg.data[i-2] = val;
-		req.msg.data_len++;
+		req->msg.data[i-2] = val;
+		req->msg.data_len++;
+	}
+
+	return 0;
+}
+
+/* ipmi_raw_batch_done  -  ipmi_intf_submit() callback of raw batch
+ *
+ * Keeps a copy of the response, the request is printed once all
+ * requests before it are done.
+ */
+static void
+ipmi_raw_batch_done(struct ipmi_intf * intf, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, void * ctx)
+{
+	struct raw_batch_rq * e = ctx;
+
+	e->usec = (uint32_t)(ipmi_stats_usec() - e->start);
+	if (rsp == NULL || rsp->data_len < 0) {
+		e->state = RAW_BATCH_FAILED;
+		return;
+	}
+	e->ccode = rsp->ccode;
+	e->rsp_len = __min(rsp->data_len, IPMI_BUF_SIZE);
+	memcpy(e->rsp, rsp->data, e->rsp_len);
+	e->state = RAW_BATCH_DONE;
+}
+
+/* ipmi_raw_batch_print  -  print one finished raw batch request
+ *
+ * The output is one line per request: input line number, status
+ * (ok, cc=<completion code>, failed or invalid), round trip time and
+ * the response data.
+ *
+ * returns 0 if the request succeeded, -1 otherwise
+ */
+static int
+ipmi_raw_batch_print(struct raw_batch_rq * e)
+{
+	int i;
+
+	switch (e->state) {
+	case RAW_BATCH_INVALID:
+		printf("%d invalid\n", e->line);
+		return -1;
+	case RAW_BATCH_FAILED:
+		printf("%d failed %u.%03u ms\n", e->line,
+			e->usec / 1000, e->usec % 1000);
+		return -1;
 	}
 
+	if (e->ccode > 0) {
+		printf("%d cc=%02x %u.%03u ms %s\n", e->line, e->ccode,
+			e->usec / 1000, e->usec % 1000,
+			val2str(e->ccode, completion_code_vals));
+		return -1;
+	}
+
+	printf("%d ok %u.%03u ms", e->line, e->usec / 1000, e->usec % 1000);
+	for (i = 0; i < e->rsp_len; i++)
+		printf(" %2.2x", e->rsp[i]);
+	printf("\n");
+	return 0;
+}
+
+/* raw_batch_ready  -  check if raw_batch_gets() would not block
+ *
+ * returns 1 if a line or the end of the input is waiting
+ * returns 0 otherwise
+ */
+static int
+raw_batch_ready(struct raw_batch_in * in)
+{
+	struct pollfd pfd;
+
+	if (in->eof || memchr(in->buf, '\n', in->len) != NULL ||
+	    in->len == sizeof(in->buf))
+		return 1;
+	pfd.fd = in->fd;
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, 0) > 0;
+}
+
+/* raw_batch_gets  -  read the next input line of raw batch
+ *
+ * Lines longer than the buffer are split, like fgets() does.
+ *
+ * @in:		input
+ * @line:	set to the line, without its newline
+ *
+ * returns 1 if a line was read
+ * returns 0 at the end of the input
+ */
+static int
+raw_batch_gets(struct raw_batch_in * in, char line[sizeof(in->buf) + 1])
+{
+	char * nl;
+	size_t n;
+	ssize_t rv;
+
+	while ((nl = memchr(in->buf, '\n', in->len)) == NULL &&
+	       in->len < sizeof(in->buf) && !in->eof) {
+		rv = read(in->fd, in->buf + in->len, sizeof(in->buf) - in->len);
+		if (rv < 0 && errno == EINTR)
+			continue;
+		if (rv < 0)
+			lperror(LOG_ERR, "raw batch: read");
+		if (rv <= 0)
+			in->eof = 1;
+		else
+			in->len += rv;
+	}
+	if (in->len == 0)
+		return 0;
+
+	n = (nl != NULL) ? (size_t)(nl - in->buf) : in->len;
+	memcpy(line, in->buf, n);
+	line[n] = '\0';
+	if (nl != NULL)
+		n++;
+	in->len -= n;
+	memmove(in->buf, in->buf + n, in->len);
+	return 1;
+}
+
+/* ipmi_raw_batch  -  send the raw requests listed in a file (raw batch)
+ *
+ * All requests share the session of @intf.  Lines are read ahead and
+ * submitted as long as the request window of the transport has room,
+ * so several of them are in flight at once, while the responses are
+ * still printed in input order.  Before reading from an input that has
+ * nothing to offer yet, e.g. a script feeding requests one at a time,
+ * outstanding requests are finished and their responses printed.
+ *
+ * @intf:	ipmi interface
+ * @file:	file name, "-" for stdin
+ *
+ * returns 0 if all requests succeeded
+ * returns -1 otherwise
+ */
+static int
+ipmi_raw_batch(struct ipmi_intf * intf, const char * file)
+{
+	struct raw_batch_rq * ring, * e;
+	struct raw_batch_in in;
+	FILE * fp;
+	char buf[sizeof(in.buf) + 1];
+	char * argv[260];
+	char * tok, * save;
+	int argc, i, line = 0, head = 0, count = 0;
+	int eof = 0, rc = 0, total = 0, failed = 0;
+	int window;
+	uint64_t start;
+
+	if (strcmp(file, "-") == 0) {
+		fp = stdin;
+	} else {
+		fp = ipmi_open_file_read(file);
+		if (fp == NULL)
+			return -1;
+	}
+
+	ring = calloc(IPMI_RAW_BATCH_DEPTH, sizeof(struct raw_batch_rq));
+	if (ring == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		if (fp != stdin)
+			fclose(fp);
+		return -1;
+	}
+
+	/* keep no more submitted than the transport sends at once, so
+	 * the time from submit to response is the round trip time */
+	window = __min(ipmi_intf_get_window(intf), IPMI_RAW_BATCH_DEPTH);
+	if (window < 1)
+		window = 1;
+
+	in.fd = fileno(fp);
+	in.eof = 0;
+	in.len = 0;
+	start = ipmi_stats_usec();
+
+	while (!eof || count > 0) {
+		/* read ahead while there is room and no need to wait */
+		while (!eof && count < IPMI_RAW_BATCH_DEPTH &&
+		       ipmi_intf_pending(intf) < window) {
+			if (count > 0 && !raw_batch_ready(&in))
+				break;
+			if (!raw_batch_gets(&in, buf)) {
+				eof = 1;
+				break;
+			}
+			line++;
+
+			argc = 0;
+			for (tok = strtok_r(buf, " \t\r\n", &save);
+			     tok != NULL && argc < 260;
+			     tok = strtok_r(NULL, " \t\r\n", &save))
+				argv[argc++] = tok;
+			if (argc == 0 || argv[0][0] == '#')
+				continue;
+
+			e = &ring[(head + count) % IPMI_RAW_BATCH_DEPTH];
+			memset(e, 0, sizeof(struct raw_batch_rq));
+			e->line = line;
+			e->req.msg.data = e->data;
+			count++;
+
+			if (ipmi_raw_parse(intf, argc, argv, &e->req) < 0) {
+				lprintf(LOG_ERR, "Invalid request on line %d", line);
+				e->state = RAW_BATCH_INVALID;
+				continue;
+			}
+			e->start = ipmi_stats_usec();
+			if (ipmi_intf_submit(intf, &e->req,
+					ipmi_raw_batch_done, e) < 0) {
+				e->state = RAW_BATCH_FAILED;
+				continue;
+			}
+			/* get it on the wire while the next line is read */
+			ipmi_intf_poll(intf, 0);
+		}
+
+		/* print everything that is finished, in order */
+		while (count > 0 && ring[head].state != RAW_BATCH_PENDING) {
+			if (ipmi_raw_batch_print(&ring[head]) < 0) {
+				failed++;
+				rc = -1;
+			}
+			total++;
+			head = (head + 1) % IPMI_RAW_BATCH_DEPTH;
+			count--;
+		}
+		fflush(stdout);
+
+		if (count > 0 && ring[head].state == RAW_BATCH_PENDING &&
+		    (eof || count == IPMI_RAW_BATCH_DEPTH ||
+		     ipmi_intf_pending(intf) >= window ||
+		     !raw_batch_ready(&in))) {
+			ipmi_intf_poll(intf, -1);
+			if (ipmi_intf_pending(intf) > 0)
+				continue;
+			/* nothing left that could complete them */
+			for (i = 0; i < count; i++) {
+				e = &ring[(head + i) % IPMI_RAW_BATCH_DEPTH];
+				if (e->state == RAW_BATCH_PENDING)
+					e->state = RAW_BATCH_FAILED;
+			}
+		}
+	}
+
+	lprintf(LOG_INFO, "RAW BATCH: %d requests, %d failed, %llu ms",
+		total, failed,
+		(unsigned long long)((ipmi_stats_usec() - start) / 1000));
+
+	free(ring);
+	if (fp != stdin)
+		fclose(fp);
+	return rc;
+}
+
+int
+ipmi_raw_main(struct ipmi_intf * intf, int argc, char ** argv)
+{
+	struct ipmi_rs * rsp;
+	struct ipmi_rq req;
+	int i;
+	uint8_t data[256];
+
+	if (argc == 1 && strncmp(argv[0], "help", 4) == 0) {
+		ipmi_raw_help();
+		return 0;
+	}
+	else if (argc >= 1 && (strcmp(argv[0], "batch") == 0 ||
+				strcmp(argv[0], "--batch") == 0)) {
+		if (argc != 2) {
+			lprintf(LOG_ERR, "Usage: raw batch <file|->");
+			return (-1);
+		}
+		ipmi_intf_session_set_timeout(intf, 15);
+		ipmi_intf_session_set_retry(intf, 1);
+		return ipmi_raw_batch(intf, argv[1]);
+	}
+	else if (argc < 2) {
+		lprintf(LOG_ERR, "Not enough parameters given.");
+		ipmi_raw_help();
+		return (-1);
+	}
+
+	ipmi_intf_session_set_timeout(intf, 15);
+	ipmi_intf_session_set_retry(intf, 1);
+
+	req.msg.data = data;
+	if (ipmi_raw_parse(intf, argc, argv, &req) < 0)
+		return (-1);
+
 	lprintf(LOG_INFO, 
            "RAW REQ (channel=0x%x netfn=0x%x lun=0x%x cmd=0x%x data_len=%d)",
            intf->target_channel & 0x0f, req.msg.netfn,req.msg.lun , 
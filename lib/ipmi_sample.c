@@ -0,0 +1,696 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_sdr.h>
+#include <ipmitool/ipmi_sample.h>
+
+#define SAMPLE_MAX_COLS		0x10000
+#define SAMPLE_MAX_ROWS		0x100000
+#define SAMPLE_MAX_BLOCK	0x4000000
+
+/* sample_put  -  append a varint
+ *
+ * returns number of bytes written, at most 10
+ */
+static int
+sample_put(uint8_t * p, uint64_t v)
+{
+	int n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (uint8_t)v;
+	return n;
+}
+
+/* sample_get  -  read a varint
+ *
+ * returns number of bytes read
+ * returns -1 if the varint runs past end
+ */
+static int
+sample_get(const uint8_t * p, const uint8_t * end, uint64_t * v)
+{
+	int n = 0, shift = 0;
+
+	*v = 0;
+	while (p + n < end && shift < 64) {
+		*v |= (uint64_t)(p[n] & 0x7f) << shift;
+		if ((p[n++] & 0x80) == 0)
+			return n;
+		shift += 7;
+	}
+	return -1;
+}
+
+static uint64_t
+sample_zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t
+sample_unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* sample_block  -  write one block
+ *
+ * @sf:		sample file
+ * @tag:	IPMI_SAMPLE_DICT or IPMI_SAMPLE_DATA
+ * @len:	payload length, the payload is in sf->buf
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+sample_block(struct ipmi_sample_file * sf, uint8_t tag, size_t len)
+{
+	uint8_t hdr[11];
+	int n;
+
+	hdr[0] = tag;
+	n = 1 + sample_put(hdr + 1, len);
+	if (fwrite(hdr, 1, n, sf->fp) != (size_t)n ||
+	    fwrite(sf->buf, 1, len, sf->fp) != len ||
+	    fflush(sf->fp) != 0) {
+		lperror(LOG_ERR, "Unable to write %s", sf->name);
+		return -1;
+	}
+	return 0;
+}
+
+/* sample_flush  -  write the buffered rows as one sample block
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+sample_flush(struct ipmi_sample_file * sf)
+{
+	uint8_t * p = sf->buf;
+	uint64_t prev;
+	uint32_t s;
+	int c, r, n;
+
+	if (sf->rows == 0)
+		return 0;
+
+	p += sample_put(p, sf->rows);
+	p += sample_put(p, sf->cols);
+
+	for (r = 0, prev = 0; r < sf->rows; r++) {
+		p += sample_put(p, sample_zigzag(sf->time[r] - prev));
+		prev = sf->time[r];
+	}
+
+	for (c = 0; c < sf->cols; c++) {
+		for (r = 0, prev = 0; r < sf->rows; r++) {
+			p += sample_put(p, sample_zigzag(
+				(int64_t)sf->reading[r * sf->cols + c] - prev));
+			prev = sf->reading[r * sf->cols + c];
+		}
+		for (r = 0; r < sf->rows; r += n) {
+			s = sf->state[r * sf->cols + c];
+			for (n = 1; r + n < sf->rows &&
+			     sf->state[(r + n) * sf->cols + c] == s; n++)
+				;
+			p += sample_put(p, n);
+			p += sample_put(p, s);
+		}
+	}
+
+	sf->rows = 0;
+	return sample_block(sf, IPMI_SAMPLE_DATA, p - sf->buf);
+}
+
+/* sample_same_dict  -  check the last dictionary of a file
+ *
+ * @sf:		sample file, positioned anywhere
+ * @len:	length of the new dictionary, which is in sf->buf
+ *
+ * returns 1 if the last dictionary block in the file is the same
+ * returns 0 if it differs, there is none or the file is damaged
+ */
+static int
+sample_same_dict(struct ipmi_sample_file * sf, size_t len)
+{
+	uint8_t hdr[10], * old;
+	uint64_t blen, dlen = 0;
+	long end, pos, dict = -1;
+	int tag, c, n, same;
+
+	if (fseek(sf->fp, 0, SEEK_END) != 0 || (end = ftell(sf->fp)) < 0 ||
+	    fseek(sf->fp, IPMI_SAMPLE_HDR_LEN, SEEK_SET) != 0)
+		return 0;
+
+	for (pos = IPMI_SAMPLE_HDR_LEN; pos < end; ) {
+		if ((tag = getc(sf->fp)) == EOF)
+			return 0;
+		for (n = 0; n < (int)sizeof(hdr); ) {
+			if ((c = getc(sf->fp)) == EOF)
+				return 0;
+			hdr[n++] = c;
+			if ((c & 0x80) == 0)
+				break;
+		}
+		if (sample_get(hdr, hdr + n, &blen) < 0 ||
+		    blen > (uint64_t)(end - pos))
+			return 0;
+		pos += 1 + n;
+		if (tag == IPMI_SAMPLE_DICT) {
+			dict = pos;
+			dlen = blen;
+		}
+		pos += blen;
+		if (pos > end || fseek(sf->fp, pos, SEEK_SET) != 0)
+			return 0;
+	}
+
+	if (dict < 0 || dlen != len || fseek(sf->fp, dict, SEEK_SET) != 0)
+		return 0;
+	old = malloc(len);
+	if (old == NULL)
+		return 0;
+	same = fread(old, 1, len, sf->fp) == len &&
+		memcmp(old, sf->buf, len) == 0;
+	free(old);
+	return same;
+}
+
+/* ipmi_sample_open  -  start appending samples to a file
+ *
+ * Creates the file if needed and writes the dictionary of the columns,
+ * unless the file already ends with the same one.
+ *
+ * @file:	sample file
+ * @sw:		sensors whose readings ipmi_sample_add() records, read
+ *		by ipmi_sdr_sweep()
+ * @cols:	number of sensors
+ *
+ * returns sample file on success
+ * returns NULL on error
+ */
+struct ipmi_sample_file *
+ipmi_sample_open(const char * file, struct sdr_sweep_entry * sw, int cols)
+{
+	struct ipmi_sample_file * sf;
+	struct sdr_record_list * e;
+	uint8_t hdr[IPMI_SAMPLE_HDR_LEN];
+	uint8_t * p;
+	size_t size;
+	int c, exists = 0;
+
+	if (cols < 1 || cols >= SAMPLE_MAX_COLS) {
+		lprintf(LOG_ERR, "Unable to record %d sensors", cols);
+		return NULL;
+	}
+
+	/* the larger of the dictionary and a sample block */
+	size = 20 + cols * (2 + 255);
+	if (size < 20 + IPMI_SAMPLE_ROWS * 10 + cols * IPMI_SAMPLE_ROWS * 12)
+		size = 20 + IPMI_SAMPLE_ROWS * 10 + cols * IPMI_SAMPLE_ROWS * 12;
+
+	sf = calloc(1, sizeof(struct ipmi_sample_file));
+	if (sf == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return NULL;
+	}
+	sf->name = strdup(file);
+	sf->reading = calloc(IPMI_SAMPLE_ROWS * cols, sizeof(uint8_t));
+	sf->state = calloc(IPMI_SAMPLE_ROWS * cols, sizeof(uint32_t));
+	sf->buf = malloc(size);
+	if (sf->name == NULL || sf->reading == NULL || sf->state == NULL ||
+	    sf->buf == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		goto fail;
+	}
+	sf->size = size;
+	sf->sw = sw;
+	sf->cols = cols;
+
+	sf->fp = fopen(file, "a+b");
+	if (sf->fp == NULL) {
+		lperror(LOG_ERR, "Unable to open file %s", file);
+		goto fail;
+	}
+
+	/* a new file gets a header, an existing one must have ours */
+	fseek(sf->fp, 0, SEEK_END);
+	if (ftell(sf->fp) == 0) {
+		memset(hdr, 0, sizeof(hdr));
+		memcpy(hdr, IPMI_SAMPLE_MAGIC, 8);
+		hdr[8] = IPMI_SAMPLE_VERSION & 0xff;
+		hdr[9] = IPMI_SAMPLE_VERSION >> 8;
+		if (fwrite(hdr, 1, sizeof(hdr), sf->fp) != sizeof(hdr)) {
+			lperror(LOG_ERR, "Unable to write %s", file);
+			goto fail;
+		}
+	} else {
+		rewind(sf->fp);
+		if (fread(hdr, 1, sizeof(hdr), sf->fp) != sizeof(hdr) ||
+		    memcmp(hdr, IPMI_SAMPLE_MAGIC, 8) != 0 ||
+		    (hdr[8] | hdr[9] << 8) != IPMI_SAMPLE_VERSION) {
+			lprintf(LOG_ERR, "%s is not a sensor sample file", file);
+			goto fail;
+		}
+		exists = 1;
+	}
+
+	p = sf->buf;
+	p += sample_put(p, cols);
+	for (c = 0; c < cols; c++) {
+		e = sw[c].entry;
+		if (e->length == 0) {
+			lprintf(LOG_ERR, "No record length for SDR 0x%04x",
+				e->id);
+			goto fail;
+		}
+		*p++ = e->type;
+		p += sample_put(p, e->length);
+		memcpy(p, e->record.common, e->length);
+		p += e->length;
+	}
+	if (exists && sample_same_dict(sf, p - sf->buf))
+		return sf;
+	if (sample_block(sf, IPMI_SAMPLE_DICT, p - sf->buf) < 0)
+		goto fail;
+
+	return sf;
+
+fail:
+	if (sf->fp != NULL)
+		fclose(sf->fp);
+	free(sf->name);
+	free(sf->reading);
+	free(sf->state);
+	free(sf->buf);
+	free(sf);
+	return NULL;
+}
+
+/* ipmi_sample_add  -  record the current readings of the columns
+ *
+ * Takes the raw responses ipmi_sdr_sweep() left in the sweep entries
+ * given to ipmi_sample_open(), stamped with the current time.  Rows
+ * are written in blocks of IPMI_SAMPLE_ROWS.
+ *
+ * @sf:		sample file
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sample_add(struct ipmi_sample_file * sf)
+{
+	struct sdr_sweep_entry * s;
+	struct timeval tv;
+	int c, i;
+
+	gettimeofday(&tv, NULL);
+	sf->time[sf->rows] = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+	for (c = 0; c < sf->cols; c++) {
+		s = &sf->sw[c];
+		i = sf->rows * sf->cols + c;
+		sf->reading[i] = s->raw_len > 0 ? s->raw[0] : 0;
+		sf->state[i] = (uint32_t)s->raw_len << 24 |
+			(s->raw_len > 1 ? s->raw[1] << 16 : 0) |
+			(s->raw_len > 2 ? s->raw[2] << 8 : 0) |
+			(s->raw_len > 3 ? s->raw[3] : 0);
+	}
+
+	if (++sf->rows < IPMI_SAMPLE_ROWS)
+		return 0;
+	return sample_flush(sf);
+}
+
+/* ipmi_sample_close  -  write the buffered rows and close the file
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sample_close(struct ipmi_sample_file * sf)
+{
+	int rc;
+
+	if (sf == NULL)
+		return 0;
+
+	rc = sample_flush(sf);
+	if (fclose(sf->fp) != 0)
+		rc = -1;
+	free(sf->name);
+	free(sf->reading);
+	free(sf->state);
+	free(sf->buf);
+	free(sf);
+	return rc;
+}
+
+/* sample_dict  -  set up the columns of a dictionary block
+ *
+ * Each record gets a buffer of at least a full sensor record, so that
+ * short records read as zeroes past their end.
+ *
+ * returns number of columns
+ * returns -1 on error
+ */
+static int
+sample_dict(const uint8_t * p, const uint8_t * end,
+	    struct sdr_sweep_entry ** swp, struct sdr_record_list ** listp)
+{
+	struct sdr_sweep_entry * sw;
+	struct sdr_record_list * list;
+	uint64_t cols, len;
+	uint8_t * rec;
+	int c, n;
+
+	n = sample_get(p, end, &cols);
+	if (n < 0 || cols < 1 || cols >= SAMPLE_MAX_COLS)
+		return -1;
+	p += n;
+
+	sw = calloc(cols, sizeof(struct sdr_sweep_entry));
+	list = calloc(cols, sizeof(struct sdr_record_list));
+	if (sw == NULL || list == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		free(sw);
+		free(list);
+		return -1;
+	}
+
+	for (c = 0; c < (int)cols; c++) {
+		if (p >= end)
+			break;
+		list[c].type = *p++;
+		n = sample_get(p, end, &len);
+		if (n < 0 || len > 255 || p + n + len > end)
+			break;
+		p += n;
+		rec = calloc(1, __max(len, sizeof(struct sdr_record_full_sensor)));
+		if (rec == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			break;
+		}
+		memcpy(rec, p, len);
+		p += len;
+		list[c].length = len;
+		list[c].raw = rec;
+		list[c].record.common = (struct sdr_record_common_sensor *)rec;
+		sw[c].entry = &list[c];
+	}
+
+	if (c < (int)cols) {
+		while (c-- > 0)
+			free(list[c].raw);
+		free(sw);
+		free(list);
+		return -1;
+	}
+
+	*swp = sw;
+	*listp = list;
+	return cols;
+}
+
+static void
+sample_dict_free(struct sdr_sweep_entry * sw, struct sdr_record_list * list,
+		 int cols)
+{
+	int c;
+
+	for (c = 0; c < cols && list != NULL; c++)
+		free(list[c].raw);
+	free(sw);
+	free(list);
+}
+
+/* sample_rows  -  decode a sample block and hand each row to row()
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+sample_rows(const uint8_t * p, const uint8_t * end,
+	    struct sdr_sweep_entry * sw, int cols, int precision,
+	    int * first,
+	    int (*row)(uint64_t msec, struct sdr_sweep_entry * sw,
+		int cols, int first, void * ctx),
+	    void * ctx)
+{
+	uint64_t rows, ncols, v, run, * time = NULL;
+	uint8_t * reading = NULL, data[4];
+	uint32_t * state = NULL, s;
+	double * value = NULL, ** conv = NULL;
+	struct sdr_record_full_sensor * full;
+	int64_t prev;
+	int c, n, rc = -1;
+	uint64_t r, i;
+
+	n = sample_get(p, end, &rows);
+	if (n < 0 || rows < 1 || rows >= SAMPLE_MAX_ROWS)
+		return -1;
+	p += n;
+	n = sample_get(p, end, &ncols);
+	if (n < 0 || ncols != (uint64_t)cols)
+		return -1;
+	p += n;
+
+	time = malloc(rows * sizeof(uint64_t));
+	reading = malloc(rows * cols);
+	state = malloc(rows * cols * sizeof(uint32_t));
+	value = malloc(rows * cols * sizeof(double));
+	conv = calloc(cols, sizeof(double *));
+	if (time == NULL || reading == NULL || state == NULL ||
+	    value == NULL || conv == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		goto out;
+	}
+
+	for (r = 0, prev = 0; r < rows; r++) {
+		if ((n = sample_get(p, end, &v)) < 0)
+			goto out;
+		p += n;
+		prev += sample_unzigzag(v);
+		time[r] = prev;
+	}
+
+	for (c = 0; c < cols; c++) {
+		for (r = 0, prev = 0; r < rows; r++) {
+			if ((n = sample_get(p, end, &v)) < 0)
+				goto out;
+			p += n;
+			prev += sample_unzigzag(v);
+			reading[c * rows + r] = (uint8_t)prev;
+		}
+		for (r = 0; r < rows; r += run) {
+			if ((n = sample_get(p, end, &run)) < 0 || run < 1 ||
+			    run > rows - r)
+				goto out;
+			p += n;
+			if ((n = sample_get(p, end, &v)) < 0)
+				goto out;
+			p += n;
+			for (i = 0; i < run; i++)
+				state[(r + i) * cols + c] = (uint32_t)v;
+		}
+		/*
+		 * Convert the whole column at once; non-linear sensors
+		 * are left to ipmi_sdr_decode_sensor_reading(), which
+		 * may have to fetch their factors first.
+		 */
+		if (sw[c].entry->type != SDR_RECORD_TYPE_FULL_SENSOR)
+			continue;
+		full = sw[c].entry->record.full;
+		if (full->linearization >= SDR_SENSOR_L_NONLINEAR &&
+		    full->linearization <= 0x7F)
+			continue;
+		conv[c] = &value[c * rows];
+		sdr_convert_sensor_readings(full, &reading[c * rows],
+					    conv[c], (int)rows);
+	}
+
+	for (r = 0; r < rows; r++) {
+		for (c = 0; c < cols; c++) {
+			s = state[r * cols + c];
+			data[0] = reading[c * rows + r];
+			data[1] = s >> 16;
+			data[2] = s >> 8;
+			data[3] = s;
+			sw[c].raw_len = __min(s >> 24, sizeof(sw[c].raw));
+			memcpy(sw[c].raw, data, sizeof(sw[c].raw));
+			ipmi_sdr_decode_sensor_reading(NULL,
+				sw[c].entry->record.common, sw[c].entry->type,
+				data, sw[c].raw_len, precision,
+				conv[c] != NULL ? &conv[c][r] : NULL,
+				&sw[c].sr);
+		}
+		if (row(time[r], sw, cols, *first, ctx) < 0)
+			goto out;
+		*first = 0;
+	}
+	rc = 0;
+
+out:
+	free(time);
+	free(reading);
+	free(state);
+	free(value);
+	free(conv);
+	return rc;
+}
+
+/* ipmi_sample_read  -  read back a sample file
+ *
+ * Converts every row with the SDR records of its dictionary and hands
+ * it to row(), which finds the readings in sw[].sr and the raw
+ * responses in sw[].raw.  first is set on the first row after each
+ * dictionary.  No requests are sent to the BMC, so non-linear sensors,
+ * whose conversion factors would have to be read from it, have no
+ * reading.
+ *
+ * @file:	sample file
+ * @precision:	decimal precision for analog format conversion
+ * @row:	called for every row, stops reading when it returns < 0
+ * @ctx:	opaque pointer handed to row()
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sample_read(const char * file, int precision,
+		int (*row)(uint64_t msec, struct sdr_sweep_entry * sw,
+			int cols, int first, void * ctx),
+		void * ctx)
+{
+	struct sdr_sweep_entry * sw = NULL;
+	struct sdr_record_list * list = NULL;
+	uint8_t hdr[IPMI_SAMPLE_HDR_LEN], * buf = NULL;
+	uint64_t len;
+	size_t size = 0;
+	int cols = 0, first = 0, ch, shift, rc = 0;
+	FILE * fp;
+
+	fp = ipmi_open_file_read(file);
+	if (fp == NULL)
+		return -1;
+
+	if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+	    memcmp(hdr, IPMI_SAMPLE_MAGIC, 8) != 0) {
+		lprintf(LOG_ERR, "%s is not a sensor sample file", file);
+		fclose(fp);
+		return -1;
+	}
+	if ((hdr[8] | hdr[9] << 8) != IPMI_SAMPLE_VERSION) {
+		lprintf(LOG_ERR, "%s: unsupported version %d", file,
+			hdr[8] | hdr[9] << 8);
+		fclose(fp);
+		return -1;
+	}
+
+	while ((ch = fgetc(fp)) != EOF) {
+		uint8_t tag = ch;
+
+		for (len = 0, shift = 0; (ch = fgetc(fp)) != EOF; shift += 7) {
+			len |= (uint64_t)(ch & 0x7f) << shift;
+			if ((ch & 0x80) == 0 || shift > 56)
+				break;
+		}
+		if (ch == EOF || (ch & 0x80) || len > SAMPLE_MAX_BLOCK) {
+			lprintf(LOG_ERR, "%s: bad block header", file);
+			rc = -1;
+			break;
+		}
+		if (len > size) {
+			uint8_t * tmp = realloc(buf, len);
+			if (tmp == NULL) {
+				lprintf(LOG_ERR, "ipmitool: malloc failure");
+				rc = -1;
+				break;
+			}
+			buf = tmp;
+			size = len;
+		}
+		if (fread(buf, 1, len, fp) != len) {
+			lprintf(LOG_ERR, "%s: truncated block", file);
+			rc = -1;
+			break;
+		}
+
+		switch (tag) {
+		case IPMI_SAMPLE_DICT:
+			sample_dict_free(sw, list, cols);
+			sw = NULL;
+			list = NULL;
+			cols = sample_dict(buf, buf + len, &sw, &list);
+			first = 1;
+			if (cols < 0) {
+				lprintf(LOG_ERR, "%s: bad dictionary", file);
+				cols = 0;
+				rc = -1;
+			}
+			break;
+		case IPMI_SAMPLE_DATA:
+			if (cols == 0 || sample_rows(buf, buf + len,
+					sw, cols, precision, &first,
+					row, ctx) < 0) {
+				lprintf(LOG_ERR, "%s: bad sample block", file);
+				rc = -1;
+			}
+			break;
+		default:
+			/* blocks of later versions */
+			break;
+		}
+		if (rc < 0)
+			break;
+	}
+
+	sample_dict_free(sw, list, cols);
+	free(buf);
+	fclose(fp);
+	return rc;
+}
@@ -37,8 +37,13 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <time.h>
 
 #include <ipmitool/ipmi.h>
@@ -56,18 +61,17 @@
 #if HAVE_CONFIG_H
 # include <config.h>
 #endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 extern int verbose;
-static int use_built_in;	/* Uses DeviceSDRs instead of SDRR */
-static int sdr_max_read_len = 0;
-static int sdr_extended = 0;
-static long sdriana = 0;
-
-static struct sdr_record_list *sdr_list_head = NULL;
-static struct sdr_record_list *sdr_list_tail = NULL;
-static struct ipmi_sdr_iterator *sdr_list_itr = NULL;
 
 void printf_sdr_usage();
+static struct ipmi_sdr_iterator *ipmi_sdr_list_start(struct ipmi_intf *intf);
+static void __sdr_list_append(struct ipmi_intf *intf,
+			      struct sdr_record_list *sdrr);
+static void __sdr_cache_unmap(struct ipmi_intf *intf);
 
 /* ipmi_sdr_get_unit_string  -  return units for base/modifier
  *
@@ -81,12 +85,19 @@ void printf_sdr_usage();
 const char *
 ipmi_sdr_get_unit_string(uint8_t pct, uint8_t type, uint8_t base, uint8_t modifier)
 {
-	static char unitstr[16];
+	static IPMI_TLS char unitstr[16];
 	/*
 	 * By default, if units are supposed to be percent, we will pre-pend
 	 * the percent string  to the textual representation of the units.
 	 */
 	char *pctstr = pct ? "% " : "";
+	const int units = sizeof(unit_desc) / sizeof(unit_desc[0]);
+
+	/* codes past the table, from a bad record, read as unspecified */
+	if (base >= units)
+		base = 0;
+	if (modifier >= units)
+		modifier = 0;
 	memset(unitstr, 0, sizeof (unitstr));
 	switch (type) {
 	case 2:
@@ -151,7 +162,8 @@ sdr_sensor_has_analog_reading(struct ipmi_intf *intf,
 			 sr->full->cmn.unit.type.base |
 			 sr->full->cmn.unit.type.modifier)) {
 			 /* And it does have the necessary units specs */
-			 if ( !(intf->manufacturer_id == IPMI_OEM_HP) ) {
+			 if (intf == NULL ||
+			     intf->manufacturer_id != IPMI_OEM_HP) {
 				/* But to be safe we only do this for HP */
 				return 0;
 			 }
@@ -161,10 +173,16 @@ sdr_sensor_has_analog_reading(struct ipmi_intf *intf,
 	}
 	/*
 	 * If sensor has linearization, then we should be able to update the
-	 * reading factors and if we cannot fail the conversion.
+	 * reading factors and if we cannot fail the conversion.  Without
+	 * an interface they cannot be read at all, so the sensor keeps its
+	 * units but has no reading.
 	 */
 	if (sr->full->linearization >= SDR_SENSOR_L_NONLINEAR &&
 	    sr->full->linearization <= 0x7F) {
+		if (intf == NULL) {
+			sr->s_reading_valid = 0;
+			return 1;
+		}
 		if (ipmi_sensor_get_sensor_reading_factors(intf, sr->full, sr->s_reading) < 0){
 			sr->s_reading_valid = 0;
 			return 0;
@@ -174,15 +192,46 @@ sdr_sensor_has_analog_reading(struct ipmi_intf *intf,
 	return 1;
 }
 
-/* sdr_convert_sensor_reading  -  convert raw sensor reading
+/*
+ * Raw readings are 8 bits wide, so conversions are looked up in a
+ * table of all 256 converted values, built on first use.  Tables are
+ * keyed by the conversion factors rather than the record, so sensors
+ * with the same factors share one.  Non-linear sensors get new
+ * factors from the BMC with every reading and are converted directly.
+ * Each thread keeps at most SDR_CONV_MAX tables; they are freed with
+ * the SDR list, so a thread releases them by calling ipmi_cleanup()
+ * on its interface before it exits.
+ */
+#define SDR_CONV_READING	0
+#define SDR_CONV_HYSTERESIS	1
+#define SDR_CONV_TOLERANCE	2
+
+#define SDR_CONV_BUCKETS	64	/* power of two */
+#define SDR_CONV_MAX		64	/* tables per thread, 2 KB each */
+
+struct sdr_conv_table {
+	struct sdr_conv_table *next;
+	uint16_t mtol;
+	uint32_t bacc;
+	uint8_t analog;
+	uint8_t linearization;
+	uint8_t kind;
+	double value[256];
+};
+
+static IPMI_TLS struct sdr_conv_table *sdr_conv_tables[SDR_CONV_BUCKETS];
+static IPMI_TLS int sdr_conv_count;
+
+/* __sdr_convert  -  convert one raw value without the tables
  *
+ * @kind:	SDR_CONV_READING, _HYSTERESIS or _TOLERANCE
  * @sensor:	sensor record
- * @val:	raw sensor reading
+ * @val:	raw value
  *
- * returns floating-point sensor reading
+ * returns floating-point value
  */
-double
-sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
+static double
+__sdr_convert(int kind, struct sdr_record_full_sensor *sensor, uint8_t val)
 {
 	int m, b, k1, k2;
 	double result;
@@ -194,16 +243,27 @@ sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
 
 	switch (sensor->cmn.unit.analog) {
 	case 0:
-		result = (double) (((m * val) +
-				    (b * pow(10, k1))) * pow(10, k2));
+		if (kind == SDR_CONV_READING)
+			result = (double) (((m * val) +
+					    (b * pow(10, k1))) * pow(10, k2));
+		else if (kind == SDR_CONV_HYSTERESIS)
+			result = (double) (((m * val)) * pow(10, k2));
+		else
+			/* as suggested in section 30.4.1 of IPMI 1.5 spec */
+			result = (double) ((((m * (double)val/2)) ) * pow(10, k2));
 		break;
 	case 1:
 		if (val & 0x80)
 			val++;
 		/* Deliberately fall through to case 2. */
 	case 2:
-		result = (double) (((m * (int8_t) val) +
-				    (b * pow(10, k1))) * pow(10, k2));
+		if (kind == SDR_CONV_READING)
+			result = (double) (((m * (int8_t) val) +
+					    (b * pow(10, k1))) * pow(10, k2));
+		else if (kind == SDR_CONV_HYSTERESIS)
+			result = (double) (((m * (int8_t) val) ) * pow(10, k2));
+		else
+			result = (double) (((m * ((double)((int8_t) val)/2))) * pow(10, k2));
 		break;
 	default:
 		/* Oops! This isn't an analog sensor. */
@@ -250,6 +310,115 @@ sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
 	}
 	return result;
 }
+
+/* __sdr_conv_table  -  find or build the conversion table of a sensor
+ *
+ * @kind:	SDR_CONV_READING, _HYSTERESIS or _TOLERANCE
+ * @sensor:	sensor record
+ *
+ * returns the 256 converted values
+ * returns NULL if the sensor is non-linear, the thread has
+ * SDR_CONV_MAX tables already or out of memory
+ */
+static const double *
+__sdr_conv_table(int kind, struct sdr_record_full_sensor *sensor)
+{
+	struct sdr_conv_table *t;
+	uint8_t analog = sensor->cmn.unit.analog;
+	uint8_t lin = sensor->linearization & 0x7f;
+	unsigned int h;
+	int i;
+
+	if (lin >= SDR_SENSOR_L_NONLINEAR)
+		return NULL;
+
+	h = (sensor->mtol * 31 + sensor->bacc) * 2654435761U;
+	h = (h ^ (analog << 8) ^ (lin << 4) ^ kind) & (SDR_CONV_BUCKETS - 1);
+
+	for (t = sdr_conv_tables[h]; t != NULL; t = t->next) {
+		if (t->mtol == sensor->mtol && t->bacc == sensor->bacc &&
+		    t->analog == analog && t->linearization == lin &&
+		    t->kind == kind)
+			return t->value;
+	}
+
+	if (sdr_conv_count >= SDR_CONV_MAX)
+		return NULL;
+	t = malloc(sizeof (struct sdr_conv_table));
+	if (t == NULL)
+		return NULL;
+	t->mtol = sensor->mtol;
+	t->bacc = sensor->bacc;
+	t->analog = analog;
+	t->linearization = lin;
+	t->kind = kind;
+	for (i = 0; i < 256; i++)
+		t->value[i] = __sdr_convert(kind, sensor, i);
+	t->next = sdr_conv_tables[h];
+	sdr_conv_tables[h] = t;
+	sdr_conv_count++;
+	return t->value;
+}
+
+/* __sdr_conv_free  -  free the conversion tables of this thread */
+static void
+__sdr_conv_free(void)
+{
+	struct sdr_conv_table *t;
+	int h;
+
+	for (h = 0; h < SDR_CONV_BUCKETS; h++) {
+		while ((t = sdr_conv_tables[h]) != NULL) {
+			sdr_conv_tables[h] = t->next;
+			free(t);
+		}
+	}
+	sdr_conv_count = 0;
+}
+
+/* sdr_convert_sensor_reading  -  convert raw sensor reading
+ *
+ * @sensor:	sensor record
+ * @val:	raw sensor reading
+ *
+ * returns floating-point sensor reading
+ */
+double
+sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
+{
+	const double *t = __sdr_conv_table(SDR_CONV_READING, sensor);
+
+	if (t == NULL)
+		return __sdr_convert(SDR_CONV_READING, sensor, val);
+	return t[val];
+}
+
+/* sdr_convert_sensor_readings  -  convert an array of raw readings
+ *
+ * All readings are of the same sensor, the loop is a plain table
+ * lookup the compiler can vectorize.
+ *
+ * @sensor:	sensor record
+ * @raw:	raw sensor readings
+ * @out:	converted readings
+ * @count:	number of readings
+ */
+void
+sdr_convert_sensor_readings(struct sdr_record_full_sensor *sensor,
+			    const uint8_t *raw, double *out, int count)
+{
+	const double *t = __sdr_conv_table(SDR_CONV_READING, sensor);
+	int i;
+
+	if (t == NULL) {
+		for (i = 0; i < count; i++)
+			out[i] = __sdr_convert(SDR_CONV_READING, sensor, raw[i]);
+		return;
+	}
+	for (i = 0; i < count; i++)
+		out[i] = t[raw[i]];
+}
+
 /* sdr_convert_sensor_hysterisis  -  convert raw sensor hysterisis
  *
  * Even though spec says histerisis should be computed using Mx+B
@@ -266,71 +435,13 @@ sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
 double
 sdr_convert_sensor_hysterisis(struct sdr_record_full_sensor *sensor, uint8_t val)
 {
-	int m, k2;
-	double result;
+	const double *t = __sdr_conv_table(SDR_CONV_HYSTERESIS, sensor);
 
-	m = __TO_M(sensor->mtol);
-
-	k2 = __TO_R_EXP(sensor->bacc);
-
-	switch (sensor->cmn.unit.analog) {
-	case 0:
-		result = (double) (((m * val)) * pow(10, k2));
-		break;
-	case 1:
-		if (val & 0x80)
-			val++;
-		/* Deliberately fall through to case 2. */
-	case 2:
-		result = (double) (((m * (int8_t) val) ) * pow(10, k2));
-		break;
-	default:
-		/* Oops! This isn't an analog sensor. */
-		return 0.0;
-	}
-
-	switch (sensor->linearization & 0x7f) {
-	case SDR_SENSOR_L_LN:
-		result = log(result);
-		break;
-	case SDR_SENSOR_L_LOG10:
-		result = log10(result);
-		break;
-	case SDR_SENSOR_L_LOG2:
-		result = (double) (log(result) / log(2.0));
-		break;
-	case SDR_SENSOR_L_E:
-		result = exp(result);
-		break;
-	case SDR_SENSOR_L_EXP10:
-		result = pow(10.0, result);
-		break;
-	case SDR_SENSOR_L_EXP2:
-		result = pow(2.0, result);
-		break;
-	case SDR_SENSOR_L_1_X:
-		result = pow(result, -1.0);	/*1/x w/o exception */
-		break;
-	case SDR_SENSOR_L_SQR:
-		result = pow(result, 2.0);
-		break;
-	case SDR_SENSOR_L_CUBE:
-		result = pow(result, 3.0);
-		break;
-	case SDR_SENSOR_L_SQRT:
-		result = sqrt(result);
-		break;
-	case SDR_SENSOR_L_CUBERT:
-		result = cbrt(result);
-		break;
-	case SDR_SENSOR_L_LINEAR:
-	default:
-		break;
-	}
-	return result;
+	if (t == NULL)
+		return __sdr_convert(SDR_CONV_HYSTERESIS, sensor, val);
+	return t[val];
 }
 
-
 /* sdr_convert_sensor_tolerance  -  convert raw sensor reading
  *
  * @sensor:	sensor record
@@ -341,68 +452,11 @@ sdr_convert_sensor_hysterisis(struct sdr_record_full_sensor *sensor, uint8_t val
 double
 sdr_convert_sensor_tolerance(struct sdr_record_full_sensor *sensor, uint8_t val)
 {
-	int m,   k2;
-	double result;
-
-	m = __TO_M(sensor->mtol);
-	k2 = __TO_R_EXP(sensor->bacc);
-
-	switch (sensor->cmn.unit.analog) {
-	case 0:
-                /* as suggested in section 30.4.1 of IPMI 1.5 spec */
-		result = (double) ((((m * (double)val/2)) ) * pow(10, k2));
-		break;
-	case 1:
-		if (val & 0x80)
-			val++;
-		/* Deliberately fall through to case 2. */
-	case 2:
-		result = (double) (((m * ((double)((int8_t) val)/2))) * pow(10, k2));
-		break;
-	default:
-		/* Oops! This isn't an analog sensor. */
-		return 0.0;
-	}
+	const double *t = __sdr_conv_table(SDR_CONV_TOLERANCE, sensor);
 
-	switch (sensor->linearization & 0x7f) {
-	case SDR_SENSOR_L_LN:
-		result = log(result);
-		break;
-	case SDR_SENSOR_L_LOG10:
-		result = log10(result);
-		break;
-	case SDR_SENSOR_L_LOG2:
-		result = (double) (log(result) / log(2.0));
-		break;
-	case SDR_SENSOR_L_E:
-		result = exp(result);
-		break;
-	case SDR_SENSOR_L_EXP10:
-		result = pow(10.0, result);
-		break;
-	case SDR_SENSOR_L_EXP2:
-		result = pow(2.0, result);
-		break;
-	case SDR_SENSOR_L_1_X:
-		result = pow(result, -1.0);	/*1/x w/o exception */
-		break;
-	case SDR_SENSOR_L_SQR:
-		result = pow(result, 2.0);
-		break;
-	case SDR_SENSOR_L_CUBE:
-		result = pow(result, 3.0);
-		break;
-	case SDR_SENSOR_L_SQRT:
-		result = sqrt(result);
-		break;
-	case SDR_SENSOR_L_CUBERT:
-		result = cbrt(result);
-		break;
-	case SDR_SENSOR_L_LINEAR:
-	default:
-		break;
-	}
-	return result;
+	if (t == NULL)
+		return __sdr_convert(SDR_CONV_TOLERANCE, sensor, val);
+	return t[val];
 }
 
 /* sdr_convert_sensor_value_to_raw  -  convert sensor reading back to raw
@@ -686,6 +740,7 @@ ipmi_sdr_get_sensor_event_enable(struct ipmi_intf *intf, uint8_t sensor,
 
 /* ipmi_sdr_get_sensor_type_desc  -  Get sensor type descriptor
  *
+ * @intf:	ipmi interface, names OEM types of its BMC, may be NULL
  * @type:	ipmi sensor type
  *
  * returns
@@ -694,9 +749,9 @@ ipmi_sdr_get_sensor_event_enable(struct ipmi_intf *intf, uint8_t sensor,
  *   or "OEM reserved"
  */
 const char *
-ipmi_sdr_get_sensor_type_desc(const uint8_t type)
+ipmi_sdr_get_sensor_type_desc(struct ipmi_intf *intf, const uint8_t type)
 {
-	static char desc[32];
+	static IPMI_TLS char desc[32];
 	memset(desc, 0, 32);
 	if (type <= SENSOR_TYPE_MAX)
 		return sensor_type_desc[type];
@@ -704,7 +759,8 @@ ipmi_sdr_get_sensor_type_desc(const uint8_t type)
 		snprintf(desc, 32, "reserved #%02x", type);
 	else
    {
-      snprintf(desc, 32, oemval2str(sdriana,type,ipmi_oem_sdr_type_vals),
+      snprintf(desc, 32, oemval2str(intf != NULL ? intf->sdr.manufacturer : 0,
+                                    type, ipmi_oem_sdr_type_vals),
                                                                    type);
    }
 	return desc;
@@ -712,6 +768,7 @@ ipmi_sdr_get_sensor_type_desc(const uint8_t type)
 
 /* ipmi_sdr_get_thresh_status  -  threshold status indicator
  *
+ * @intf:		ipmi interface, for the sdr elist style, may be NULL
  * @rsp:		response from Get Sensor Reading comand
  * @validread:	validity of the status field argument
  * @invalidstr:	string to return if status field is not valid
@@ -724,8 +781,10 @@ ipmi_sdr_get_sensor_type_desc(const uint8_t type)
  *   ns = not specified
  */
 const char *
-ipmi_sdr_get_thresh_status(struct sensor_reading *sr, const char *invalidstr)
+ipmi_sdr_get_thresh_status(struct ipmi_intf *intf, struct sensor_reading *sr,
+			   const char *invalidstr)
 {
+	int extended = intf != NULL && intf->sdr.extended;
 	uint8_t stat;
 	if (!sr->s_reading_valid) {
 	    return invalidstr;
@@ -734,42 +793,42 @@ ipmi_sdr_get_thresh_status(struct sensor_reading *sr, const char *invalidstr)
 	if (stat & SDR_SENSOR_STAT_LO_NR) {
 		if (verbose)
 			return "Lower Non-Recoverable";
-		else if (sdr_extended)
+		else if (extended)
 			return "lnr";
 		else
 			return "nr";
 	} else if (stat & SDR_SENSOR_STAT_HI_NR) {
 		if (verbose)
 			return "Upper Non-Recoverable";
-		else if (sdr_extended)
+		else if (extended)
 			return "unr";
 		else
 			return "nr";
 	} else if (stat & SDR_SENSOR_STAT_LO_CR) {
 		if (verbose)
 			return "Lower Critical";
-		else if (sdr_extended)
+		else if (extended)
 			return "lcr";
 		else
 			return "cr";
 	} else if (stat & SDR_SENSOR_STAT_HI_CR) {
 		if (verbose)
 			return "Upper Critical";
-		else if (sdr_extended)
+		else if (extended)
 			return "ucr";
 		else
 			return "cr";
 	} else if (stat & SDR_SENSOR_STAT_LO_NC) {
 		if (verbose)
 			return "Lower Non-Critical";
-		else if (sdr_extended)
+		else if (extended)
 			return "lnc";
 		else
 			return "nc";
 	} else if (stat & SDR_SENSOR_STAT_HI_NC) {
 		if (verbose)
 			return "Upper Non-Critical";
-		else if (sdr_extended)
+		else if (extended)
 			return "unc";
 		else
 			return "nc";
@@ -782,7 +841,7 @@ ipmi_sdr_get_thresh_status(struct sensor_reading *sr, const char *invalidstr)
  * @intf:	ipmi interface
  * @itr:	sdr iterator
  *
- * returns pointer to static sensor retrieval struct
+ * returns pointer to the header kept in the iterator
  * returns NULL on error
  */
 static struct sdr_get_rs *
@@ -791,7 +850,7 @@ ipmi_sdr_get_header(struct ipmi_intf *intf, struct ipmi_sdr_iterator *itr)
 	struct ipmi_rq req;
 	struct ipmi_rs *rsp;
 	struct sdr_get_rq sdr_rq;
-	static struct sdr_get_rs sdr_rs;
+	struct sdr_get_rs *sdr_rs = &itr->header;
 	int try = 0;
 
 	memset(&sdr_rq, 0, sizeof (sdr_rq));
@@ -850,11 +909,11 @@ ipmi_sdr_get_header(struct ipmi_intf *intf, struct ipmi_sdr_iterator *itr)
 
 	lprintf(LOG_DEBUG, "SDR record ID   : 0x%04x", itr->next);
 
-	memcpy(&sdr_rs, rsp->data, sizeof (sdr_rs));
+	memcpy(sdr_rs, rsp->data, sizeof (*sdr_rs));
 
-	if (sdr_rs.length == 0) {
+	if (sdr_rs->length == 0) {
 		lprintf(LOG_ERR, "SDR record id 0x%04x: invalid length %d",
-			itr->next, sdr_rs.length);
+			itr->next, sdr_rs->length);
 		return NULL;
 	}
 
@@ -866,16 +925,16 @@ ipmi_sdr_get_header(struct ipmi_intf *intf, struct ipmi_sdr_iterator *itr)
 	 * completion code CBh = "Requested Sensor, data, or record
 	 * not present"
 	 */
-	if (sdr_rs.id != itr->next) {
-		lprintf(LOG_DEBUG, "SDR record id mismatch: 0x%04x", sdr_rs.id);
-		sdr_rs.id = itr->next;
+	if (sdr_rs->id != itr->next) {
+		lprintf(LOG_DEBUG, "SDR record id mismatch: 0x%04x", sdr_rs->id);
+		sdr_rs->id = itr->next;
 	}
 
-	lprintf(LOG_DEBUG, "SDR record type : 0x%02x", sdr_rs.type);
-	lprintf(LOG_DEBUG, "SDR record next : 0x%04x", sdr_rs.next);
-	lprintf(LOG_DEBUG, "SDR record bytes: %d", sdr_rs.length);
+	lprintf(LOG_DEBUG, "SDR record type : 0x%02x", sdr_rs->type);
+	lprintf(LOG_DEBUG, "SDR record next : 0x%04x", sdr_rs->next);
+	lprintf(LOG_DEBUG, "SDR record bytes: %d", sdr_rs->length);
 
-	return &sdr_rs;
+	return sdr_rs;
 }
 
 /* ipmi_sdr_get_next_header  -  retreive next SDR header
@@ -1400,77 +1459,79 @@ print_csv_discrete(struct sdr_record_common_sensor    *sensor,
 		sr->s_data3);
 }
 
-/* ipmi_sdr_read_sensor_value  -  read sensor value
+/* __sdr_reading_init  -  prepare a sensor reading for a sensor record
  *
- * @intf		Interface pointer
- * @sensor		Common sensor component pointer
- * @sdr_record_type	Type of sdr sensor record
- * @precision		decimal precision for analog format conversion
+ * @sr:			sensor reading to fill in
+ * @sensor:		Common sensor component pointer
+ * @sdr_record_type:	Type of sdr sensor record
  *
- * returns a pointer to sensor value reading data structure
+ * returns 0 on success
+ * returns -1 if the record is not a full or compact sensor
  */
-struct sensor_reading *
-ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
-		 struct sdr_record_common_sensor *sensor,
-		 uint8_t sdr_record_type, int precision)
+static int
+__sdr_reading_init(struct sensor_reading *sr,
+		   struct sdr_record_common_sensor *sensor,
+		   uint8_t sdr_record_type)
 {
-	static struct sensor_reading sr;
-
-	if (sensor == NULL)
-		return NULL;
+	int idlen;
 
 	/* Initialize to reading valid value of zero */
-	memset(&sr, 0, sizeof(sr));
+	memset(sr, 0, sizeof(*sr));
 
 	switch (sdr_record_type) {
-		int idlen;
 		case (SDR_RECORD_TYPE_FULL_SENSOR):
-			sr.full = (struct sdr_record_full_sensor *)sensor;
-			idlen = sr.full->id_code & 0x1f;
-			idlen = idlen < sizeof(sr.s_id) ?
-						idlen : sizeof(sr.s_id) - 1;
-			memcpy(sr.s_id, sr.full->id_string, idlen);
+			sr->full = (struct sdr_record_full_sensor *)sensor;
+			idlen = sr->full->id_code & 0x1f;
+			idlen = idlen < sizeof(sr->s_id) ?
+						idlen : sizeof(sr->s_id) - 1;
+			memcpy(sr->s_id, sr->full->id_string, idlen);
 			break;
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			sr.compact = (struct sdr_record_compact_sensor *)sensor;
-			idlen = sr.compact->id_code & 0x1f;
-			idlen = idlen < sizeof(sr.s_id) ?
-						idlen : sizeof(sr.s_id) - 1;
-			memcpy(sr.s_id, sr.compact->id_string, idlen);
+			sr->compact = (struct sdr_record_compact_sensor *)sensor;
+			idlen = sr->compact->id_code & 0x1f;
+			idlen = idlen < sizeof(sr->s_id) ?
+						idlen : sizeof(sr->s_id) - 1;
+			memcpy(sr->s_id, sr->compact->id_string, idlen);
 			break;
 		default:
-			return NULL;
+			return -1;
 	}
 
-	/*
-	 * Get current reading via IPMI interface
-	 */
-	struct ipmi_rs *rsp;
-	rsp = ipmi_sdr_get_sensor_reading_ipmb(intf,
-					       sensor->keys.sensor_num,
-					       sensor->keys.owner_id,
-					       sensor->keys.lun,
-					       sensor->keys.channel);
-	sr.s_a_val   = 0.0;	/* init analog value to a floating point 0 */
-	sr.s_a_str[0] = '\0';	/* no converted analog value string */
-	sr.s_a_units = "";	/* no converted analog units units */
-
+	sr->s_a_val   = 0.0;	/* init analog value to a floating point 0 */
+	sr->s_a_str[0] = '\0';	/* no converted analog value string */
+	sr->s_a_units = "";	/* no converted analog units units */
+	return 0;
+}
 
+/* __sdr_reading_set  -  fill in a sensor reading from its response
+ *
+ * @intf:	ipmi interface
+ * @sr:		sensor reading set up by __sdr_reading_init()
+ * @sensor:	Common sensor component pointer
+ * @rsp:	Get Sensor Reading response, NULL if the request failed
+ * @precision:	decimal precision for analog format conversion
+ * @value:	converted reading, NULL to convert rsp->data[0] here
+ */
+static void
+__sdr_reading_set(struct ipmi_intf *intf, struct sensor_reading *sr,
+		  struct sdr_record_common_sensor *sensor,
+		  struct ipmi_rs *rsp, int precision, const double *value)
+{
 	if (rsp == NULL) {
 		lprintf(LOG_DEBUG, "Error reading sensor %s (#%02x)",
-			sr.s_id, sensor->keys.sensor_num);
-		return &sr;
+			sr->s_id, sensor->keys.sensor_num);
+		return;
 	}
 
 	if (rsp->ccode) {
-		if ( !((sr.full    && rsp->ccode == 0xcb) ||
-		       (sr.compact && rsp->ccode == 0xcd)) ) {
+		if ( !((sr->full    && rsp->ccode == 0xcb) ||
+		       (sr->compact && rsp->ccode == 0xcd)) ) {
 			lprintf(LOG_DEBUG,
-				"Error reading sensor %s (#%02x): %s", sr.s_id,
+				"Error reading sensor %s (#%02x): %s", sr->s_id,
 				sensor->keys.sensor_num,
 				val2str(rsp->ccode, completion_code_vals));
 		}
-		return &sr;
+		return;
 	}
 
 	if (rsp->data_len < 2) {
@@ -1481,76 +1542,350 @@ ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
 		 * a valid sensor reading.
 		 */
 		lprintf(LOG_DEBUG, "Error reading sensor %s invalid len %d",
-			sr.s_id, rsp->data_len);
-		return &sr;
+			sr->s_id, rsp->data_len);
+		return;
 	}
 
 
 	if (IS_READING_UNAVAILABLE(rsp->data[1]))
-		sr.s_reading_unavailable = 1;
+		sr->s_reading_unavailable = 1;
 
 	if (IS_SCANNING_DISABLED(rsp->data[1])) {
-		sr.s_scanning_disabled = 1;
+		sr->s_scanning_disabled = 1;
 		lprintf(LOG_DEBUG, "Sensor %s (#%02x) scanning disabled",
-			sr.s_id, sensor->keys.sensor_num);
-		return &sr;
+			sr->s_id, sensor->keys.sensor_num);
+		return;
 	}
-	if ( !sr.s_reading_unavailable ) {
-		sr.s_reading_valid = 1;
-		sr.s_reading = rsp->data[0];
+	if ( !sr->s_reading_unavailable ) {
+		sr->s_reading_valid = 1;
+		sr->s_reading = rsp->data[0];
 	}
 	if (rsp->data_len > 2)
-		sr.s_data2   = rsp->data[2];
+		sr->s_data2   = rsp->data[2];
 	if (rsp->data_len > 3)
-		sr.s_data3   = rsp->data[3];
-	if (sdr_sensor_has_analog_reading(intf, &sr)) {
-		sr.s_has_analog_value = 1;
-		if (sr.s_reading_valid) {
-			sr.s_a_val = sdr_convert_sensor_reading(sr.full, sr.s_reading);
+		sr->s_data3   = rsp->data[3];
+	if (sdr_sensor_has_analog_reading(intf, sr)) {
+		sr->s_has_analog_value = 1;
+		if (sr->s_reading_valid) {
+			sr->s_a_val = value != NULL ? *value :
+				sdr_convert_sensor_reading(sr->full,
+							   sr->s_reading);
 		}
 		/* determine units string with possible modifiers */
-		sr.s_a_units = ipmi_sdr_get_unit_string(sr.full->cmn.unit.pct,
-					   sr.full->cmn.unit.modifier,
-					   sr.full->cmn.unit.type.base,
-					   sr.full->cmn.unit.type.modifier);
-		snprintf(sr.s_a_str, sizeof(sr.s_a_str), "%.*f",
-			(sr.s_a_val == (int) sr.s_a_val) ? 0 :
-			precision, sr.s_a_val);
+		snprintf(sr->s_units, sizeof(sr->s_units), "%s",
+			ipmi_sdr_get_unit_string(sr->full->cmn.unit.pct,
+					   sr->full->cmn.unit.modifier,
+					   sr->full->cmn.unit.type.base,
+					   sr->full->cmn.unit.type.modifier));
+		sr->s_a_units = sr->s_units;
+		snprintf(sr->s_a_str, sizeof(sr->s_a_str), "%.*f",
+			(sr->s_a_val == (int) sr->s_a_val) ? 0 :
+			precision, sr->s_a_val);
 	}
-	return &sr;
 }
 
-/* ipmi_sdr_print_sensor_fc  -  print full & compact SDR records
+/* ipmi_sdr_read_sensor_value  -  read sensor value
  *
- * @intf:		ipmi interface
- * @sensor:		common sensor structure
- * @sdr_record_type:	type of sdr record, either full or compact
+ * @intf		Interface pointer
+ * @sensor		Common sensor component pointer
+ * @sdr_record_type	Type of sdr sensor record
+ * @precision		decimal precision for analog format conversion
  *
- * returns 0 on success
- * returns -1 on error
+ * returns a pointer to sensor value reading data structure, valid
+ * until the next call; see ipmi_sdr_sweep() for reading many sensors
  */
-int
-ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
-			   struct sdr_record_common_sensor    *sensor,
-			   uint8_t sdr_record_type)
+struct sensor_reading *
+ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
+		 struct sdr_record_common_sensor *sensor,
+		 uint8_t sdr_record_type, int precision)
 {
-	char sval[16];
-	int i = 0;
-	uint8_t target, lun, channel;
-	struct sensor_reading *sr;
-
-
-	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 2);
+	static IPMI_TLS struct sensor_reading sr;
+	struct ipmi_rs *rsp;
 
-	if (sr == NULL)
-		return -1;
+	if (sensor == NULL)
+		return NULL;
 
-	target = sensor->keys.owner_id;
-	lun = sensor->keys.lun;
-	channel = sensor->keys.channel;
+	if (__sdr_reading_init(&sr, sensor, sdr_record_type) < 0)
+		return NULL;
 
 	/*
-	 * CSV OUTPUT
+	 * Get current reading via IPMI interface
+	 */
+	rsp = ipmi_sdr_get_sensor_reading_ipmb(intf,
+					       sensor->keys.sensor_num,
+					       sensor->keys.owner_id,
+					       sensor->keys.lun,
+					       sensor->keys.channel);
+	__sdr_reading_set(intf, &sr, sensor, rsp, precision, NULL);
+	return &sr;
+}
+
+/* ipmi_sdr_decode_sensor_reading  -  sensor reading from saved data
+ *
+ * Interprets the data of a Get Sensor Reading response taken earlier,
+ * for instance by ipmi_sdr_sweep(), as ipmi_sdr_read_sensor_value()
+ * would.
+ *
+ * @intf:		ipmi interface, NULL to send no requests: non-linear
+ *			sensors then have no reading
+ * @sensor:		Common sensor component pointer
+ * @sdr_record_type:	Type of sdr sensor record
+ * @data:		response data
+ * @data_len:		its length, 0 if the request had failed
+ * @precision:		decimal precision for analog format conversion
+ * @value:		converted reading, from sdr_convert_sensor_readings()
+ *			say, or NULL to convert data[0] here
+ * @sr:			sensor reading to fill in
+ *
+ * returns 0 on success
+ * returns -1 if the record is not a full or compact sensor
+ */
+int
+ipmi_sdr_decode_sensor_reading(struct ipmi_intf *intf,
+			       struct sdr_record_common_sensor *sensor,
+			       uint8_t sdr_record_type,
+			       const uint8_t *data, int data_len,
+			       int precision, const double *value,
+			       struct sensor_reading *sr)
+{
+	struct ipmi_rs rsp;
+
+	if (__sdr_reading_init(sr, sensor, sdr_record_type) < 0)
+		return -1;
+
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.data_len = __min(data_len, (int)sizeof(rsp.data));
+	memcpy(rsp.data, data, rsp.data_len);
+	__sdr_reading_set(intf, sr, sensor, data_len > 0 ? &rsp : NULL,
+			  precision, value);
+	return 0;
+}
+
+/* sdr_sweep_ctx  -  state shared with __sdr_sweep_done()
+ */
+struct sdr_sweep_ctx {
+	struct sdr_sweep_entry *sw;
+	int *idx;	/* 2 * sweep entry, +1 for Get Sensor Thresholds */
+};
+
+/* __sdr_sweep_done  -  ipmi_intf_sendrecv_window() callback of
+ *                      ipmi_sdr_sweep()
+ *
+ * Only keeps the response; it is decoded by __sdr_sweep_decode() once
+ * the window is done, as non-linear sensors need another request.
+ */
+static void
+__sdr_sweep_done(struct ipmi_intf *intf, int idx, struct ipmi_rq *req,
+		 struct ipmi_rs *rsp, void *ctx)
+{
+	struct sdr_sweep_ctx *sc = (struct sdr_sweep_ctx *)ctx;
+	struct sdr_sweep_entry *s = &sc->sw[sc->idx[idx] / 2];
+
+	if ((sc->idx[idx] & 1) == 0) {
+		if (rsp == NULL)
+			return;
+		s->ccode = rsp->ccode;
+		if (rsp->ccode == 0) {
+			s->raw_len = __min(rsp->data_len, (int)sizeof(s->raw));
+			memcpy(s->raw, rsp->data, s->raw_len);
+		}
+		return;
+	}
+	if (rsp == NULL || rsp->ccode > 0 || rsp->data_len == 0)
+		return;
+	s->thresh_len = __min(rsp->data_len, (int)sizeof(s->thresh));
+	memcpy(s->thresh, rsp->data, s->thresh_len);
+}
+
+/* __sdr_sweep_decode  -  fill in the reading of a swept sensor
+ *
+ * @intf:	ipmi interface, addressing the sensor
+ * @s:		sweep entry with the response kept by __sdr_sweep_done()
+ * @precision:	decimal precision for analog format conversion
+ */
+static void
+__sdr_sweep_decode(struct ipmi_intf *intf, struct sdr_sweep_entry *s,
+		   int precision)
+{
+	struct ipmi_rs rsp;
+
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.ccode = s->ccode;
+	rsp.data_len = s->raw_len;
+	memcpy(rsp.data, s->raw, s->raw_len);
+	__sdr_reading_set(intf, &s->sr, s->entry->record.common,
+			  s->ccode < 0 ? NULL : &rsp, precision, NULL);
+}
+
+/* ipmi_sdr_sweep  -  read many sensors at once
+ *
+ * Fills in the sensor reading, and with @thresholds the thresholds of
+ * threshold sensors, of every full and compact sensor record in @sw.
+ * The requests of all sensors behind one IPMB target go out together
+ * through ipmi_intf_sendrecv_window(), so up to the interface window
+ * of them are in flight at once.  Other records are left zeroed.
+ *
+ * @intf:	ipmi interface
+ * @sw:		sensors to read, entry set by the caller
+ * @count:	number of sensors
+ * @precision:	decimal precision for analog format conversion
+ * @thresholds:	also issue Get Sensor Thresholds
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_sweep(struct ipmi_intf *intf, struct sdr_sweep_entry *sw,
+	       int count, int precision, int thresholds)
+{
+	struct sdr_record_common_sensor *sensor, *s;
+	struct sdr_sweep_ctx sc;
+	struct ipmi_rq *reqs;
+	uint8_t *pending;
+	uint32_t save_addr;
+	uint8_t save_channel;
+	int bridged, i, j, n, rc = 0;
+
+	reqs = calloc(2 * count + 1, sizeof(struct ipmi_rq));
+	sc.idx = calloc(2 * count + 1, sizeof(int));
+	pending = calloc(count + 1, 1);
+	if (reqs == NULL || sc.idx == NULL || pending == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		rc = -1;
+		goto out;
+	}
+	sc.sw = sw;
+
+	for (i = 0; i < count; i++) {
+		sw[i].raw_len = 0;
+		sw[i].ccode = -1;
+		sw[i].thresh_len = 0;
+		if (__sdr_reading_init(&sw[i].sr, sw[i].entry->record.common,
+				       sw[i].entry->type) == 0)
+			pending[i] = 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!pending[i])
+			continue;
+
+		/* all pending sensors with the same IPMB target as this one */
+		sensor = sw[i].entry->record.common;
+		bridged = BRIDGE_TO_SENSOR(intf, sensor->keys.owner_id,
+					   sensor->keys.channel);
+		for (j = i, n = 0; j < count; j++) {
+			if (!pending[j])
+				continue;
+			s = sw[j].entry->record.common;
+			if (bridged ?
+			    (s->keys.owner_id != sensor->keys.owner_id ||
+			     s->keys.channel != sensor->keys.channel) :
+			    BRIDGE_TO_SENSOR(intf, s->keys.owner_id,
+					     s->keys.channel))
+				continue;
+			pending[j] = 0;
+
+			reqs[n].msg.netfn = IPMI_NETFN_SE;
+			reqs[n].msg.lun = s->keys.lun;
+			reqs[n].msg.cmd = GET_SENSOR_READING;
+			reqs[n].msg.data = &s->keys.sensor_num;
+			reqs[n].msg.data_len = 1;
+			sc.idx[n++] = 2 * j;
+
+			if (!thresholds || !IS_THRESHOLD_SENSOR(s))
+				continue;
+			reqs[n].msg.netfn = IPMI_NETFN_SE;
+			reqs[n].msg.lun = s->keys.lun;
+			reqs[n].msg.cmd = GET_SENSOR_THRESHOLDS;
+			reqs[n].msg.data = &s->keys.sensor_num;
+			reqs[n].msg.data_len = 1;
+			sc.idx[n++] = 2 * j + 1;
+		}
+
+		if (bridged) {
+			lprintf(LOG_DEBUG,
+				"Bridge to Sensor "
+				"Intf my/%#x tgt/%#x:%#x Sdr tgt/%#x:%#x\n",
+				intf->my_addr, intf->target_addr,
+				intf->target_channel,
+				sensor->keys.owner_id, sensor->keys.channel);
+			save_addr = intf->target_addr;
+			intf->target_addr = sensor->keys.owner_id;
+			save_channel = intf->target_channel;
+			intf->target_channel = sensor->keys.channel;
+		}
+		if (ipmi_intf_sendrecv_window(intf, reqs, n,
+					      __sdr_sweep_done, &sc) < 0)
+			rc = -1;
+		for (j = 0; j < n; j++) {
+			if ((sc.idx[j] & 1) == 0)
+				__sdr_sweep_decode(intf, &sw[sc.idx[j] / 2],
+						   precision);
+		}
+		if (bridged) {
+			intf->target_addr = save_addr;
+			intf->target_channel = save_channel;
+		}
+	}
+
+out:
+	free(reqs);
+	free(sc.idx);
+	free(pending);
+	return rc;
+}
+
+/* ipmi_sdr_print_sensor_fc  -  print full & compact SDR records
+ *
+ * @intf:		ipmi interface
+ * @sensor:		common sensor structure
+ * @sdr_record_type:	type of sdr record, either full or compact
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
+			   struct sdr_record_common_sensor    *sensor,
+			   uint8_t sdr_record_type)
+{
+	struct sensor_reading *sr;
+
+	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 2);
+
+	if (sr == NULL)
+		return -1;
+
+	return ipmi_sdr_print_sensor_reading(intf, sensor, sdr_record_type, sr);
+}
+
+/* ipmi_sdr_print_sensor_reading  -  print a full or compact SDR record
+ *                                   with a reading already taken
+ *
+ * @intf:		ipmi interface
+ * @sensor:		common sensor structure
+ * @sdr_record_type:	type of sdr record, either full or compact
+ * @sr:			its reading, see ipmi_sdr_sweep()
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_print_sensor_reading(struct ipmi_intf *intf,
+			      struct sdr_record_common_sensor *sensor,
+			      uint8_t sdr_record_type,
+			      struct sensor_reading *sr)
+{
+	char sval[16];
+	int i = 0;
+	uint8_t target, lun, channel;
+
+	target = sensor->keys.owner_id;
+	lun = sensor->keys.lun;
+	channel = sensor->keys.channel;
+
+	/*
+	 * CSV OUTPUT
 	 */
 
 	if (csv_output) {
@@ -1572,7 +1907,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 					(int) sr->s_a_val) ? 0 : 3,
 					sr->s_a_val);
 					printf("%s,%s", sr->s_a_units,
-					       ipmi_sdr_get_thresh_status(sr, "ns"));
+					       ipmi_sdr_get_thresh_status(intf, sr, "ns"));
 				} else { /* Discrete/Threshold */
 					print_csv_discrete(sensor, sr);
 				}
@@ -1584,7 +1919,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 				printf(",%d.%d,%s,%s,",
 				       sensor->entity.id, sensor->entity.instance,
 				       val2str(sensor->entity.id, entity_id_vals),
-				       ipmi_sdr_get_sensor_type_desc(sensor->sensor.
+				       ipmi_sdr_get_sensor_type_desc(intf, sensor->sensor.
 								     type));
 
 				if (sr->full) {
@@ -1631,7 +1966,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 	 * NORMAL OUTPUT
 	 */
 
-	if (verbose == 0 && sdr_extended == 0) {
+	if (verbose == 0 && intf->sdr.extended == 0) {
 		/*
 		 * print sensor name, reading, state
 		 */
@@ -1660,7 +1995,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 		printf(" | ");
 
 		if (IS_THRESHOLD_SENSOR(sensor)) {
-			printf("%s", ipmi_sdr_get_thresh_status(sr, "ns"));
+			printf("%s", ipmi_sdr_get_thresh_status(intf, sr, "ns"));
 		}
 		else {
 			printf("%s", sr->s_reading_valid ? "ok" : "ns");
@@ -1669,7 +2004,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 		printf("\n");
 
 		return 0;	/* done */
-	} else if (verbose == 0 && sdr_extended == 1) {
+	} else if (verbose == 0 && intf->sdr.extended == 1) {
 		/*
 		 * print sensor name, number, state, entity, reading
 		 */
@@ -1679,7 +2014,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 		if (IS_THRESHOLD_SENSOR(sensor)) {
 			/* Threshold Analog & Discrete */
 			printf("%-3s | %2d.%1d | ",
-			   ipmi_sdr_get_thresh_status(sr, "ns"),
+			   ipmi_sdr_get_thresh_status(intf, sr, "ns"),
 		           sensor->entity.id, sensor->entity.instance);
 		}
 		else {
@@ -1733,7 +2068,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 	if (!IS_THRESHOLD_SENSOR(sensor)) {
 		/* Discrete */
 		printf(" Sensor Type (Discrete): %s (0x%02x)\n",
-				ipmi_sdr_get_sensor_type_desc(sensor->sensor.type),
+				ipmi_sdr_get_sensor_type_desc(intf, sensor->sensor.type),
 				sensor->sensor.type);
 		lprintf(LOG_DEBUG, " Event Type Code       : 0x%02x",
 			sensor->event_type);
@@ -1797,7 +2132,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 		return 0;	/* done */
 	}
 	printf(" Sensor Type (Threshold)  : %s (0x%02x)\n",
-		ipmi_sdr_get_sensor_type_desc(sensor->sensor.type),
+		ipmi_sdr_get_sensor_type_desc(intf, sensor->sensor.type),
 		sensor->sensor.type);
 
 	printf(" Sensor Reading        : ");
@@ -1824,7 +2159,7 @@ ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
 		printf("No Reading\n");
 
 	printf(" Status                : %s\n",
-	       ipmi_sdr_get_thresh_status(sr, "Not Available"));
+	       ipmi_sdr_get_thresh_status(intf, sr, "Not Available"));
 
 	if(sr->full) {
 		SENSOR_PRINT_NORMAL(sr->full, "Nominal Reading", nominal_read);
@@ -2122,7 +2457,7 @@ ipmi_sdr_print_sensor_eventonly(struct ipmi_intf *intf,
 		       sensor->entity.id, sensor->entity.instance,
 		       val2str(sensor->entity.id, entity_id_vals));
 		printf("Sensor Type            : %s (0x%02x)\n",
-			ipmi_sdr_get_sensor_type_desc(sensor->sensor_type),
+			ipmi_sdr_get_sensor_type_desc(intf, sensor->sensor_type),
 			sensor->sensor_type);
 		lprintf(LOG_DEBUG, "Event Type Code        : 0x%02x",
 			sensor->event_type);
@@ -2133,7 +2468,7 @@ ipmi_sdr_print_sensor_eventonly(struct ipmi_intf *intf,
 			       sensor->id_code ? desc : "",
 			       sensor->keys.sensor_num,
 			       sensor->entity.id, sensor->entity.instance);
-		else if (sdr_extended)
+		else if (intf->sdr.extended)
 			printf("%-16s | %02Xh | ns  | %2d.%1d | Event-Only\n",
 			       sensor->id_code ? desc : "",
 			       sensor->keys.sensor_num,
@@ -2171,7 +2506,7 @@ ipmi_sdr_print_sensor_mc_locator(struct ipmi_intf *intf,
 			printf("%s,00h,ok,%d.%d\n",
 			       mc->id_code ? desc : "",
 			       mc->entity.id, mc->entity.instance);
-		else if (sdr_extended) {
+		else if (intf->sdr.extended) {
 			printf("%-16s | 00h | ok  | %2d.%1d | ",
 			       mc->id_code ? desc : "",
 			       mc->entity.id, mc->entity.instance);
@@ -2264,7 +2599,7 @@ ipmi_sdr_print_sensor_generic_locator(struct ipmi_intf *intf,
 			printf("%s,00h,ns,%d.%d\n",
 			       dev->id_code ? desc : "",
 			       dev->entity.id, dev->entity.instance);
-		else if (sdr_extended)
+		else if (intf->sdr.extended)
 			printf
 			    ("%-16s | 00h | ns  | %2d.%1d | Generic Device @%02Xh:%02Xh.%1d\n",
 			     dev->id_code ? desc : "", dev->entity.id,
@@ -2321,7 +2656,7 @@ ipmi_sdr_print_sensor_fru_locator(struct ipmi_intf *intf,
 			printf("%s,00h,ns,%d.%d\n",
 			       fru->id_code ? desc : "",
 			       fru->entity.id, fru->entity.instance);
-		else if (sdr_extended)
+		else if (intf->sdr.extended)
 			printf("%-16s | 00h | ns  | %2d.%1d | %s FRU @%02Xh\n",
 			       fru->id_code ? desc : "",
 			       fru->entity.id, fru->entity.instance,
@@ -2675,6 +3010,9 @@ ipmi_sdr_print_listentry(struct ipmi_intf *intf, struct sdr_record_list *entry)
 }
 
 /* ipmi_sdr_print_sdr  -  iterate through SDR printing records
+ *
+ * The whole repository is read first, then the readings of all sensors
+ * to print are taken with ipmi_sdr_sweep() before printing in SDR order.
  *
  * intf:	ipmi interface
  * type:	record type to print
@@ -2685,111 +3023,57 @@ ipmi_sdr_print_listentry(struct ipmi_intf *intf, struct sdr_record_list *entry)
 int
 ipmi_sdr_print_sdr(struct ipmi_intf *intf, uint8_t type)
 {
-	struct sdr_get_rs *header;
+	struct sdr_sweep_entry *sw;
 	struct sdr_record_list *e;
-	int rc = 0;
+	int count, i, rc = 0;
 
 	lprintf(LOG_DEBUG, "Querying SDR for sensor list");
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
-			lprintf(LOG_ERR, "Unable to open SDR for reading");
+	if (ipmi_sdr_list_cache(intf) < 0) {
+		if (intf->sdr.itr == NULL)
 			return -1;
-		}
+		rc = -1;
 	}
 
-	for (e = sdr_list_head; e != NULL; e = e->next) {
+	for (count = 0, e = intf->sdr.head; e != NULL; e = e->next)
+		count++;
+	sw = calloc(count + 1, sizeof(struct sdr_sweep_entry));
+	if (sw == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+
+	for (count = 0, e = intf->sdr.head; e != NULL; e = e->next) {
 		if (type != e->type && type != 0xff && type != 0xfe)
 			continue;
 		if (type == 0xfe &&
 		    e->type != SDR_RECORD_TYPE_FULL_SENSOR &&
 		    e->type != SDR_RECORD_TYPE_COMPACT_SENSOR)
 			continue;
-		if (ipmi_sdr_print_listentry(intf, e) < 0)
-			rc = -1;
+		sw[count++].entry = e;
 	}
 
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
-		uint8_t *rec;
-		struct sdr_record_list *sdrr;
-
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
-		if (rec == NULL) {
-			lprintf(LOG_ERR, "ipmitool: ipmi_sdr_get_record() failed");
-			rc = -1;
-			continue;
-		}
-
-		sdrr = malloc(sizeof (struct sdr_record_list));
-		if (sdrr == NULL) {
-			lprintf(LOG_ERR, "ipmitool: malloc failure");
-			if (rec != NULL) {
-				free(rec);
-				rec = NULL;
-			}
-			break;
-		}
-		memset(sdrr, 0, sizeof (struct sdr_record_list));
-		sdrr->id = header->id;
-		sdrr->type = header->type;
+	if (ipmi_sdr_sweep(intf, sw, count, 2, 0) < 0)
+		rc = -1;
 
-		switch (header->type) {
+	for (i = 0; i < count; i++) {
+		e = sw[i].entry;
+		switch (e->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			sdrr->record.common =
-			    (struct sdr_record_common_sensor *) rec;
-			break;
-		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
-			sdrr->record.eventonly =
-			    (struct sdr_record_eventonly_sensor *) rec;
-			break;
-		case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
-			sdrr->record.genloc =
-			    (struct sdr_record_generic_locator *) rec;
-			break;
-		case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
-			sdrr->record.fruloc =
-			    (struct sdr_record_fru_locator *) rec;
-			break;
-		case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
-			sdrr->record.mcloc =
-			    (struct sdr_record_mc_locator *) rec;
-			break;
-		case SDR_RECORD_TYPE_ENTITY_ASSOC:
-			sdrr->record.entassoc =
-			    (struct sdr_record_entity_assoc *) rec;
+			if (ipmi_sdr_print_sensor_reading(intf,
+					e->record.common, e->type,
+					&sw[i].sr) < 0)
+				rc = -1;
 			break;
 		default:
-			free(rec);
-			rec = NULL;
-			if (sdrr != NULL) {
-				free(sdrr);
-				sdrr = NULL;
-			}
-			continue;
-		}
-
-                lprintf(LOG_DEBUG, "SDR record ID   : 0x%04x", sdrr->id);
-
-		if (type == header->type || type == 0xff ||
-		    (type == 0xfe &&
-		     (header->type == SDR_RECORD_TYPE_FULL_SENSOR ||
-		      header->type == SDR_RECORD_TYPE_COMPACT_SENSOR))) {
-			if (ipmi_sdr_print_rawentry(intf, header->type,
-						    rec, header->length) < 0)
+			if (ipmi_sdr_print_listentry(intf, e) < 0)
 				rc = -1;
+			break;
 		}
-
-		/* add to global record liset */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
 	}
 
+	free(sw);
 	return rc;
 }
 
@@ -2877,13 +3161,16 @@ ipmi_sdr_start(struct ipmi_intf *intf, int use_builtin)
 	}
 	devid = (struct ipm_devid_rsp *) rsp->data;
 
-   sdriana =  (long)IPM_DEV_MANUFACTURER_ID(devid->manufacturer_id);
+	intf->sdr.manufacturer = IPM_DEV_MANUFACTURER_ID(devid->manufacturer_id);
+	intf->sdr.product = devid->product_id[0] | (devid->product_id[1] << 8);
+	intf->sdr.firmware = ((devid->fw_rev1 & IPM_DEV_FWREV1_MAJOR_MASK) << 8) |
+		devid->fw_rev2;
 
 	if (!use_builtin && (devid->device_revision & IPM_DEV_DEVICE_ID_SDR_MASK)) {
 		if ((devid->adtl_device_support & 0x02) == 0) {
 			if ((devid->adtl_device_support & 0x01)) {
 				lprintf(LOG_DEBUG, "Using Device SDRs\n");
-				use_built_in = 1;
+				intf->sdr.use_built_in = 1;
 			} else {
 				lprintf(LOG_ERR, "Error obtaining SDR info");
 				free(itr);
@@ -2894,7 +3181,7 @@ ipmi_sdr_start(struct ipmi_intf *intf, int use_builtin)
 			lprintf(LOG_DEBUG, "Using SDR from Repository \n");
 		}
 	}
-	itr->use_built_in = use_builtin ? 1 : use_built_in;
+	itr->use_built_in = use_builtin ? 1 : intf->sdr.use_built_in;
    /***********************/
 	if (itr->use_built_in == 0) {
 		struct sdr_repo_info_rs sdr_info;
@@ -2933,6 +3220,11 @@ ipmi_sdr_start(struct ipmi_intf *intf, int use_builtin)
 		itr->total = sdr_info.count;
 		itr->next = 0;
 
+		/* the automatic cache is valid while these are unchanged */
+		intf->sdr.count = sdr_info.count;
+		intf->sdr.add_stamp = sdr_info.add_stamp;
+		intf->sdr.erase_stamp = sdr_info.erase_stamp;
+
 		lprintf(LOG_DEBUG, "SDR free space: %d", sdr_info.free);
 		lprintf(LOG_DEBUG, "SDR records   : %d", sdr_info.count);
 
@@ -3025,13 +3317,13 @@ ipmi_sdr_get_record(struct ipmi_intf * intf, struct sdr_get_rs * header,
 	req.msg.data_len = sizeof (sdr_rq);
 
 	/* check if max length is null */
-	if ( sdr_max_read_len == 0 ) {
+	if ( intf->sdr.max_read_len == 0 ) {
 		/* get maximum response size */
-		sdr_max_read_len = ipmi_intf_get_max_response_data_size(intf) - 2;
+		intf->sdr.max_read_len = ipmi_intf_get_max_response_data_size(intf) - 2;
 
 		/* cap the number of bytes to read */
-		if (sdr_max_read_len > 0xFE) {
-			sdr_max_read_len = 0xFE;
+		if (intf->sdr.max_read_len > 0xFE) {
+			intf->sdr.max_read_len = 0xFE;
 		}
 	}
 
@@ -3040,8 +3332,8 @@ ipmi_sdr_get_record(struct ipmi_intf * intf, struct sdr_get_rs * header,
 	 * transport buffer size.  (completion code 0xca)
 	 */
 	while (i < len) {
-		sdr_rq.length = (len - i < sdr_max_read_len) ?
-		    len - i : sdr_max_read_len;
+		sdr_rq.length = (len - i < intf->sdr.max_read_len) ?
+		    len - i : intf->sdr.max_read_len;
 		sdr_rq.offset = i + 5;	/* 5 header bytes */
 
 		lprintf(LOG_DEBUG, "Getting %d bytes from SDR at offset %d",
@@ -3049,8 +3341,8 @@ ipmi_sdr_get_record(struct ipmi_intf * intf, struct sdr_get_rs * header,
 
 		rsp = intf->sendrecv(intf, &req);
 		if (rsp == NULL) {
-		    sdr_max_read_len = sdr_rq.length - 1;
-		    if (sdr_max_read_len > 0) {
+		    intf->sdr.max_read_len = sdr_rq.length - 1;
+		    if (intf->sdr.max_read_len > 0) {
 			/* no response may happen if requests are bridged
 			   and too many bytes are requested */
 			continue;
@@ -3064,7 +3356,7 @@ ipmi_sdr_get_record(struct ipmi_intf * intf, struct sdr_get_rs * header,
 		switch (rsp->ccode) {
 		case 0xca:
 			/* read too many bytes at once */
-			sdr_max_read_len = sdr_rq.length - 1;
+			intf->sdr.max_read_len = sdr_rq.length - 1;
 			continue;
 		case 0xc5:
 			/* lost reservation */
@@ -3091,7 +3383,7 @@ ipmi_sdr_get_record(struct ipmi_intf * intf, struct sdr_get_rs * header,
 		}
 
 		memcpy(data + i, rsp->data + 2, sdr_rq.length);
-		i += sdr_max_read_len;
+		i += intf->sdr.max_read_len;
 	}
 
 	return data;
@@ -3113,71 +3405,428 @@ ipmi_sdr_end(struct ipmi_intf *intf, struct ipmi_sdr_iterator *itr)
 	}
 }
 
-/* __sdr_list_add  -  helper function to add SDR record to list
- *
- * @head:	list head
- * @entry:	new entry to add to end of list
- *
- * returns 0 on success
- * returns -1 on error
+/*
+ * Lookup tables over the global SDR list.  Records are indexed as they
+ * are appended, chains keep list order so the first match is the one a
+ * walk of the list would find.  Sensor owner LUN is not part of the
+ * number key, lookups by SEL generator ID have never compared it.
  */
-static int
-__sdr_list_add(struct sdr_record_list *head, struct sdr_record_list *entry)
-{
+#define SDR_INDEX_BUCKETS	1024	/* power of two */
+
+struct sdr_index_node {
 	struct sdr_record_list *e;
-	struct sdr_record_list *new;
+	struct sdr_index_node *next;
+};
+
+struct sdr_index_chain {
+	struct sdr_index_node *head;
+	struct sdr_index_node *tail;
+};
+
+#define SDR_INDEX_BLOCK		256	/* nodes per allocation */
+
+struct sdr_index_block {
+	struct sdr_index_block *next;
+	int used;
+	struct sdr_index_node node[SDR_INDEX_BLOCK];
+};
+
+struct sdr_index {
+	struct sdr_index_chain bynum[SDR_INDEX_BUCKETS];
+	struct sdr_index_chain byid[SDR_INDEX_BUCKETS];
+	struct sdr_index_chain byentity[256];
+	struct sdr_index_chain bysensortype[256];
+	struct sdr_index_block *blocks;
+};
+
+/* keys of one record, from the record or a cache file index */
+#define SDR_KEY_SENSOR		0x01	/* owner, num and type are set */
+#define SDR_KEY_ENTITY		0x02	/* entity is set */
+#define SDR_KEY_ID		0x08	/* id and idlen are set */
+
+struct sdr_keys {
+	uint8_t flags;
+	uint8_t owner;
+	uint8_t num;
+	uint8_t type;
+	uint8_t entity;
+	const char *id;		/* not terminated, NULL if none */
+	int idlen;
+};
 
-	if (head == NULL)
-		return -1;
+static unsigned int
+__sdr_hash_num(uint8_t owner, uint8_t num, uint8_t type)
+{
+	uint32_t key = (owner << 16) | (num << 8) | type;
 
-	new = malloc(sizeof (struct sdr_record_list));
-	if (new == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return -1;
-	}
-	memcpy(new, entry, sizeof (struct sdr_record_list));
+	return (key * 2654435761U) >> 22;	/* 10 bits */
+}
 
-	e = head;
-	while (e->next)
-		e = e->next;
-	e->next = new;
-	new->next = NULL;
+static unsigned int
+__sdr_hash_id(const char *id, int len)
+{
+	uint32_t h = 2166136261U;
+	int i;
 
-	return 0;
+	for (i = 0; i < len; i++)
+		h = (h ^ (uint8_t)id[i]) * 16777619U;
+	return h & (SDR_INDEX_BUCKETS - 1);
 }
 
-/* __sdr_list_empty  -  low-level handler to clean up record list
+/* __sdr_record_idstr  -  ID string of a record
  *
- * @head:	list head to clean
+ * @e:		SDR entry
+ * @len:	set to string length, up to the first NUL
  *
- * no meaningful return code
+ * returns pointer to the unterminated string
+ * returns NULL for records without one
  */
-static void
-__sdr_list_empty(struct sdr_record_list *head)
+static const char *
+__sdr_record_idstr(struct sdr_record_list *e, int *len)
 {
-	struct sdr_record_list *e, *f;
-	for (e = head; e != NULL; e = f) {
-		f = e->next;
-		free(e);
-		e = NULL;
+	const uint8_t *s;
+	uint8_t code;
+	int n;
+
+	switch (e->type) {
+	case SDR_RECORD_TYPE_FULL_SENSOR:
+		s = e->record.full->id_string;
+		code = e->record.full->id_code;
+		break;
+	case SDR_RECORD_TYPE_COMPACT_SENSOR:
+		s = e->record.compact->id_string;
+		code = e->record.compact->id_code;
+		break;
+	case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
+		s = e->record.eventonly->id_string;
+		code = e->record.eventonly->id_code;
+		break;
+	case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
+		s = e->record.genloc->id_string;
+		code = e->record.genloc->id_code;
+		break;
+	case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
+		s = e->record.fruloc->id_string;
+		code = e->record.fruloc->id_code;
+		break;
+	case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
+		s = e->record.mcloc->id_string;
+		code = e->record.mcloc->id_code;
+		break;
+	default:
+		return NULL;
 	}
-	head = NULL;
+
+	for (n = 0; n < (code & 0x1f) && n < 16 && s[n] != '\0'; n++)
+		;
+	*len = n;
+	return (const char *)s;
 }
 
-/* ipmi_sdr_list_empty  -  clean global SDR list
- *
- * @intf:	ipmi interface
- *
- * no meaningful return code
- */
-void
-ipmi_sdr_list_empty(struct ipmi_intf *intf)
+/* __sdr_record_entity  -  entity of a record, NULL if it has none */
+static struct entity_id *
+__sdr_record_entity(struct sdr_record_list *e)
 {
-	struct sdr_record_list *list, *next;
-
-	ipmi_sdr_end(intf, sdr_list_itr);
+	switch (e->type) {
+	case SDR_RECORD_TYPE_FULL_SENSOR:
+	case SDR_RECORD_TYPE_COMPACT_SENSOR:
+		return &e->record.common->entity;
+	case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
+		return &e->record.eventonly->entity;
+	case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
+		return &e->record.genloc->entity;
+	case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
+		return &e->record.fruloc->entity;
+	case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
+		return &e->record.mcloc->entity;
+	case SDR_RECORD_TYPE_ENTITY_ASSOC:
+		return &e->record.entassoc->entity;
+	}
+	return NULL;
+}
+
+/* __sdr_record_sensor  -  owner, number and sensor type of a record
+ *
+ * returns 0 on success
+ * returns -1 for records that do not describe a sensor
+ */
+static int
+__sdr_record_sensor(struct sdr_record_list *e, uint8_t *owner,
+		    uint8_t *num, uint8_t *type)
+{
+	switch (e->type) {
+	case SDR_RECORD_TYPE_FULL_SENSOR:
+	case SDR_RECORD_TYPE_COMPACT_SENSOR:
+		*owner = e->record.common->keys.owner_id;
+		*num = e->record.common->keys.sensor_num;
+		*type = e->record.common->sensor.type;
+		return 0;
+	case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
+		*owner = e->record.eventonly->keys.owner_id;
+		*num = e->record.eventonly->keys.sensor_num;
+		*type = e->record.eventonly->sensor_type;
+		return 0;
+	}
+	return -1;
+}
+
+/* __sdr_record_keys  -  lookup keys of a record
+ *
+ * @e:		SDR entry
+ * @k:		filled with the keys, absent ones are flagged
+ */
+static void
+__sdr_record_keys(struct sdr_record_list *e, struct sdr_keys *k)
+{
+	struct entity_id *entity;
+
+	memset(k, 0, sizeof (*k));
+	if (__sdr_record_sensor(e, &k->owner, &k->num, &k->type) == 0)
+		k->flags |= SDR_KEY_SENSOR;
+	k->id = __sdr_record_idstr(e, &k->idlen);
+	if (k->id != NULL)
+		k->flags |= SDR_KEY_ID;
+	entity = __sdr_record_entity(e);
+	if (entity != NULL) {
+		k->flags |= SDR_KEY_ENTITY;
+		k->entity = entity->id;
+	}
+}
+
+static int
+__sdr_index_chain_add(struct sdr_index *idx, struct sdr_index_chain *c,
+		      struct sdr_record_list *e)
+{
+	struct sdr_index_block *blk = idx->blocks;
+	struct sdr_index_node *n;
+
+	/* nodes come from blocks so a large repository is not a
+	 * malloc per record */
+	if (blk == NULL || blk->used == SDR_INDEX_BLOCK) {
+		blk = malloc(sizeof (struct sdr_index_block));
+		if (blk == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+		blk->used = 0;
+		blk->next = idx->blocks;
+		idx->blocks = blk;
+	}
+	n = &blk->node[blk->used++];
+	n->e = e;
+	n->next = NULL;
+	if (c->tail == NULL)
+		c->head = n;
+	else
+		c->tail->next = n;
+	c->tail = n;
+	return 0;
+}
+
+/* __sdr_index_add  -  enter a record of the global list in its index
+ *
+ * @intf:	ipmi interface
+ * @e:		entry already linked into the list
+ * @k:		its keys
+ *
+ * no meaningful return code, a record missing from the index is
+ * only reported
+ */
+static void
+__sdr_index_add(struct ipmi_intf *intf, struct sdr_record_list *e,
+		const struct sdr_keys *k)
+{
+	struct sdr_index *idx;
+	int rc = 0;
+
+	if (intf->sdr.index == NULL) {
+		intf->sdr.index = calloc(1, sizeof (struct sdr_index));
+		if (intf->sdr.index == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return;
+		}
+	}
+	idx = intf->sdr.index;
+
+	if (k->flags & SDR_KEY_SENSOR) {
+		rc |= __sdr_index_chain_add(idx,
+			&idx->bynum[__sdr_hash_num(k->owner, k->num, k->type)],
+			e);
+		rc |= __sdr_index_chain_add(idx, &idx->bysensortype[k->type],
+					    e);
+	}
+	if (k->id != NULL)
+		rc |= __sdr_index_chain_add(idx,
+			&idx->byid[__sdr_hash_id(k->id, k->idlen)], e);
+	if (k->flags & SDR_KEY_ENTITY)
+		rc |= __sdr_index_chain_add(idx, &idx->byentity[k->entity], e);
+
+	if (rc != 0)
+		lprintf(LOG_WARN, "SDR record %04x not indexed", e->id);
+}
+
+/* __sdr_list_append  -  add SDR record to global list and its index
+ *
+ * @intf:	ipmi interface
+ * @sdrr:	new entry, its record must be set
+ */
+static void
+__sdr_list_append(struct ipmi_intf *intf, struct sdr_record_list *sdrr)
+{
+	struct sdr_keys k;
+
+	if (intf->sdr.head == NULL)
+		intf->sdr.head = sdrr;
+	else
+		intf->sdr.tail->next = sdrr;
+
+	intf->sdr.tail = sdrr;
+
+	__sdr_record_keys(sdrr, &k);
+	__sdr_index_add(intf, sdrr, &k);
+}
+
+/* __sdr_index_free  -  release the lookup tables of the global list
+ *
+ * @intf:	ipmi interface
+ */
+static void
+__sdr_index_free(struct ipmi_intf *intf)
+{
+	struct sdr_index_block *blk, *next;
+
+	if (intf->sdr.index == NULL)
+		return;
+
+	for (blk = intf->sdr.index->blocks; blk != NULL; blk = next) {
+		next = blk->next;
+		free(blk);
+	}
+	free(intf->sdr.index);
+	intf->sdr.index = NULL;
+}
+
+/* __sdr_index_bynum  -  indexed lookup of a sensor already read
+ *
+ * returns the first matching entry of the global list
+ * returns NULL if there is none
+ */
+static struct sdr_record_list *
+__sdr_index_bynum(struct ipmi_intf *intf, uint8_t owner, uint8_t num,
+		  uint8_t type)
+{
+	struct sdr_index_node *n;
+	uint8_t o, s, t;
+
+	if (intf->sdr.index == NULL)
+		return NULL;
+
+	n = intf->sdr.index->bynum[__sdr_hash_num(owner, num, type)].head;
+	for (; n != NULL; n = n->next) {
+		if (__sdr_record_sensor(n->e, &o, &s, &t) == 0 &&
+		    o == owner && s == num && t == type)
+			return n->e;
+	}
+	return NULL;
+}
+
+/* __sdr_index_byid  -  indexed lookup of an ID string already read
+ *
+ * returns the first matching entry of the global list
+ * returns NULL if there is none
+ */
+static struct sdr_record_list *
+__sdr_index_byid(struct ipmi_intf *intf, const char *id)
+{
+	struct sdr_index_node *n;
+	const char *s;
+	int idlen, len;
+
+	if (intf->sdr.index == NULL)
+		return NULL;
+
+	idlen = strlen(id);
+	n = intf->sdr.index->byid[__sdr_hash_id(id, idlen)].head;
+	for (; n != NULL; n = n->next) {
+		s = __sdr_record_idstr(n->e, &len);
+		if (s != NULL && len == idlen && memcmp(s, id, len) == 0)
+			return n->e;
+	}
+	return NULL;
+}
+
+/* __sdr_list_add  -  helper function to add SDR record to list
+ *
+ * @head:	list head
+ * @entry:	new entry to add to end of list
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+__sdr_list_add(struct sdr_record_list *head, struct sdr_record_list *entry)
+{
+	struct sdr_record_list *e;
+	struct sdr_record_list *new;
+
+	if (head == NULL)
+		return -1;
+
+	new = malloc(sizeof (struct sdr_record_list));
+	if (new == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	memcpy(new, entry, sizeof (struct sdr_record_list));
+
+	e = head;
+	while (e->next)
+		e = e->next;
+	e->next = new;
+	new->next = NULL;
+
+	return 0;
+}
+
+/* __sdr_list_empty  -  low-level handler to clean up record list
+ *
+ * @head:	list head to clean
+ *
+ * no meaningful return code
+ */
+static void
+__sdr_list_empty(struct sdr_record_list *head)
+{
+	struct sdr_record_list *e, *f;
+	for (e = head; e != NULL; e = f) {
+		f = e->next;
+		free(e);
+		e = NULL;
+	}
+	head = NULL;
+}
+
+/* ipmi_sdr_list_empty  -  clean global SDR list
+ *
+ * @intf:	ipmi interface
+ *
+ * no meaningful return code
+ */
+void
+ipmi_sdr_list_empty(struct ipmi_intf *intf)
+{
+	struct sdr_record_list *list, *next;
 
-	for (list = sdr_list_head; list != NULL; list = next) {
+	ipmi_sdr_end(intf, intf->sdr.itr);
+	__sdr_index_free(intf);
+
+	for (list = intf->sdr.head; list != NULL; list = next) {
+		/* entries of an SDR cache file go with the mapping */
+		if (list >= intf->sdr.map.nodes &&
+		    list < intf->sdr.map.nodes + intf->sdr.map.count) {
+			next = list->next;
+			continue;
+		}
 		switch (list->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
@@ -3222,9 +3871,12 @@ ipmi_sdr_list_empty(struct ipmi_intf *intf)
 		list = NULL;
 	}
 
-	sdr_list_head = NULL;
-	sdr_list_tail = NULL;
-	sdr_list_itr = NULL;
+	__sdr_cache_unmap(intf);
+	__sdr_conv_free();
+
+	intf->sdr.head = NULL;
+	intf->sdr.tail = NULL;
+	intf->sdr.itr = NULL;
 }
 
 /* ipmi_sdr_find_sdr_bynumtype  -  lookup SDR entry by number/type
@@ -3244,35 +3896,21 @@ ipmi_sdr_find_sdr_bynumtype(struct ipmi_intf *intf, uint16_t gen_id, uint8_t num
 	struct sdr_record_list *e;
 	int found = 0;
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = ipmi_sdr_list_start(intf);
+		if (intf->sdr.itr == NULL) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
 		}
 	}
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e != NULL; e = e->next) {
-		switch (e->type) {
-		case SDR_RECORD_TYPE_FULL_SENSOR:
-		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			if (e->record.common->keys.sensor_num == num &&
-			    e->record.common->keys.owner_id == (gen_id & 0x00ff) &&
-			    e->record.common->sensor.type == type)
-				return e;
-			break;
-		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
-			if (e->record.eventonly->keys.sensor_num == num &&
-			    e->record.eventonly->keys.owner_id == (gen_id & 0x00ff) &&
-			    e->record.eventonly->sensor_type == type)
-				return e;
-			break;
-		}
-	}
+	e = __sdr_index_bynum(intf, gen_id & 0x00ff, num, type);
+	if (e != NULL)
+		return e;
 
 	/* now keep looking */
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
+	while ((header = ipmi_sdr_get_next_header(intf, intf->sdr.itr)) != NULL) {
 		uint8_t *rec;
 		struct sdr_record_list *sdrr;
 
@@ -3284,8 +3922,9 @@ ipmi_sdr_find_sdr_bynumtype(struct ipmi_intf *intf, uint16_t gen_id, uint8_t num
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
+		rec = ipmi_sdr_get_record(intf, header, intf->sdr.itr);
 		if (rec == NULL) {
 			if (sdrr != NULL) {
 				free(sdrr);
@@ -3338,13 +3977,8 @@ ipmi_sdr_find_sdr_bynumtype(struct ipmi_intf *intf, uint16_t gen_id, uint8_t num
 			continue;
 		}
 
-		/* put in the global record list */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(intf, sdrr);
 
 		if (found)
 			return sdrr;
@@ -3366,11 +4000,11 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 {
 	struct sdr_record_list *head;
 	struct sdr_get_rs *header;
-	struct sdr_record_list *e;
+	struct sdr_index_node *n;
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = ipmi_sdr_list_start(intf);
+		if (intf->sdr.itr == NULL) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
 		}
@@ -3384,22 +4018,14 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 	}
 	memset(head, 0, sizeof (struct sdr_record_list));
 
-	for (e = sdr_list_head; e != NULL; e = e->next) {
-		switch (e->type) {
-		case SDR_RECORD_TYPE_FULL_SENSOR:
-		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			if (e->record.common->sensor.type == type)
-				__sdr_list_add(head, e);
-			break;
-		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
-			if (e->record.eventonly->sensor_type == type)
-				__sdr_list_add(head, e);
-			break;
-		}
+	if (intf->sdr.index != NULL) {
+		for (n = intf->sdr.index->bysensortype[type].head; n != NULL;
+		     n = n->next)
+			__sdr_list_add(head, n->e);
 	}
 
 	/* now keep looking */
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
+	while ((header = ipmi_sdr_get_next_header(intf, intf->sdr.itr)) != NULL) {
 		uint8_t *rec;
 		struct sdr_record_list *sdrr;
 
@@ -3411,8 +4037,9 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
+		rec = ipmi_sdr_get_record(intf, header, intf->sdr.itr);
 		if (rec == NULL) {
 			if (sdrr != NULL) {
 				free(sdrr);
@@ -3461,13 +4088,8 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 			continue;
 		}
 
-		/* put in the global record list */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(intf, sdrr);
 	}
 
 	return head;
@@ -3485,12 +4107,12 @@ struct sdr_record_list *
 ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 {
 	struct sdr_get_rs *header;
-	struct sdr_record_list *e;
+	struct sdr_index_node *n;
 	struct sdr_record_list *head;
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = ipmi_sdr_list_start(intf);
+		if (intf->sdr.itr == NULL) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
 		}
@@ -3504,56 +4126,18 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 	memset(head, 0, sizeof (struct sdr_record_list));
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e != NULL; e = e->next) {
-		switch (e->type) {
-		case SDR_RECORD_TYPE_FULL_SENSOR:
-		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			if (e->record.common->entity.id == entity->id &&
-			    (entity->instance == 0x7f ||
-			     e->record.common->entity.instance ==
-			     entity->instance))
-				__sdr_list_add(head, e);
-			break;
-		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
-			if (e->record.eventonly->entity.id == entity->id &&
-			    (entity->instance == 0x7f ||
-			     e->record.eventonly->entity.instance ==
-			     entity->instance))
-				__sdr_list_add(head, e);
-			break;
-		case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
-			if (e->record.genloc->entity.id == entity->id &&
-			    (entity->instance == 0x7f ||
-			     e->record.genloc->entity.instance ==
-			     entity->instance))
-				__sdr_list_add(head, e);
-			break;
-		case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
-			if (e->record.fruloc->entity.id == entity->id &&
-			    (entity->instance == 0x7f ||
-			     e->record.fruloc->entity.instance ==
-			     entity->instance))
-				__sdr_list_add(head, e);
-			break;
-		case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
-			if (e->record.mcloc->entity.id == entity->id &&
-			    (entity->instance == 0x7f ||
-			     e->record.mcloc->entity.instance ==
-			     entity->instance))
-				__sdr_list_add(head, e);
-			break;
-		case SDR_RECORD_TYPE_ENTITY_ASSOC:
-			if (e->record.entassoc->entity.id == entity->id &&
-			    (entity->instance == 0x7f ||
-			     e->record.entassoc->entity.instance ==
-			     entity->instance))
-				__sdr_list_add(head, e);
-			break;
+	if (intf->sdr.index != NULL) {
+		for (n = intf->sdr.index->byentity[entity->id].head; n != NULL;
+		     n = n->next) {
+			if (entity->instance == 0x7f ||
+			    __sdr_record_entity(n->e)->instance ==
+			    entity->instance)
+				__sdr_list_add(head, n->e);
 		}
 	}
 
 	/* now keep looking */
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
+	while ((header = ipmi_sdr_get_next_header(intf, intf->sdr.itr)) != NULL) {
 		uint8_t *rec;
 		struct sdr_record_list *sdrr;
 
@@ -3565,8 +4149,9 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
+		rec = ipmi_sdr_get_record(intf, header, intf->sdr.itr);
 		if (rec == NULL) {
 			if (sdrr != NULL) {
 				free(sdrr);
@@ -3642,12 +4227,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 		}
 
 		/* add to global record list */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		__sdr_list_append(intf, sdrr);
 	}
 
 	return head;
@@ -3668,9 +4248,9 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 	struct sdr_record_list *e;
 	struct sdr_record_list *head;
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = ipmi_sdr_list_start(intf);
+		if (intf->sdr.itr == NULL) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
 		}
@@ -3684,12 +4264,12 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 	memset(head, 0, sizeof (struct sdr_record_list));
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e != NULL; e = e->next)
+	for (e = intf->sdr.head; e != NULL; e = e->next)
 		if (e->type == type)
 			__sdr_list_add(head, e);
 
 	/* now keep looking */
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
+	while ((header = ipmi_sdr_get_next_header(intf, intf->sdr.itr)) != NULL) {
 		uint8_t *rec;
 		struct sdr_record_list *sdrr;
 
@@ -3701,8 +4281,9 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
+		rec = ipmi_sdr_get_record(intf, header, intf->sdr.itr);
 		if (rec == NULL) {
 			if (sdrr != NULL) {
 				free(sdrr);
@@ -3751,12 +4332,7 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 			__sdr_list_add(head, sdrr);
 
 		/* add to global record list */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		__sdr_list_append(intf, sdrr);
 	}
 
 	return head;
@@ -3783,58 +4359,21 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 
 	idlen = strlen(id);
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = ipmi_sdr_list_start(intf);
+		if (intf->sdr.itr == NULL) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
 		}
 	}
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e != NULL; e = e->next) {
-		switch (e->type) {
-		case SDR_RECORD_TYPE_FULL_SENSOR:
-			if (!strncmp((const char *)e->record.full->id_string,
-				     (const char *)id,
-				     __max(e->record.full->id_code & 0x1f, idlen)))
-				return e;
-			break;
-		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			if (!strncmp((const char *)e->record.compact->id_string,
-				     (const char *)id,
-				     __max(e->record.compact->id_code & 0x1f, idlen)))
-				return e;
-			break;
-		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
-			if (!strncmp((const char *)e->record.eventonly->id_string,
-				     (const char *)id,
-				     __max(e->record.eventonly->id_code & 0x1f, idlen)))
-				return e;
-			break;
-		case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
-			if (!strncmp((const char *)e->record.genloc->id_string,
-				     (const char *)id,
-				     __max(e->record.genloc->id_code & 0x1f, idlen)))
-				return e;
-			break;
-		case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
-			if (!strncmp((const char *)e->record.fruloc->id_string,
-				     (const char *)id,
-				     __max(e->record.fruloc->id_code & 0x1f, idlen)))
-				return e;
-			break;
-		case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
-			if (!strncmp((const char *)e->record.mcloc->id_string,
-				     (const char *)id,
-				     __max(e->record.mcloc->id_code & 0x1f, idlen)))
-				return e;
-			break;
-		}
-	}
+	e = __sdr_index_byid(intf, id);
+	if (e != NULL)
+		return e;
 
 	/* now keep looking */
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
+	while ((header = ipmi_sdr_get_next_header(intf, intf->sdr.itr)) != NULL) {
 		uint8_t *rec;
 		struct sdr_record_list *sdrr;
 
@@ -3846,8 +4385,9 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
+		rec = ipmi_sdr_get_record(intf, header, intf->sdr.itr);
 		if (rec == NULL) {
 			if (sdrr != NULL) {
 				free(sdrr);
@@ -3927,13 +4467,8 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 			continue;
 		}
 
-		/* add to global record liset */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(intf, sdrr);
 
 		if (found)
 			return sdrr;
@@ -3942,18 +4477,282 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 	return NULL;
 }
 
-/* ipmi_sdr_list_cache_fromfile  -  generate SDR cache for fast lookup from local file
+/*
+ * SDR cache file, written by "sdr dump <file> cache" and by the
+ * automatic cache and used in place through mmap().  Numbers are
+ * little endian.
+ *
+ *   header, SDR_CACHE_HDR_LEN bytes
+ *	 0  "ipmisdr\0"
+ *	 8  format version (2), SDR_CACHE_VERSION
+ *	10  entry size (2), at least SDR_CACHE_ENT_LEN
+ *	12  number of entries (4)
+ *	16  repository addition timestamp (4)
+ *	20  repository erase timestamp (4)
+ *	24  repository record count (2)
+ *	28  offset of the first entry (4)
+ *   entries, one per record in repository order
+ *	 0  offset of the record body (4)
+ *	 4  record id (2)
+ *	 6  SDR version, record type, body length
+ *	 9  SDR_KEY_* flags
+ *	10  sensor owner, number and type
+ *	13  entity id
+ *	14  ID string length
+ *	16  ID string (16), zero padded
+ *   record bodies, each followed by a zero byte
+ *
+ * Sensor keys and ID strings in the entries let the lookup index be
+ * built without touching the record pages.
+ */
+#define SDR_CACHE_MAGIC		"ipmisdr"
+#define SDR_CACHE_VERSION	1
+#define SDR_CACHE_HDR_LEN	32
+#define SDR_CACHE_ENT_LEN	32
+
+static void
+__sdr_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+}
+
+static void
+__sdr_put32(uint8_t *p, uint32_t v)
+{
+	__sdr_put16(p, v & 0xffff);
+	__sdr_put16(p + 2, v >> 16);
+}
+
+/* __sdr_cache_write  -  write global list in SDR cache file format
  *
  * @intf:	ipmi interface
- * @ifile:	input filename
+ * @fp:		output file
  *
- * returns pointer to SDR list
- * returns NULL on error
+ * returns 0 on success
+ * returns -1 on error
  */
-int
-ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile)
+static int
+__sdr_cache_write(struct ipmi_intf *intf, FILE *fp)
+{
+	struct sdr_record_list *e;
+	struct sdr_keys k;
+	uint8_t h[SDR_CACHE_HDR_LEN];
+	uint8_t ent[SDR_CACHE_ENT_LEN];
+	uint32_t count = 0, offset;
+
+	for (e = intf->sdr.head; e != NULL; e = e->next) {
+		if (e->length == 0 || e->record.common == NULL) {
+			lprintf(LOG_ERR, "SDR record %04x has no data", e->id);
+			return -1;
+		}
+		count++;
+	}
+
+	memset(h, 0, sizeof(h));
+	memcpy(h, SDR_CACHE_MAGIC, 8);
+	__sdr_put16(h + 8, SDR_CACHE_VERSION);
+	__sdr_put16(h + 10, SDR_CACHE_ENT_LEN);
+	__sdr_put32(h + 12, count);
+	__sdr_put32(h + 16, intf->sdr.add_stamp);
+	__sdr_put32(h + 20, intf->sdr.erase_stamp);
+	__sdr_put16(h + 24, intf->sdr.count);
+	__sdr_put32(h + 28, SDR_CACHE_HDR_LEN);
+	if (fwrite(h, 1, sizeof(h), fp) != sizeof(h))
+		return -1;
+
+	offset = SDR_CACHE_HDR_LEN + count * SDR_CACHE_ENT_LEN;
+	for (e = intf->sdr.head; e != NULL; e = e->next) {
+		memset(ent, 0, sizeof(ent));
+		__sdr_record_keys(e, &k);
+		__sdr_put32(ent, offset);
+		__sdr_put16(ent + 4, e->id);
+		ent[6] = e->version;
+		ent[7] = e->type;
+		ent[8] = e->length;
+		ent[10] = k.owner;
+		ent[11] = k.num;
+		ent[12] = k.type;
+		ent[13] = k.entity;
+		if (k.flags & SDR_KEY_ID) {
+			ent[14] = k.idlen;
+			memcpy(ent + 16, k.id, k.idlen);
+		}
+		ent[9] = k.flags;
+		if (fwrite(ent, 1, sizeof(ent), fp) != sizeof(ent))
+			return -1;
+		offset += e->length + 1;
+	}
+
+	for (e = intf->sdr.head; e != NULL; e = e->next) {
+		if (fwrite(e->record.common, 1, e->length, fp) != e->length ||
+		    fputc(0, fp) == EOF)
+			return -1;
+	}
+	return 0;
+}
+
+/* __sdr_cache_unmap  -  release a cache file used by the global list */
+static void
+__sdr_cache_unmap(struct ipmi_intf *intf)
+{
+	if (intf->sdr.map.base == NULL)
+		return;
+#ifdef HAVE_MMAP
+	munmap(intf->sdr.map.base, intf->sdr.map.len);
+#else
+	free(intf->sdr.map.base);
+#endif
+	free(intf->sdr.map.nodes);
+	memset(&intf->sdr.map, 0, sizeof(intf->sdr.map));
+}
+
+/* __sdr_cache_map  -  use an SDR cache file in place as global list
+ *
+ * The records stay in the mapping and the list entries are one
+ * array, so nothing is allocated per record.  The mapping is private
+ * and the file is never written through it.
+ *
+ * @intf:	ipmi interface, with an empty global list
+ * @file:	cache file
+ * @current:	only accept a file written for the repository seen by
+ *		the last ipmi_sdr_start()
+ *
+ * returns 0 on success
+ * returns 1 if the file is missing or not in cache format
+ * returns -1 on error or if the file is stale
+ */
+static int
+__sdr_cache_map(struct ipmi_intf *intf, const char *file, int current)
+{
+	struct sdr_record_list *nodes = NULL;
+	struct sdr_keys k;
+	struct stat st;
+	uint8_t *base, *ent;
+	uint32_t count, first, entlen, i, offset;
+	int fd, rc = -1;
+
+	if (intf->sdr.map.base != NULL || intf->sdr.head != NULL)
+		return -1;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return 1;
+	if (fstat(fd, &st) < 0 || st.st_size < SDR_CACHE_HDR_LEN) {
+		close(fd);
+		return 1;
+	}
+#ifdef HAVE_MMAP
+	base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, 0);
+	if (base == MAP_FAILED)
+		base = NULL;
+#else
+	base = malloc(st.st_size);
+	if (base != NULL && read(fd, base, st.st_size) != st.st_size) {
+		free(base);
+		base = NULL;
+	}
+#endif
+	close(fd);
+	if (base == NULL) {
+		lprintf(LOG_ERR, "Unable to map SDR cache %s", file);
+		return -1;
+	}
+	intf->sdr.map.base = base;
+	intf->sdr.map.len = st.st_size;
+
+	if (memcmp(base, SDR_CACHE_MAGIC, 8) != 0) {
+		__sdr_cache_unmap(intf);
+		return 1;
+	}
+
+	count = buf2long(base + 12);
+	entlen = buf2short(base + 10);
+	first = buf2long(base + 28);
+	if (buf2short(base + 8) != SDR_CACHE_VERSION ||
+	    entlen < SDR_CACHE_ENT_LEN || first < SDR_CACHE_HDR_LEN ||
+	    count > (st.st_size - first) / entlen) {
+		lprintf(LOG_ERR, "Unsupported SDR cache %s", file);
+		goto out;
+	}
+	if (current &&
+	    (buf2long(base + 16) != intf->sdr.add_stamp ||
+	     buf2long(base + 20) != intf->sdr.erase_stamp ||
+	     buf2short(base + 24) != intf->sdr.count)) {
+		lprintf(LOG_DEBUG, "SDR cache %s is stale", file);
+		goto out;
+	}
+
+	/* check every entry before anything is linked */
+	for (i = 0, ent = base + first; i < count; i++, ent += entlen) {
+		offset = buf2long(ent);
+		if (ent[8] == 0 || ent[14] > 16 ||
+		    offset > st.st_size - ent[8] - 1) {
+			lprintf(LOG_ERR, "SDR cache %s is damaged", file);
+			goto out;
+		}
+	}
+
+	if (count > 0) {
+		nodes = calloc(count, sizeof (struct sdr_record_list));
+		if (nodes == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			goto out;
+		}
+	}
+	intf->sdr.map.nodes = nodes;
+	intf->sdr.map.count = count;
+
+	for (i = 0, ent = base + first; i < count; i++, ent += entlen) {
+		struct sdr_record_list *e = &nodes[i];
+
+		e->id = buf2short(ent + 4);
+		e->version = ent[6];
+		e->type = ent[7];
+		e->length = ent[8];
+		e->record.common =
+		    (struct sdr_record_common_sensor *)(base + buf2long(ent));
+
+		if (intf->sdr.head == NULL)
+			intf->sdr.head = e;
+		else
+			intf->sdr.tail->next = e;
+		intf->sdr.tail = e;
+
+		memset(&k, 0, sizeof(k));
+		k.flags = ent[9];
+		k.owner = ent[10];
+		k.num = ent[11];
+		k.type = ent[12];
+		k.entity = ent[13];
+		if (k.flags & SDR_KEY_ID) {
+			k.id = (const char *)ent + 16;
+			k.idlen = ent[14];
+		}
+		__sdr_index_add(intf, e, &k);
+	}
+	rc = 0;
+
+	lprintf(LOG_DEBUG, "Mapped %d records of SDR cache %s", count, file);
+out:
+	if (rc < 0)
+		__sdr_cache_unmap(intf);
+	return rc;
+}
+
+/* __sdr_list_read  -  append records in "sdr dump" format to global list
+ *
+ * @intf:	ipmi interface
+ * @fp:		file positioned at the first record
+ * @count:	set to the number of records added
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+__sdr_list_read(struct ipmi_intf *intf, FILE *fp, int *count)
 {
-	FILE *fp;
 	struct __sdr_header {
 		uint16_t id;
 		uint8_t version;
@@ -3962,20 +4761,9 @@ ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile)
 	} header;
 	struct sdr_record_list *sdrr;
 	uint8_t *rec;
-	int ret = 0, count = 0, bc = 0;
-
-	if (ifile == NULL) {
-		lprintf(LOG_ERR, "No SDR cache filename given");
-		return -1;
-	}
-
-	fp = ipmi_open_file_read(ifile);
-	if (fp == NULL) {
-		lprintf(LOG_ERR, "Unable to open SDR cache %s for reading",
-			ifile);
-		return -1;
-	}
+	int ret = 0, bc = 0;
 
+	*count = 0;
 	while (feof(fp) == 0) {
 		memset(&header, 0, 5);
 		bc = fread(&header, 1, 5, fp);
@@ -4010,7 +4798,9 @@ ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile)
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 
 		sdrr->id = header.id;
+		sdrr->version = header.version;
 		sdrr->type = header.type;
+		sdrr->length = header.length;
 
 		rec = malloc(header.length + 1);
 		if (rec == NULL) {
@@ -4077,30 +4867,63 @@ ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile)
 			continue;
 		}
 
-		/* add to global record liset */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(intf, sdrr);
 
-		count++;
+		(*count)++;
 
 		lprintf(LOG_DEBUG, "Read record %04x from file into cache",
 			sdrr->id);
 	}
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = malloc(sizeof (struct ipmi_sdr_iterator));
-		if (sdr_list_itr != NULL) {
-			sdr_list_itr->reservation = 0;
-			sdr_list_itr->total = count;
-			sdr_list_itr->next = 0xffff;
+	return ret;
+}
+
+/* ipmi_sdr_list_cache_fromfile  -  generate SDR cache for fast lookup from local file
+ *
+ * Accepts both SDR cache files, which are used in place, and the raw
+ * records written by older versions of "sdr dump".
+ *
+ * @intf:	ipmi interface
+ * @ifile:	input filename
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile)
+{
+	FILE *fp;
+	int ret = 0, count = 0;
+
+	if (ifile == NULL) {
+		lprintf(LOG_ERR, "No SDR cache filename given");
+		return -1;
+	}
+
+	ret = __sdr_cache_map(intf, ifile, 0);
+	if (ret == 0) {
+		count = intf->sdr.map.count;
+	} else if (ret > 0) {
+		fp = ipmi_open_file_read(ifile);
+		if (fp == NULL) {
+			lprintf(LOG_ERR, "Unable to open SDR cache %s for reading",
+				ifile);
+			return -1;
+		}
+		ret = __sdr_list_read(intf, fp, &count);
+		fclose(fp);
+	}
+
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = malloc(sizeof (struct ipmi_sdr_iterator));
+		if (intf->sdr.itr != NULL) {
+			intf->sdr.itr->reservation = 0;
+			intf->sdr.itr->total = count;
+			intf->sdr.itr->next = 0xffff;
 		}
 	}
 
-	fclose(fp);
 	return ret;
 }
 
@@ -4108,37 +4931,42 @@ ipmi_sdr_list_cache_fromfile(struct ipmi_intf *intf, const char *ifile)
  *
  * @intf:	ipmi interface
  *
- * returns pointer to SDR list
- * returns NULL on error
+ * returns 0 when the whole repository is in the list
+ * returns -1 on error
  */
 int
 ipmi_sdr_list_cache(struct ipmi_intf *intf)
 {
 	struct sdr_get_rs *header;
+	int rc = 0;
 
-	if (sdr_list_itr == NULL) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
-		if (sdr_list_itr == NULL) {
+	if (intf->sdr.itr == NULL) {
+		intf->sdr.itr = ipmi_sdr_list_start(intf);
+		if (intf->sdr.itr == NULL) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return -1;
 		}
 	}
 
-	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr)) != NULL) {
+	while ((header = ipmi_sdr_get_next_header(intf, intf->sdr.itr)) != NULL) {
 		uint8_t *rec;
 		struct sdr_record_list *sdrr;
 
 		sdrr = malloc(sizeof (struct sdr_record_list));
 		if (sdrr == NULL) {
 			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			rc = -1;
 			break;
 		}
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
+		sdrr->version = header->version;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
-		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
+		rec = ipmi_sdr_get_record(intf, header, intf->sdr.itr);
 		if (rec == NULL) {
+			rc = -1;
 			if (sdrr != NULL) {
 				free(sdrr);
 				sdrr = NULL;
@@ -4182,18 +5010,226 @@ ipmi_sdr_list_cache(struct ipmi_intf *intf)
 			continue;
 		}
 
-		/* add to global record liset */
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
+		/* add to global record list */
+		__sdr_list_append(intf, sdrr);
+	}
 
-		sdr_list_tail = sdrr;
+	if (intf->sdr.itr->next != 0xffff)
+		rc = -1;
+
+	return rc;
+}
+
+/* ipmi_sdr_cache_enable  -  keep a copy of the SDR repository on disk
+ *
+ * The copy is keyed by the BMC GUID, manufacturer and product id,
+ * firmware revision and the bridging target.  It is used as long as
+ * Get SDR Repository Info reports the record count and addition/erase
+ * timestamps it was written with, and refreshed otherwise.  BMCs that
+ * leave the addition timestamp unspecified are not cached.
+ *
+ * @intf:	ipmi interface
+ * @dir:	cache directory, NULL for $IPMI_SDR_CACHE_DIR or else
+ *		$HOME/.ipmitool/sdr; an empty string disables the cache
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_cache_enable(struct ipmi_intf *intf, const char *dir)
+{
+	char path[PATH_MAX];
+	const char *home;
+
+	if (intf->sdr.cache_dir != NULL) {
+		free(intf->sdr.cache_dir);
+		intf->sdr.cache_dir = NULL;
+	}
+
+	if (dir == NULL)
+		dir = getenv("IPMI_SDR_CACHE_DIR");
+	if (dir == NULL) {
+		home = getenv("HOME");
+		if (home == NULL || home[0] == '\0')
+			return -1;
+		snprintf(path, sizeof(path), "%s/.ipmitool/sdr", home);
+		dir = path;
+	}
+	if (dir[0] == '\0')
+		return 0;
+
+	intf->sdr.cache_dir = strdup(dir);
+	if (intf->sdr.cache_dir == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	return 0;
+}
+
+/* ipmi_sdr_cache_file  -  build the cache file name of this BMC
+ *
+ * @intf:	ipmi interface, after ipmi_sdr_start()
+ * @file:	buffer for the name
+ * @len:	size of buffer
+ *
+ * returns 0 on success
+ * returns -1 if the BMC has no GUID
+ */
+static int
+ipmi_sdr_cache_file(struct ipmi_intf *intf, char *file, size_t len)
+{
+	struct ipmi_rs *rsp;
+	struct ipmi_rq req;
+	char guid[33];
+	int i;
+
+	memset(&req, 0, sizeof (req));
+	req.msg.netfn = IPMI_NETFN_APP;
+	req.msg.cmd = BMC_GET_GUID;
+
+	rsp = intf->sendrecv(intf, &req);
+	if (rsp == NULL || rsp->ccode > 0 || rsp->data_len != 16) {
+		lprintf(LOG_DEBUG, "No BMC GUID, not using the SDR cache");
+		return -1;
+	}
+	for (i = 0; i < 16; i++)
+		sprintf(guid + 2 * i, "%02x", rsp->data[i]);
+
+	snprintf(file, len, "%s/%s-%06x-%04x-%04x-%02x-%x.sdr",
+		 intf->sdr.cache_dir, guid, intf->sdr.manufacturer,
+		 intf->sdr.product, intf->sdr.firmware, intf->target_addr,
+		 intf->target_channel);
+	return 0;
+}
+
+/* ipmi_sdr_cache_load  -  use a current cache file as global list
+ *
+ * @intf:	ipmi interface, after ipmi_sdr_start()
+ * @file:	cache file
+ *
+ * returns 0 on success
+ * returns -1 if the file is missing, stale or unreadable
+ */
+static int
+ipmi_sdr_cache_load(struct ipmi_intf *intf, const char *file)
+{
+	if (__sdr_cache_map(intf, file, 1) != 0)
+		return -1;
+	return 0;
+}
+
+/* ipmi_sdr_cache_save  -  write global list to the cache file
+ *
+ * The file is replaced atomically, so concurrent readers see either
+ * the old or the new repository.
+ *
+ * @intf:	ipmi interface, after ipmi_sdr_list_cache()
+ * @file:	cache file
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_sdr_cache_save(struct ipmi_intf *intf, const char *file)
+{
+	char tmp[PATH_MAX];
+	char *p;
+	FILE *fp;
+	int fd, rc = 0;
+
+	/* create the directory and its parents */
+	snprintf(tmp, sizeof(tmp), "%s", intf->sdr.cache_dir);
+	for (p = strchr(tmp + 1, '/'); ; p = strchr(p + 1, '/')) {
+		if (p != NULL)
+			*p = '\0';
+		if (mkdir(tmp, 0700) < 0 && errno != EEXIST) {
+			lprintf(LOG_DEBUG, "Unable to create %s: %s",
+				tmp, strerror(errno));
+			return -1;
+		}
+		if (p == NULL)
+			break;
+		*p = '/';
+	}
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file) >= sizeof(tmp))
+		return -1;
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		lprintf(LOG_DEBUG, "Unable to create %s: %s",
+			tmp, strerror(errno));
+		return -1;
+	}
+	fp = fdopen(fd, "wb");
+	if (fp == NULL) {
+		close(fd);
+		unlink(tmp);
+		return -1;
 	}
 
+	rc = __sdr_cache_write(intf, fp);
+
+	if (fclose(fp) != 0)
+		rc = -1;
+	if (rc == 0 && rename(tmp, file) < 0)
+		rc = -1;
+	if (rc < 0) {
+		lprintf(LOG_DEBUG, "Unable to write SDR cache %s", file);
+		unlink(tmp);
+		return -1;
+	}
+
+	lprintf(LOG_DEBUG, "Wrote SDR cache %s", file);
 	return 0;
 }
 
+/* ipmi_sdr_list_start  -  open the iterator behind the global SDR list
+ *
+ * With the automatic cache enabled the list is read from the cache
+ * file if the repository is unchanged, or downloaded in full and
+ * written back, so the iterator is at its end either way.
+ *
+ * @intf:	ipmi interface
+ *
+ * returns sdr iterator structure pointer, also set in intf->sdr.itr
+ * returns NULL on error
+ */
+static struct ipmi_sdr_iterator *
+ipmi_sdr_list_start(struct ipmi_intf *intf)
+{
+	struct ipmi_sdr_iterator *itr;
+	char file[PATH_MAX];
+
+	itr = ipmi_sdr_start(intf, 0);
+	if (itr == NULL || intf->sdr.cache_dir == NULL || itr->use_built_in)
+		return itr;
+
+	/*
+	 * Without an addition timestamp a changed repository can't be
+	 * told from the cached one.  Repopulating after an erase moves
+	 * the addition timestamp too, so the erase timestamp may be 0.
+	 */
+	if (intf->sdr.add_stamp == 0 || intf->sdr.add_stamp == 0xffffffff) {
+		lprintf(LOG_DEBUG, "SDR repository has no addition timestamp, "
+			"not using the SDR cache");
+		return itr;
+	}
+
+	if (ipmi_sdr_cache_file(intf, file, sizeof(file)) < 0)
+		return itr;
+
+	if (ipmi_sdr_cache_load(intf, file) == 0) {
+		itr->next = 0xffff;
+		intf->sdr.itr = itr;
+		return itr;
+	}
+
+	intf->sdr.itr = itr;
+	if (ipmi_sdr_list_cache(intf) == 0)
+		ipmi_sdr_cache_save(intf, file);
+	return itr;
+}
+
 /*
  * ipmi_sdr_get_info
  *
@@ -4248,7 +5284,7 @@ ipmi_sdr_get_info(struct ipmi_intf *intf,
 static char *
 ipmi_sdr_timestamp(uint32_t stamp)
 {
-	static char tbuf[40];
+	static IPMI_TLS char tbuf[40];
 	time_t s = (time_t) stamp;
 	memset(tbuf, 0, 40);
 	if (stamp)
@@ -4355,6 +5391,39 @@ ipmi_sdr_print_info(struct ipmi_intf *intf)
 	return 0;
 }
 
+/* ipmi_sdr_dump_cache  -  Write SDR cache file
+ *
+ * @intf:	ipmi interface
+ * @ofile:	output filename
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_sdr_dump_cache(struct ipmi_intf *intf, const char *ofile)
+{
+	FILE *fp;
+	int rc;
+
+	if (ipmi_sdr_list_cache(intf) < 0) {
+		lprintf(LOG_ERR, "Unable to read the whole SDR repository");
+		return -1;
+	}
+
+	printf("Dumping Sensor Data Repository to '%s'\n", ofile);
+
+	fp = ipmi_open_file_write(ofile);
+	if (fp == NULL)
+		return -1;
+
+	rc = __sdr_cache_write(intf, fp);
+	if (fclose(fp) != 0 || rc < 0) {
+		lprintf(LOG_ERR, "Error writing to output file %s", ofile);
+		return -1;
+	}
+	return 0;
+}
+
 /* ipmi_sdr_dump_bin  -  Write raw SDR to binary file
  *
  * used for post-processing by other utilities
@@ -4410,12 +5479,12 @@ ipmi_sdr_dump_bin(struct ipmi_intf *intf, const char *ofile)
 		    return -1;
 		}
 
-		if (sdr_list_head == NULL)
-			sdr_list_head = sdrr;
+		if (intf->sdr.head == NULL)
+			intf->sdr.head = sdrr;
 		else
-			sdr_list_tail->next = sdrr;
+			intf->sdr.tail->next = sdrr;
 
-		sdr_list_tail = sdrr;
+		intf->sdr.tail = sdrr;
 	}
 
 	ipmi_sdr_end(intf, itr);
@@ -4425,7 +5494,7 @@ ipmi_sdr_dump_bin(struct ipmi_intf *intf, const char *ofile)
 	if (fp == NULL)
 		return -1;
 
-	for (sdrr = sdr_list_head; sdrr != NULL; sdrr = sdrr->next) {
+	for (sdrr = intf->sdr.head; sdrr != NULL; sdrr = sdrr->next) {
 		int r;
 		uint8_t h[5];
 
@@ -4663,9 +5732,9 @@ ipmi_sdr_main(struct ipmi_intf *intf, int argc, char **argv)
 		   || strncmp(argv[0], "elist", 5) == 0) {
 
 		if (strncmp(argv[0], "elist", 5) == 0)
-			sdr_extended = 1;
+			intf->sdr.extended = 1;
 		else
-			sdr_extended = 0;
+			intf->sdr.extended = 0;
 
 		if (argc <= 1)
 			rc = ipmi_sdr_print_sdr(intf, 0xfe);
@@ -4705,22 +5774,26 @@ ipmi_sdr_main(struct ipmi_intf *intf, int argc, char **argv)
 			return (-1);
 		}
 	} else if (strncmp(argv[0], "type", 4) == 0) {
-		sdr_extended = 1;
+		intf->sdr.extended = 1;
 		rc = ipmi_sdr_print_type(intf, argv[1]);
 	} else if (strncmp(argv[0], "entity", 6) == 0) {
-		sdr_extended = 1;
+		intf->sdr.extended = 1;
 		rc = ipmi_sdr_print_entity(intf, argv[1]);
 	} else if (strncmp(argv[0], "info", 4) == 0) {
 		rc = ipmi_sdr_print_info(intf);
 	} else if (strncmp(argv[0], "get", 3) == 0) {
 		rc = ipmi_sdr_print_entry_byid(intf, argc - 1, &argv[1]);
 	} else if (strncmp(argv[0], "dump", 4) == 0) {
-		if (argc < 2) {
+		if (argc < 2 || (argc > 2 && strcmp(argv[2], "raw") != 0 &&
+				 strcmp(argv[2], "cache") != 0)) {
 			lprintf(LOG_ERR, "Not enough parameters given.");
-			lprintf(LOG_NOTICE, "usage: sdr dump <file>");
+			lprintf(LOG_NOTICE, "usage: sdr dump <file> [raw|cache]");
 			return (-1);
 		}
-		rc = ipmi_sdr_dump_bin(intf, argv[1]);
+		if (argc > 2 && strcmp(argv[2], "cache") == 0)
+			rc = ipmi_sdr_dump_cache(intf, argv[1]);
+		else
+			rc = ipmi_sdr_dump_bin(intf, argv[1]);
 	} else if (strncmp(argv[0], "fill", 4) == 0) {
 		if (argc <= 1) {
 			lprintf(LOG_ERR, "Not enough parameters given.");
@@ -4811,9 +5884,9 @@ printf_sdr_usage()
 	lprintf(LOG_NOTICE,
 "                     Display all sensors associated with an entity\n");
 	lprintf(LOG_NOTICE,
-"               dump <file>");
+"               dump <file> [raw|cache]");
 	lprintf(LOG_NOTICE,
-"                     Dump raw SDR data to a file\n");
+"                     Dump raw SDR data or an indexed SDR cache to a file\n");
 	lprintf(LOG_NOTICE,
 "               fill <option>");
 	lprintf(LOG_NOTICE,
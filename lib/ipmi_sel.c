@@ -229,7 +229,7 @@ ipmi_get_event_type(uint8_t code)
 static char *
 ipmi_sel_timestamp(uint32_t stamp)
 {
-	static char tbuf[40];
+	static IPMI_TLS char tbuf[40];
 	time_t s = (time_t)stamp;
 	memset(tbuf, 0, 40);
 	strftime(tbuf, sizeof(tbuf), "%m/%d/%Y %H:%M:%S", gmtime(&s));
@@ -239,7 +239,7 @@ ipmi_sel_timestamp(uint32_t stamp)
 static char *
 ipmi_sel_timestamp_date(uint32_t stamp)
 {
-	static char tbuf[11];
+	static IPMI_TLS char tbuf[11];
 	time_t s = (time_t)stamp;
 	strftime(tbuf, sizeof(tbuf), "%m/%d/%Y", gmtime(&s));
 	return tbuf;
@@ -248,7 +248,7 @@ ipmi_sel_timestamp_date(uint32_t stamp)
 static char *
 ipmi_sel_timestamp_time(uint32_t stamp)
 {
-	static char tbuf[9];
+	static IPMI_TLS char tbuf[9];
 	time_t s = (time_t)stamp;
 	strftime(tbuf, sizeof(tbuf), "%H:%M:%S", gmtime(&s));
 	return tbuf;
@@ -2640,7 +2640,7 @@ ipmi_sel_get_time(struct ipmi_intf * intf)
 {
 	struct ipmi_rs * rsp;
 	struct ipmi_rq req;
-	static char tbuf[40];
+	static IPMI_TLS char tbuf[40];
 	uint32_t timei;
 	time_t time;
 
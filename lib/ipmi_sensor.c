@@ -32,6 +32,8 @@
 
 #include <string.h>
 #include <math.h>
+#include <signal.h>
+#include <time.h>
 
 #include <ipmitool/ipmi.h>
 #include <ipmitool/helper.h>
@@ -40,6 +42,7 @@
 #include <ipmitool/ipmi_sdr.h>
 #include <ipmitool/ipmi_sel.h>
 #include <ipmitool/ipmi_sensor.h>
+#include <ipmitool/ipmi_sample.h>
 
 extern int verbose;
 void print_sensor_get_usage();
@@ -158,17 +161,8 @@ ipmi_sensor_set_sensor_thresholds(struct ipmi_intf *intf,
 static int
 ipmi_sensor_print_fc_discrete(struct ipmi_intf *intf,
 				struct sdr_record_common_sensor *sensor,
-				uint8_t sdr_record_type)
+				struct sensor_reading *sr)
 {
-	const char *id;
-	struct sensor_reading *sr;
-
-	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 3);
-
-	if (sr == NULL) {
-		return -1;
-	}
-
 	if (csv_output) {
 		/* NOT IMPLEMENTED */
 	} else {
@@ -201,7 +195,7 @@ ipmi_sensor_print_fc_discrete(struct ipmi_intf *intf,
 			printf(" Entity ID             : %d.%d\n",
 			       sensor->entity.id, sensor->entity.instance);
 			printf(" Sensor Type (Discrete): %s\n",
-			       ipmi_sdr_get_sensor_type_desc(sensor->sensor.
+			       ipmi_sdr_get_sensor_type_desc(intf, sensor->sensor.
 							     type));
 			if( sr->s_reading_valid )
 			{
@@ -243,32 +237,22 @@ print_thresh_setting(struct sdr_record_full_sensor *full,
 	}
 }
 
+/* ipmi_sensor_print_fc_threshold  -  print a threshold sensor
+ *
+ * @intf:	ipmi interface
+ * @sensor:	common sensor structure
+ * @sr:		its reading
+ * @thresh:	Get Sensor Thresholds response data
+ * @thresh_len:	its length, 0 if the thresholds are not available
+ */
 static int
 ipmi_sensor_print_fc_threshold(struct ipmi_intf *intf,
 			      struct sdr_record_common_sensor *sensor,
-			      uint8_t sdr_record_type)
+			      struct sensor_reading *sr,
+			      const uint8_t *thresh, int thresh_len)
 {
-	int thresh_available = 1;
-	struct ipmi_rs *rsp;
-	struct sensor_reading *sr;
-
-	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 3);
-
-	if (sr == NULL) {
-		return -1;
-	}
-
-	const char *thresh_status = ipmi_sdr_get_thresh_status(sr, "ns");
-
-	/*
-	 * Get sensor thresholds
-	 */
-	rsp = ipmi_sdr_get_sensor_thresholds(intf,
-				sensor->keys.sensor_num, sensor->keys.owner_id,
-				sensor->keys.lun, sensor->keys.channel);
-
-	if ((rsp == NULL) || (rsp->ccode > 0) || (rsp->data_len == 0))
-		thresh_available = 0;
+	int thresh_available = thresh_len > 0;
+	const char *thresh_status = ipmi_sdr_get_thresh_status(intf, sr, "ns");
 
 	if (csv_output) {
 		/* NOT IMPLEMENTED */
@@ -291,8 +275,8 @@ ipmi_sensor_print_fc_threshold(struct ipmi_intf *intf,
 			}
 			if (thresh_available && sr->full) {
 #define PTS(bit, dataidx) {						\
-	print_thresh_setting(sr->full, rsp->data[0] & (bit),  		\
-	    rsp->data[(dataidx)], "| ", "%-10.3f", "0x-8x", "%-10s");	\
+	print_thresh_setting(sr->full, thresh[0] & (bit),  		\
+	    thresh[(dataidx)], "| ", "%-10.3f", "0x-8x", "%-10s");	\
 }
 				PTS(LOWER_NON_RECOV_SPECIFIED,	3);
 				PTS(LOWER_CRIT_SPECIFIED,	2);
@@ -316,7 +300,7 @@ ipmi_sensor_print_fc_threshold(struct ipmi_intf *intf,
 			       sensor->entity.id, sensor->entity.instance);
 
 			printf(" Sensor Type (Threshold)  : %s\n",
-			       ipmi_sdr_get_sensor_type_desc(sensor->sensor.
+			       ipmi_sdr_get_sensor_type_desc(intf, sensor->sensor.
 							     type));
 
 			printf(" Sensor Reading        : ");
@@ -348,8 +332,8 @@ ipmi_sensor_print_fc_threshold(struct ipmi_intf *intf,
 				if (thresh_available) {
 					if (sr->full) {
 #define PTS(bit, dataidx, str) { 			\
-print_thresh_setting(sr->full, rsp->data[0] & (bit),	\
-		     rsp->data[(dataidx)], 		\
+print_thresh_setting(sr->full, thresh[0] & (bit),	\
+		     thresh[(dataidx)], 		\
 		    (str), "%.3f\n", "0x%x\n", "%s\n"); \
 }
 
@@ -409,56 +393,113 @@ ipmi_sensor_print_fc(struct ipmi_intf *intf,
 		       struct sdr_record_common_sensor *sensor,
 			uint8_t sdr_record_type)
 {
-	if (IS_THRESHOLD_SENSOR(sensor))
-		return ipmi_sensor_print_fc_threshold(intf, sensor, sdr_record_type);
-	else
-		return ipmi_sensor_print_fc_discrete(intf, sensor, sdr_record_type);
+	struct sensor_reading *sr;
+	struct ipmi_rs *rsp;
+
+	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 3);
+
+	if (sr == NULL) {
+		return -1;
+	}
+
+	if (!IS_THRESHOLD_SENSOR(sensor))
+		return ipmi_sensor_print_fc_discrete(intf, sensor, sr);
+
+	/*
+	 * Get sensor thresholds
+	 */
+	rsp = ipmi_sdr_get_sensor_thresholds(intf,
+				sensor->keys.sensor_num, sensor->keys.owner_id,
+				sensor->keys.lun, sensor->keys.channel);
+
+	if ((rsp == NULL) || (rsp->ccode > 0) || (rsp->data_len == 0))
+		return ipmi_sensor_print_fc_threshold(intf, sensor, sr, NULL, 0);
+	return ipmi_sensor_print_fc_threshold(intf, sensor, sr,
+					      rsp->data, rsp->data_len);
 }
 
+/* ipmi_sensor_list  -  print all sensors with their thresholds
+ *
+ * With file=<file> the readings are appended to a sample file, see
+ * ipmi_sample_add(), instead of being printed.
+ *
+ * @intf:	ipmi interface
+ * @argc:	number of arguments
+ * @argv:	options
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
 static int
-ipmi_sensor_list(struct ipmi_intf *intf)
+ipmi_sensor_list(struct ipmi_intf *intf, int argc, char **argv)
 {
-	struct sdr_get_rs *header;
-	struct ipmi_sdr_iterator *itr;
-	int rc = 0;
-
-	lprintf(LOG_DEBUG, "Querying SDR for sensor list");
+	struct sdr_sweep_entry *sw;
+	struct sdr_record_list *e;
+	struct ipmi_sample_file *sf;
+	const char *file = NULL;
+	int count, i, rc = 0;
 
-	itr = ipmi_sdr_start(intf, 0);
-	if (itr == NULL) {
-		lprintf(LOG_ERR, "Unable to open SDR for reading");
-		return -1;
+	for (i = 0; i < argc; i++) {
+		if (strncmp(argv[i], "file=", 5) == 0) {
+			file = argv[i] + 5;
+		} else {
+			lprintf(LOG_ERR, "Invalid sensor list option: %s",
+				argv[i]);
+			return -1;
+		}
 	}
 
-	while ((header = ipmi_sdr_get_next_header(intf, itr)) != NULL) {
-		uint8_t *rec;
+	lprintf(LOG_DEBUG, "Querying SDR for sensor list");
 
-		rec = ipmi_sdr_get_record(intf, header, itr);
-		if (rec == NULL) {
-			lprintf(LOG_DEBUG, "rec == NULL");
-			continue;
-		}
+	/* the global list may come from the SDR cache */
+	if (ipmi_sdr_list_cache(intf) < 0 && intf->sdr.itr == NULL)
+		return -1;
 
-		switch (header->type) {
+	for (count = 0, e = intf->sdr.head; e != NULL; e = e->next)
+		count++;
+	sw = calloc(count + 1, sizeof(struct sdr_sweep_entry));
+	if (sw == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	for (count = 0, e = intf->sdr.head; e != NULL; e = e->next) {
+		switch (e->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			ipmi_sensor_print_fc(intf,
-						   (struct
-						    sdr_record_common_sensor *)
-						   rec,
-						   header->type);
+			sw[count++].entry = e;
 			break;
 		}
-		free(rec);
-		rec = NULL;
+	}
+
+	if (file != NULL) {
+		ipmi_sdr_sweep(intf, sw, count, 3, 0);
+		sf = ipmi_sample_open(file, sw, count);
+		if (sf == NULL || ipmi_sample_add(sf) < 0)
+			rc = -1;
+		if (ipmi_sample_close(sf) < 0)
+			rc = -1;
+		free(sw);
+		return rc;
+	}
+
+	/* take all readings and thresholds first, then print in SDR order */
+	ipmi_sdr_sweep(intf, sw, count, 3, 1);
+
+	for (i = 0; i < count; i++) {
+		if (IS_THRESHOLD_SENSOR(sw[i].entry->record.common))
+			ipmi_sensor_print_fc_threshold(intf,
+					sw[i].entry->record.common, &sw[i].sr,
+					sw[i].thresh, sw[i].thresh_len);
+		else
+			ipmi_sensor_print_fc_discrete(intf,
+					sw[i].entry->record.common, &sw[i].sr);
 
 		/* fix for CR6604909: */
 		/* mask failure of individual reads in sensor list command */
 		/* rc = (r == 0) ? rc : r; */
 	}
 
-	ipmi_sdr_end(intf, itr);
-
+	free(sw);
 	return rc;
 }
 
@@ -901,23 +942,496 @@ ipmi_sensor_get(struct ipmi_intf *intf, int argc, char **argv)
 	return rc;
 }
 
+#define SENSOR_WATCH_RING	64	/* raw samples kept per sensor */
+
+/*
+ * A raw sample of sensor watch
+ */
+struct sensor_sample {
+	uint32_t when;		/* ms since the watch started */
+	uint8_t valid;
+	uint8_t reading;
+	uint8_t data2;		/* threshold or discrete state bits */
+	uint8_t data3;
+};
+
+/*
+ * Per-sensor state of sensor watch: its last samples and running
+ * statistics over the valid ones
+ */
+struct sensor_watch {
+	struct sensor_sample ring[SENSOR_WATCH_RING];
+	uint32_t samples;	/* ring[(samples - 1) % RING] is the last */
+	uint32_t changes;
+	uint32_t valid;
+	double min;
+	double max;
+	double sum;
+};
+
+static volatile sig_atomic_t sensor_watch_stop = 0;
+
+static void
+ipmi_sensor_watch_signal(int sig)
+{
+	sensor_watch_stop = 1;
+}
+
+static void
+print_sensor_watch_usage(void)
+{
+	lprintf(LOG_NOTICE,
+"sensor watch [interval=<ms>] [count=<n>] [only-changed] [file=<file>] [<id> ...]");
+	lprintf(LOG_NOTICE,
+"   interval     : time between samples, default 1000 ms");
+	lprintf(LOG_NOTICE,
+"   count        : stop after n samples, default is to run until interrupted");
+	lprintf(LOG_NOTICE,
+"   only-changed : print only readings or states that changed");
+	lprintf(LOG_NOTICE,
+"   file         : append the raw samples to a sample file instead of printing");
+	lprintf(LOG_NOTICE,
+"   id           : names of the sensors to watch, default all");
+}
+
+/* ipmi_sensor_watch_value  -  value of a reading for the statistics
+ *
+ * The analog value when the sensor has one, the raw reading otherwise.
+ */
+static double
+ipmi_sensor_watch_value(struct sensor_reading *sr)
+{
+	return sr->s_has_analog_value ? sr->s_a_val : sr->s_reading;
+}
+
+/* ipmi_sensor_watch_print  -  print one sample of sensor watch
+ *
+ * @when:	time of the sample
+ * @sensor:	common sensor structure
+ * @sr:		its reading
+ */
+static void
+ipmi_sensor_watch_print(const char *when,
+			struct sdr_record_common_sensor *sensor,
+			struct sensor_reading *sr)
+{
+	char sval[16], status[16];
+	const char *units = sr->s_has_analog_value ? sr->s_a_units : "discrete";
+
+	if (!sr->s_reading_valid)
+		snprintf(sval, sizeof(sval), "na");
+	else if (sr->s_has_analog_value)
+		snprintf(sval, sizeof(sval), "%.3f", sr->s_a_val);
+	else
+		snprintf(sval, sizeof(sval), "0x%x", sr->s_reading);
+
+	if (IS_THRESHOLD_SENSOR(sensor))
+		snprintf(status, sizeof(status), "%s",
+			 ipmi_sdr_get_thresh_status(NULL, sr, "ns"));
+	else if (sr->s_reading_valid)
+		snprintf(status, sizeof(status), "0x%02x%02x",
+			 sr->s_data2, sr->s_data3);
+	else
+		snprintf(status, sizeof(status), "na");
+
+	if (csv_output)
+		printf("%s,%s,%s,%s,%s\n", when, sr->s_id, sval, units, status);
+	else
+		printf("%s | %-16s | %-10s | %-10s | %s\n",
+		       when, sr->s_id, sval, units, status);
+}
+
+/* ipmi_sensor_watch_summary  -  print the statistics of sensor watch
+ *
+ * @sw:		watched sensors
+ * @w:		their state
+ * @count:	number of sensors
+ */
+static void
+ipmi_sensor_watch_summary(struct sdr_sweep_entry *sw, struct sensor_watch *w,
+			  int count)
+{
+	char smin[16], smax[16], savg[16];
+	uint32_t i, n;
+	int k;
+
+	if (!csv_output)
+		printf("\n%-16s | %-10s | %-10s | %-10s | %-7s | %s\n",
+		       "Sensor", "Min", "Max", "Avg", "Samples", "Changes");
+
+	for (k = 0; k < count; k++) {
+		if (w[k].valid == 0) {
+			snprintf(smin, sizeof(smin), "na");
+			snprintf(smax, sizeof(smax), "na");
+			snprintf(savg, sizeof(savg), "na");
+		} else if (sw[k].sr.s_has_analog_value) {
+			snprintf(smin, sizeof(smin), "%.3f", w[k].min);
+			snprintf(smax, sizeof(smax), "%.3f", w[k].max);
+			snprintf(savg, sizeof(savg), "%.3f",
+				 w[k].sum / w[k].valid);
+		} else {
+			snprintf(smin, sizeof(smin), "0x%x", (int)w[k].min);
+			snprintf(smax, sizeof(smax), "0x%x", (int)w[k].max);
+			snprintf(savg, sizeof(savg), "na");
+		}
+
+		if (csv_output)
+			printf("%s,%s,%s,%s,%u,%u\n", sw[k].sr.s_id,
+			       smin, smax, savg, w[k].samples, w[k].changes);
+		else
+			printf("%-16s | %-10s | %-10s | %-10s | %-7u | %u\n",
+			       sw[k].sr.s_id, smin, smax, savg,
+			       w[k].samples, w[k].changes);
+
+		if (verbose < 1 || w[k].samples == 0)
+			continue;
+
+		/* the raw readings still in the ring, oldest first */
+		n = __min(w[k].samples, SENSOR_WATCH_RING);
+		printf(" Last raw readings     :");
+		for (i = w[k].samples - n; i < w[k].samples; i++) {
+			struct sensor_sample *s = &w[k].ring[i % SENSOR_WATCH_RING];
+			if (s->valid)
+				printf(" %02x", s->reading);
+			else
+				printf(" --");
+		}
+		printf("\n");
+	}
+}
+
+/* ipmi_sensor_watch  -  sample sensors until interrupted
+ *
+ * The SDR list is read once and the session kept open.  Every interval
+ * all watched sensors are read and converted with ipmi_sdr_sweep(), and
+ * their raw readings appended to per-sensor rings.  Every converted
+ * value counts towards the minimum, maximum and average printed on
+ * exit; with only-changed a sample is printed only if its raw reading
+ * or state differs from the previous one.
+ *
+ * @intf:	ipmi interface
+ * @argc:	number of arguments
+ * @argv:	options and sensor names
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_sensor_watch(struct ipmi_intf *intf, int argc, char **argv)
+{
+	struct sdr_sweep_entry *sw = NULL;
+	struct sensor_watch *w = NULL;
+	struct ipmi_sample_file *sf = NULL;
+	struct sdr_record_list *e;
+	struct sigaction act, oldint, oldterm;
+	int32_t interval = 1000, samples = 0;
+	int only_changed = 0, names = 0;
+	const char *file = NULL;
+	char when[16];
+	int count = 0, i, k, rc = 0;
+	uint32_t start, now, due;
+	struct timespec ts;
+
+	for (i = 0; i < argc; i++) {
+		if (strncmp(argv[i], "interval=", 9) == 0) {
+			if (str2int(argv[i] + 9, &interval) != 0 ||
+			    interval < 1) {
+				lprintf(LOG_ERR, "Invalid interval: %s",
+					argv[i] + 9);
+				return -1;
+			}
+		} else if (strncmp(argv[i], "count=", 6) == 0) {
+			if (str2int(argv[i] + 6, &samples) != 0 ||
+			    samples < 1) {
+				lprintf(LOG_ERR, "Invalid count: %s",
+					argv[i] + 6);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "only-changed") == 0) {
+			only_changed = 1;
+		} else if (strncmp(argv[i], "file=", 5) == 0) {
+			file = argv[i] + 5;
+		} else if (strcmp(argv[i], "help") == 0) {
+			print_sensor_watch_usage();
+			return 0;
+		} else {
+			names++;
+		}
+	}
+
+	/* the global list may come from the SDR cache */
+	if (ipmi_sdr_list_cache(intf) < 0 && intf->sdr.itr == NULL)
+		return -1;
+
+	for (e = intf->sdr.head; e != NULL; e = e->next)
+		count++;
+	if (names > count)
+		count = names;
+	sw = calloc(count + 1, sizeof(struct sdr_sweep_entry));
+	if (sw == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+
+	count = 0;
+	if (names == 0) {
+		for (e = intf->sdr.head; e != NULL; e = e->next) {
+			if (e->type == SDR_RECORD_TYPE_FULL_SENSOR ||
+			    e->type == SDR_RECORD_TYPE_COMPACT_SENSOR)
+				sw[count++].entry = e;
+		}
+	}
+	for (i = 0; names > 0 && i < argc; i++) {
+		if (strchr(argv[i], '=') != NULL ||
+		    strcmp(argv[i], "only-changed") == 0)
+			continue;
+		e = ipmi_sdr_find_sdr_byid(intf, argv[i]);
+		if (e == NULL || (e->type != SDR_RECORD_TYPE_FULL_SENSOR &&
+				  e->type != SDR_RECORD_TYPE_COMPACT_SENSOR)) {
+			lprintf(LOG_ERR, "Sensor \"%s\" not found!", argv[i]);
+			rc = -1;
+			continue;
+		}
+		sw[count++].entry = e;
+	}
+	if (count == 0) {
+		lprintf(LOG_ERR, "No sensors to watch");
+		free(sw);
+		return -1;
+	}
+
+	w = calloc(count, sizeof(struct sensor_watch));
+	if (w == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		free(sw);
+		return -1;
+	}
+
+	if (file != NULL) {
+		sf = ipmi_sample_open(file, sw, count);
+		if (sf == NULL) {
+			free(w);
+			free(sw);
+			return -1;
+		}
+	}
+
+	sensor_watch_stop = 0;
+	act.sa_handler = ipmi_sensor_watch_signal;
+	act.sa_flags = 0;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGINT, &act, &oldint);
+	sigaction(SIGTERM, &act, &oldterm);
+
+	start = due = ipmi_intf_msec();
+	while (!sensor_watch_stop) {
+		now = ipmi_intf_msec() - start;
+		ipmi_sdr_sweep(intf, sw, count, 3, 0);
+		if (sf != NULL && ipmi_sample_add(sf) < 0) {
+			rc = -1;
+			break;
+		}
+		snprintf(when, sizeof(when), csv_output ? "%u.%03u" : "%6u.%03u",
+			 now / 1000, now % 1000);
+
+		for (k = 0; k < count; k++) {
+			struct sensor_reading *sr = &sw[k].sr;
+			struct sensor_sample *s, *prev = NULL;
+			double v;
+
+			if (w[k].samples > 0)
+				prev = &w[k].ring[(w[k].samples - 1) %
+						  SENSOR_WATCH_RING];
+			s = &w[k].ring[w[k].samples++ % SENSOR_WATCH_RING];
+			s->when = now;
+			s->valid = sr->s_reading_valid;
+			s->reading = sr->s_reading;
+			s->data2 = sr->s_data2;
+			s->data3 = sr->s_data3;
+
+			if (s->valid) {
+				v = ipmi_sensor_watch_value(sr);
+				if (w[k].valid == 0 || v < w[k].min)
+					w[k].min = v;
+				if (w[k].valid == 0 || v > w[k].max)
+					w[k].max = v;
+				w[k].sum += v;
+				w[k].valid++;
+			}
+
+			if (prev != NULL && (prev->valid != s->valid ||
+			    prev->reading != s->reading ||
+			    prev->data2 != s->data2 ||
+			    prev->data3 != s->data3))
+				w[k].changes++;
+			else if (prev != NULL && only_changed)
+				continue;
+
+			if (sf == NULL)
+				ipmi_sensor_watch_print(when,
+					sw[k].entry->record.common, sr);
+		}
+		fflush(stdout);
+
+		if (samples > 0 && (int32_t)w[0].samples >= samples)
+			break;
+
+		/* keep to the schedule, skipping samples we are late for */
+		due += interval;
+		now = ipmi_intf_msec();
+		if ((int32_t)(due - now) <= 0)
+			due = now;
+		else {
+			ts.tv_sec = (due - now) / 1000;
+			ts.tv_nsec = ((due - now) % 1000) * 1000000;
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	sigaction(SIGINT, &oldint, NULL);
+	sigaction(SIGTERM, &oldterm, NULL);
+
+	if (ipmi_sample_close(sf) < 0)
+		rc = -1;
+	ipmi_sensor_watch_summary(sw, w, count);
+
+	free(w);
+	free(sw);
+	return rc;
+}
+
+/*
+ * State of sensor export between rows
+ */
+struct sensor_export_ctx {
+	int only_changed;
+	uint8_t *prev;		/* raw_len and raw[] of each column */
+};
+
+/* ipmi_sensor_export_row  -  ipmi_sample_read() callback of sensor export
+ */
+static int
+ipmi_sensor_export_row(uint64_t msec, struct sdr_sweep_entry *sw, int cols,
+		       int first, void *ctx)
+{
+	struct sensor_export_ctx *ec = (struct sensor_export_ctx *)ctx;
+	time_t t = msec / 1000;
+	char when[40];
+	uint8_t *p;
+	int c, n;
+
+	if (first) {
+		free(ec->prev);
+		ec->prev = calloc(cols, 1 + sizeof(sw->raw));
+		if (ec->prev == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+	}
+
+	if (csv_output) {
+		snprintf(when, sizeof(when), "%lu.%03u",
+			 (unsigned long)t, (unsigned int)(msec % 1000));
+	} else {
+		n = strftime(when, sizeof(when), "%m/%d/%Y %H:%M:%S",
+			     localtime(&t));
+		snprintf(when + n, sizeof(when) - n, ".%03u",
+			 (unsigned int)(msec % 1000));
+	}
+
+	for (c = 0; c < cols; c++) {
+		p = ec->prev + c * (1 + sizeof(sw->raw));
+		if (ec->only_changed && !first && p[0] == sw[c].raw_len &&
+		    memcmp(p + 1, sw[c].raw, sizeof(sw->raw)) == 0)
+			continue;
+		p[0] = sw[c].raw_len;
+		memcpy(p + 1, sw[c].raw, sizeof(sw->raw));
+		ipmi_sensor_watch_print(when, sw[c].entry->record.common,
+					&sw[c].sr);
+	}
+	return 0;
+}
+
+/* ipmi_sensor_export  -  print a sample file
+ *
+ * Converts the raw samples written by sensor watch or sensor list with
+ * file= using the SDR records stored in the file, and prints them as
+ * sensor watch does, or as CSV with -c.
+ *
+ * @intf:	ipmi interface
+ * @argc:	number of arguments
+ * @argv:	file name and options
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_sensor_export(struct ipmi_intf *intf, int argc, char **argv)
+{
+	struct sensor_export_ctx ec;
+	int i, rc;
+
+	if (argc < 1 || strcmp(argv[0], "help") == 0) {
+		lprintf(LOG_NOTICE, "sensor export <file> [only-changed]");
+		lprintf(LOG_NOTICE,
+"   file         : sample file written by sensor watch or list file=");
+		lprintf(LOG_NOTICE,
+"   only-changed : print only readings or states that changed");
+		return argc < 1 ? -1 : 0;
+	}
+
+	memset(&ec, 0, sizeof(ec));
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "only-changed") == 0) {
+			ec.only_changed = 1;
+		} else {
+			lprintf(LOG_ERR, "Invalid sensor export option: %s",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	rc = ipmi_sample_read(argv[0], 3, ipmi_sensor_export_row, &ec);
+	free(ec.prev);
+	return rc;
+}
+
+/* ipmi_sensor_offline  -  tell ipmi_main() which sensor commands need
+ *                        no BMC
+ *
+ * @argc:	number of arguments
+ * @argv:	sensor subcommand and its arguments
+ *
+ * returns 1 for sensor export, which only reads a sample file
+ * returns 0 otherwise
+ */
+int
+ipmi_sensor_offline(int argc, char **argv)
+{
+	return argc > 0 && strcmp(argv[0], "export") == 0;
+}
+
 int
 ipmi_sensor_main(struct ipmi_intf *intf, int argc, char **argv)
 {
 	int rc = 0;
 
 	if (argc == 0) {
-		rc = ipmi_sensor_list(intf);
+		rc = ipmi_sensor_list(intf, 0, NULL);
 	} else if (strncmp(argv[0], "help", 4) == 0) {
-		lprintf(LOG_NOTICE, "Sensor Commands:  list thresh get reading");
+		lprintf(LOG_NOTICE, "Sensor Commands:  list thresh get reading watch export");
 	} else if (strncmp(argv[0], "list", 4) == 0) {
-		rc = ipmi_sensor_list(intf);
+		rc = ipmi_sensor_list(intf, argc - 1, &argv[1]);
 	} else if (strncmp(argv[0], "thresh", 5) == 0) {
 		rc = ipmi_sensor_set_threshold(intf, argc - 1, &argv[1]);
 	} else if (strncmp(argv[0], "get", 3) == 0) {
 		rc = ipmi_sensor_get(intf, argc - 1, &argv[1]);
 	} else if (strncmp(argv[0], "reading", 7) == 0) {
 		rc = ipmi_sensor_get_reading(intf, argc - 1, &argv[1]);
+	} else if (strncmp(argv[0], "watch", 5) == 0) {
+		rc = ipmi_sensor_watch(intf, argc - 1, &argv[1]);
+	} else if (strcmp(argv[0], "export") == 0) {
+		rc = ipmi_sensor_export(intf, argc - 1, &argv[1]);
 	} else {
 		lprintf(LOG_ERR, "Invalid sensor command: %s", argv[0]);
 		rc = -1;
@@ -41,6 +41,7 @@
 #include <time.h>
 #include <signal.h>
 #include <unistd.h>
+#include <errno.h>
 
 #if defined(HAVE_CONFIG_H)
 # include <config.h>
@@ -87,7 +88,31 @@ const struct valstr sol_parameter_vals[] = {
 };
 
 
-static struct timeval _start_keepalive;
+#define SOL_OUTPUT_BUFFER_SIZE	8192	/* console data collected per write() */
+#define SOL_RECV_BURST		64	/* packets read before looking at stdin */
+
+/*
+ * Character data on its way to the BMC.  Only one packet is in flight
+ * at a time, as the protocol requires; keystrokes that arrive while it
+ * waits for its ACK are collected in data[] and go out together in the
+ * next packet.
+ */
+struct sol_tx {
+	struct ipmi_v2_payload payload;	/* the packet in flight */
+	int      inflight;
+	uint8_t  seq;		/* its packet sequence number */
+	uint32_t sent;		/* ipmi_intf_msec() of the last transmission */
+	int      tries;
+	uint8_t  data[IPMI_BUF_SIZE];	/* waiting for the next packet */
+	int      len;
+	int      size;		/* largest packet the BMC accepts */
+	int      brk;		/* generate a break with the next packet */
+};
+
+static struct sol_tx  _sol_tx;
+static uint8_t        _sol_out[SOL_OUTPUT_BUFFER_SIZE];
+static int            _sol_out_len = 0;
+static uint32_t       _last_keepalive;	/* ipmi_intf_msec() */
 static struct termios _saved_tio;
 static int            _in_raw_mode = 0;
 static int            _disable_keepalive = 0;
@@ -1182,21 +1207,6 @@ enter_raw_mode(void)
 }
 
 
-static void
-sendBreak(struct ipmi_intf * intf)
-{
-	struct ipmi_v2_payload  v2_payload;
-
-	memset(&v2_payload, 0, sizeof(v2_payload));
-
-	v2_payload.payload.sol_packet.character_count = 0;
-	v2_payload.payload.sol_packet.generate_break  = 1;
-
-	intf->send_sol(intf, &v2_payload);
-}
-
-
-
 /*
  * suspendSelf
  *
@@ -1247,10 +1257,45 @@ printSolEscapeSequences(struct ipmi_intf * intf)
 
 
 
+/*
+ * flush_output
+ *
+ * Write the console data collected by output() to stdout
+ */
+static void
+flush_output(void)
+{
+	int off = 0;
+	int rc;
+
+	while (off < _sol_out_len) {
+		rc = write(fileno(stdout), _sol_out + off, _sol_out_len - off);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				fd_set write_fds;
+
+				FD_ZERO(&write_fds);
+				FD_SET(fileno(stdout), &write_fds);
+				select(fileno(stdout) + 1, NULL, &write_fds, NULL, NULL);
+				continue;
+			}
+			break;	/* nowhere to put it */
+		}
+		off += rc;
+	}
+	_sol_out_len = 0;
+}
+
+
+
 /*
  * output
  *
- * Send the specified data to stdout
+ * Queue the specified data for stdout.  The SOL loop writes it out
+ * with a single write() once the packets that arrived together have
+ * been handled.
  */
 static void
 output(struct ipmi_rs * rsp)
@@ -1268,12 +1313,14 @@ output(struct ipmi_rs * rsp)
 	    (rsp->session.authtype    == IPMI_SESSION_AUTHTYPE_RMCP_PLUS) &&
 	    (rsp->session.payloadtype == IPMI_PAYLOAD_TYPE_SOL))
 	{
-		int i;
+		if (rsp->data_len <= 0)
+			return;
 
-		for (i = 0; i < rsp->data_len; ++i)
-			putc(rsp->data[i], stdout);
+		if (_sol_out_len + rsp->data_len > sizeof(_sol_out))
+			flush_output();
 
-		fflush(stdout);
+		memcpy(_sol_out + _sol_out_len, rsp->data, rsp->data_len);
+		_sol_out_len += rsp->data_len;
 	}
 }
 
@@ -1282,7 +1329,7 @@ output(struct ipmi_rs * rsp)
 /*
  * ipmi_sol_deactivate
  */
-static int
+int
 ipmi_sol_deactivate(struct ipmi_intf * intf, int instance)
 {
 	struct ipmi_rs * rsp;
@@ -1341,10 +1388,11 @@ ipmi_sol_deactivate(struct ipmi_intf * intf, int instance)
  *
  * Act on user input into the SOL session.  The only reason this
  * is complicated is that we have to process escape sequences.
+ * Everything else is collected in _sol_tx and goes out with the
+ * next packet, see sol_send_data().
  *
  * return   0 on success
  *          1 if we should exit
- *        < 0 on error (BMC probably closed the session)
  */
 static int
 processSolUserInput(
@@ -1354,14 +1402,11 @@ processSolUserInput(
 {
 	static int escape_pending = 0;
 	static int last_was_cr    = 1;
-	struct ipmi_v2_payload v2_payload;
-	int  length               = 0;
+	struct sol_tx * tx        = &_sol_tx;
 	int  retval               = 0;
 	char ch;
 	int  i;
 
-	memset(&v2_payload, 0, sizeof(v2_payload));
-
 	/*
 	 * Our first order of business is to check the input for escape
 	 * sequences to act on.
@@ -1373,6 +1418,9 @@ processSolUserInput(
 		if (escape_pending){
 			escape_pending = 0;
 
+			/* keep the console output in front of our messages */
+			flush_output();
+
 			/*
 			 * Process a possible escape sequence.
 			 */
@@ -1380,36 +1428,41 @@ processSolUserInput(
 			case '.':
 				printf("%c. [terminated ipmitool]\n",
 				       intf->session->sol_escape_char);
+				fflush(stdout);
 				retval = 1;
 				break;
 
 			case 'Z' - 64:
 				printf("%c^Z [suspend ipmitool]\n",
 				       intf->session->sol_escape_char);
+				fflush(stdout);
 				suspendSelf(1); /* Restore tty back to raw */
 				continue;
 
 			case 'X' - 64:
 				printf("%c^Z [suspend ipmitool]\n",
 				       intf->session->sol_escape_char);
+				fflush(stdout);
 				suspendSelf(0); /* Don't restore to raw mode */
 				continue;
 
 			case 'B':
 				printf("%cB [send break]\n",
 				       intf->session->sol_escape_char);
-				sendBreak(intf);
+				fflush(stdout);
+				tx->brk = 1;
 				continue;
 
 			case '?':
 				printSolEscapeSequences(intf);
+				fflush(stdout);
 				continue;
 
 			default:
 				if (ch != intf->session->sol_escape_char)
-					v2_payload.payload.sol_packet.data[length++] =
+					tx->data[tx->len++] =
 						intf->session->sol_escape_char;
-				v2_payload.payload.sol_packet.data[length++] = ch;
+				tx->data[tx->len++] = ch;
 			}
 		}
 
@@ -1420,7 +1473,7 @@ processSolUserInput(
 				continue;
 			}
 
-			v2_payload.payload.sol_packet.data[length++] =	ch;
+			tx->data[tx->len++] = ch;
 		}
 
 
@@ -1430,67 +1483,153 @@ processSolUserInput(
 		last_was_cr = (ch == '\r' || ch == '\n');
 	}
 
+	return retval;
+}
 
-	/*
-	 * If there is anything left to process we dispatch it to the BMC,
-	 * send intf->session->sol_data.max_outbound_payload_size bytes
-	 * at a time.
-	 */
-	if (length)
-	{
-		struct ipmi_rs * rsp = NULL;
-		int try = 0;
 
-		while (try < intf->session->retry) {
 
-			v2_payload.payload.sol_packet.character_count = length;
+/*
+ * sol_xmit
+ *
+ * (Re)transmit the packet in _sol_tx without waiting for the ACK
+ */
+static void
+sol_xmit(struct ipmi_intf * intf)
+{
+	struct sol_tx * tx = &_sol_tx;
 
-			rsp = intf->send_sol(intf, &v2_payload);
+	intf->noanswer = 1;
+	intf->send_sol(intf, &tx->payload);
+	intf->noanswer = 0;
 
-			if (rsp)
-			{
-				break;
-			}
+	tx->inflight = 1;
+	tx->sent = ipmi_intf_msec();
+	tx->tries++;
+}
 
-			usleep(5000);
-			try++;
-		}
 
-		if (! rsp)
-		{
-			lprintf(LOG_ERR, "Error sending SOL data: FAIL");
-			retval = -1;
-		}
 
-		/* If the sequence number is set we know we have new data */
-		if (retval == 0)
-			if ((rsp->session.authtype == IPMI_SESSION_AUTHTYPE_RMCP_PLUS) &&
-			    (rsp->session.payloadtype == IPMI_PAYLOAD_TYPE_SOL)        &&
-			    (rsp->payload.sol_packet.packet_sequence_number))
-				output(rsp);
+/*
+ * sol_send_data
+ *
+ * Put the keystrokes collected so far on the wire, unless the previous
+ * packet is still waiting for its ACK.  Typing while a packet is in
+ * flight thus fills the next one, up to the size the BMC accepts.
+ */
+static void
+sol_send_data(struct ipmi_intf * intf)
+{
+	struct sol_tx * tx = &_sol_tx;
+	int len;
+
+	if (tx->inflight || (tx->len == 0 && !tx->brk))
+		return;
+
+	len = __min(tx->len, tx->size);
+
+	memset(&tx->payload, 0, sizeof(tx->payload));
+	memcpy(tx->payload.payload.sol_packet.data, tx->data, len);
+	tx->payload.payload.sol_packet.character_count = len;
+	tx->payload.payload.sol_packet.generate_break  = tx->brk;
+
+	tx->len -= len;
+	memmove(tx->data, tx->data + len, tx->len);
+	tx->brk = 0;
+
+	tx->tries = 0;
+	sol_xmit(intf);
+	tx->seq = tx->payload.payload.sol_packet.packet_sequence_number;
+}
+
+
+
+/*
+ * sol_resend_data
+ *
+ * Retransmit the packet in flight once the session timeout passed
+ * without an ACK.
+ *
+ * return   0 on success
+ *        < 0 if the BMC did not ACK it after all retries
+ */
+static int
+sol_resend_data(struct ipmi_intf * intf)
+{
+	struct sol_tx * tx = &_sol_tx;
+
+	if (!tx->inflight ||
+	    ipmi_intf_msec() - tx->sent < ipmi_intf_session_timeout_ms(intf))
+		return 0;
+
+	if (tx->tries >= intf->session->retry) {
+		lprintf(LOG_ERR, "Error sending SOL data: FAIL");
+		return -1;
 	}
 
-	return retval;
+	/* A retransmission keeps its sequence number, so the BMC can
+	 * tell it from new data */
+	intf->session->sol_data.sequence_number = tx->seq;
+	sol_xmit(intf);
+	return 0;
+}
+
+
+
+/*
+ * sol_handle_ack
+ *
+ * Retire the packet in flight if rsp ACKs it.  What a partial ACK did
+ * not accept goes out again, ahead of anything typed since.
+ */
+static void
+sol_handle_ack(struct ipmi_intf * intf, struct ipmi_rs * rsp)
+{
+	struct sol_tx * tx = &_sol_tx;
+	int count, accepted;
+
+	if (!tx->inflight                                                 ||
+	    (rsp->session.authtype    != IPMI_SESSION_AUTHTYPE_RMCP_PLUS) ||
+	    (rsp->session.payloadtype != IPMI_PAYLOAD_TYPE_SOL)           ||
+	    (rsp->payload.sol_packet.acked_packet_number != tx->seq))
+		return;
+
+	tx->inflight = 0;
+
+	count    = tx->payload.payload.sol_packet.character_count;
+	accepted = rsp->payload.sol_packet.accepted_character_count;
+
+	/* Nacks are not honored, the data is dropped as before */
+	if (rsp->payload.sol_packet.transfer_unavailable ||
+	    rsp->payload.sol_packet.is_nack              ||
+	    accepted >= count)
+		return;
+
+	if (ipmi_oem_active(intf, "intelplus") && accepted == 0)
+		return;
+
+	memmove(tx->data + count - accepted, tx->data, tx->len);
+	memcpy(tx->data, tx->payload.payload.sol_packet.data + accepted,
+	       count - accepted);
+	tx->len += count - accepted;
 }
 
+
+
 static int
 ipmi_sol_keepalive_using_sol(struct ipmi_intf * intf)
 {
 	struct ipmi_v2_payload v2_payload;
-	struct timeval end;
 
 	if (_disable_keepalive)
 		return 0;
 
-	gettimeofday(&end, 0);
-
-	if (end.tv_sec - _start_keepalive.tv_sec > SOL_KEEPALIVE_TIMEOUT) {
+	if (ipmi_intf_msec() - _last_keepalive > SOL_KEEPALIVE_TIMEOUT * 1000) {
 		memset(&v2_payload, 0, sizeof(v2_payload));
 		v2_payload.payload.sol_packet.character_count = 0;
 		if (intf->send_sol(intf, &v2_payload) == NULL)
 			return -1;
 		/* good return, reset start time */
-		gettimeofday(&_start_keepalive, 0);
+		_last_keepalive = ipmi_intf_msec();
 	}
 	return 0;
 }
@@ -1498,30 +1637,52 @@ ipmi_sol_keepalive_using_sol(struct ipmi_intf * intf)
 static int
 ipmi_sol_keepalive_using_getdeviceid(struct ipmi_intf * intf)
 {
-	struct timeval  end;
-
 	if (_disable_keepalive)
 		return 0;
 
-	gettimeofday(&end, 0);
-
-	if (end.tv_sec - _start_keepalive.tv_sec > SOL_KEEPALIVE_TIMEOUT) {
+	if (ipmi_intf_msec() - _last_keepalive > SOL_KEEPALIVE_TIMEOUT * 1000) {
 		if (intf->keepalive(intf) != 0)
          		return -1;
 		/* good return, reset start time */
-		gettimeofday(&_start_keepalive, 0);
+		_last_keepalive = ipmi_intf_msec();
    	}
 	return 0;
 }
 
 
 
+/*
+ * sol_readable
+ *
+ * Check without blocking whether fd has data
+ */
+static int
+sol_readable(int fd)
+{
+	fd_set read_fds;
+	struct timeval tv = { 0, 0 };
+
+	FD_ZERO(&read_fds);
+	FD_SET(fd, &read_fds);
+
+	return select(fd + 1, &read_fds, NULL, NULL, &tv) > 0;
+}
+
+
+
 /*
  * ipmi_sol_red_pill
+ *
+ * The SOL event loop.  It sleeps in select() until the keyboard or the
+ * BMC has something, a packet in flight is due for retransmission or
+ * the next keepalive is due.  Packets that arrived together are
+ * handled in one go and their data written with a single write().
  */
 static int
 ipmi_sol_red_pill(struct ipmi_intf * intf, int instance)
 {
+	struct ipmi_session * s  = intf->session;
+	struct sol_tx * tx       = &_sol_tx;
 	char   * buffer;
 	int    numRead;
 	int    bShouldExit       = 0;
@@ -1532,29 +1693,39 @@ ipmi_sol_red_pill(struct ipmi_intf * intf, int instance)
 	int    buffer_size = intf->session->sol_data.max_inbound_payload_size;
 	int    keepAliveRet = 0;
 	int    retrySol = 0;
+	int    use_keepalive = !ipmi_oem_active(intf, "i82571spt");
+	int    room, wait, n;
+	uint32_t elapsed;
 
 	/* Subtract SOL header from max_inbound_payload_size */
 	if (buffer_size > 4)
 		buffer_size -= 4;
 
-	buffer = (char*)malloc(buffer_size);
+	/* Partial ACKs count accepted characters in a single byte */
+	if (buffer_size > 255)
+		buffer_size = 255;
+	if (buffer_size < 1)
+		buffer_size = 1;
+
+	buffer = (char*)malloc(sizeof(tx->data));
 	if (buffer == NULL) {
 		lprintf(LOG_ERR, "ipmitool: malloc failure"); 
 		return -1;
 	}
 
+	memset(tx, 0, sizeof(struct sol_tx));
+	tx->size = buffer_size;
+	_sol_out_len = 0;
+
 	/* Initialize keepalive start time */
-	gettimeofday(&_start_keepalive, 0);
+	_last_keepalive = ipmi_intf_msec();
 
 	enter_raw_mode();
 
 	while (! bShouldExit)
 	{
-		FD_ZERO(&read_fds);
-		FD_SET(0, &read_fds);
-		FD_SET(intf->fd, &read_fds);
-
-		if (!ipmi_oem_active(intf,"i82571spt"))
+		/* No keepalive while data is in flight, its ACK is proof enough */
+		if (use_keepalive && !tx->inflight)
 		{
 			/* Send periodic keepalive packet */
 			if(_use_sol_for_keepalive == 0)
@@ -1592,60 +1763,92 @@ ipmi_sol_red_pill(struct ipmi_intf * intf, int instance)
 				/* if the keep Alive is successful reset retries to zero */
 				retrySol = 0;
 			}
-		} /* !oem="i82571spt" */
-		/* Wait up to half a second */
-		tv.tv_sec =  0;
-		tv.tv_usec = 500000;
 
-		retval = select(intf->fd + 1, &read_fds, NULL, NULL, &tv);
+			/* the keepalive may have brought console data along */
+			flush_output();
+		}
 
-		if (retval)
+		/* Sleep until the next timer, if any, is due */
+		wait = -1;
+		if (use_keepalive && !_disable_keepalive && !tx->inflight) {
+			elapsed = ipmi_intf_msec() - _last_keepalive;
+			wait = (elapsed > SOL_KEEPALIVE_TIMEOUT * 1000) ? 0 :
+				SOL_KEEPALIVE_TIMEOUT * 1000 + 1 - elapsed;
+		}
+		if (tx->inflight) {
+			elapsed = ipmi_intf_msec() - tx->sent;
+			n = ipmi_intf_session_timeout_ms(intf);
+			n = (elapsed >= n) ? 0 : n - elapsed;
+			if (wait < 0 || n < wait)
+				wait = n;
+		}
+		if (s->rxq.count > 0)
+			wait = 0;	/* read ahead by the transport */
+
+		FD_ZERO(&read_fds);
+		FD_SET(intf->fd, &read_fds);
+
+		/* Leave room to put back what a partial ACK did not accept
+		 * and for an escape character held back from the last read */
+		room = sizeof(tx->data) - tx->size - tx->len - 1;
+		if (room > 0)
+			FD_SET(0, &read_fds);
+
+		tv.tv_sec  = wait / 1000;
+		tv.tv_usec = (wait % 1000) * 1000;
+
+		retval = select(intf->fd + 1, &read_fds, NULL, NULL,
+				(wait < 0) ? NULL : &tv);
+
+		if (retval == -1)
 		{
-			if (retval == -1)
-			{
-				/* ERROR */
-				perror("select");
-				return -1;
-			}
+			if (errno == EINTR)
+				continue;
 
+			/* ERROR */
+			perror("select");
+			leave_raw_mode();
+			free(buffer);
+			return -1;
+		}
 
-			/*
-			 * Process input from the user
-			 */
-			if (FD_ISSET(0, &read_fds))
-	 		{
-				memset(buffer, 0, buffer_size);
-				numRead = read(fileno(stdin),
-							   buffer,
-							   buffer_size);
-
-				if (numRead > 0)
-				{
-					int rc = processSolUserInput(intf, (uint8_t *)buffer, numRead);
-
-					if (rc)
-					{
-						if (rc < 0)
-							bShouldExit = bBmcClosedSession = 1;
-						else
-							bShouldExit = 1;
-					}
-				}
-				else
-				{
+		if (retval == 0)
+			FD_ZERO(&read_fds);
+
+
+		/*
+		 * Process input from the user
+		 */
+		if (FD_ISSET(0, &read_fds))
+		{
+			numRead = read(fileno(stdin), buffer, room);
+
+			if (numRead > 0)
+			{
+				if (processSolUserInput(intf, (uint8_t *)buffer, numRead))
 					bShouldExit = 1;
-				}
 			}
+			else
+			{
+				bShouldExit = 1;
+			}
+		}
 
 
-			/*
-			 * Process input from the BMC
-			 */
-			else if (FD_ISSET(intf->fd, &read_fds))
+		/*
+		 * Process input from the BMC, everything that is there
+		 * already
+		 */
+		if (FD_ISSET(intf->fd, &read_fds) || s->rxq.count > 0)
+		{
+			for (n = 0; n < SOL_RECV_BURST; n++)
 			{
-				struct ipmi_rs * rs =intf->recv_sol(intf);
-				if ( rs)
+				struct ipmi_rs * rs = intf->recv_sol(intf);
+				if (rs)
 				{
+					/* the BMC is alive, no need to ask */
+					_last_keepalive = ipmi_intf_msec();
+					sol_handle_ack(intf, rs);
 					output(rs);
 				}
 				/*
@@ -1653,20 +1856,23 @@ ipmi_sol_red_pill(struct ipmi_intf * intf, int instance)
 				 * Just fall through, the keepalive logic will determine if
 				 * the BMC has dropped the session.
 				 */
- 			}
-
-
-			/*
-			 * ERROR in select
-			 */
- 			else
-			{
-				lprintf(LOG_ERR, "Error: Select returned with nothing to read");
-				bShouldExit = 1;
+				if (s->rxq.count == 0 && !sol_readable(intf->fd))
+					break;
 			}
 		}
+
+		if (!bShouldExit)
+		{
+			if (sol_resend_data(intf) < 0)
+				bShouldExit = bBmcClosedSession = 1;
+			else
+				sol_send_data(intf);
+		}
+
+		flush_output();
 	}
 
+	free(buffer);
 	leave_raw_mode();
 
 	if (keepAliveRet != 0)
@@ -1688,15 +1894,17 @@ ipmi_sol_red_pill(struct ipmi_intf * intf, int instance)
 	return 0;
 }
 
-
-
-
 /*
- * ipmi_sol_activate
+ * ipmi_sol_activate_payload
+ *
+ * Send Activate Payload for SOL and set the session up for SOL
+ * traffic with the payload sizes and port the BMC returns.
+ *
+ * returns the completion code, or -1 if there was no response or
+ * the response cannot be used
  */
-static int
-ipmi_sol_activate(struct ipmi_intf * intf, int looptest, int interval,
-		int instance)
+int
+ipmi_sol_activate_payload(struct ipmi_intf * intf, int instance)
 {
 	struct ipmi_rs * rsp;
 	struct ipmi_rq   req;
@@ -1705,31 +1913,6 @@ ipmi_sol_activate(struct ipmi_intf * intf, int looptest, int interval,
 	uint8_t    bSolEncryption     = 1;
 	uint8_t    bSolAuthentication = 1;
 
-	/*
-	 * This command is only available over RMCP+ (the lanplus
-	 * interface).
-	 */
-	if (strncmp(intf->name, "lanplus", 7) != 0)
-	{
-		lprintf(LOG_ERR, "Error: This command is only available over the "
-			   "lanplus interface");
-		return -1;
-	}
-
-	if ((instance <= 0) || (instance > 15)) {
-		lprintf(LOG_ERR, "Error: Instance must range from 1 to 15");
-		return -1;
-	}
-
-
-	/*
-	 * Setup a callback so that the lanplus processing knows what
-	 * to do with packets that come unexpectedly (while waiting for
-	 * an ACK, perhaps.
-	 */
-	intf->session->sol_data.sol_input_handler = output;
-
-
 	memset(&req, 0, sizeof(req));
 	req.msg.netfn    = IPMI_NETFN_APP;
 	req.msg.cmd      = IPMI_ACTIVATE_PAYLOAD;
@@ -1770,42 +1953,18 @@ ipmi_sol_activate(struct ipmi_intf * intf, int looptest, int interval,
 
 	rsp = intf->sendrecv(intf, &req);
 
-	if (NULL != rsp) {
-		switch (rsp->ccode) {
-			case 0x00: 
-				if (rsp->data_len == 12) {
-					break;
-				} else {
-					lprintf(LOG_ERR, "Error: Unexpected data length (%d) received "
-						   "in payload activation response",
-						   rsp->data_len);
-					return -1;
-				}
-				break;
-			case 0x80:
-				lprintf(LOG_ERR, "Info: SOL payload already active on another session");
-				return -1;
-			case 0x81:
-				lprintf(LOG_ERR, "Info: SOL payload disabled");
-				return -1;
-			case 0x82:
-				lprintf(LOG_ERR, "Info: SOL payload activation limit reached");
-				return -1;
-			case 0x83:
-				lprintf(LOG_ERR, "Info: cannot activate SOL payload with encryption");
-				return -1;
-			case 0x84:
-				lprintf(LOG_ERR, "Info: cannot activate SOL payload without encryption");
-				return -1;
-			default:
-				lprintf(LOG_ERR, "Error activating SOL payload: %s",
-					val2str(rsp->ccode, completion_code_vals));
-				return -1;
-		}
-	} else {
+	if (NULL == rsp) {
 		lprintf(LOG_ERR, "Error: No response activating SOL payload");
 		return -1;
 	}
+	if (rsp->ccode != 0)
+		return rsp->ccode;
+	if (rsp->data_len != 12) {
+		lprintf(LOG_ERR, "Error: Unexpected data length (%d) received "
+			   "in payload activation response",
+			   rsp->data_len);
+		return -1;
+	}
 
 
 	memcpy(&ap_rsp, rsp->data, sizeof(struct activate_payload_rsp));
@@ -1841,6 +2000,72 @@ ipmi_sol_activate(struct ipmi_intf * intf, int looptest, int interval,
 		}
 	}
 
+	return 0;
+}
+
+
+
+/*
+ * ipmi_sol_activate
+ */
+static int
+ipmi_sol_activate(struct ipmi_intf * intf, int looptest, int interval,
+		int instance)
+{
+	int ccode;
+
+	/*
+	 * This command is only available over RMCP+ (the lanplus
+	 * interface).
+	 */
+	if (strncmp(intf->name, "lanplus", 7) != 0)
+	{
+		lprintf(LOG_ERR, "Error: This command is only available over the "
+			   "lanplus interface");
+		return -1;
+	}
+
+	if ((instance <= 0) || (instance > 15)) {
+		lprintf(LOG_ERR, "Error: Instance must range from 1 to 15");
+		return -1;
+	}
+
+
+	/*
+	 * Setup a callback so that the lanplus processing knows what
+	 * to do with packets that come unexpectedly (while waiting for
+	 * an ACK, perhaps.
+	 */
+	intf->session->sol_data.sol_input_handler = output;
+
+
+	ccode = ipmi_sol_activate_payload(intf, instance);
+	switch (ccode) {
+		case 0x00:
+			break;
+		case 0x80:
+			lprintf(LOG_ERR, "Info: SOL payload already active on another session");
+			return -1;
+		case 0x81:
+			lprintf(LOG_ERR, "Info: SOL payload disabled");
+			return -1;
+		case 0x82:
+			lprintf(LOG_ERR, "Info: SOL payload activation limit reached");
+			return -1;
+		case 0x83:
+			lprintf(LOG_ERR, "Info: cannot activate SOL payload with encryption");
+			return -1;
+		case 0x84:
+			lprintf(LOG_ERR, "Info: cannot activate SOL payload without encryption");
+			return -1;
+		case -1:
+			return -1;
+		default:
+			lprintf(LOG_ERR, "Error activating SOL payload: %s",
+				val2str(ccode, completion_code_vals));
+			return -1;
+	}
+
 	printf("[SOL Session operational.  Use %c? for help]\n",
 	       intf->session->sol_escape_char);
 
@@ -0,0 +1,485 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_stats.h>
+
+extern int csv_output;
+
+/* ipmi_stats_usec  -  microsecond clock for latency measurements
+ *
+ * Only differences between two values are meaningful.  The clock is
+ * monotonic, so steps of the wall clock don't show up as latency.
+ */
+uint64_t
+ipmi_stats_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* stats_bucket  -  histogram bucket for a latency
+ *
+ * Values below 4us get a bucket each, above that every power of two
+ * is split into four buckets on the two bits below the leading one.
+ */
+static int
+stats_bucket(uint32_t usec)
+{
+	int msb = 2;
+
+	if (usec < 4)
+		return usec;
+
+	while ((usec >> (msb + 1)) != 0)
+		msb++;
+
+	return msb * 4 + ((usec >> (msb - 2)) & 3);
+}
+
+/* stats_bucket_top  -  largest latency that falls into a bucket */
+static uint64_t
+stats_bucket_top(int idx)
+{
+	int msb = idx / 4;
+
+	if (idx < 4)
+		return idx;
+
+	return ((uint64_t)(5 + idx % 4) << (msb - 2)) - 1;
+}
+
+static void
+stats_hist_add(struct ipmi_stats_hist * h, uint64_t usec)
+{
+	uint32_t v = (usec > UINT32_MAX) ? UINT32_MAX : (uint32_t)usec;
+
+	h->count++;
+	h->total += v;
+	if (v > h->max)
+		h->max = v;
+	h->bucket[stats_bucket(v)]++;
+}
+
+/* stats_percentile  -  latency below which @pct percent of samples fall
+ *
+ * The result is the upper edge of the bucket holding the sample of
+ * that rank, but never more than the largest latency seen.
+ */
+static uint32_t
+stats_percentile(struct ipmi_stats_hist * h, int pct)
+{
+	uint64_t rank, seen = 0;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	rank = ((uint64_t)h->count * pct + 99) / 100;
+	for (i = 0; i < IPMI_STATS_BUCKETS; i++) {
+		seen += h->bucket[i];
+		if (seen >= rank)
+			return (uint32_t)__min(stats_bucket_top(i), (uint64_t)h->max);
+	}
+
+	return h->max;
+}
+
+/* stats_cmd  -  find or add the counters for one netfn/cmd pair
+ *
+ * returns NULL on memory allocation failure
+ */
+static struct ipmi_stats_cmd *
+stats_cmd(struct ipmi_stats * st, uint8_t netfn, uint8_t cmd)
+{
+	struct ipmi_stats_cmd * tmp;
+	int i;
+
+	for (i = 0; i < st->cmd_count; i++) {
+		if (st->cmd[i].netfn == netfn && st->cmd[i].cmd == cmd)
+			return &st->cmd[i];
+	}
+
+	if (st->cmd_count == st->cmd_size) {
+		tmp = realloc(st->cmd, (st->cmd_size + 16) * sizeof(*tmp));
+		if (tmp == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return NULL;
+		}
+		st->cmd = tmp;
+		st->cmd_size += 16;
+	}
+
+	tmp = &st->cmd[st->cmd_count++];
+	memset(tmp, 0, sizeof(*tmp));
+	tmp->netfn = netfn;
+	tmp->cmd = cmd;
+	return tmp;
+}
+
+/* ipmi_stats_record  -  account for one completed request
+ *
+ * Interfaces that answer requests outside of intf->sendrecv(), such
+ * as a poll hook, call this directly.  Latency is only
+ * recorded for requests that got a response.
+ *
+ * @intf:	ipmi interface
+ * @req:	the request
+ * @rsp:	its response, NULL if none arrived
+ * @usec:	time from first transmission to the response
+ */
+void
+ipmi_stats_record(struct ipmi_intf * intf, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, uint64_t usec)
+{
+	struct ipmi_stats * st = intf->stats;
+	struct ipmi_stats_cmd * c;
+
+	if (st == NULL)
+		return;
+
+	c = stats_cmd(st, req->msg.netfn, req->msg.cmd);
+	if (rsp == NULL) {
+		st->noresp++;
+		if (c != NULL)
+			c->noresp++;
+		return;
+	}
+
+	if (rsp->ccode != 0) {
+		st->errors++;
+		if (c != NULL)
+			c->errors++;
+	}
+
+	stats_hist_add(&st->lat, usec);
+	if (c != NULL)
+		stats_hist_add(&c->lat, usec);
+}
+
+static int
+ipmi_stats_open(struct ipmi_intf * intf)
+{
+	struct ipmi_stats * st = intf->stats;
+	uint64_t start = ipmi_stats_usec();
+	int rc;
+
+	rc = st->open(intf);
+	st->setups++;
+	st->setup_us += ipmi_stats_usec() - start;
+
+	return rc;
+}
+
+static struct ipmi_rs *
+ipmi_stats_sendrecv(struct ipmi_intf * intf, struct ipmi_rq * req)
+{
+	struct ipmi_stats * st = intf->stats;
+	struct ipmi_rs * rsp;
+	uint64_t start, setup;
+
+	start = ipmi_stats_usec();
+	setup = st->setup_us;
+
+	rsp = st->sendrecv(intf, req);
+
+	/* a session opened on demand is not part of the request latency */
+	ipmi_stats_record(intf, req, rsp,
+			ipmi_stats_usec() - start - (st->setup_us - setup));
+
+	return rsp;
+}
+
+/* ipmi_stats_enable  -  start collecting statistics on an interface
+ *
+ * The interface open and sendrecv methods are wrapped to time session
+ * setup and every request, the plugins add their transport counters
+ * through IPMI_STATS_ADD().  Calling this again is harmless.
+ *
+ * @intf:	ipmi interface
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_stats_enable(struct ipmi_intf * intf)
+{
+	struct ipmi_stats * st;
+
+	if (intf->stats != NULL)
+		return 0;
+
+	st = calloc(1, sizeof(*st));
+	if (st == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	st->start = ipmi_stats_usec();
+
+	st->open = intf->open;
+	if (intf->open != NULL)
+		intf->open = ipmi_stats_open;
+	st->sendrecv = intf->sendrecv;
+	if (intf->sendrecv != NULL)
+		intf->sendrecv = ipmi_stats_sendrecv;
+
+	intf->stats = st;
+	return 0;
+}
+
+/* ipmi_stats_reset  -  zero all counters, keep collecting */
+void
+ipmi_stats_reset(struct ipmi_intf * intf)
+{
+	struct ipmi_stats * st = intf->stats;
+	int (*open)(struct ipmi_intf * intf);
+	struct ipmi_rs *(*sendrecv)(struct ipmi_intf * intf, struct ipmi_rq * req);
+
+	if (st == NULL)
+		return;
+
+	open = st->open;
+	sendrecv = st->sendrecv;
+	free(st->cmd);
+
+	memset(st, 0, sizeof(*st));
+	st->start = ipmi_stats_usec();
+	st->open = open;
+	st->sendrecv = sendrecv;
+}
+
+/* ipmi_stats_free  -  stop collecting and release the statistics */
+void
+ipmi_stats_free(struct ipmi_intf * intf)
+{
+	struct ipmi_stats * st = intf->stats;
+
+	if (st == NULL)
+		return;
+
+	intf->open = st->open;
+	intf->sendrecv = st->sendrecv;
+	intf->stats = NULL;
+	free(st->cmd);
+	free(st);
+}
+
+/* slowest commands, by time spent waiting for them, first */
+static int
+stats_cmd_compare(const void * a, const void * b)
+{
+	const struct ipmi_stats_cmd * ca = a;
+	const struct ipmi_stats_cmd * cb = b;
+
+	if (ca->lat.total != cb->lat.total)
+		return (ca->lat.total < cb->lat.total) ? 1 : -1;
+	if (ca->netfn != cb->netfn)
+		return ca->netfn - cb->netfn;
+	return ca->cmd - cb->cmd;
+}
+
+static void
+stats_print_json_hist(struct ipmi_stats_hist * h)
+{
+	printf("{\"count\":%u,\"total_us\":%llu,\"p50_us\":%u,"
+		"\"p99_us\":%u,\"max_us\":%u}",
+		h->count, (unsigned long long)h->total,
+		stats_percentile(h, 50), stats_percentile(h, 99), h->max);
+}
+
+/*
+ * The whole report is a single line, so that it keeps its host prefix
+ * when several hosts are queried at once.
+ */
+static void
+stats_print_json(struct ipmi_stats * st, uint64_t elapsed)
+{
+	int i;
+
+	printf("{\"elapsed_us\":%llu,", (unsigned long long)elapsed);
+	printf("\"setup\":{\"count\":%u,\"total_us\":%llu},",
+		st->setups, (unsigned long long)st->setup_us);
+	printf("\"requests\":%u,\"errors\":%u,\"noresp\":%u,",
+		st->lat.count + st->noresp, st->errors, st->noresp);
+	printf("\"retransmits\":%u,\"timeouts\":%u,",
+		st->retransmits, st->timeouts);
+	printf("\"tx\":{\"packets\":%u,\"bytes\":%llu},",
+		st->tx_packets, (unsigned long long)st->tx_bytes);
+	printf("\"rx\":{\"packets\":%u,\"bytes\":%llu},",
+		st->rx_packets, (unsigned long long)st->rx_bytes);
+	printf("\"latency\":");
+	stats_print_json_hist(&st->lat);
+	printf(",\"commands\":[");
+	for (i = 0; i < st->cmd_count; i++) {
+		printf("%s{\"netfn\":%u,\"cmd\":%u,\"errors\":%u,\"noresp\":%u,"
+			"\"latency\":", i ? "," : "",
+			st->cmd[i].netfn, st->cmd[i].cmd,
+			st->cmd[i].errors, st->cmd[i].noresp);
+		stats_print_json_hist(&st->cmd[i].lat);
+		printf("}");
+	}
+	printf("]}\n");
+}
+
+static void
+stats_print_text(struct ipmi_stats * st, uint64_t elapsed)
+{
+	struct ipmi_stats_cmd * c;
+	int i;
+
+	printf("Elapsed time          : %.3f s\n", elapsed / 1000000.0);
+	printf("Session setup         : %u in %.3f ms\n",
+		st->setups, st->setup_us / 1000.0);
+	printf("Requests              : %u\n", st->lat.count + st->noresp);
+	printf("  Error responses     : %u\n", st->errors);
+	printf("  No response         : %u\n", st->noresp);
+	printf("Retransmits           : %u\n", st->retransmits);
+	printf("Timeouts              : %u\n", st->timeouts);
+	printf("Sent                  : %u packets, %llu bytes\n",
+		st->tx_packets, (unsigned long long)st->tx_bytes);
+	printf("Received              : %u packets, %llu bytes\n",
+		st->rx_packets, (unsigned long long)st->rx_bytes);
+	printf("Latency p50/p99/max   : %.3f / %.3f / %.3f ms\n",
+		stats_percentile(&st->lat, 50) / 1000.0,
+		stats_percentile(&st->lat, 99) / 1000.0,
+		st->lat.max / 1000.0);
+
+	if (st->cmd_count == 0)
+		return;
+
+	if (csv_output)
+		printf("\nnetfn,cmd,count,errors,noresp,total_us,p50_us,p99_us,max_us\n");
+	else
+		printf("\n%-6s %-5s %7s %7s %7s %10s %9s %9s %9s\n",
+			"NetFn", "Cmd", "Count", "Errors", "NoResp",
+			"Total ms", "p50 ms", "p99 ms", "max ms");
+
+	for (i = 0; i < st->cmd_count; i++) {
+		c = &st->cmd[i];
+		if (csv_output) {
+			printf("0x%02x,0x%02x,%u,%u,%u,%llu,%u,%u,%u\n",
+				c->netfn, c->cmd, c->lat.count + c->noresp,
+				c->errors, c->noresp,
+				(unsigned long long)c->lat.total,
+				stats_percentile(&c->lat, 50),
+				stats_percentile(&c->lat, 99), c->lat.max);
+			continue;
+		}
+		printf("0x%02x   0x%02x  %7u %7u %7u %10.3f %9.3f %9.3f %9.3f\n",
+			c->netfn, c->cmd, c->lat.count + c->noresp,
+			c->errors, c->noresp, c->lat.total / 1000.0,
+			stats_percentile(&c->lat, 50) / 1000.0,
+			stats_percentile(&c->lat, 99) / 1000.0,
+			c->lat.max / 1000.0);
+	}
+}
+
+/* ipmi_stats_print  -  print the statistics collected on an interface
+ *
+ * @intf:	ipmi interface
+ * @format:	IPMI_STATS_TEXT or IPMI_STATS_JSON
+ */
+void
+ipmi_stats_print(struct ipmi_intf * intf, int format)
+{
+	struct ipmi_stats * st = intf->stats;
+
+	if (st == NULL)
+		return;
+
+	if (st->cmd_count > 1)
+		qsort(st->cmd, st->cmd_count, sizeof(*st->cmd), stats_cmd_compare);
+
+	if (format == IPMI_STATS_JSON)
+		stats_print_json(st, ipmi_stats_usec() - st->start);
+	else
+		stats_print_text(st, ipmi_stats_usec() - st->start);
+
+	fflush(stdout);
+}
+
+static void
+ipmi_stats_usage(void)
+{
+	lprintf(LOG_NOTICE, "usage: stats [text|json|reset]");
+	lprintf(LOG_NOTICE, "");
+	lprintf(LOG_NOTICE, "   text    Print request latency and transport counters (default)");
+	lprintf(LOG_NOTICE, "   json    Print the same as a single line of JSON");
+	lprintf(LOG_NOTICE, "   reset   Clear all counters");
+	lprintf(LOG_NOTICE, "");
+	lprintf(LOG_NOTICE, "Collection starts with the first stats command, or at");
+	lprintf(LOG_NOTICE, "startup when the -Z option is given.");
+}
+
+int
+ipmi_stats_main(struct ipmi_intf * intf, int argc, char ** argv)
+{
+	int format = IPMI_STATS_TEXT;
+
+	if (argc > 0 && strncmp(argv[0], "help", 4) == 0) {
+		ipmi_stats_usage();
+		return 0;
+	}
+
+	if (intf->stats == NULL) {
+		if (ipmi_stats_enable(intf) < 0)
+			return -1;
+		printf("Statistics collection enabled\n");
+		return 0;
+	}
+
+	if (argc == 0 || strncmp(argv[0], "text", 4) == 0) {
+		format = IPMI_STATS_TEXT;
+	} else if (strncmp(argv[0], "json", 4) == 0) {
+		format = IPMI_STATS_JSON;
+	} else if (strncmp(argv[0], "reset", 5) == 0) {
+		ipmi_stats_reset(intf);
+		return 0;
+	} else {
+		lprintf(LOG_ERR, "Invalid stats command: %s", argv[0]);
+		ipmi_stats_usage();
+		return -1;
+	}
+
+	ipmi_stats_print(intf, format);
+	return 0;
+}
@@ -54,7 +54,7 @@ static void log_reinit(void)
 
 void lprintf(int level, const char * format, ...)
 {
-	static char logmsg[LOG_MSG_LENGTH];
+	char logmsg[LOG_MSG_LENGTH];
 	va_list vptr;
 
 	if (!logpriv)
@@ -76,7 +76,7 @@ void lprintf(int level, const char * format, ...)
 
 void lperror(int level, const char * format, ...)
 {
-	static char logmsg[LOG_MSG_LENGTH];
+	char logmsg[LOG_MSG_LENGTH];
 	va_list vptr;
 
 	if (!logpriv)
@@ -0,0 +1,645 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#if defined(HAVE_CONFIG_H)
+# include <config.h>
+#endif
+
+#ifdef HAVE_PATHS_H
+# include <paths.h>
+#endif
+
+#ifndef _PATH_VARRUN
+# define _PATH_VARRUN "/var/run/"
+#endif
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_main.h>
+#include <ipmitool/ipmi_proxy.h>
+
+#define DEFAULT_PIDFILE		_PATH_VARRUN "ipmiproxyd"
+#define PROXY_CLIENTS		64	/* connected clients per BMC */
+#define PROXY_BATCH		32	/* requests handed to the interface at once */
+#define PROXY_KEEPALIVE		30	/* seconds of silence before a keepalive */
+#define PROXY_REOPEN_MAX	60	/* seconds, longest wait between reopens */
+#define PROXY_TIMEOUT		60	/* seconds, see the proxy interface */
+#define PROXY_FRAME_MAX		(sizeof(struct ipmi_proxy_rq) + IPMI_BUF_SIZE)
+
+/* global variables */
+int verbose = 0;
+int csv_output = 0;
+
+struct proxy_client {
+	int fd;
+	uint32_t gen;			/* bumped whenever the slot is freed */
+	size_t len;
+	uint8_t buf[2 * PROXY_FRAME_MAX];
+};
+
+struct proxy_rq {
+	int client;
+	uint32_t gen;
+	struct ipmi_proxy_rq hdr;
+	uint8_t data[IPMI_BUF_SIZE];
+};
+
+static struct proxy_client client[PROXY_CLIENTS];
+static struct proxy_rq queue[PROXY_BATCH];
+static int queued = 0;
+static int answered = 0;
+
+static char sockpath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static char pidfile[64];
+static volatile sig_atomic_t proxy_stop = 0;
+
+static void
+ipmiproxyd_usage(void)
+{
+	lprintf(LOG_NOTICE, "Options:");
+	lprintf(LOG_NOTICE, "\tdaemon        Become a daemon [default]");
+	lprintf(LOG_NOTICE, "\tnodaemon      Do NOT become a daemon");
+	lprintf(LOG_NOTICE, "\tdir=path      Directory for the client sockets [default=%s]",
+		IPMI_PROXY_DIR);
+	lprintf(LOG_NOTICE, "\tmode=octal    Permissions of the client sockets [default=0600]");
+	lprintf(LOG_NOTICE, "\tpidfile=file  PID file [default=%s.<host>.pid]",
+		DEFAULT_PIDFILE);
+}
+
+static void
+proxy_catch_signal(int signal)
+{
+	proxy_stop = 1;
+}
+
+/* proxy_listen  -  create the listening socket for one BMC
+ *
+ * A stale socket left behind by an earlier instance is removed, any
+ * other file in the way is not.
+ *
+ * returns socket descriptor, -1 on error
+ */
+static int
+proxy_listen(const char * path, mode_t mode)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			lprintf(LOG_ERR, "%s exists and is not a socket", path);
+			return -1;
+		}
+		(void)unlink(path);
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		lperror(LOG_ERR, "socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		lperror(LOG_ERR, "Unable to bind to %s", path);
+		close(fd);
+		return -1;
+	}
+	if (chmod(path, mode) < 0 || listen(fd, SOMAXCONN) < 0 ||
+	    fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+		lperror(LOG_ERR, "Unable to listen on %s", path);
+		close(fd);
+		(void)unlink(path);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void
+proxy_drop(int c)
+{
+	close(client[c].fd);
+	client[c].fd = -1;
+	client[c].len = 0;
+	client[c].gen++;
+}
+
+/* proxy_accept  -  take a new client and greet it */
+static void
+proxy_accept(struct ipmi_intf * intf, int lfd)
+{
+	struct ipmi_proxy_hello hello;
+	int fd, c;
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	for (c = 0; c < PROXY_CLIENTS; c++) {
+		if (client[c].fd < 0)
+			break;
+	}
+	if (c == PROXY_CLIENTS) {
+		lprintf(LOG_WARN, "Too many clients, connection refused");
+		close(fd);
+		return;
+	}
+
+	memset(&hello, 0, sizeof(hello));
+	hello.version = IPMI_PROXY_VERSION;
+	hello.max_request_data_size = intf->max_request_data_size;
+	hello.max_response_data_size = intf->max_response_data_size;
+
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 ||
+	    send(fd, &hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello)) {
+		close(fd);
+		return;
+	}
+
+	client[c].fd = fd;
+	client[c].len = 0;
+	lprintf(LOG_DEBUG, "Client %d connected", c);
+}
+
+/* proxy_read  -  pull whatever a client has sent into its buffer */
+static void
+proxy_read(int c)
+{
+	ssize_t ret;
+
+	if (client[c].len == sizeof(client[c].buf))
+		return;
+
+	ret = recv(client[c].fd, client[c].buf + client[c].len,
+		   sizeof(client[c].buf) - client[c].len, 0);
+	if (ret > 0) {
+		client[c].len += ret;
+	} else if (ret == 0 || (errno != EAGAIN && errno != EINTR)) {
+		lprintf(LOG_DEBUG, "Client %d disconnected", c);
+		proxy_drop(c);
+	}
+}
+
+/* proxy_parse  -  move one complete request from a client to the queue
+ *
+ * returns 1 if a request was queued, 0 otherwise
+ */
+static int
+proxy_parse(int c)
+{
+	struct ipmi_proxy_rq hdr;
+	struct proxy_rq * rq;
+	size_t len;
+
+	if (client[c].fd < 0 || client[c].len < sizeof(hdr))
+		return 0;
+
+	memcpy(&hdr, client[c].buf, sizeof(hdr));
+	if (hdr.data_len > IPMI_BUF_SIZE) {
+		lprintf(LOG_WARN, "Client %d sent a malformed request", c);
+		proxy_drop(c);
+		return 0;
+	}
+
+	len = sizeof(hdr) + hdr.data_len;
+	if (client[c].len < len)
+		return 0;
+
+	rq = &queue[queued++];
+	rq->client = c;
+	rq->gen = client[c].gen;
+	rq->hdr = hdr;
+	memcpy(rq->data, client[c].buf + sizeof(hdr), hdr.data_len);
+
+	client[c].len -= len;
+	memmove(client[c].buf, client[c].buf + len, client[c].len);
+
+	return 1;
+}
+
+/* proxy_done  -  send a response back to the client that asked for it
+ *
+ * A client that cannot take the whole response right away is not
+ * reading its socket and is dropped.
+ */
+static void
+proxy_done(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+	   struct ipmi_rs * rsp, void * ctx)
+{
+	struct proxy_rq * rq = (struct proxy_rq *)ctx + idx;
+	struct ipmi_proxy_rs hdr;
+	uint8_t frame[sizeof(hdr) + IPMI_BUF_SIZE];
+	size_t len;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.id = rq->hdr.id;
+	if (rsp == NULL) {
+		hdr.status = IPMI_PROXY_NORESP;
+	} else {
+		hdr.ccode = rsp->ccode;
+		if (rsp->data_len > 0)
+			hdr.data_len = __min(rsp->data_len, IPMI_BUF_SIZE);
+		answered++;
+	}
+
+	if (client[rq->client].fd < 0 || client[rq->client].gen != rq->gen)
+		return;
+
+	memcpy(frame, &hdr, sizeof(hdr));
+	if (hdr.data_len > 0)
+		memcpy(frame + sizeof(hdr), rsp->data, hdr.data_len);
+	len = sizeof(hdr) + hdr.data_len;
+
+	if (send(client[rq->client].fd, frame, len,
+		 MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)len) {
+		lprintf(LOG_WARN, "Client %d is not reading, dropped",
+			rq->client);
+		proxy_drop(rq->client);
+	}
+}
+
+/* proxy_dispatch  -  run the queued requests over the BMC session
+ *
+ * Runs of requests for the same bridging target go out together
+ * through ipmi_intf_sendrecv_window(), so with -W the requests of
+ * all clients share the window.
+ *
+ * returns number of requests that got a response
+ */
+static int
+proxy_dispatch(struct ipmi_intf * intf)
+{
+	struct ipmi_rq req[PROXY_BATCH];
+	struct ipmi_proxy_rq * hdr;
+	int i, j;
+
+	memset(req, 0, sizeof(req));
+	for (i = 0; i < queued; i++) {
+		req[i].msg.netfn = queue[i].hdr.netfn;
+		req[i].msg.lun = queue[i].hdr.lun;
+		req[i].msg.cmd = queue[i].hdr.cmd;
+		req[i].msg.data_len = queue[i].hdr.data_len;
+		req[i].msg.data = queue[i].data;
+	}
+
+	answered = 0;
+	for (i = 0; i < queued; i = j) {
+		hdr = &queue[i].hdr;
+		for (j = i + 1; j < queued; j++) {
+			if (queue[j].hdr.target_addr != hdr->target_addr ||
+			    queue[j].hdr.target_channel != hdr->target_channel ||
+			    queue[j].hdr.transit_addr != hdr->transit_addr ||
+			    queue[j].hdr.transit_channel != hdr->transit_channel)
+				break;
+		}
+
+		intf->target_addr = hdr->target_addr;
+		intf->target_channel = hdr->target_channel;
+		intf->transit_addr = hdr->transit_addr;
+		intf->transit_channel = hdr->transit_channel;
+
+		ipmi_intf_sendrecv_window(intf, &req[i], j - i,
+					  proxy_done, &queue[i]);
+	}
+	queued = 0;
+
+	return answered;
+}
+
+/* proxy_reopen  -  replace a session the BMC no longer answers on
+ *
+ * The close method would also free the session settings given on the
+ * command line, so only the socket and request table are dropped here
+ * and the open method, which resets the session state itself, runs
+ * again on the same settings.
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+proxy_reopen(struct ipmi_intf * intf)
+{
+	struct ipmi_session * s = intf->session;
+
+	lprintf(LOG_NOTICE, "Session to %s lost, reopening", s->hostname);
+
+	if (intf->fd >= 0)
+		close(intf->fd);
+	intf->fd = -1;
+	intf->opened = 0;
+	intf->abort = 1;
+	ipmi_req_clear_entries(intf);
+
+	if (intf->open(intf) < 0)
+		return -1;
+
+	lprintf(LOG_NOTICE, "Session to %s reopened", s->hostname);
+	return 0;
+}
+
+/* proxy_serve  -  main loop, runs until a signal asks it to stop
+ *
+ * returns 0 on a clean shutdown, -1 if the session is beyond repair
+ */
+static int
+proxy_serve(struct ipmi_intf * intf, int lfd)
+{
+	struct pollfd pfd[PROXY_CLIENTS + 1];
+	int idx[PROXY_CLIENTS + 1];
+	time_t last, retry = 0;
+	int backoff = 1;
+	int n, c, i, timeout, more;
+
+	for (c = 0; c < PROXY_CLIENTS; c++)
+		client[c].fd = -1;
+
+	last = time(NULL);
+	while (!proxy_stop) {
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		n = 1;
+		more = 0;
+		for (c = 0; c < PROXY_CLIENTS; c++) {
+			if (client[c].fd < 0)
+				continue;
+			pfd[n].fd = client[c].fd;
+			pfd[n].events = POLLIN;
+			idx[n++] = c;
+			if (client[c].len >= sizeof(struct ipmi_proxy_rq))
+				more = 1;
+		}
+
+		if (more)
+			timeout = 0;
+		else if (!intf->opened)
+			timeout = __max(retry - time(NULL), 0) * 1000;
+		else if (intf->keepalive != NULL)
+			timeout = __max(last + PROXY_KEEPALIVE - time(NULL), 0) * 1000;
+		else
+			timeout = -1;
+
+		if (poll(pfd, n, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			return -1;
+		}
+
+		if (pfd[0].revents & POLLIN)
+			proxy_accept(intf, lfd);
+		for (i = 1; i < n; i++) {
+			if (pfd[i].revents & (POLLIN | POLLERR | POLLHUP))
+				proxy_read(idx[i]);
+		}
+
+		/* take one request per client per pass, so no client starves */
+		do {
+			more = 0;
+			for (c = 0; c < PROXY_CLIENTS && queued < PROXY_BATCH; c++)
+				more |= proxy_parse(c);
+		} while (more && queued < PROXY_BATCH);
+
+		if (!intf->opened) {
+			if (time(NULL) < retry) {
+				/* answer right away while the BMC is unreachable */
+				for (i = 0; i < queued; i++)
+					proxy_done(intf, i, NULL, NULL, queue);
+				queued = 0;
+				continue;
+			}
+			if (proxy_reopen(intf) < 0) {
+				if (intf->session == NULL)
+					return -1;
+				retry = time(NULL) + backoff;
+				backoff = __min(backoff * 2, PROXY_REOPEN_MAX);
+				continue;
+			}
+			backoff = 1;
+			last = time(NULL);
+		}
+
+		if (queued > 0) {
+			n = queued;
+			if (proxy_dispatch(intf) > 0 || intf->keepalive == NULL) {
+				last = time(NULL);
+				continue;
+			}
+			lprintf(LOG_DEBUG, "No response to %d requests", n);
+		} else if (intf->keepalive == NULL ||
+			   time(NULL) < last + PROXY_KEEPALIVE) {
+			continue;
+		}
+
+		/* silence from the BMC, or idle for a while: is it still there? */
+		if (intf->keepalive(intf) == 0) {
+			last = time(NULL);
+			continue;
+		}
+		intf->opened = 0;
+	}
+
+	return 0;
+}
+
+static void
+proxy_cleanup(void)
+{
+	struct stat st;
+
+	if (sockpath[0] != '\0' && lstat(sockpath, &st) == 0 &&
+	    S_ISSOCK(st.st_mode))
+		(void)unlink(sockpath);
+	if (pidfile[0] != '\0')
+		(void)unlink(pidfile);
+}
+
+int
+ipmiproxyd_main(struct ipmi_intf * intf, int argc, char ** argv)
+{
+	const char * dir = IPMI_PROXY_DIR;
+	const char * name = IPMI_PROXY_LOCAL;
+	struct sigaction act;
+	unsigned long mode = 0600;
+	char * end;
+	int daemon = 1;
+	int i, lfd, rc;
+	FILE * fp;
+
+	if (intf->session != NULL && intf->session->hostname != NULL)
+		name = intf->session->hostname;
+
+	memset(pidfile, 0, sizeof(pidfile));
+	snprintf(pidfile, sizeof(pidfile), "%s.%s.pid", DEFAULT_PIDFILE, name);
+
+	for (i = 0; i < argc; i++) {
+		if (strncasecmp(argv[i], "help", 4) == 0) {
+			ipmiproxyd_usage();
+			return 0;
+		}
+		if (strncasecmp(argv[i], "nodaemon", 8) == 0) {
+			daemon = 0;
+		}
+		else if (strncasecmp(argv[i], "daemon", 6) == 0) {
+			daemon = 1;
+		}
+		else if (strncasecmp(argv[i], "dir=", 4) == 0) {
+			dir = argv[i] + 4;
+		}
+		else if (strncasecmp(argv[i], "mode=", 5) == 0) {
+			errno = 0;
+			mode = strtoul(argv[i] + 5, &end, 8);
+			if (errno != 0 || *end != '\0' || mode > 0777) {
+				lprintf(LOG_ERR, "Invalid socket mode: %s", argv[i] + 5);
+				return -1;
+			}
+		}
+		else if (strncasecmp(argv[i], "pidfile=", 8) == 0) {
+			memset(pidfile, 0, sizeof(pidfile));
+			strncpy(pidfile, argv[i] + 8, sizeof(pidfile) - 1);
+		}
+		else {
+			lprintf(LOG_ERR, "Invalid option: %s", argv[i]);
+			ipmiproxyd_usage();
+			return -1;
+		}
+	}
+
+	if (snprintf(sockpath, sizeof(sockpath), "%s/%s", dir, name) >=
+			(int)sizeof(sockpath)) {
+		lprintf(LOG_ERR, "Socket path %s/%s is too long", dir, name);
+		return -1;
+	}
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		lperror(LOG_ERR, "Unable to create %s", dir);
+		return -1;
+	}
+
+	/*
+	 * The interface was opened by ipmi_main() before we got here,
+	 * so session errors have already been reported on the terminal.
+	 */
+	if (daemon) {
+		struct stat st1;
+
+		if (lstat(pidfile, &st1) == 0) {
+			lprintf(LOG_ERR, "PID file '%s' already exists.", pidfile);
+			lprintf(LOG_ERR, "Perhaps another instance is already running.");
+			return -1;
+		}
+
+		ipmi_start_daemon(intf);
+
+		umask(022);
+		fp = ipmi_open_file_write(pidfile);
+		if (fp == NULL) {
+			log_halt();
+			log_init("ipmiproxyd", daemon, verbose);
+			lprintf(LOG_ERR,
+				"Failed to open PID file '%s' for writing. Check file permission.",
+				pidfile);
+			exit(EXIT_FAILURE);
+		}
+		fprintf(fp, "%d\n", (int)getpid());
+		fclose(fp);
+	} else {
+		pidfile[0] = '\0';
+	}
+
+	log_halt();
+	log_init("ipmiproxyd", daemon, verbose);
+
+	lfd = proxy_listen(sockpath, mode);
+	if (lfd < 0) {
+		sockpath[0] = '\0';
+		proxy_cleanup();
+		return -1;
+	}
+
+	act.sa_handler = proxy_catch_signal;
+	act.sa_flags = 0;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGQUIT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	lprintf(LOG_NOTICE, "Serving %s on %s", name, sockpath);
+
+	rc = proxy_serve(intf, lfd);
+
+	close(lfd);
+	proxy_cleanup();
+
+	if (rc < 0)
+		lprintf(LOG_ERR, "Session to %s cannot be reopened, exiting", name);
+	else
+		lprintf(LOG_NOTICE, "Shutting down");
+
+	return rc;
+}
+
+struct ipmi_cmd ipmiproxyd_cmd_list[] = {
+	{ ipmiproxyd_main,	"default",	"Share IPMI sessions with local clients" },
+	{ NULL }
+};
+
+int main(int argc, char ** argv)
+{
+	int rc;
+
+	rc = ipmi_main(argc, argv, ipmiproxyd_cmd_list, NULL);
+
+	if (rc < 0)
+		exit(EXIT_FAILURE);
+	else
+		exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,231 @@
+#!/bin/sh
+#
+# ipmisim-check.sh  -  drive ipmitool against ipmisim (make check)
+#
+# Starts the BMC simulator on a loopback port and runs the paths that
+# have no other regression coverage: the SDR cache (including truncated
+# and corrupt cache files and the legacy sdr dump format), the request
+# window of the lanplus and proxy interfaces under packet loss,
+# duplication and reordering, and the sample file encode/decode round
+# trip.  Output of every windowed or cached run is compared with a plain
+# one-request-at-a-time run.
+#
+# Exits 77 (skipped) when ipmisim was not built, i.e. without lanplus.
+
+builddir=${builddir:-.}
+IPMITOOL=$builddir/ipmitool
+IPMISIM=$builddir/ipmisim
+IPMIPROXYD=$builddir/ipmiproxyd
+
+if [ ! -x "$IPMISIM" ]; then
+	echo "ipmisim not built, skipping"
+	exit 77
+fi
+
+tmp=`mktemp -d ${TMPDIR:-/tmp}/ipmisim-check.XXXXXX` || exit 99
+sim_pid=
+proxy_pid=
+failed=0
+
+cleanup()
+{
+	[ -n "$proxy_pid" ] && kill $proxy_pid 2>/dev/null
+	[ -n "$sim_pid" ] && kill $sim_pid 2>/dev/null
+	rm -rf "$tmp"
+}
+trap cleanup 0
+trap 'exit 99' 1 2 15
+
+# keep the SDR cache and session files out of the user's home
+HOME=$tmp
+export HOME
+unset IPMI_SDR_CACHE_DIR IPMI_PASSWORD
+
+port=`expr 20000 + $$ % 20000`
+LAN="-I lanplus -H 127.0.0.1 -p $port -U admin -P secret -N 1 -R 8"
+
+fail()
+{
+	echo "FAIL: $*"
+	failed=1
+}
+
+# same  -  compare two output files, report the test name on mismatch
+same()
+{
+	if cmp -s "$2" "$3"; then
+		echo "ok: $1"
+	else
+		fail "$1"
+		diff "$2" "$3" | head -20
+	fi
+}
+
+# sim_start  -  (re)start ipmisim with the given impairment options
+sim_start()
+{
+	sim_stop
+	"$IPMISIM" -p $port -U admin -P secret -n 12 "$@" \
+		>"$tmp/sim.log" 2>&1 &
+	sim_pid=$!
+	i=0
+	while [ $i -lt 20 ]; do
+		grep -q "^Listening on" "$tmp/sim.log" 2>/dev/null && return 0
+		kill -0 $sim_pid 2>/dev/null || break
+		sleep 1
+		i=`expr $i + 1`
+	done
+	cat "$tmp/sim.log"
+	echo "ipmisim did not start"
+	exit 99
+}
+
+sim_stop()
+{
+	if [ -n "$sim_pid" ]; then
+		kill $sim_pid 2>/dev/null
+		wait $sim_pid 2>/dev/null
+		sim_pid=
+	fi
+}
+
+sim_start -s 1
+
+# reference output, one request at a time and without a cache
+$IPMITOOL $LAN -W 1 sensor list >"$tmp/sensor.ref" 2>"$tmp/err" ||
+	{ cat "$tmp/err"; fail "sensor list -W 1"; }
+$IPMITOOL $LAN -W 1 sdr list >"$tmp/sdr.ref" 2>"$tmp/err" ||
+	{ cat "$tmp/err"; fail "sdr list -W 1"; }
+if [ `wc -l <"$tmp/sensor.ref"` -ne 12 ]; then
+	fail "sensor list returned `wc -l <"$tmp/sensor.ref"` of 12 sensors"
+fi
+
+#
+# request window
+#
+$IPMITOOL $LAN -W 8 sensor list >"$tmp/out" 2>&1
+same "sensor list -W 8" "$tmp/sensor.ref" "$tmp/out"
+
+i=0
+: >"$tmp/batch"
+while [ $i -lt 16 ]; do
+	echo "0x06 0x01" >>"$tmp/batch"
+	i=`expr $i + 1`
+done
+# drop the response times, they differ from run to run
+$IPMITOOL $LAN -W 1 raw batch "$tmp/batch" 2>&1 |
+	awk '{ $3 = $4 = ""; print }' >"$tmp/batch.ref"
+$IPMITOOL $LAN -W 8 raw batch - <"$tmp/batch" 2>&1 |
+	awk '{ $3 = $4 = ""; print }' >"$tmp/out"
+same "raw batch -W 8" "$tmp/batch.ref" "$tmp/out"
+if [ `wc -l <"$tmp/batch.ref"` -ne 16 ]; then
+	fail "raw batch printed `wc -l <"$tmp/batch.ref"` of 16 responses"
+fi
+
+# lost, duplicated and reordered packets must not change the result
+sim_start -s 7 -l 10 -u 10 -r 20
+$IPMITOOL $LAN -W 8 sensor list >"$tmp/out" 2>"$tmp/err"
+same "sensor list -W 8 with loss, dup and reorder" "$tmp/sensor.ref" "$tmp/out"
+sim_start -s 1
+
+#
+# SDR cache
+#
+sdrcache=$tmp/.ipmitool/sdr
+$IPMITOOL $LAN sdr list >"$tmp/out" 2>&1
+same "sdr list filling the cache" "$tmp/sdr.ref" "$tmp/out"
+cache=`ls "$sdrcache"/*.sdr 2>/dev/null | head -1`
+if [ -z "$cache" ]; then
+	fail "no SDR cache file written to $sdrcache"
+else
+	$IPMITOOL $LAN sdr list >"$tmp/out" 2>&1
+	same "sdr list from the cache" "$tmp/sdr.ref" "$tmp/out"
+
+	# a truncated cache is discarded and rebuilt from the BMC
+	size=`wc -c <"$cache"`
+	dd if="$cache" of="$tmp/trunc" bs=1 count=`expr $size / 2` 2>/dev/null
+	cp "$tmp/trunc" "$cache"
+	$IPMITOOL $LAN sdr list >"$tmp/out" 2>/dev/null
+	same "sdr list with a truncated cache" "$tmp/sdr.ref" "$tmp/out"
+	if [ `wc -c <"$cache"` -ne $size ]; then
+		fail "truncated SDR cache was not rewritten"
+	fi
+
+	# so is one with garbage in the entry table
+	tr '\000' '\377' </dev/zero |
+		dd of="$cache" bs=1 seek=64 count=64 conv=notrunc 2>/dev/null
+	$IPMITOOL $LAN sdr list >"$tmp/out" 2>/dev/null
+	same "sdr list with a corrupt cache" "$tmp/sdr.ref" "$tmp/out"
+fi
+
+# legacy sdr dump files are still read by -S
+$IPMITOOL $LAN sdr dump "$tmp/dump" >/dev/null 2>&1
+$IPMITOOL $LAN -S "$tmp/dump" sdr list >"$tmp/out" 2>&1
+same "sdr list -S from an sdr dump file" "$tmp/sdr.ref" "$tmp/out"
+
+#
+# proxy
+#
+if [ -x "$IPMIPROXYD" ] && $IPMITOOL -h 2>&1 | grep -q "^	proxy "; then
+	mkdir "$tmp/proxy"
+	$IPMIPROXYD -I lanplus -H 127.0.0.1 -p $port -U admin -P secret \
+		dir="$tmp/proxy" nodaemon pidfile="$tmp/proxy/pid" \
+		>"$tmp/proxy.log" 2>&1 &
+	proxy_pid=$!
+	i=0
+	while [ $i -lt 20 ] && [ ! -S "$tmp/proxy/127.0.0.1" ]; do
+		sleep 1
+		i=`expr $i + 1`
+	done
+	$IPMITOOL -I proxy -D "$tmp/proxy" -H 127.0.0.1 -W 8 sensor list \
+		>"$tmp/out" 2>&1
+	same "sensor list -W 8 through ipmiproxyd" "$tmp/sensor.ref" "$tmp/out"
+	kill $proxy_pid 2>/dev/null
+	wait $proxy_pid 2>/dev/null
+	proxy_pid=
+else
+	echo "skip: proxy interface not built"
+fi
+
+#
+# sample file round trip
+#
+smp=$tmp/watch.smp
+$IPMITOOL $LAN sensor watch interval=1 count=2 file="$smp" >/dev/null 2>&1
+$IPMITOOL $LAN sensor watch count=1 file="$tmp/one.smp" >/dev/null 2>&1
+# appending to the file must reuse its dictionary, so one more sample
+# grows it by less than a fresh file holding one sample and the header
+size=`wc -c <"$smp"`
+$IPMITOOL $LAN sensor watch interval=1 count=1 file="$smp" >/dev/null 2>&1
+grown=`expr \`wc -c <"$smp"\` - $size`
+if [ $grown -ge `expr \`wc -c <"$tmp/one.smp"\` - 16` ]; then
+	fail "sample dictionary written again on append"
+else
+	echo "ok: sample dictionary written once"
+fi
+$IPMITOOL $LAN sensor watch count=1 >"$tmp/watch" 2>&1
+
+sim_stop
+# export works without a BMC and must not try to reach one
+$IPMITOOL sensor export "$smp" >"$tmp/export" 2>"$tmp/err" ||
+	{ cat "$tmp/err"; fail "sensor export"; }
+rows=`wc -l <"$tmp/export"`
+if [ $rows -ne 36 ]; then
+	fail "sensor export returned $rows of 36 rows"
+else
+	echo "ok: sensor export row count"
+fi
+
+# every decoded reading matches what sensor watch printed live
+sed 's/^[^|]*| //' "$tmp/watch" >"$tmp/watch.rows"
+sed 's/^[^|]*| //' "$tmp/export" | grep -v '| na ' >"$tmp/export.rows"
+if [ ! -s "$tmp/export.rows" ]; then
+	fail "sensor export decoded no readings"
+elif grep -v -x -F -f "$tmp/watch.rows" "$tmp/export.rows" >"$tmp/out"; then
+	fail "sensor export readings differ from sensor watch"
+	head -5 "$tmp/out"
+else
+	echo "ok: sensor export readings"
+fi
+
+exit $failed
@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+/*
+ * ipmisim - a loopback BMC for exercising the lan and lanplus interfaces
+ *
+ * Answers RMCP presence pings, IPMI v1.5 sessions (NONE, PASSWORD and
+ * MD5 authentication) and RMCP+ sessions (RAKP-HMAC-SHA1, HMAC-SHA1-96
+ * and AES-CBC-128).  SDR, SEL and FRU data come from files saved by
+ * "sdr dump", "sel writeraw" and "fru read", or from synthetic sensors.
+ *
+ * Datagrams sent back to the console can be delayed, lost, duplicated
+ * and reordered so the retransmit paths of the transports can be driven
+ * reproducibly.
+ *
+ * With -t the same commands are also served in serial basic mode on a
+ * pseudo terminal, paced at the line rate given with -b, for measuring
+ * the serial-basic interface:
+ *
+ *	ipmisim -t -b 115200 &
+ *	time ipmitool -I serial-basic -D /dev/pts/N:115200 -W 8 raw batch file
+ *
+ * With -B it only times the lanplus per packet crypto and exits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <ipmitool/log.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/ipmi.h>
+
+#include "ipmisim.h"
+
+#define OPTION_STRING	"a:b:B:d:E:hj:k:l:n:o:p:P:r:R:s:S:tu:U:vw:"
+
+struct ipmisim_pkt {
+	uint64_t due;		/* ms */
+	uint32_t order;
+	int len;
+	struct sockaddr_storage to;
+	socklen_t tolen;
+	uint8_t data[IPMI_BUF_SIZE];
+};
+
+struct ipmisim_config sim;
+
+int verbose = 0;
+int csv_output = 0;
+
+static struct {
+	int latency;		/* ms */
+	int jitter;		/* ms */
+	int loss;		/* percent */
+	int dup;		/* percent */
+	int reorder;		/* percent */
+} impair;
+
+static struct {
+	unsigned long rx;
+	unsigned long tx;
+	unsigned long lost;
+	unsigned long dup;
+	unsigned long reordered;
+	unsigned long overflow;
+} stats;
+
+static struct ipmisim_pkt queue[IPMISIM_QUEUE_LEN];
+static struct ipmisim_pkt * held;
+static uint32_t order;
+static volatile sig_atomic_t done;
+
+static void
+ipmisim_usage(void)
+{
+	lprintf(LOG_NOTICE, "ipmisim version %s\n", VERSION);
+	lprintf(LOG_NOTICE, "usage: ipmisim [options...]\n");
+	lprintf(LOG_NOTICE, "       -h             This help");
+	lprintf(LOG_NOTICE, "       -v             Verbose (can use multiple times)");
+	lprintf(LOG_NOTICE, "       -a address     Address to listen on [default=127.0.0.1]");
+	lprintf(LOG_NOTICE, "       -p port        UDP port to listen on [default=%d]", IPMISIM_PORT);
+	lprintf(LOG_NOTICE, "       -U username    Username accepted by the BMC [default=NULL]");
+	lprintf(LOG_NOTICE, "       -P password    Password of that user");
+	lprintf(LOG_NOTICE, "       -k key         Kg key for IPMIv2 authentication");
+	lprintf(LOG_NOTICE, "       -S file        SDR repository saved by 'sdr dump'");
+	lprintf(LOG_NOTICE, "       -E file        SEL saved by 'sel writeraw'");
+	lprintf(LOG_NOTICE, "       -R file        FRU image saved by 'fru read'");
+	lprintf(LOG_NOTICE, "       -n count       Add count synthetic sensors");
+	lprintf(LOG_NOTICE, "       -o rate        SOL console output in bytes/s");
+	lprintf(LOG_NOTICE, "       -w ms          Move every fourth sensor reading each ms");
+	lprintf(LOG_NOTICE, "       -t             Also serve serial basic mode on a pty");
+	lprintf(LOG_NOTICE, "       -b baud        Line rate of the pty [default=none]");
+	lprintf(LOG_NOTICE, "       -d ms          Delay every response");
+	lprintf(LOG_NOTICE, "       -j ms          Add up to ms of random delay");
+	lprintf(LOG_NOTICE, "       -l percent     Lose responses");
+	lprintf(LOG_NOTICE, "       -u percent     Duplicate responses");
+	lprintf(LOG_NOTICE, "       -r percent     Hold responses back behind the next one");
+	lprintf(LOG_NOTICE, "       -s seed        Random seed for the impairments");
+	lprintf(LOG_NOTICE, "       -B packets     Time lanplus packet crypto and exit");
+	lprintf(LOG_NOTICE, "");
+}
+
+uint64_t
+ipmisim_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int
+ipmisim_chance(int percent)
+{
+	return percent > 0 && (random() % 100) < percent;
+}
+
+/* ipmisim_queue  -  pass a response through the impairments
+ *
+ * A datagram picked for reordering waits until the next datagram is
+ * queued and is then sent right after it, or IPMISIM_REORDER_HOLD ms
+ * if nothing else turns up.
+ */
+static void
+ipmisim_queue(uint8_t * data, int len, struct sockaddr * to, socklen_t tolen)
+{
+	struct ipmisim_pkt * p;
+	int copies, i, j;
+
+	if (ipmisim_chance(impair.loss)) {
+		stats.lost++;
+		return;
+	}
+	copies = 1;
+	if (ipmisim_chance(impair.dup)) {
+		stats.dup++;
+		copies = 2;
+	}
+
+	for (i = 0; i < copies; i++) {
+		p = NULL;
+		for (j = 0; j < IPMISIM_QUEUE_LEN; j++) {
+			if (queue[j].len == 0) {
+				p = &queue[j];
+				break;
+			}
+		}
+		if (p == NULL) {
+			stats.overflow++;
+			return;
+		}
+		p->due = ipmisim_msec() + impair.latency;
+		if (impair.jitter > 0)
+			p->due += random() % (impair.jitter + 1);
+		p->order = ++order;
+		p->len = len;
+		memcpy(p->data, data, len);
+		memcpy(&p->to, to, tolen);
+		p->tolen = tolen;
+
+		if (held != NULL) {
+			held->due = p->due;
+			held->order = ++order;
+			held = NULL;
+		} else if (ipmisim_chance(impair.reorder)) {
+			stats.reordered++;
+			p->due += IPMISIM_REORDER_HOLD;
+			held = p;
+		}
+	}
+}
+
+/* ipmisim_flush  -  send queued datagrams that are due
+ *
+ * returns ms until the next datagram is due
+ * returns -1 if the queue is empty
+ */
+static int
+ipmisim_flush(int fd)
+{
+	struct ipmisim_pkt * p;
+	uint64_t now;
+	int j;
+
+	for (;;) {
+		p = NULL;
+		for (j = 0; j < IPMISIM_QUEUE_LEN; j++) {
+			if (queue[j].len == 0)
+				continue;
+			if (p == NULL || queue[j].due < p->due ||
+			    (queue[j].due == p->due && queue[j].order < p->order))
+				p = &queue[j];
+		}
+		if (p == NULL)
+			return -1;
+		now = ipmisim_msec();
+		if (p->due > now)
+			return p->due - now;
+
+		if (sendto(fd, p->data, p->len, 0,
+			   (struct sockaddr *)&p->to, p->tolen) < 0)
+			lperror(LOG_INFO, "sendto");
+		else
+			stats.tx++;
+		if (held == p)
+			held = NULL;
+		p->len = 0;
+	}
+}
+
+static void
+ipmisim_signal(int sig)
+{
+	done = 1;
+}
+
+static int
+ipmisim_socket(const char * address, int port)
+{
+	struct addrinfo hints, *res, *rp;
+	char service[16];
+	int fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = AI_PASSIVE;
+	snprintf(service, sizeof(service), "%d", port);
+
+	if (getaddrinfo(address, service, &hints, &res) != 0) {
+		lprintf(LOG_ERR, "Address lookup for %s failed", address);
+		return -1;
+	}
+	for (rp = res; rp != NULL; rp = rp->ai_next) {
+		fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (bind(fd, rp->ai_addr, rp->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		lperror(LOG_ERR, "Unable to listen on %s port %d", address, port);
+	return fd;
+}
+
+int
+main(int argc, char ** argv)
+{
+	const char * address = "127.0.0.1";
+	struct sockaddr_storage from;
+	struct sigaction act;
+	struct pollfd pfd[2];
+	socklen_t fromlen;
+	uint8_t in[IPMI_BUF_SIZE], out[IPMI_BUF_SIZE];
+	struct ipmisim_session * s;
+	int argflag, fd, i, n, timeout;
+	int tty = -1, serial = 0, baud = 0;
+	int port = IPMISIM_PORT;
+	int sensors = 0;
+	int bench = 0;
+	int32_t val;
+	unsigned int seed = time(NULL);
+
+	while ((argflag = getopt(argc, argv, OPTION_STRING)) != -1) {
+		val = 0;
+		switch (argflag) {
+		case 'b':
+		case 'B':
+		case 'd':
+		case 'j':
+		case 'l':
+		case 'n':
+		case 'o':
+		case 'p':
+		case 'r':
+		case 's':
+		case 'u':
+		case 'w':
+			if (str2int(optarg, &val) != 0 || val < 0) {
+				lprintf(LOG_ERR, "Invalid parameter given or out "
+					"of range for '-%c'.", argflag);
+				return EXIT_FAILURE;
+			}
+			break;
+		}
+
+		switch (argflag) {
+		case 'h':
+			ipmisim_usage();
+			return EXIT_SUCCESS;
+		case 'v':
+			verbose++;
+			break;
+		case 'a':
+			address = optarg;
+			break;
+		case 'p':
+			port = val;
+			break;
+		case 'U':
+			if (strlen(optarg) > 16) {
+				lprintf(LOG_ERR, "Username is too long (> 16 bytes)");
+				return EXIT_FAILURE;
+			}
+			strncpy(sim.username, optarg, 16);
+			break;
+		case 'P':
+			if (strlen(optarg) > 20) {
+				lprintf(LOG_ERR, "Password is too long (> 20 bytes)");
+				return EXIT_FAILURE;
+			}
+			memcpy(sim.password, optarg, strlen(optarg));
+			break;
+		case 'k':
+			if (strlen(optarg) > 20) {
+				lprintf(LOG_ERR, "Kg key is too long (> 20 bytes)");
+				return EXIT_FAILURE;
+			}
+			memcpy(sim.kg, optarg, strlen(optarg));
+			break;
+		case 'S':
+			if (ipmisim_load_sdr(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case 'E':
+			if (ipmisim_load_sel(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case 'R':
+			if (ipmisim_load_fru(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case 'n':
+			sensors = val;
+			break;
+		case 'o':
+			sim.sol_rate = val;
+			break;
+		case 'w':
+			sim.wander = val;
+			break;
+		case 't':
+			serial = 1;
+			break;
+		case 'b':
+			baud = val;
+			break;
+		case 'B':
+			bench = val;
+			break;
+		case 'd':
+			impair.latency = val;
+			break;
+		case 'j':
+			impair.jitter = val;
+			break;
+		case 'l':
+			impair.loss = val;
+			break;
+		case 'u':
+			impair.dup = val;
+			break;
+		case 'r':
+			impair.reorder = val;
+			break;
+		case 's':
+			seed = val;
+			break;
+		default:
+			ipmisim_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	log_init("ipmisim", 0, verbose);
+	srandom(seed);
+
+	if (bench > 0)
+		return ipmisim_crypt_bench(bench) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	if (sensors > 0 && ipmisim_add_sensors(sensors) < 0)
+		return EXIT_FAILURE;
+	memcpy(sim.guid, "ipmisim-00000001", 16);
+	sim.snap.power = 1;
+
+	sim.port = port;
+	fd = ipmisim_socket(address, port);
+	if (fd < 0)
+		return EXIT_FAILURE;
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = ipmisim_signal;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+
+	lprintf(LOG_NOTICE, "Listening on %s port %d (seed %u)",
+		address, port, seed);
+
+	if (serial) {
+		tty = ipmisim_serial_open(baud);
+		if (tty < 0)
+			return EXIT_FAILURE;
+	}
+
+	pfd[0].fd = fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = tty;
+	pfd[1].events = POLLIN;
+	timeout = -1;
+	while (!done) {
+		n = poll(pfd, serial ? 2 : 1, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			break;
+		}
+		if (serial && pfd[1].revents)
+			ipmisim_serial_read(tty, impair.latency, impair.loss);
+		n = pfd[0].revents;
+		while (n > 0) {
+			fromlen = sizeof(from);
+			n = recvfrom(fd, in, sizeof(in), MSG_DONTWAIT,
+				     (struct sockaddr *)&from, &fromlen);
+			if (n <= 0)
+				break;
+			stats.rx++;
+			if (verbose > 2)
+				printbuf(in, n, "<< received");
+			n = ipmisim_handle_packet(in, n,
+					(struct sockaddr *)&from, fromlen, out);
+			if (n > 0) {
+				if (verbose > 2)
+					printbuf(out, n, ">> sending");
+				ipmisim_queue(out, n, (struct sockaddr *)&from,
+					      fromlen);
+			}
+			n = 1;
+		}
+
+		/* SOL output is not a response, it is sent on its own */
+		timeout = -1;
+		for (i = 0; i < IPMISIM_MAX_SESSIONS; i++) {
+			s = &sim.session[i];
+			n = ipmisim_sol_poll(s, ipmisim_msec(), out, &timeout);
+			if (n > 0)
+				ipmisim_queue(out, n, (struct sockaddr *)&s->addr,
+					      s->addrlen);
+		}
+		n = ipmisim_flush(fd);
+		if (n >= 0 && (timeout < 0 || n < timeout))
+			timeout = n;
+		n = serial ? ipmisim_serial_flush(tty) : -1;
+		if (n >= 0 && (timeout < 0 || n < timeout))
+			timeout = n;
+	}
+
+	lprintf(LOG_NOTICE, "received %lu, sent %lu, lost %lu, duplicated %lu, "
+		"reordered %lu, queue overflows %lu", stats.rx, stats.tx,
+		stats.lost, stats.dup, stats.reordered, stats.overflow);
+	if (serial) {
+		ipmisim_serial_stats();
+		close(tty);
+	}
+	close(fd);
+	return EXIT_SUCCESS;
+}
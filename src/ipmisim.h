@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#ifndef IPMISIM_H
+#define IPMISIM_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <ipmitool/ipmi.h>
+
+#define IPMISIM_PORT		623
+#define IPMISIM_MAX_SESSIONS	32
+#define IPMISIM_SESSION_IDLE	60	/* seconds before an idle slot is reused */
+#define IPMISIM_QUEUE_LEN	256	/* datagrams held back by the impairments */
+#define IPMISIM_REORDER_HOLD	50	/* ms a reordered datagram waits at most */
+#define IPMISIM_SOL_PAYLOAD	255	/* SOL characters per packet */
+#define IPMISIM_SOL_BUF		4096
+
+#define IPMISIM_RMCP_VERSION	0x06
+#define IPMISIM_RMCP_CLASS_ASF	0x06
+#define IPMISIM_RMCP_CLASS_IPMI	0x07
+#define IPMISIM_ASF_IANA	0x000011be
+#define IPMISIM_ASF_PING	0x80
+#define IPMISIM_ASF_PONG	0x40
+
+/* RMCP+ status codes used in the session setup payloads */
+#define IPMISIM_RAKP_OK			0x00
+#define IPMISIM_RAKP_NO_RESOURCES	0x01
+#define IPMISIM_RAKP_INVALID_SESSION	0x02
+#define IPMISIM_RAKP_INVALID_ROLE	0x09
+#define IPMISIM_RAKP_UNAUTHORIZED_NAME	0x0d
+#define IPMISIM_RAKP_BAD_INTEGRITY	0x0f
+#define IPMISIM_RAKP_BAD_AUTH_ALG	0x11
+#define IPMISIM_RAKP_BAD_INTEGRITY_ALG	0x12
+#define IPMISIM_RAKP_BAD_CRYPT_ALG	0x13
+
+enum ipmisim_state {
+	IPMISIM_FREE = 0,
+	IPMISIM_CHALLENGE,	/* v1.5: challenge handed out */
+	IPMISIM_OPENED,		/* v2.0: open session answered */
+	IPMISIM_RAKP2_SENT,	/* v2.0: waiting for RAKP 3 */
+	IPMISIM_ACTIVE,
+};
+
+struct ipmisim_sol {
+	int active;
+	uint64_t start;		/* ms, for the synthetic output */
+	unsigned long lines;	/* synthetic output lines so far */
+	unsigned long rx;	/* characters from the remote console */
+	unsigned long tx;	/* characters to the remote console */
+
+	uint8_t seq;		/* sequence number of the packet in flight */
+	int inflight;		/* characters in that packet */
+	int tries;
+	uint64_t sent;		/* ms */
+	uint8_t buf[IPMISIM_SOL_BUF];	/* output not acknowledged yet */
+	int len;
+
+	uint8_t in_seq;		/* last packet from the remote console */
+	uint8_t in_count;	/* characters accepted from it */
+};
+
+struct ipmisim_session {
+	enum ipmisim_state state;
+	int v2;
+	time_t last;
+
+	uint32_t id;		/* our (BMC) session ID */
+	uint32_t console_id;	/* remote console session ID, v2.0 only */
+	uint32_t out_seq;
+	uint8_t authtype;
+	uint8_t privlvl;
+	uint8_t challenge[16];
+
+	uint8_t auth_alg;
+	uint8_t integrity_alg;
+	uint8_t crypt_alg;
+	uint8_t role;
+	uint8_t rm[16];
+	uint8_t rc[16];
+	uint8_t username[17];
+	uint8_t sik[20];
+	uint8_t k1[20];
+	uint8_t k2[20];
+
+	struct sockaddr_storage addr;	/* remote console, v2.0 only */
+	socklen_t addrlen;
+	struct ipmisim_sol sol;
+};
+
+struct ipmisim_sdr {
+	uint16_t id;
+	uint8_t len;		/* total record length, header included */
+	uint8_t * data;
+};
+
+struct ipmisim_snapshot {
+	struct ipmisim_sdr * sdr;
+	int sdr_count;
+	uint16_t sdr_resv;
+	uint32_t sdr_stamp;	/* most recent addition */
+
+	uint8_t * sel;		/* 16 byte records */
+	int sel_count;
+	int sel_max;
+	uint16_t sel_resv;
+
+	uint8_t * fru;
+	int fru_len;
+
+	uint8_t power;
+};
+
+struct ipmisim_config {
+	char username[17];
+	uint8_t password[20];
+	uint8_t kg[20];
+	uint8_t guid[16];
+	int port;
+	int sol_rate;		/* synthetic SOL output, bytes per second */
+	int wander;		/* ms per step of moving sensor readings */
+	struct ipmisim_snapshot snap;
+	struct ipmisim_session session[IPMISIM_MAX_SESSIONS];
+};
+
+extern struct ipmisim_config sim;
+
+/* ipmisim.c */
+uint64_t ipmisim_msec(void);
+
+/* ipmisim_session.c */
+int ipmisim_handle_packet(uint8_t * in, int in_len, struct sockaddr * from,
+		socklen_t fromlen, uint8_t * out);
+int ipmisim_v2_packet(struct ipmisim_session * s, uint8_t type,
+		const uint8_t * payload, int len, uint8_t * out);
+
+/* ipmisim_cmd.c */
+int ipmisim_handle_cmd(struct ipmisim_session * s, uint8_t netfn, uint8_t cmd,
+		uint8_t * data, int data_len, uint8_t * rsp);
+int ipmisim_load_sdr(const char * file);
+int ipmisim_load_sel(const char * file);
+int ipmisim_load_fru(const char * file);
+int ipmisim_add_sensors(int count);
+
+/* ipmisim_sol.c */
+int ipmisim_sol_activate(struct ipmisim_session * s, uint8_t * data, int len,
+		uint8_t * rsp);
+int ipmisim_sol_deactivate(struct ipmisim_session * s, uint8_t * data, int len,
+		uint8_t * rsp);
+int ipmisim_sol_packet(struct ipmisim_session * s, uint8_t * in, int len,
+		uint8_t * rsp);
+int ipmisim_sol_poll(struct ipmisim_session * s, uint64_t now, uint8_t * out,
+		int * timeout);
+
+/* ipmisim_serial.c */
+int ipmisim_serial_open(int baud);
+void ipmisim_serial_read(int fd, int latency, int loss);
+int ipmisim_serial_flush(int fd);
+void ipmisim_serial_stats(void);
+
+/* ipmisim_bench.c */
+int ipmisim_crypt_bench(int packets);
+
+#endif /* IPMISIM_H */
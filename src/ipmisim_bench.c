@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+
+/*
+ * Throughput of the lanplus per packet crypto work, so the effect of
+ * keying the cipher and HMAC once per session can be measured:
+ *
+ *	ipmisim -B 200000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_constants.h>
+
+#include "lanplus.h"
+#include "lanplus_crypt.h"
+#include "lanplus_crypt_impl.h"
+#include "ipmisim.h"
+
+/*
+ * ipmisim_crypt_bench
+ *
+ * Encrypt a 64 byte payload with AES-CBC-128 and MAC the result with
+ * HMAC-SHA1-96, packets times, once with the one-shot key based calls
+ * and once with a keyed per session context, and print packets/s.
+ *
+ * returns 0 on success, -1 on error
+ */
+int
+ipmisim_crypt_bench(int packets)
+{
+	uint8_t k1[20], k2[20];
+	uint8_t data[64];
+	uint8_t packet[IPMI_BUF_SIZE];
+	uint8_t md[IPMI_MAX_MAC_SIZE];
+	uint16_t bytes_encrypted;
+	uint32_t md_len;
+	struct lanplus_crypt_ctx * ctx;
+	uint64_t start, msec;
+	int pass, i;
+
+	if (lanplus_rand(k1, sizeof(k1)) || lanplus_rand(k2, sizeof(k2)) ||
+			lanplus_rand(data, sizeof(data)))
+		return -1;
+
+	ctx = lanplus_crypt_ctx_new(k1, sizeof(k1), k2);
+	if (ctx == NULL) {
+		lprintf(LOG_ERR, "Unable to set up the crypt context");
+		return -1;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		start = ipmisim_msec();
+		for (i = 0; i < packets; i++) {
+			lanplus_encrypt_payload(IPMI_CRYPT_AES_CBC_128, k2,
+					pass ? ctx : NULL, data, sizeof(data),
+					packet, &bytes_encrypted);
+			if (pass)
+				lanplus_HMAC_ctx(ctx, packet, bytes_encrypted,
+						md, &md_len);
+			else
+				lanplus_HMAC(IPMI_INTEGRITY_HMAC_SHA1_96, k1,
+						sizeof(k1), packet, bytes_encrypted,
+						md, &md_len);
+		}
+		msec = ipmisim_msec() - start;
+		if (msec == 0)
+			msec = 1;
+
+		printf("%-12s %d packets in %.3f s, %.0f packets/s\n",
+			pass ? "per session" : "per packet", packets,
+			msec / 1000.0, packets * 1000.0 / msec);
+	}
+
+	lanplus_crypt_ctx_free(ctx);
+	return 0;
+}
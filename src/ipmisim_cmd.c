@@ -0,0 +1,688 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <ipmitool/log.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_constants.h>
+#include <ipmitool/ipmi_fru.h>
+#include <ipmitool/ipmi_mc.h>
+#include <ipmitool/ipmi_sdr.h>
+#include <ipmitool/ipmi_sel.h>
+
+#include "ipmisim.h"
+
+/* byte offsets inside a full sensor record, header included */
+#define SDR_OFS_NUMBER		7
+#define SDR_OFS_READABLE	18
+#define SDR_OFS_LINEAR		23
+#define SDR_OFS_FACTORS		24	/* M, M/tol, B, B/acc, acc, R/B exp */
+#define SDR_OFS_NOMINAL		31
+#define SDR_OFS_THRESHOLDS	36	/* UNR, UC, UNC, LNR, LC, LNC */
+#define SDR_OFS_ID_CODE		47
+#define SDR_FULL_LEN		48	/* without the ID string */
+
+/* ipmisim_read_file  -  read a whole file into memory
+ *
+ * @file:	file name
+ * @len:	set to the file size
+ *
+ * returns malloc'ed contents
+ * returns NULL on error
+ */
+static uint8_t *
+ipmisim_read_file(const char * file, int * len)
+{
+	struct stat st;
+	uint8_t * buf;
+	FILE * fp;
+
+	fp = ipmi_open_file_read(file);
+	if (fp == NULL)
+		return NULL;
+	if (fstat(fileno(fp), &st) < 0 || st.st_size == 0) {
+		lprintf(LOG_ERR, "Unable to read '%s'", file);
+		fclose(fp);
+		return NULL;
+	}
+	buf = malloc(st.st_size);
+	if (buf == NULL) {
+		lprintf(LOG_ERR, "ipmisim: malloc failure");
+		fclose(fp);
+		return NULL;
+	}
+	if (fread(buf, 1, st.st_size, fp) != (size_t)st.st_size) {
+		lprintf(LOG_ERR, "Unable to read '%s'", file);
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	*len = st.st_size;
+	return buf;
+}
+
+static int
+ipmisim_sdr_append(uint8_t * rec)
+{
+	struct ipmisim_sdr * sdr;
+
+	sdr = realloc(sim.snap.sdr, (sim.snap.sdr_count + 1) * sizeof(*sdr));
+	if (sdr == NULL) {
+		lprintf(LOG_ERR, "ipmisim: malloc failure");
+		return -1;
+	}
+	sim.snap.sdr = sdr;
+	sdr += sim.snap.sdr_count++;
+	sdr->id = rec[0] | (rec[1] << 8);
+	sdr->len = 5 + rec[4];
+	sdr->data = rec;
+	sim.snap.sdr_stamp = time(NULL);
+	return 0;
+}
+
+/* ipmisim_load_sdr  -  load records written by "sdr dump"
+ *
+ * @file:	dump file
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmisim_load_sdr(const char * file)
+{
+	uint8_t * buf;
+	int len, x;
+
+	buf = ipmisim_read_file(file, &len);
+	if (buf == NULL)
+		return -1;
+	for (x = 0; x + 5 <= len && x + 5 + buf[x + 4] <= len;
+	     x += 5 + buf[x + 4]) {
+		if (ipmisim_sdr_append(buf + x) < 0)
+			return -1;
+	}
+	if (x != len)
+		lprintf(LOG_WARN, "Ignoring %d trailing bytes in '%s'",
+			len - x, file);
+	lprintf(LOG_NOTICE, "Loaded %d SDR records from '%s'",
+		sim.snap.sdr_count, file);
+	return 0;
+}
+
+/* ipmisim_load_sel  -  load records written by "sel writeraw"
+ *
+ * @file:	raw SEL file
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmisim_load_sel(const char * file)
+{
+	uint8_t * buf;
+	int len;
+
+	buf = ipmisim_read_file(file, &len);
+	if (buf == NULL)
+		return -1;
+	if (len % 16)
+		lprintf(LOG_WARN, "Ignoring %d trailing bytes in '%s'",
+			len % 16, file);
+	free(sim.snap.sel);
+	sim.snap.sel = buf;
+	sim.snap.sel_count = sim.snap.sel_max = len / 16;
+	lprintf(LOG_NOTICE, "Loaded %d SEL records from '%s'",
+		sim.snap.sel_count, file);
+	return 0;
+}
+
+/* ipmisim_load_fru  -  load a raw FRU image, e.g. from "fru read"
+ *
+ * @file:	FRU image
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmisim_load_fru(const char * file)
+{
+	uint8_t * buf;
+	int len;
+
+	buf = ipmisim_read_file(file, &len);
+	if (buf == NULL)
+		return -1;
+	free(sim.snap.fru);
+	sim.snap.fru = buf;
+	sim.snap.fru_len = len;
+	return 0;
+}
+
+/* ipmisim_add_sensors  -  add synthetic threshold sensors
+ *
+ * Records cycle through temperature, voltage and fan sensors with
+ * a 1:1 conversion so readings are easy to check by eye.  Fans are
+ * flagged non-linear, so their factors are read with every reading.
+ *
+ * @count:	number of sensors to add
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmisim_add_sensors(int count)
+{
+	static const struct {
+		const char * name;
+		uint8_t type;
+		uint8_t unit;
+		uint8_t nominal;
+		uint8_t thresh[6];
+		uint8_t linear;
+	} kind[] = {
+		{ "Temp", 0x01, 1,  40, { 0, 90, 80, 0, 5, 10 }, 0x00 },
+		{ "Volt", 0x02, 4, 120, { 0, 140, 132, 0, 100, 108 }, 0x00 },
+		{ "Fan",  0x04, 18, 80, { 0, 0, 0, 0, 10, 20 }, 0x70 },
+	};
+	uint8_t * rec;
+	uint16_t id = 0;
+	int i, k, n;
+
+	for (i = 0; i < sim.snap.sdr_count; i++)
+		if (sim.snap.sdr[i].id >= id)
+			id = sim.snap.sdr[i].id + 1;
+
+	for (i = 0; i < count; i++, id++) {
+		k = i % 3;
+		rec = malloc(SDR_FULL_LEN + 16);
+		if (rec == NULL) {
+			lprintf(LOG_ERR, "ipmisim: malloc failure");
+			return -1;
+		}
+		memset(rec, 0, SDR_FULL_LEN + 16);
+		n = snprintf((char *)rec + SDR_FULL_LEN, 16, "%s %d",
+			     kind[k].name, i / 3 + 1);
+		rec[0] = id & 0xff;
+		rec[1] = id >> 8;
+		rec[2] = 0x51;
+		rec[3] = SDR_RECORD_TYPE_FULL_SENSOR;
+		rec[4] = SDR_FULL_LEN - 5 + n;
+		rec[5] = IPMI_BMC_SLAVE_ADDR;
+		rec[SDR_OFS_NUMBER] = i & 0xff;
+		rec[8] = 0x07;			/* system board */
+		rec[9] = 1 + i / 0x100;
+		rec[10] = 0x7f;			/* scanning, events enabled */
+		rec[11] = 0x68;			/* thresholds readable */
+		rec[12] = kind[k].type;
+		rec[13] = 0x01;			/* threshold reading type */
+		rec[SDR_OFS_READABLE] = 0x1b;	/* LNC LC UNC UC */
+		rec[21] = kind[k].unit;
+		rec[SDR_OFS_LINEAR] = kind[k].linear;
+		rec[SDR_OFS_FACTORS] = 1;	/* M */
+		rec[30] = 0x01;			/* nominal reading given */
+		rec[SDR_OFS_NOMINAL] = kind[k].nominal;
+		rec[34] = 0xff;			/* sensor maximum */
+		memcpy(rec + SDR_OFS_THRESHOLDS, kind[k].thresh, 6);
+		rec[SDR_OFS_ID_CODE] = 0xc0 | n;
+		if (ipmisim_sdr_append(rec) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static struct ipmisim_sdr *
+ipmisim_sdr_sensor(uint8_t number)
+{
+	int i;
+
+	for (i = 0; i < sim.snap.sdr_count; i++) {
+		struct ipmisim_sdr * sdr = &sim.snap.sdr[i];
+
+		if ((sdr->data[3] == SDR_RECORD_TYPE_FULL_SENSOR ||
+		     sdr->data[3] == SDR_RECORD_TYPE_COMPACT_SENSOR) &&
+		    sdr->len > SDR_OFS_NUMBER &&
+		    sdr->data[SDR_OFS_NUMBER] == number)
+			return sdr;
+	}
+	return NULL;
+}
+
+static int
+ipmisim_get_sdr(uint8_t * data, int len, uint8_t * rsp)
+{
+	struct ipmisim_sdr * sdr = NULL;
+	uint16_t resv, id, next;
+	int i, offset, count;
+
+	if (len < 6) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	resv = data[0] | (data[1] << 8);
+	id = data[2] | (data[3] << 8);
+	offset = data[4];
+	count = data[5];
+
+	if (offset != 0 && resv != sim.snap.sdr_resv) {
+		rsp[0] = 0xc5;
+		return 1;
+	}
+	for (i = 0; i < sim.snap.sdr_count; i++) {
+		if (id == 0 || sim.snap.sdr[i].id == id ||
+		    (id == 0xffff && i == sim.snap.sdr_count - 1)) {
+			sdr = &sim.snap.sdr[i];
+			break;
+		}
+	}
+	if (sdr == NULL) {
+		rsp[0] = 0xcb;
+		return 1;
+	}
+	if (offset > sdr->len) {
+		rsp[0] = 0xc9;
+		return 1;
+	}
+	if (count == GET_SDR_ENTIRE_RECORD || offset + count > sdr->len)
+		count = sdr->len - offset;
+
+	next = (i + 1 < sim.snap.sdr_count) ? sim.snap.sdr[i + 1].id : 0xffff;
+	rsp[0] = 0;
+	rsp[1] = next & 0xff;
+	rsp[2] = next >> 8;
+	memcpy(rsp + 3, sdr->data + offset, count);
+	return 3 + count;
+}
+
+static int
+ipmisim_get_sel(uint8_t * data, int len, uint8_t * rsp)
+{
+	uint16_t id, next;
+	int i, offset, count;
+
+	if (len < 6) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	id = data[2] | (data[3] << 8);
+	offset = data[4];
+	count = data[5];
+
+	if (sim.snap.sel_count == 0) {
+		rsp[0] = 0xcb;
+		return 1;
+	}
+	if (id == 0)
+		i = 0;
+	else if (id == 0xffff)
+		i = sim.snap.sel_count - 1;
+	else
+		i = id - 1;
+	if (i >= sim.snap.sel_count) {
+		rsp[0] = 0xcb;
+		return 1;
+	}
+	if (offset > 16) {
+		rsp[0] = 0xc9;
+		return 1;
+	}
+	if (count == 0xff || offset + count > 16)
+		count = 16 - offset;
+
+	/* record IDs are positions, whatever the snapshot said */
+	sim.snap.sel[i * 16] = (i + 1) & 0xff;
+	sim.snap.sel[i * 16 + 1] = (i + 1) >> 8;
+
+	next = (i + 1 < sim.snap.sel_count) ? i + 2 : 0xffff;
+	rsp[0] = 0;
+	rsp[1] = next & 0xff;
+	rsp[2] = next >> 8;
+	memcpy(rsp + 3, sim.snap.sel + i * 16 + offset, count);
+	return 3 + count;
+}
+
+static int
+ipmisim_add_sel(uint8_t * data, int len, uint8_t * rsp)
+{
+	uint8_t * sel;
+	int i;
+
+	if (len < 16) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	if (sim.snap.sel_count == sim.snap.sel_max) {
+		sel = realloc(sim.snap.sel, (sim.snap.sel_max + 64) * 16);
+		if (sel == NULL) {
+			rsp[0] = 0xc4;	/* out of space */
+			return 1;
+		}
+		sim.snap.sel = sel;
+		sim.snap.sel_max += 64;
+	}
+	i = sim.snap.sel_count++;
+	memcpy(sim.snap.sel + i * 16, data, 16);
+	sim.snap.sel[i * 16] = (i + 1) & 0xff;
+	sim.snap.sel[i * 16 + 1] = (i + 1) >> 8;
+	rsp[0] = 0;
+	rsp[1] = (i + 1) & 0xff;
+	rsp[2] = (i + 1) >> 8;
+	return 3;
+}
+
+static int
+ipmisim_sensor_reading(uint8_t * data, int len, uint8_t * rsp)
+{
+	struct ipmisim_sdr * sdr;
+
+	if (len < 1) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	sdr = ipmisim_sdr_sensor(data[0]);
+	if (sdr == NULL) {
+		rsp[0] = 0xcb;
+		return 1;
+	}
+	rsp[0] = 0;
+	rsp[1] = 0;
+	rsp[2] = 0xc0;		/* events and scanning enabled */
+	rsp[3] = 0;
+	rsp[4] = 0x80;
+	if (sdr->data[3] == SDR_RECORD_TYPE_FULL_SENSOR &&
+	    sdr->len > SDR_OFS_NOMINAL)
+		rsp[1] = sdr->data[SDR_OFS_NOMINAL];
+	/* with -w every fourth sensor steps through nominal -1, 0, +1 */
+	if (sim.wander > 0 && (data[0] & 3) == 0)
+		rsp[1] += (int)((ipmisim_msec() / sim.wander + data[0]) % 3) - 1;
+	return 5;
+}
+
+static int
+ipmisim_sensor_factors(uint8_t * data, int len, uint8_t * rsp)
+{
+	struct ipmisim_sdr * sdr;
+
+	if (len < 2) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	sdr = ipmisim_sdr_sensor(data[0]);
+	if (sdr == NULL || sdr->data[3] != SDR_RECORD_TYPE_FULL_SENSOR ||
+	    sdr->len < SDR_OFS_FACTORS + 6) {
+		rsp[0] = 0xcb;
+		return 1;
+	}
+	/* the same factors for every reading */
+	rsp[0] = 0;
+	rsp[1] = 0;		/* next reading */
+	memcpy(rsp + 2, sdr->data + SDR_OFS_FACTORS, 6);
+	return 8;
+}
+
+static int
+ipmisim_sensor_thresholds(uint8_t * data, int len, uint8_t * rsp)
+{
+	struct ipmisim_sdr * sdr;
+	uint8_t * t;
+
+	if (len < 1) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	sdr = ipmisim_sdr_sensor(data[0]);
+	if (sdr == NULL || sdr->data[3] != SDR_RECORD_TYPE_FULL_SENSOR ||
+	    sdr->len < SDR_OFS_THRESHOLDS + 6) {
+		rsp[0] = 0xcb;
+		return 1;
+	}
+	t = sdr->data + SDR_OFS_THRESHOLDS;
+	rsp[0] = 0;
+	rsp[1] = sdr->data[SDR_OFS_READABLE] & 0x3f;
+	rsp[2] = t[5];	/* LNC */
+	rsp[3] = t[4];	/* LC */
+	rsp[4] = t[3];	/* LNR */
+	rsp[5] = t[2];	/* UNC */
+	rsp[6] = t[1];	/* UC */
+	rsp[7] = t[0];	/* UNR */
+	return 8;
+}
+
+static int
+ipmisim_app_cmd(uint8_t cmd, uint8_t * data, int len, uint8_t * rsp)
+{
+	switch (cmd) {
+	case BMC_GET_DEVICE_ID:
+		memset(rsp, 0, 16);
+		rsp[1] = 0x20;		/* device ID */
+		rsp[2] = 0x01;		/* device revision */
+		rsp[3] = 0x01;		/* firmware 1.00 */
+		rsp[5] = 0x02;		/* IPMI 2.0 */
+		rsp[6] = 0x8f;		/* chassis, FRU, SEL, SDR, sensors */
+		return 16;
+	case BMC_GET_SELF_TEST:
+		rsp[0] = 0;
+		rsp[1] = 0x55;		/* no error */
+		rsp[2] = 0;
+		return 3;
+	case BMC_GET_GUID:
+		rsp[0] = 0;
+		memcpy(rsp + 1, sim.guid, 16);
+		return 17;
+	}
+	rsp[0] = 0xc1;
+	return 1;
+}
+
+static int
+ipmisim_chassis_cmd(uint8_t cmd, uint8_t * data, int len, uint8_t * rsp)
+{
+	switch (cmd) {
+	case 0x01:	/* Get Chassis Status */
+		rsp[0] = 0;
+		rsp[1] = sim.snap.power;
+		rsp[2] = 0;
+		rsp[3] = 0;
+		rsp[4] = 0;
+		return 5;
+	case 0x02:	/* Chassis Control */
+		if (len < 1) {
+			rsp[0] = 0xc7;
+			return 1;
+		}
+		switch (data[0] & 0xf) {
+		case IPMI_CHASSIS_CTL_POWER_DOWN:
+		case IPMI_CHASSIS_CTL_ACPI_SOFT:
+			sim.snap.power = 0;
+			break;
+		case IPMI_CHASSIS_CTL_POWER_UP:
+		case IPMI_CHASSIS_CTL_POWER_CYCLE:
+		case IPMI_CHASSIS_CTL_HARD_RESET:
+			sim.snap.power = 1;
+			break;
+		}
+		rsp[0] = 0;
+		return 1;
+	}
+	rsp[0] = 0xc1;
+	return 1;
+}
+
+static int
+ipmisim_storage_cmd(uint8_t cmd, uint8_t * data, int len, uint8_t * rsp)
+{
+	int n, offset;
+	uint32_t now;
+
+	switch (cmd) {
+	case GET_FRU_INFO:
+		if (len < 1 || data[0] != 0 || sim.snap.fru == NULL) {
+			rsp[0] = 0xcb;
+			return 1;
+		}
+		rsp[0] = 0;
+		rsp[1] = sim.snap.fru_len & 0xff;
+		rsp[2] = (sim.snap.fru_len >> 8) & 0xff;
+		rsp[3] = 0;		/* byte access */
+		return 4;
+	case GET_FRU_DATA:
+		if (len < 4) {
+			rsp[0] = 0xc7;
+			return 1;
+		}
+		if (data[0] != 0 || sim.snap.fru == NULL) {
+			rsp[0] = 0xcb;
+			return 1;
+		}
+		offset = data[1] | (data[2] << 8);
+		n = data[3];
+		if (offset >= sim.snap.fru_len) {
+			rsp[0] = 0xc9;
+			return 1;
+		}
+		if (offset + n > sim.snap.fru_len)
+			n = sim.snap.fru_len - offset;
+		rsp[0] = 0;
+		rsp[1] = n;
+		memcpy(rsp + 2, sim.snap.fru + offset, n);
+		return 2 + n;
+	case GET_SDR_REPO_INFO:
+		memset(rsp, 0, 15);
+		rsp[1] = 0x51;
+		rsp[2] = sim.snap.sdr_count & 0xff;
+		rsp[3] = sim.snap.sdr_count >> 8;
+		rsp[6] = sim.snap.sdr_stamp & 0xff;
+		rsp[7] = (sim.snap.sdr_stamp >> 8) & 0xff;
+		rsp[8] = (sim.snap.sdr_stamp >> 16) & 0xff;
+		rsp[9] = (sim.snap.sdr_stamp >> 24) & 0xff;
+		rsp[14] = 0x02;		/* reserve supported */
+		return 15;
+	case GET_SDR_RESERVE_REPO:
+		if (++sim.snap.sdr_resv == 0)
+			sim.snap.sdr_resv++;
+		rsp[0] = 0;
+		rsp[1] = sim.snap.sdr_resv & 0xff;
+		rsp[2] = sim.snap.sdr_resv >> 8;
+		return 3;
+	case GET_SDR:
+		return ipmisim_get_sdr(data, len, rsp);
+	case IPMI_CMD_GET_SEL_INFO:
+		memset(rsp, 0, 15);
+		rsp[1] = 0x51;
+		rsp[2] = sim.snap.sel_count & 0xff;
+		rsp[3] = sim.snap.sel_count >> 8;
+		rsp[4] = 0xff;		/* free space */
+		rsp[5] = 0xff;
+		rsp[14] = 0x02;		/* reserve supported */
+		return 15;
+	case IPMI_CMD_RESERVE_SEL:
+		if (++sim.snap.sel_resv == 0)
+			sim.snap.sel_resv++;
+		rsp[0] = 0;
+		rsp[1] = sim.snap.sel_resv & 0xff;
+		rsp[2] = sim.snap.sel_resv >> 8;
+		return 3;
+	case IPMI_CMD_GET_SEL_ENTRY:
+		return ipmisim_get_sel(data, len, rsp);
+	case IPMI_CMD_ADD_SEL_ENTRY:
+		return ipmisim_add_sel(data, len, rsp);
+	case IPMI_CMD_CLEAR_SEL:
+		if (len < 6) {
+			rsp[0] = 0xc7;
+			return 1;
+		}
+		if ((data[0] | (data[1] << 8)) != sim.snap.sel_resv) {
+			rsp[0] = 0xc5;
+			return 1;
+		}
+		if (data[5] == 0xaa)
+			sim.snap.sel_count = 0;
+		rsp[0] = 0;
+		rsp[1] = 0x01;		/* erasure completed */
+		return 2;
+	case IPMI_CMD_GET_SEL_TIME:
+		now = time(NULL);
+		rsp[0] = 0;
+		rsp[1] = now & 0xff;
+		rsp[2] = (now >> 8) & 0xff;
+		rsp[3] = (now >> 16) & 0xff;
+		rsp[4] = (now >> 24) & 0xff;
+		return 5;
+	}
+	rsp[0] = 0xc1;
+	return 1;
+}
+
+/* ipmisim_handle_cmd  -  answer a request inside an active session
+ *
+ * @s:		session
+ * @netfn:	request network function
+ * @cmd:	request command
+ * @data:	request data
+ * @data_len:	request data length
+ * @rsp:	completion code followed by response data
+ *
+ * returns response length
+ */
+int
+ipmisim_handle_cmd(struct ipmisim_session * s, uint8_t netfn, uint8_t cmd,
+		uint8_t * data, int data_len, uint8_t * rsp)
+{
+	switch (netfn) {
+	case IPMI_NETFN_APP:
+		if (cmd == IPMI_ACTIVATE_PAYLOAD)
+			return ipmisim_sol_activate(s, data, data_len, rsp);
+		if (cmd == IPMI_DEACTIVATE_PAYLOAD)
+			return ipmisim_sol_deactivate(s, data, data_len, rsp);
+		return ipmisim_app_cmd(cmd, data, data_len, rsp);
+	case IPMI_NETFN_CHASSIS:
+		return ipmisim_chassis_cmd(cmd, data, data_len, rsp);
+	case IPMI_NETFN_SE:
+		if (cmd == GET_SENSOR_READING)
+			return ipmisim_sensor_reading(data, data_len, rsp);
+		if (cmd == GET_SENSOR_THRESHOLDS)
+			return ipmisim_sensor_thresholds(data, data_len, rsp);
+		if (cmd == GET_SENSOR_FACTORS)
+			return ipmisim_sensor_factors(data, data_len, rsp);
+		break;
+	case IPMI_NETFN_STORAGE:
+		return ipmisim_storage_cmd(cmd, data, data_len, rsp);
+	}
+	rsp[0] = 0xc1;
+	return 1;
+}
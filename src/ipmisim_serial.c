@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#define _GNU_SOURCE	/* posix_openpt, cfmakeraw */
+
+/*
+ * Serial Interface, Basic Mode on a pseudo terminal, for the
+ * serial-basic interface.  Responses can be paced at a line rate, so
+ * transport throughput is measured as it would be on a real port.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include <ipmitool/log.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_constants.h>
+
+#include "ipmisim.h"
+
+#define BM_START		0xA0
+#define BM_STOP			0xA5
+#define BM_HANDSHAKE		0xA6
+#define BM_ESCAPE		0xAA
+
+#define IPMISIM_BM_MAX_MSG	64
+#define IPMISIM_BM_QUEUE	64
+
+struct ipmisim_bm_frame {
+	uint64_t due;		/* us, when the last byte is on the line */
+	int len;
+	uint8_t data[IPMISIM_BM_MAX_MSG * 2 + 2];
+};
+
+static struct {
+	int slave;		/* kept open so the pty outlives its clients */
+	int baud;
+	uint64_t line_free;	/* us, when the line to the console is idle */
+
+	uint8_t msg[IPMISIM_BM_MAX_MSG];
+	int len;
+	int state;		/* 0 = idle, 1 = in message, 2 = after escape */
+
+	struct ipmisim_bm_frame queue[IPMISIM_BM_QUEUE];
+	int head;
+	int count;
+
+	unsigned long requests;
+	unsigned long dropped;
+	unsigned long rx;	/* bytes */
+	unsigned long tx;
+} bm;
+
+static struct ipmisim_session bm_session;
+
+/* ipmisim_serial_byte_time  -  microseconds per character at the line rate */
+static uint64_t
+ipmisim_serial_byte_time(int len)
+{
+	if (bm.baud <= 0)
+		return 0;
+	return (uint64_t)len * 10 * 1000000 / bm.baud;
+}
+
+/* ipmisim_serial_open  -  create the pseudo terminal
+ *
+ * @baud:	line rate to pace responses at, 0 for none
+ *
+ * returns the master side descriptor, -1 on error
+ */
+int
+ipmisim_serial_open(int baud)
+{
+	struct termios ti;
+	char * name;
+	int fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0 ||
+	    (name = ptsname(fd)) == NULL) {
+		lperror(LOG_ERR, "Unable to create a pseudo terminal");
+		return -1;
+	}
+	bm.slave = open(name, O_RDWR | O_NOCTTY);
+	if (bm.slave < 0) {
+		lperror(LOG_ERR, "Unable to open %s", name);
+		close(fd);
+		return -1;
+	}
+	tcgetattr(bm.slave, &ti);
+	cfmakeraw(&ti);
+	tcsetattr(bm.slave, TCSANOW, &ti);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	bm.baud = baud;
+	bm_session.state = IPMISIM_ACTIVE;
+	bm_session.privlvl = IPMI_SESSION_PRIV_ADMIN;
+
+	lprintf(LOG_NOTICE, "Serial basic mode on %s", name);
+	return fd;
+}
+
+/* ipmisim_serial_queue  -  escape and frame a response */
+static void
+ipmisim_serial_queue(const uint8_t * msg, int len, int latency,
+		uint64_t arrived)
+{
+	struct ipmisim_bm_frame * f;
+	uint64_t start;
+	int i;
+
+	if (bm.count == IPMISIM_BM_QUEUE) {
+		bm.dropped++;
+		return;
+	}
+	f = &bm.queue[(bm.head + bm.count++) % IPMISIM_BM_QUEUE];
+	f->len = 0;
+	f->data[f->len++] = BM_START;
+	for (i = 0; i < len; i++) {
+		switch (msg[i]) {
+		case BM_START:
+		case BM_STOP:
+		case BM_HANDSHAKE:
+		case BM_ESCAPE:
+		case 0x1B:
+			f->data[f->len++] = BM_ESCAPE;
+			f->data[f->len++] = (msg[i] == 0x1B) ? 0x3B : msg[i] + 0x10;
+			break;
+		default:
+			f->data[f->len++] = msg[i];
+		}
+	}
+	f->data[f->len++] = BM_STOP;
+
+	start = arrived + (uint64_t)latency * 1000;
+	if (start < bm.line_free)
+		start = bm.line_free;
+	f->due = start + ipmisim_serial_byte_time(f->len);
+	bm.line_free = f->due;
+}
+
+/* ipmisim_serial_request  -  answer one IPMB request */
+static void
+ipmisim_serial_request(int latency, int loss, uint64_t arrived)
+{
+	uint8_t * m = bm.msg;
+	uint8_t rsp[IPMISIM_BM_MAX_MSG + IPMI_BUF_SIZE];
+	int n;
+
+	if (bm.len < 7 || ipmi_csum(m, 3) != 0 ||
+	    ipmi_csum(m + 3, bm.len - 3) != 0) {
+		lprintf(LOG_INFO, "Dropping serial message with bad checksum");
+		return;
+	}
+	bm.requests++;
+	if (verbose > 2)
+		printbuf(m, bm.len, "<< serial request");
+
+	n = ipmisim_handle_cmd(&bm_session, m[1] >> 2, m[5],
+			m + 6, bm.len - 7, rsp + 6);
+	if (n > IPMISIM_BM_MAX_MSG - 7)
+		n = IPMISIM_BM_MAX_MSG - 7;
+
+	rsp[0] = m[3];				/* rqSA */
+	rsp[1] = (((m[1] >> 2) + 1) << 2) | (m[4] & 3);
+	rsp[2] = -(rsp[0] + rsp[1]);
+	rsp[3] = m[0];				/* rsSA */
+	rsp[4] = (m[4] & ~3) | (m[1] & 3);
+	rsp[5] = m[5];
+	rsp[6 + n] = ipmi_csum(rsp + 3, n + 3);
+
+	if (loss > 0 && (random() % 100) < loss) {
+		bm.dropped++;
+		return;
+	}
+	if (verbose > 2)
+		printbuf(rsp, n + 7, ">> serial response");
+	ipmisim_serial_queue(rsp, n + 7, latency, arrived);
+}
+
+/* ipmisim_serial_read  -  take requests from the console
+ *
+ * @fd:		master side of the pseudo terminal
+ * @latency:	ms before a response starts
+ * @loss:	percentage of responses to lose
+ */
+void
+ipmisim_serial_read(int fd, int latency, int loss)
+{
+	uint8_t buf[512];
+	uint64_t now;
+	int i, n;
+
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		bm.rx += n;
+		now = ipmisim_msec() * 1000;
+		/* the request is complete once its last byte came in */
+		now += ipmisim_serial_byte_time(n);
+		for (i = 0; i < n; i++) {
+			if (buf[i] == BM_START) {
+				bm.state = 1;
+				bm.len = 0;
+			} else if (bm.state == 0 || buf[i] == BM_HANDSHAKE) {
+				continue;
+			} else if (bm.state == 2) {
+				bm.state = 1;
+				if (bm.len < IPMISIM_BM_MAX_MSG)
+					bm.msg[bm.len++] = (buf[i] == 0x3B) ?
+						0x1B : buf[i] - 0x10;
+			} else if (buf[i] == BM_ESCAPE) {
+				bm.state = 2;
+			} else if (buf[i] == BM_STOP) {
+				bm.state = 0;
+				ipmisim_serial_request(latency, loss, now);
+			} else if (bm.len < IPMISIM_BM_MAX_MSG) {
+				bm.msg[bm.len++] = buf[i];
+			}
+		}
+	}
+}
+
+/* ipmisim_serial_flush  -  write the responses that are due
+ *
+ * returns ms until the next response is due
+ * returns -1 if there is none
+ */
+int
+ipmisim_serial_flush(int fd)
+{
+	struct ipmisim_bm_frame * f;
+	uint64_t now;
+
+	while (bm.count > 0) {
+		f = &bm.queue[bm.head];
+		now = ipmisim_msec() * 1000;
+		if (f->due > now)
+			return (f->due - now + 999) / 1000;
+		if (write(fd, f->data, f->len) != f->len)
+			lperror(LOG_INFO, "serial write");
+		bm.tx += f->len;
+		bm.head = (bm.head + 1) % IPMISIM_BM_QUEUE;
+		bm.count--;
+	}
+	return -1;
+}
+
+/* ipmisim_serial_stats  -  report what went over the line */
+void
+ipmisim_serial_stats(void)
+{
+	lprintf(LOG_NOTICE, "serial: %lu requests, %lu responses dropped, "
+		"%lu bytes in, %lu bytes out", bm.requests, bm.dropped,
+		bm.rx, bm.tx);
+}
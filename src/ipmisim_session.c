@@ -0,0 +1,867 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include <ipmitool/log.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_constants.h>
+#include <ipmitool/ipmi_intf.h>
+
+#include "ipmisim.h"
+
+#define IPMISIM_AUTH_RAKP_HMAC_SHA1	0x01
+#define IPMISIM_INTEGRITY_HMAC_SHA1_96	0x01
+#define IPMISIM_CRYPT_AES_CBC_128	0x01
+#define IPMISIM_MAX_PRIV		IPMI_SESSION_PRIV_ADMIN
+
+#define IPMISIM_AUTHTYPES	((1 << IPMI_SESSION_AUTHTYPE_NONE) | \
+				 (1 << IPMI_SESSION_AUTHTYPE_MD5) | \
+				 (1 << IPMI_SESSION_AUTHTYPE_PASSWORD))
+
+static uint32_t
+get32(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void
+put32(uint8_t * p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+static void
+ipmisim_random(uint8_t * buf, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = random() & 0xff;
+}
+
+static struct ipmisim_session *
+ipmisim_session_find(uint32_t id)
+{
+	int i;
+
+	if (id == 0)
+		return NULL;
+	for (i = 0; i < IPMISIM_MAX_SESSIONS; i++) {
+		if (sim.session[i].state != IPMISIM_FREE &&
+		    sim.session[i].id == id)
+			return &sim.session[i];
+	}
+	return NULL;
+}
+
+static uint32_t
+ipmisim_session_id(void)
+{
+	uint32_t id;
+
+	do {
+		id = (uint32_t)random() ^ ((uint32_t)random() << 16);
+	} while (id == 0 || ipmisim_session_find(id) != NULL);
+	return id;
+}
+
+/* ipmisim_session_alloc  -  take a free session slot
+ *
+ * Slots left behind by consoles that never closed their session
+ * are reused once they have been idle for IPMISIM_SESSION_IDLE.
+ *
+ * returns NULL when all slots are busy
+ */
+static struct ipmisim_session *
+ipmisim_session_alloc(int v2)
+{
+	struct ipmisim_session * s = NULL;
+	time_t now = time(NULL);
+	int i;
+
+	for (i = 0; i < IPMISIM_MAX_SESSIONS; i++) {
+		if (sim.session[i].state == IPMISIM_FREE) {
+			s = &sim.session[i];
+			break;
+		}
+		if (sim.session[i].last + IPMISIM_SESSION_IDLE < now &&
+		    (s == NULL || sim.session[i].last < s->last))
+			s = &sim.session[i];
+	}
+	if (s == NULL)
+		return NULL;
+
+	if (s->state != IPMISIM_FREE)
+		lprintf(LOG_INFO, "Reclaiming idle session 0x%08x", s->id);
+
+	memset(s, 0, sizeof(*s));
+	s->v2 = v2;
+	s->last = now;
+	s->id = ipmisim_session_id();
+	s->privlvl = IPMI_SESSION_PRIV_USER;
+	return s;
+}
+
+/* ipmisim_authcode  -  IPMI v1.5 authcode of a message
+ *
+ * @authtype:	session authentication type
+ * @sid:	session ID field of the packet
+ * @msg:	IPMI message
+ * @len:	IPMI message length
+ * @seq:	session sequence field of the packet
+ * @out:	16 byte authcode
+ */
+static void
+ipmisim_authcode(uint8_t authtype, const uint8_t * sid, const uint8_t * msg,
+		int len, const uint8_t * seq, uint8_t * out)
+{
+	EVP_MD_CTX * ctx;
+
+	switch (authtype) {
+	case IPMI_SESSION_AUTHTYPE_PASSWORD:
+		memcpy(out, sim.password, 16);
+		break;
+	case IPMI_SESSION_AUTHTYPE_MD5:
+		ctx = EVP_MD_CTX_create();
+		if (ctx == NULL) {
+			memset(out, 0, 16);
+			break;
+		}
+		EVP_DigestInit_ex(ctx, EVP_md5(), NULL);
+		EVP_DigestUpdate(ctx, sim.password, 16);
+		EVP_DigestUpdate(ctx, sid, 4);
+		EVP_DigestUpdate(ctx, msg, len);
+		EVP_DigestUpdate(ctx, seq, 4);
+		EVP_DigestUpdate(ctx, sim.password, 16);
+		EVP_DigestFinal_ex(ctx, out, NULL);
+		EVP_MD_CTX_destroy(ctx);
+		break;
+	default:
+		memset(out, 0, 16);
+		break;
+	}
+}
+
+static void
+ipmisim_hmac(const uint8_t * key, const uint8_t * data, int len, uint8_t * md)
+{
+	unsigned int md_len;
+
+	HMAC(EVP_sha1(), key, 20, data, len, md, &md_len);
+}
+
+/* ipmisim_aes  -  AES-CBC-128 in either direction, no padding
+ *
+ * returns number of bytes written
+ * returns -1 on error
+ */
+static int
+ipmisim_aes(int enc, const uint8_t * key, const uint8_t * iv,
+		const uint8_t * in, int len, uint8_t * out)
+{
+	EVP_CIPHER_CTX * ctx;
+	int n = -1, tmp;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL)
+		return -1;
+	if (EVP_CipherInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv, enc) &&
+	    EVP_CIPHER_CTX_set_padding(ctx, 0) &&
+	    EVP_CipherUpdate(ctx, out, &n, in, len) &&
+	    EVP_CipherFinal_ex(ctx, out + n, &tmp))
+		n += tmp;
+	else
+		n = -1;
+	EVP_CIPHER_CTX_free(ctx);
+	return n;
+}
+
+/* ipmisim_session_cmd  -  session management commands
+ *
+ * @s:		session the request arrived on, NULL outside a session
+ * @cmd:	application command
+ * @data:	request data
+ * @len:	request data length
+ * @rsp:	completion code followed by response data
+ *
+ * returns response length
+ * returns 0 if @cmd is not a session command
+ * returns -1 if the request must be ignored
+ */
+static int
+ipmisim_session_cmd(struct ipmisim_session * s, uint8_t cmd,
+		uint8_t * data, int len, uint8_t * rsp)
+{
+	struct ipmisim_session * t;
+	uint32_t seq;
+
+	switch (cmd) {
+	case 0x38:	/* Get Channel Authentication Capabilities */
+		if (len < 2)
+			break;
+		memset(rsp, 0, 9);
+		rsp[1] = 0x01;		/* LAN channel */
+		rsp[2] = IPMISIM_AUTHTYPES | (data[0] & 0x80);
+		rsp[3] = IPMI_AUTHSTATUS_NONNULL_USERS_ENABLED;
+		if (sim.username[0] == 0)
+			rsp[3] |= IPMI_AUTHSTATUS_NULL_USERS_ENABLED;
+		rsp[4] = (data[0] & 0x80) ? 0x02 : 0;
+		return 9;
+
+	case 0x39:	/* Get Session Challenge */
+		if (len < 17)
+			break;
+		if (!(IPMISIM_AUTHTYPES & (1 << (data[0] & 0xf)))) {
+			rsp[0] = 0xcc;
+			return 1;
+		}
+		if (strncmp((char *)data + 1, sim.username, 16) != 0) {
+			rsp[0] = 0x81;
+			return 1;
+		}
+		t = ipmisim_session_alloc(0);
+		if (t == NULL) {
+			rsp[0] = 0xc0;
+			return 1;
+		}
+		t->state = IPMISIM_CHALLENGE;
+		t->authtype = data[0] & 0xf;
+		ipmisim_random(t->challenge, 16);
+		rsp[0] = 0;
+		put32(rsp + 1, t->id);
+		memcpy(rsp + 5, t->challenge, 16);
+		return 21;
+
+	case 0x3a:	/* Activate Session */
+		if (s == NULL || s->state != IPMISIM_CHALLENGE)
+			return -1;
+		if (len < 22)
+			break;
+		if (memcmp(data + 2, s->challenge, 16) != 0) {
+			rsp[0] = 0xcc;
+			return 1;
+		}
+		if ((data[1] & 0xf) > IPMISIM_MAX_PRIV) {
+			rsp[0] = 0x86;
+			return 1;
+		}
+		s->state = IPMISIM_ACTIVE;
+		s->privlvl = data[1] & 0xf;
+		s->id = ipmisim_session_id();
+		s->out_seq = get32(data + 18);
+		do {
+			seq = random();
+		} while (seq == 0);
+		rsp[0] = 0;
+		rsp[1] = s->authtype;
+		put32(rsp + 2, s->id);
+		put32(rsp + 6, seq);
+		rsp[10] = IPMISIM_MAX_PRIV;
+		return 11;
+
+	case 0x3b:	/* Set Session Privilege Level */
+		if (s == NULL)
+			return -1;
+		if (len < 1)
+			break;
+		if ((data[0] & 0xf) > IPMISIM_MAX_PRIV) {
+			rsp[0] = 0x81;
+			return 1;
+		}
+		if (data[0] & 0xf)
+			s->privlvl = data[0] & 0xf;
+		rsp[0] = 0;
+		rsp[1] = s->privlvl;
+		return 2;
+
+	case 0x3c:	/* Close Session */
+		if (s == NULL)
+			return -1;
+		if (len < 4)
+			break;
+		t = ipmisim_session_find(get32(data));
+		if (t == NULL) {
+			rsp[0] = 0x87;
+			return 1;
+		}
+		/* the reply still goes out with this session's credentials */
+		t->state = IPMISIM_FREE;
+		lprintf(LOG_INFO, "Closed session 0x%08x", t->id);
+		rsp[0] = 0;
+		return 1;
+
+	default:
+		return 0;
+	}
+
+	rsp[0] = 0xc7;	/* request data length invalid */
+	return 1;
+}
+
+/* ipmisim_ipmi_msg  -  answer one IPMI request message
+ *
+ * @s:		session the request arrived on, NULL outside a session
+ * @msg:	request message, from the responder address on
+ * @len:	request message length
+ * @out:	response message
+ *
+ * returns response message length
+ * returns -1 if the request must be ignored
+ */
+static int
+ipmisim_ipmi_msg(struct ipmisim_session * s, uint8_t * msg, int len,
+		uint8_t * out)
+{
+	uint8_t rsp[IPMI_BUF_SIZE];
+	uint8_t netfn, cmd;
+	int n, x;
+
+	if (len < 7 || ipmi_csum(msg, 3) != 0 || ipmi_csum(msg + 3, len - 3) != 0) {
+		lprintf(LOG_INFO, "Dropping message with bad checksum");
+		return -1;
+	}
+
+	netfn = msg[1] >> 2;
+	cmd = msg[5];
+	lprintf(LOG_DEBUG, "Request netfn 0x%02x cmd 0x%02x (%d bytes)",
+		netfn, cmd, len - 7);
+
+	n = 0;
+	if (netfn == IPMI_NETFN_APP)
+		n = ipmisim_session_cmd(s, cmd, msg + 6, len - 7, rsp);
+	if (n < 0)
+		return -1;
+	if (n == 0) {
+		/* everything else needs an established session */
+		if (s == NULL || s->state != IPMISIM_ACTIVE)
+			return -1;
+		n = ipmisim_handle_cmd(s, netfn, cmd, msg + 6, len - 7, rsp);
+	}
+	if (n > IPMI_BUF_SIZE - 64) {
+		rsp[0] = 0xca;
+		n = 1;
+	}
+
+	x = 0;
+	out[x++] = msg[3];
+	out[x++] = ((netfn | 1) << 2) | (msg[4] & 3);
+	out[x] = ipmi_csum(out, x);
+	x++;
+	out[x++] = msg[0];
+	out[x++] = (msg[4] & ~3) | (msg[1] & 3);
+	out[x++] = cmd;
+	memcpy(out + x, rsp, n);
+	x += n;
+	out[x] = ipmi_csum(out + 3, x - 3);
+	x++;
+	return x;
+}
+
+static int
+ipmisim_rmcp_hdr(uint8_t * out, uint8_t class)
+{
+	out[0] = IPMISIM_RMCP_VERSION;
+	out[1] = 0;
+	out[2] = 0xff;
+	out[3] = class;
+	return 4;
+}
+
+/* ipmisim_handle_ping  -  answer an RMCP presence ping */
+static int
+ipmisim_handle_ping(uint8_t * in, int len, uint8_t * out)
+{
+	int x;
+
+	if (len < 12 || in[8] != IPMISIM_ASF_PING ||
+	    (uint32_t)((in[4] << 24) | (in[5] << 16) | (in[6] << 8) | in[7])
+	    != IPMISIM_ASF_IANA)
+		return -1;
+
+	x = ipmisim_rmcp_hdr(out, IPMISIM_RMCP_CLASS_ASF);
+	memset(out + x, 0, 24);
+	memcpy(out + x, in + 4, 4);	/* IANA */
+	out[x + 4] = IPMISIM_ASF_PONG;
+	out[x + 5] = in[9];		/* message tag */
+	out[x + 7] = 16;
+	memcpy(out + x + 8, in + 4, 4);	/* IANA */
+	out[x + 16] = 0x81;		/* IPMI supported, ASF 1.0 */
+	return x + 24;
+}
+
+/* ipmisim_handle_v15  -  IPMI v1.5 session packet
+ *
+ * returns response length
+ * returns -1 if the packet must be ignored
+ */
+static int
+ipmisim_handle_v15(uint8_t * in, int len, uint8_t * out)
+{
+	struct ipmisim_session * s = NULL;
+	uint8_t authcode[16];
+	uint8_t * sid = in + 9;
+	uint8_t * seq = in + 5;
+	uint8_t authtype = in[4];
+	int x = 13, ap = 0, mp, n;
+
+	if (authtype != IPMI_SESSION_AUTHTYPE_NONE)
+		x += 16;
+	if (len < x + 1 || len < x + 1 + in[x])
+		return -1;
+
+	if (get32(sid) != 0) {
+		s = ipmisim_session_find(get32(sid));
+		if (s == NULL || s->v2 || authtype != s->authtype)
+			return -1;
+		ipmisim_authcode(authtype, sid, in + x + 1, in[x], seq, authcode);
+		if (authtype != IPMI_SESSION_AUTHTYPE_NONE &&
+		    memcmp(authcode, in + 13, 16) != 0) {
+			lprintf(LOG_INFO, "Dropping packet with bad authcode "
+				"for session 0x%08x", s->id);
+			return -1;
+		}
+		s->last = time(NULL);
+	}
+
+	/* session header: authtype, sequence, session ID, authcode */
+	mp = 13;
+	if (s != NULL && s->authtype != IPMI_SESSION_AUTHTYPE_NONE) {
+		ap = mp;
+		mp += 16;
+	}
+	n = ipmisim_ipmi_msg(s, in + x + 1, in[x], out + mp + 1);
+	if (n < 0)
+		return -1;
+
+	ipmisim_rmcp_hdr(out, IPMISIM_RMCP_CLASS_IPMI);
+	out[4] = (s != NULL) ? s->authtype : IPMI_SESSION_AUTHTYPE_NONE;
+	put32(out + 5, 0);
+	if (s != NULL && s->state != IPMISIM_CHALLENGE) {
+		put32(out + 5, s->out_seq);
+		if (s->out_seq != 0 && ++s->out_seq == 0)
+			s->out_seq++;
+	}
+	memcpy(out + 9, sid, 4);
+	out[mp] = n;
+	if (ap)
+		ipmisim_authcode(s->authtype, out + 9, out + mp + 1, n,
+				 out + 5, out + ap);
+	return mp + 1 + n;
+}
+
+/* ipmisim_v2_packet  -  frame an RMCP+ payload
+ *
+ * Payloads of an active session are encrypted and authenticated
+ * with the algorithms negotiated for it.
+ *
+ * @s:		active session, NULL during session setup
+ * @type:	payload type
+ * @payload:	payload data
+ * @len:	payload length
+ * @out:	packet buffer
+ *
+ * returns packet length
+ * returns -1 on error
+ */
+int
+ipmisim_v2_packet(struct ipmisim_session * s, uint8_t type,
+		const uint8_t * payload, int len, uint8_t * out)
+{
+	uint8_t buf[IPMI_BUF_SIZE];
+	uint8_t md[20];
+	int x, i, pad;
+
+	x = ipmisim_rmcp_hdr(out, IPMISIM_RMCP_CLASS_IPMI);
+	out[x++] = IPMI_SESSION_AUTHTYPE_RMCP_PLUS;
+	if (s != NULL && s->crypt_alg)
+		type |= 0x80;
+	if (s != NULL && s->integrity_alg)
+		type |= 0x40;
+	out[x++] = type;
+	put32(out + x, (s != NULL) ? s->console_id : 0);
+	x += 4;
+	put32(out + x, (s != NULL) ? s->out_seq++ : 0);
+	x += 4;
+	x += 2;		/* payload length, filled in below */
+
+	if (s != NULL && s->crypt_alg) {
+		if (len + 1 + 16 > (int)sizeof(buf))
+			return -1;
+		memcpy(buf, payload, len);
+		pad = (16 - (len + 1) % 16) % 16;
+		for (i = 0; i < pad; i++)
+			buf[len + i] = i + 1;
+		buf[len + pad] = pad;
+		ipmisim_random(out + x, 16);
+		if (ipmisim_aes(1, s->k2, out + x, buf, len + pad + 1,
+				out + x + 16) < 0)
+			return -1;
+		len += pad + 1 + 16;
+	} else {
+		memcpy(out + x, payload, len);
+	}
+	out[x - 2] = len & 0xff;
+	out[x - 1] = len >> 8;
+	x += len;
+
+	if (s != NULL && s->integrity_alg) {
+		/* pad so that authtype through next header is 4 byte aligned */
+		pad = (4 - (x - 4 + 2) % 4) % 4;
+		memset(out + x, 0xff, pad);
+		x += pad;
+		out[x++] = pad;
+		out[x++] = 0x07;
+		HMAC(EVP_sha1(), s->k1, 20, out + 4, x - 4, md, NULL);
+		memcpy(out + x, md, 12);
+		x += 12;
+	}
+	return x;
+}
+
+/* ipmisim_open_session  -  RMCP+ Open Session Request */
+static int
+ipmisim_open_session(uint8_t * p, int len, uint8_t * out)
+{
+	struct ipmisim_session * s = NULL;
+	uint8_t rsp[36];
+	uint8_t status = IPMISIM_RAKP_OK;
+	int n = 8;
+
+	if (len < 32)
+		return -1;
+
+	if (p[12] > IPMISIM_AUTH_RAKP_HMAC_SHA1)
+		status = IPMISIM_RAKP_BAD_AUTH_ALG;
+	else if (p[20] > IPMISIM_INTEGRITY_HMAC_SHA1_96)
+		status = IPMISIM_RAKP_BAD_INTEGRITY_ALG;
+	else if (p[28] > IPMISIM_CRYPT_AES_CBC_128)
+		status = IPMISIM_RAKP_BAD_CRYPT_ALG;
+	else if ((p[1] & 0xf) > IPMISIM_MAX_PRIV)
+		status = IPMISIM_RAKP_INVALID_ROLE;
+	else if ((s = ipmisim_session_alloc(1)) == NULL)
+		status = IPMISIM_RAKP_NO_RESOURCES;
+
+	memset(rsp, 0, sizeof(rsp));
+	rsp[0] = p[0];
+	rsp[1] = status;
+	rsp[2] = (p[1] & 0xf) ? (p[1] & 0xf) : IPMISIM_MAX_PRIV;
+	memcpy(rsp + 4, p + 4, 4);
+	if (s != NULL) {
+		s->state = IPMISIM_OPENED;
+		s->console_id = get32(p + 4);
+		s->auth_alg = p[12];
+		s->integrity_alg = p[20];
+		s->crypt_alg = p[28];
+		put32(rsp + 8, s->id);
+		rsp[12] = 0;
+		rsp[15] = 8;
+		rsp[16] = s->auth_alg;
+		rsp[20] = 1;
+		rsp[23] = 8;
+		rsp[24] = s->integrity_alg;
+		rsp[28] = 2;
+		rsp[31] = 8;
+		rsp[32] = s->crypt_alg;
+		n = 36;
+		lprintf(LOG_INFO, "Opened session 0x%08x (auth %d, integrity %d, "
+			"crypt %d)", s->id, s->auth_alg, s->integrity_alg,
+			s->crypt_alg);
+	}
+	return ipmisim_v2_packet(NULL, IPMI_PAYLOAD_TYPE_RMCP_OPEN_RESPONSE,
+				 rsp, n, out);
+}
+
+/* ipmisim_rakp1  -  RAKP Message 1, answered with RAKP Message 2 */
+static int
+ipmisim_rakp1(uint8_t * p, int len, uint8_t * out)
+{
+	struct ipmisim_session * s;
+	uint8_t rsp[60], buf[80];
+	uint8_t status = IPMISIM_RAKP_OK;
+	int ulen, n = 8;
+
+	if (len < 28 || len < 28 + p[27])
+		return -1;
+	s = ipmisim_session_find(get32(p + 4));
+	if (s == NULL || !s->v2 ||
+	    (s->state != IPMISIM_OPENED && s->state != IPMISIM_RAKP2_SENT))
+		return -1;
+	s->last = time(NULL);
+
+	ulen = p[27];
+	if (ulen > 16 || ulen != (int)strlen(sim.username) ||
+	    memcmp(p + 28, sim.username, ulen) != 0)
+		status = IPMISIM_RAKP_UNAUTHORIZED_NAME;
+	else if ((p[24] & 0xf) > IPMISIM_MAX_PRIV)
+		status = IPMISIM_RAKP_INVALID_ROLE;
+
+	memset(rsp, 0, sizeof(rsp));
+	rsp[0] = p[0];
+	rsp[1] = status;
+	put32(rsp + 4, s->console_id);
+	if (status != IPMISIM_RAKP_OK) {
+		s->state = IPMISIM_FREE;
+		return ipmisim_v2_packet(NULL, IPMI_PAYLOAD_TYPE_RAKP_2,
+					 rsp, n, out);
+	}
+
+	memcpy(s->rm, p + 8, 16);
+	s->role = p[24];
+	memcpy(s->username, p + 28, ulen);
+	s->username[ulen] = 0;
+	ipmisim_random(s->rc, 16);
+	s->state = IPMISIM_RAKP2_SENT;
+
+	memcpy(rsp + 8, s->rc, 16);
+	memcpy(rsp + 24, sim.guid, 16);
+	n = 40;
+	if (s->auth_alg == IPMISIM_AUTH_RAKP_HMAC_SHA1) {
+		put32(buf, s->console_id);
+		put32(buf + 4, s->id);
+		memcpy(buf + 8, s->rm, 16);
+		memcpy(buf + 24, s->rc, 16);
+		memcpy(buf + 40, sim.guid, 16);
+		buf[56] = s->role;
+		buf[57] = ulen;
+		memcpy(buf + 58, s->username, ulen);
+		ipmisim_hmac(sim.password, buf, 58 + ulen, rsp + 40);
+		n += 20;
+	}
+	return ipmisim_v2_packet(NULL, IPMI_PAYLOAD_TYPE_RAKP_2, rsp, n, out);
+}
+
+/* ipmisim_rakp3  -  RAKP Message 3, answered with RAKP Message 4
+ *
+ * A retransmitted RAKP 3 gets the same RAKP 4 again, the console
+ * cannot tell a lost RAKP 4 from a lost RAKP 3.
+ */
+static int
+ipmisim_rakp3(uint8_t * p, int len, uint8_t * out)
+{
+	struct ipmisim_session * s;
+	uint8_t rsp[20], buf[80], md[20];
+	uint8_t status = IPMISIM_RAKP_OK;
+	int ulen, n = 8;
+
+	if (len < 8)
+		return -1;
+	s = ipmisim_session_find(get32(p + 4));
+	if (s == NULL || !s->v2 ||
+	    (s->state != IPMISIM_RAKP2_SENT && s->state != IPMISIM_ACTIVE))
+		return -1;
+	s->last = time(NULL);
+
+	if (p[1] != IPMISIM_RAKP_OK) {
+		lprintf(LOG_INFO, "Console aborted session 0x%08x: status 0x%02x",
+			s->id, p[1]);
+		s->state = IPMISIM_FREE;
+		return -1;
+	}
+
+	ulen = strlen((char *)s->username);
+	if (s->auth_alg == IPMISIM_AUTH_RAKP_HMAC_SHA1) {
+		memcpy(buf, s->rc, 16);
+		put32(buf + 16, s->console_id);
+		buf[20] = s->role;
+		buf[21] = ulen;
+		memcpy(buf + 22, s->username, ulen);
+		ipmisim_hmac(sim.password, buf, 22 + ulen, md);
+		if (len < 28 || memcmp(md, p + 8, 20) != 0)
+			status = IPMISIM_RAKP_BAD_INTEGRITY;
+	}
+
+	memset(rsp, 0, sizeof(rsp));
+	rsp[0] = p[0];
+	rsp[1] = status;
+	put32(rsp + 4, s->console_id);
+	if (status != IPMISIM_RAKP_OK) {
+		lprintf(LOG_INFO, "RAKP 3 authcode mismatch on session 0x%08x",
+			s->id);
+		s->state = IPMISIM_FREE;
+		return ipmisim_v2_packet(NULL, IPMI_PAYLOAD_TYPE_RAKP_4,
+					 rsp, n, out);
+	}
+
+	if (s->auth_alg == IPMISIM_AUTH_RAKP_HMAC_SHA1) {
+		/* SIK, then K1 and K2 from the SIK */
+		memcpy(buf, s->rm, 16);
+		memcpy(buf + 16, s->rc, 16);
+		buf[32] = s->role;
+		buf[33] = ulen;
+		memcpy(buf + 34, s->username, ulen);
+		ipmisim_hmac(sim.kg[0] ? sim.kg : sim.password, buf,
+			     34 + ulen, s->sik);
+		memset(buf, 0x01, 20);
+		ipmisim_hmac(s->sik, buf, 20, s->k1);
+		memset(buf, 0x02, 20);
+		ipmisim_hmac(s->sik, buf, 20, s->k2);
+
+		memcpy(buf, s->rm, 16);
+		put32(buf + 16, s->id);
+		memcpy(buf + 20, sim.guid, 16);
+		ipmisim_hmac(s->sik, buf, 36, md);
+		memcpy(rsp + 8, md, 12);
+		n += 12;
+	}
+
+	if (s->state != IPMISIM_ACTIVE) {
+		s->privlvl = (s->role & 0xf) ? (s->role & 0xf) : IPMISIM_MAX_PRIV;
+		lprintf(LOG_INFO, "Activated session 0x%08x for user '%s'",
+			s->id, s->username);
+	}
+	n = ipmisim_v2_packet(NULL, IPMI_PAYLOAD_TYPE_RAKP_4, rsp, n, out);
+	s->state = IPMISIM_ACTIVE;
+	return n;
+}
+
+/* ipmisim_handle_v2  -  IPMI v2.0 / RMCP+ packet
+ *
+ * The sender of an authenticated packet is remembered as the remote
+ * console of its session, for SOL output.
+ *
+ * returns response length
+ * returns -1 if the packet must be ignored
+ */
+static int
+ipmisim_handle_v2(uint8_t * in, int len, struct sockaddr * from,
+		socklen_t fromlen, uint8_t * out)
+{
+	struct ipmisim_session * s;
+	uint8_t msg[IPMI_BUF_SIZE], rsp[IPMI_BUF_SIZE];
+	uint8_t md[20];
+	uint8_t type = in[5] & 0x3f;
+	uint8_t * payload = in + 16;
+	int plen, n;
+
+	if (len < 16)
+		return -1;
+	plen = in[14] | (in[15] << 8);
+	if (16 + plen > len)
+		return -1;
+
+	switch (type) {
+	case IPMI_PAYLOAD_TYPE_RMCP_OPEN_REQUEST:
+		return ipmisim_open_session(payload, plen, out);
+	case IPMI_PAYLOAD_TYPE_RAKP_1:
+		return ipmisim_rakp1(payload, plen, out);
+	case IPMI_PAYLOAD_TYPE_RAKP_3:
+		return ipmisim_rakp3(payload, plen, out);
+	case IPMI_PAYLOAD_TYPE_IPMI:
+	case IPMI_PAYLOAD_TYPE_SOL:
+		break;
+	default:
+		lprintf(LOG_INFO, "Unsupported payload type 0x%02x", type);
+		return -1;
+	}
+
+	s = ipmisim_session_find(get32(in + 6));
+	if (s == NULL || !s->v2 || s->state != IPMISIM_ACTIVE)
+		return -1;
+
+	if (s->integrity_alg) {
+		if (!(in[5] & 0x40) || len < 16 + plen + 14)
+			return -1;
+		HMAC(EVP_sha1(), s->k1, 20, in + 4, len - 4 - 12, md, NULL);
+		if (memcmp(md, in + len - 12, 12) != 0) {
+			lprintf(LOG_INFO, "Dropping packet with bad integrity "
+				"data for session 0x%08x", s->id);
+			return -1;
+		}
+	}
+	if (s->crypt_alg) {
+		if (!(in[5] & 0x80) || plen < 32 || plen % 16 != 0)
+			return -1;
+		n = ipmisim_aes(0, s->k2, payload, payload + 16, plen - 16, msg);
+		if (n < 1 || msg[n - 1] >= n)
+			return -1;
+		plen = n - 1 - msg[n - 1];
+		payload = msg;
+	}
+	s->last = time(NULL);
+	memcpy(&s->addr, from, fromlen);
+	s->addrlen = fromlen;
+
+	if (type == IPMI_PAYLOAD_TYPE_SOL) {
+		n = ipmisim_sol_packet(s, payload, plen, rsp);
+		if (n < 0)
+			return -1;
+		return ipmisim_v2_packet(s, IPMI_PAYLOAD_TYPE_SOL, rsp, n, out);
+	}
+
+	n = ipmisim_ipmi_msg(s, payload, plen, rsp);
+	if (n < 0)
+		return -1;
+	return ipmisim_v2_packet(s, IPMI_PAYLOAD_TYPE_IPMI, rsp, n, out);
+}
+
+/* ipmisim_handle_packet  -  answer one RMCP datagram
+ *
+ * @in:		received datagram
+ * @in_len:	datagram length
+ * @from:	sender address
+ * @fromlen:	sender address length
+ * @out:	response datagram, IPMI_BUF_SIZE bytes
+ *
+ * returns response length
+ * returns -1 if nothing is to be sent back
+ */
+int
+ipmisim_handle_packet(uint8_t * in, int in_len, struct sockaddr * from,
+		socklen_t fromlen, uint8_t * out)
+{
+	if (in_len < 4 || in[0] != IPMISIM_RMCP_VERSION)
+		return -1;
+
+	switch (in[3] & 0x1f) {
+	case IPMISIM_RMCP_CLASS_ASF:
+		return ipmisim_handle_ping(in, in_len, out);
+	case IPMISIM_RMCP_CLASS_IPMI:
+		if (in_len < 14)
+			return -1;
+		if (in[4] == IPMI_SESSION_AUTHTYPE_RMCP_PLUS)
+			return ipmisim_handle_v2(in, in_len, from, fromlen,
+					out);
+		return ipmisim_handle_v15(in, in_len, out);
+	default:
+		return -1;
+	}
+}
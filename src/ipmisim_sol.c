@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <ipmitool/log.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_constants.h>
+
+#include "ipmisim.h"
+
+#define IPMISIM_SOL_INSTANCE	1
+#define IPMISIM_SOL_RETRY_MS	500
+#define IPMISIM_SOL_RETRIES	8
+#define IPMISIM_SOL_LINE	16	/* "sol 0000000001\r\n" */
+
+#define IPMISIM_SOL_BREAK	0x10	/* console to BMC: generate break */
+
+/* ipmisim_sol_activate  -  Activate Payload
+ *
+ * Only SOL instance 1 exists, and only one session may have it
+ * active at a time.
+ *
+ * returns response length
+ */
+int
+ipmisim_sol_activate(struct ipmisim_session * s, uint8_t * data, int len,
+		uint8_t * rsp)
+{
+	int i;
+
+	if (len < 6) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	if (!s->v2 || data[0] != IPMI_PAYLOAD_TYPE_SOL ||
+	    data[1] != IPMISIM_SOL_INSTANCE) {
+		rsp[0] = 0x81;		/* payload type disabled */
+		return 1;
+	}
+	for (i = 0; i < IPMISIM_MAX_SESSIONS; i++) {
+		if (sim.session[i].state == IPMISIM_ACTIVE &&
+		    sim.session[i].sol.active) {
+			rsp[0] = 0x80;	/* already active */
+			return 1;
+		}
+	}
+
+	memset(&s->sol, 0, sizeof(s->sol));
+	s->sol.active = 1;
+	s->sol.start = ipmisim_msec();
+	lprintf(LOG_INFO, "SOL activated on session 0x%08x", s->id);
+
+	memset(rsp, 0, 13);
+	rsp[5] = IPMISIM_SOL_PAYLOAD & 0xff;	/* inbound payload size */
+	rsp[6] = IPMISIM_SOL_PAYLOAD >> 8;
+	rsp[7] = IPMISIM_SOL_PAYLOAD & 0xff;	/* outbound payload size */
+	rsp[8] = IPMISIM_SOL_PAYLOAD >> 8;
+	rsp[9] = sim.port & 0xff;
+	rsp[10] = sim.port >> 8;
+	rsp[11] = 0xff;				/* no VLAN */
+	rsp[12] = 0xff;
+	return 13;
+}
+
+/* ipmisim_sol_deactivate  -  Deactivate Payload */
+int
+ipmisim_sol_deactivate(struct ipmisim_session * s, uint8_t * data, int len,
+		uint8_t * rsp)
+{
+	if (len < 6) {
+		rsp[0] = 0xc7;
+		return 1;
+	}
+	if (data[0] != IPMI_PAYLOAD_TYPE_SOL ||
+	    data[1] != IPMISIM_SOL_INSTANCE || !s->sol.active) {
+		rsp[0] = 0x80;		/* already deactivated */
+		return 1;
+	}
+	s->sol.active = 0;
+	lprintf(LOG_INFO, "SOL deactivated on session 0x%08x (%lu bytes in, "
+		"%lu bytes out)", s->id, s->sol.rx, s->sol.tx);
+	rsp[0] = 0;
+	return 1;
+}
+
+/* ipmisim_sol_packet  -  SOL payload from the remote console
+ *
+ * An ACK for the packet in flight releases the accepted characters.
+ * Character data is echoed back, as a serial console would, and is
+ * acknowledged right away.  A retransmission is recognised by its
+ * sequence number and only acknowledged again.
+ *
+ * @s:		session the payload arrived on
+ * @in:		SOL payload
+ * @len:	payload length
+ * @rsp:	ACK payload
+ *
+ * returns ACK payload length
+ * returns -1 if nothing is to be sent back
+ */
+int
+ipmisim_sol_packet(struct ipmisim_session * s, uint8_t * in, int len,
+		uint8_t * rsp)
+{
+	struct ipmisim_sol * sol = &s->sol;
+	uint8_t seq = in[0] & 0x0f;
+	uint8_t ack = in[1] & 0x0f;
+	int n;
+
+	if (!sol->active || len < 4)
+		return -1;
+
+	if (ack != 0 && sol->inflight > 0 && ack == sol->seq) {
+		n = in[2];
+		if (n == 0 || n > sol->inflight)
+			n = sol->inflight;
+		sol->len -= n;
+		memmove(sol->buf, sol->buf + n, sol->len);
+		sol->inflight = 0;
+	}
+	if (seq == 0)
+		return -1;
+
+	if (in[3] & IPMISIM_SOL_BREAK)
+		lprintf(LOG_INFO, "SOL break on session 0x%08x", s->id);
+
+	if (seq != sol->in_seq) {
+		n = __min(len - 4, (int)sizeof(sol->buf) - sol->len);
+		memcpy(sol->buf + sol->len, in + 4, n);
+		sol->len += n;
+		sol->in_seq = seq;
+		sol->in_count = n;
+		sol->rx += n;
+	}
+
+	rsp[0] = 0;
+	rsp[1] = seq;
+	rsp[2] = sol->in_count;
+	rsp[3] = 0;	/* a short count asks for the rest again */
+	return 4;
+}
+
+/* ipmisim_sol_output  -  synthetic console output
+ *
+ * Numbered lines at sim.sol_rate bytes per second, so the remote
+ * console can tell lost and repeated output apart.
+ */
+static void
+ipmisim_sol_output(struct ipmisim_sol * sol, uint64_t now)
+{
+	uint64_t due;
+
+	if (sim.sol_rate <= 0)
+		return;
+	due = (now - sol->start) * sim.sol_rate / 1000;
+	while ((sol->lines + 1) * IPMISIM_SOL_LINE <= due &&
+	       sol->len + IPMISIM_SOL_LINE < (int)sizeof(sol->buf)) {
+		sol->lines++;
+		sprintf((char *)sol->buf + sol->len, "sol %010lu\r\n",
+			sol->lines);
+		sol->len += IPMISIM_SOL_LINE;
+	}
+}
+
+/* ipmisim_sol_poll  -  send console output of a session
+ *
+ * Output goes out one packet at a time; a packet that is not
+ * acknowledged is sent again with the same sequence number.
+ *
+ * @s:		session
+ * @now:	current time in ms
+ * @out:	packet buffer, IPMI_BUF_SIZE bytes
+ * @timeout:	lowered to the ms until the session needs polling again
+ *
+ * returns packet length
+ * returns 0 if there is nothing to send
+ */
+int
+ipmisim_sol_poll(struct ipmisim_session * s, uint64_t now, uint8_t * out,
+		int * timeout)
+{
+	struct ipmisim_sol * sol = &s->sol;
+	uint8_t payload[IPMISIM_SOL_PAYLOAD + 4];
+	int wait;
+
+	if (s->state != IPMISIM_ACTIVE || !sol->active)
+		return 0;
+
+	ipmisim_sol_output(sol, now);
+	if (sim.sol_rate > 0 && (*timeout < 0 || *timeout > 10))
+		*timeout = 10;
+
+	if (sol->inflight > 0) {
+		wait = sol->sent + IPMISIM_SOL_RETRY_MS - now;
+		if (wait > 0) {
+			if (*timeout < 0 || *timeout > wait)
+				*timeout = wait;
+			return 0;
+		}
+		if (sol->tries >= IPMISIM_SOL_RETRIES) {
+			lprintf(LOG_INFO, "SOL packet %d on session 0x%08x "
+				"not acknowledged, dropped", sol->seq, s->id);
+			sol->len -= sol->inflight;
+			memmove(sol->buf, sol->buf + sol->inflight, sol->len);
+			sol->inflight = 0;
+		}
+	}
+	if (sol->inflight == 0) {
+		if (sol->len == 0)
+			return 0;
+		sol->seq = sol->seq % 15 + 1;
+		sol->inflight = __min(sol->len, IPMISIM_SOL_PAYLOAD);
+		sol->tries = 0;
+		sol->tx += sol->inflight;
+	}
+
+	payload[0] = sol->seq;
+	payload[1] = 0;
+	payload[2] = 0;
+	payload[3] = 0;
+	memcpy(payload + 4, sol->buf, sol->inflight);
+	sol->tries++;
+	sol->sent = now;
+	if (*timeout < 0 || *timeout > IPMISIM_SOL_RETRY_MS)
+		*timeout = IPMISIM_SOL_RETRY_MS;
+
+	return ipmisim_v2_packet(s, IPMI_PAYLOAD_TYPE_SOL, payload,
+			sol->inflight + 4, out);
+}
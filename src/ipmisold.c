@@ -0,0 +1,970 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#if defined(HAVE_CONFIG_H)
+# include <config.h>
+#endif
+
+#ifdef HAVE_PATHS_H
+# include <paths.h>
+#endif
+
+#ifndef _PATH_VARRUN
+# define _PATH_VARRUN "/var/run/"
+#endif
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_mc.h>
+#include <ipmitool/ipmi_fanout.h>
+#include <ipmitool/ipmi_sol.h>
+#include <ipmitool/ipmi_strings.h>
+#include <ipmitool/ipmi_constants.h>
+
+#define OPTION_STRING	"C:d:DEf:hH:i:k:L:N:p:P:r:R:s:u:U:v"
+
+#define DEFAULT_PIDFILE		_PATH_VARRUN "ipmisold.pid"
+#define DEFAULT_LOGDIR		"/var/log/ipmisold"
+#define SOLD_BUF_SIZE		65536	/* log data held per console */
+#define SOLD_FLUSH		2	/* seconds before a partial buffer is written */
+#define SOLD_ROTATE_SIZE	10240	/* KiB */
+#define SOLD_ROTATE_KEEP	5
+#define SOLD_BURST		32	/* packets read from one console per pass */
+#define SOLD_KEEPALIVE		5	/* seconds of silence before a keepalive */
+#define SOLD_REOPEN_MAX		60	/* seconds, longest wait between probes */
+#define SOLD_STAMP_LEN		20	/* "YYYY-MM-DD HH:MM:SS " */
+#define SOLD_PORT		623
+
+/* global variables */
+int verbose = 0;
+int csv_output = 0;
+
+enum sold_state {
+	SOLD_PROBE = 0,		/* pinging the BMC */
+	SOLD_SETUP,		/* BMC answered, session setup pending */
+	SOLD_ACTIVE,		/* SOL payload active */
+};
+
+/*
+ * One SOL console.  Console output is collected in buf and appended
+ * to <dir>/<host>.log with one write() when the buffer fills up or
+ * has waited SOLD_FLUSH seconds.
+ */
+struct sold_console {
+	char * name;		/* as given with -H */
+	char * host;
+	char * path;
+	int port;
+	enum sold_state state;
+	struct ipmi_intf * intf;
+
+	struct sockaddr_storage addr;	/* for the presence ping */
+	socklen_t addrlen;
+	time_t retry;		/* next presence ping */
+	int backoff;
+
+	uint32_t last_rx;	/* ipmi_intf_msec() */
+	uint32_t last_ka;
+	int ka_tries;
+
+	char * buf;
+	size_t len;
+	time_t dirty;		/* when buf got its oldest byte */
+	int bol;		/* next character starts a line */
+};
+
+static struct {
+	char * username;
+	char * password;
+	char * kgkey;
+	int cipher;
+	int privlvl;
+	int port;
+	int timeout;
+	int retry;
+	int instance;
+	int userid;		/* enable SOL payload access for this user */
+	char * dir;
+	off_t rotate_size;
+	int rotate_keep;
+} opt;
+
+static struct sold_console * console;
+static int consoles;
+static struct sold_console * sold_current;	/* for sol_input_handler */
+static int ping_fd[2] = { -1, -1 };		/* IPv4, IPv6 */
+static char stamp[SOLD_STAMP_LEN + 1];
+static time_t stamp_time;
+static volatile sig_atomic_t sold_stop = 0;
+
+static void
+ipmisold_usage(void)
+{
+	lprintf(LOG_NOTICE, "ipmisold version %s\n", VERSION);
+	lprintf(LOG_NOTICE, "usage: ipmisold [options...] -H host[,host...]|@file\n");
+	lprintf(LOG_NOTICE, "       -h             This help");
+	lprintf(LOG_NOTICE, "       -v             Verbose (can use multiple times)");
+	lprintf(LOG_NOTICE, "       -D             Stay in the foreground");
+	lprintf(LOG_NOTICE, "       -H hosts       BMC[:port], comma separated BMCs or @file");
+	lprintf(LOG_NOTICE, "       -p port        Remote RMCP port [default=623]");
+	lprintf(LOG_NOTICE, "       -U username    Remote session username");
+	lprintf(LOG_NOTICE, "       -P password    Remote session password");
+	lprintf(LOG_NOTICE, "       -E             Read password from IPMI_PASSWORD environment variable");
+	lprintf(LOG_NOTICE, "       -f file        Read remote session password from file");
+	lprintf(LOG_NOTICE, "       -k key         Use Kg key for IPMIv2 authentication");
+	lprintf(LOG_NOTICE, "       -C ciphersuite Cipher suite to be used by lanplus interface [default=3]");
+	lprintf(LOG_NOTICE, "       -L level       Remote session privilege level [default=ADMINISTRATOR]");
+	lprintf(LOG_NOTICE, "       -N seconds     Timeout for session setup [default=1]");
+	lprintf(LOG_NOTICE, "       -R retry       Retries for session setup [default=2]");
+	lprintf(LOG_NOTICE, "       -i instance    SOL payload instance [default=1]");
+	lprintf(LOG_NOTICE, "       -u userid      Enable SOL payload access for this user first");
+	lprintf(LOG_NOTICE, "       -d dir         Log directory [default=%s]", DEFAULT_LOGDIR);
+	lprintf(LOG_NOTICE, "       -s size        Rotate logs at size KiB [default=%d]",
+		SOLD_ROTATE_SIZE);
+	lprintf(LOG_NOTICE, "       -r count       Rotated logs to keep [default=%d]",
+		SOLD_ROTATE_KEEP);
+	lprintf(LOG_NOTICE, "");
+}
+
+static void
+sold_catch_signal(int sig)
+{
+	sold_stop = 1;
+}
+
+/* sold_rotate  -  shift <host>.log to <host>.log.1 and so on */
+static void
+sold_rotate(struct sold_console * c)
+{
+	char from[PATH_MAX], to[PATH_MAX];
+	int i;
+
+	if (opt.rotate_keep == 0) {
+		(void)truncate(c->path, 0);
+		return;
+	}
+	for (i = opt.rotate_keep - 1; i >= 0; i--) {
+		if (i == 0)
+			snprintf(from, sizeof(from), "%s", c->path);
+		else
+			snprintf(from, sizeof(from), "%s.%d", c->path, i);
+		snprintf(to, sizeof(to), "%s.%d", c->path, i + 1);
+		if (rename(from, to) < 0 && errno != ENOENT)
+			lperror(LOG_WARNING, "Unable to rotate %s", from);
+	}
+}
+
+/* sold_flush  -  append the buffered output of a console to its log
+ *
+ * The log is opened for every flush, so it may be moved away by
+ * other tools at any time, and idle consoles hold no descriptor.
+ */
+static void
+sold_flush(struct sold_console * c)
+{
+	struct stat st;
+	ssize_t n;
+	size_t off = 0;
+	int fd;
+
+	if (c->len == 0)
+		return;
+
+	if (stat(c->path, &st) == 0 &&
+	    st.st_size + (off_t)c->len > opt.rotate_size && st.st_size > 0)
+		sold_rotate(c);
+
+	fd = open(c->path, O_WRONLY | O_APPEND | O_CREAT, 0640);
+	if (fd < 0) {
+		lperror(LOG_ERR, "Unable to open %s", c->path);
+	} else {
+		while (off < c->len) {
+			n = write(fd, c->buf + off, c->len - off);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				lperror(LOG_ERR, "Unable to write %s", c->path);
+				break;
+			}
+			off += n;
+		}
+		close(fd);
+	}
+	c->len = 0;
+	c->dirty = 0;
+}
+
+/* sold_append  -  add console output, each line prefixed with the time */
+static void
+sold_append(struct sold_console * c, const uint8_t * data, int len)
+{
+	time_t now = time(NULL);
+	int i;
+
+	if (now != stamp_time) {
+		strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S ",
+			 localtime(&now));
+		stamp_time = now;
+	}
+	for (i = 0; i < len; i++) {
+		if (c->len + SOLD_STAMP_LEN + 1 > SOLD_BUF_SIZE)
+			sold_flush(c);
+		if (c->bol) {
+			memcpy(c->buf + c->len, stamp, SOLD_STAMP_LEN);
+			c->len += SOLD_STAMP_LEN;
+			c->bol = 0;
+		}
+		c->buf[c->len++] = data[i];
+		if (data[i] == '\n')
+			c->bol = 1;
+	}
+	if (c->dirty == 0)
+		c->dirty = now;
+}
+
+/* sold_mark  -  note a session event in the log of a console */
+static void
+sold_mark(struct sold_console * c, const char * event)
+{
+	char line[128];
+	int n;
+
+	n = snprintf(line, sizeof(line), "%s[ipmisold: %s]\n",
+		     c->bol ? "" : "\n", event);
+	sold_append(c, (uint8_t *)line, __min(n, (int)sizeof(line) - 1));
+}
+
+/* sold_input  -  SOL data handed over by the lanplus transport
+ *
+ * Only called while a request on sold_current is outstanding.
+ */
+static void
+sold_input(struct ipmi_rs * rsp)
+{
+	if (sold_current != NULL && rsp != NULL && rsp->data_len > 0)
+		sold_append(sold_current, rsp->data, rsp->data_len);
+}
+
+/* sold_free  -  release the session of a console
+ *
+ * @c:		console
+ * @polite:	send Close Session first
+ *
+ * A lost session is dropped without a goodbye, waiting for a BMC
+ * that is gone would hold up every other console.
+ */
+static void
+sold_free(struct sold_console * c, int polite)
+{
+	struct ipmi_intf * intf = c->intf;
+
+	if (intf == NULL)
+		return;
+	c->intf = NULL;
+
+	/* a failed open leaves the socket behind unless it closed the session */
+	if (!intf->opened && intf->session != NULL && intf->fd >= 0)
+		close(intf->fd);
+	intf->abort = !polite;
+	ipmi_intf_free(intf);
+}
+
+/* sold_drop  -  give up the session and go back to probing */
+static void
+sold_drop(struct sold_console * c, const char * why)
+{
+	lprintf(LOG_NOTICE, "%s: %s", c->name, why);
+	sold_mark(c, why);
+	sold_free(c, 0);
+	c->state = SOLD_PROBE;
+	c->backoff = 1;
+	c->retry = time(NULL) + c->backoff;
+}
+
+/* sold_resolve  -  look up the address the presence ping goes to
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+sold_resolve(struct sold_console * c)
+{
+	struct addrinfo hints, *res;
+	char service[16];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+	snprintf(service, sizeof(service), "%d", c->port);
+
+	if (getaddrinfo(c->host, service, &hints, &res) != 0) {
+		lprintf(LOG_ERR, "%s: address lookup failed", c->name);
+		return -1;
+	}
+	memcpy(&c->addr, res->ai_addr, res->ai_addrlen);
+	c->addrlen = res->ai_addrlen;
+	freeaddrinfo(res);
+	return 0;
+}
+
+/* sold_ping  -  send an RMCP presence ping
+ *
+ * Session setup blocks, so it is only tried once the BMC has shown
+ * that it is there; a dead BMC costs one datagram per probe.
+ */
+static void
+sold_ping(struct sold_console * c)
+{
+	static const uint8_t ping[12] = {
+		0x06, 0x00, 0xff, 0x06,		/* RMCP, ASF class */
+		0x00, 0x00, 0x11, 0xbe,		/* ASF IANA */
+		0x80, 0x00, 0x00, 0x00,		/* presence ping */
+	};
+	int v6;
+
+	if (c->addrlen == 0 && sold_resolve(c) < 0)
+		return;
+
+	v6 = (c->addr.ss_family == AF_INET6);
+	if (ping_fd[v6] < 0) {
+		ping_fd[v6] = socket(c->addr.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+		if (ping_fd[v6] < 0) {
+			lperror(LOG_ERR, "socket");
+			return;
+		}
+		fcntl(ping_fd[v6], F_SETFL, O_NONBLOCK);
+	}
+	if (sendto(ping_fd[v6], ping, sizeof(ping), 0,
+		   (struct sockaddr *)&c->addr, c->addrlen) < 0)
+		lprintf(LOG_DEBUG, "%s: ping: %s", c->name, strerror(errno));
+}
+
+static int
+sold_same_addr(struct sockaddr_storage * a, struct sockaddr_storage * b)
+{
+	if (a->ss_family != b->ss_family)
+		return 0;
+	if (a->ss_family == AF_INET)
+		return memcmp(&((struct sockaddr_in *)a)->sin_addr,
+			      &((struct sockaddr_in *)b)->sin_addr,
+			      sizeof(struct in_addr)) == 0 &&
+			((struct sockaddr_in *)a)->sin_port ==
+			((struct sockaddr_in *)b)->sin_port;
+	if (a->ss_family == AF_INET6)
+		return memcmp(&((struct sockaddr_in6 *)a)->sin6_addr,
+			      &((struct sockaddr_in6 *)b)->sin6_addr,
+			      sizeof(struct in6_addr)) == 0 &&
+			((struct sockaddr_in6 *)a)->sin6_port ==
+			((struct sockaddr_in6 *)b)->sin6_port;
+	return 0;
+}
+
+/* sold_pong  -  read presence pongs, their BMCs are ready for setup */
+static void
+sold_pong(int fd)
+{
+	struct sockaddr_storage from;
+	socklen_t fromlen;
+	uint8_t buf[64];
+	ssize_t n;
+	int i;
+
+	for (;;) {
+		fromlen = sizeof(from);
+		n = recvfrom(fd, buf, sizeof(buf), 0,
+			     (struct sockaddr *)&from, &fromlen);
+		if (n < 0)
+			return;
+		if (n < 12 || buf[3] != 0x06 || buf[8] != 0x40)
+			continue;
+		for (i = 0; i < consoles; i++) {
+			if (console[i].state == SOLD_PROBE &&
+			    sold_same_addr(&console[i].addr, &from))
+				console[i].state = SOLD_SETUP;
+		}
+	}
+}
+
+/* sold_activate  -  open a session and activate SOL on it
+ *
+ * A SOL payload still held by an earlier session, most likely our own
+ * before a restart, is taken over.
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+sold_activate(struct sold_console * c)
+{
+	struct ipmi_intf * intf;
+	int ccode;
+
+	intf = ipmi_intf_new("lanplus");
+	if (intf == NULL) {
+		lprintf(LOG_ERR, "Unable to load interface lanplus");
+		return -1;
+	}
+	intf->fd = -1;
+	c->intf = intf;
+	sold_current = c;
+
+	ipmi_intf_session_set_hostname(intf, c->host);
+	ipmi_intf_session_set_port(intf, c->port);
+	if (opt.username != NULL)
+		ipmi_intf_session_set_username(intf, opt.username);
+	if (opt.password != NULL)
+		ipmi_intf_session_set_password(intf, opt.password);
+	if (opt.kgkey != NULL)
+		ipmi_intf_session_set_kgkey(intf, opt.kgkey);
+	ipmi_intf_session_set_privlvl(intf, opt.privlvl);
+	ipmi_intf_session_set_lookupbit(intf, 0x10);
+	ipmi_intf_session_set_cipher_suite_id(intf, opt.cipher);
+	ipmi_intf_session_set_sol_escape_char(intf, SOL_ESCAPE_CHARACTER_DEFAULT);
+	ipmi_intf_session_set_timeout(intf, opt.timeout);
+	ipmi_intf_session_set_retry(intf, opt.retry);
+	intf->my_addr = IPMI_BMC_SLAVE_ADDR;
+
+	if (intf->open(intf) < 0)
+		return -1;
+	intf->session->sol_data.sol_input_handler = sold_input;
+
+	if (opt.userid > 0 &&
+	    ipmi_sol_payload_access(intf, 0x0e, opt.userid, 1) < 0)
+		return -1;
+
+	ccode = ipmi_sol_activate_payload(intf, opt.instance);
+	if (ccode == 0x80) {
+		lprintf(LOG_INFO, "%s: taking over the active SOL payload",
+			c->name);
+		ipmi_sol_deactivate(intf, opt.instance);
+		ccode = ipmi_sol_activate_payload(intf, opt.instance);
+	}
+	if (ccode > 0)
+		lprintf(LOG_ERR, "%s: Error activating SOL payload: %s",
+			c->name, val2str(ccode, completion_code_vals));
+	return (ccode == 0) ? 0 : -1;
+}
+
+/* sold_read  -  take the SOL packets a console has waiting */
+static void
+sold_read(struct sold_console * c)
+{
+	struct ipmi_intf * intf = c->intf;
+	struct ipmi_session * s = intf->session;
+	struct ipmi_rs * rsp;
+	struct pollfd pfd;
+	int i;
+
+	sold_current = c;
+	for (i = 0; i < SOLD_BURST; i++) {
+		if (s->rxq.count == 0) {
+			pfd.fd = intf->fd;
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, 0) <= 0)
+				break;
+		}
+
+		/* ipmi_lanplus_recv_sol() acks the packet and drops repeats */
+		s->rtt.wait = 1;
+		rsp = intf->recv_sol(intf);
+		s->rtt.wait = 0;
+		if (rsp == NULL)
+			break;
+
+		/* anything from the BMC shows that the session is alive */
+		c->last_rx = ipmi_intf_msec();
+		c->ka_tries = 0;
+
+		if (rsp->session.payloadtype != IPMI_PAYLOAD_TYPE_SOL)
+			continue;
+		if (rsp->payload.sol_packet.sol_inactive) {
+			sold_drop(c, "SOL deactivated by the BMC");
+			return;
+		}
+		if (rsp->data_len > 0)
+			sold_append(c, rsp->data, rsp->data_len);
+	}
+}
+
+/* sold_keepalive  -  Get Device ID, without waiting for the answer
+ *
+ * The answer, like any other packet, is picked up by sold_read().
+ */
+static void
+sold_keepalive(struct sold_console * c)
+{
+	struct ipmi_rq req;
+
+	memset(&req, 0, sizeof(req));
+	req.msg.netfn = IPMI_NETFN_APP;
+	req.msg.cmd = BMC_GET_DEVICE_ID;
+
+	sold_current = c;
+	c->intf->noanswer = 1;
+	c->intf->sendrecv(c->intf, &req);
+	c->intf->noanswer = 0;
+
+	c->last_ka = ipmi_intf_msec();
+	c->ka_tries++;
+}
+
+/* sold_serve  -  main loop, runs until a signal asks it to stop
+ *
+ * Every console is driven from the one poll() below.  Session setup is
+ * the only blocking step and is done for one console per pass, so the
+ * active consoles are serviced in between.
+ */
+static void
+sold_serve(void)
+{
+	struct pollfd * pfd;
+	int * idx;
+	struct sold_console * c;
+	uint32_t now_ms;
+	time_t now;
+	int i, n, timeout, next = 0;
+
+	pfd = calloc(consoles + 2, sizeof(struct pollfd));
+	idx = calloc(consoles + 2, sizeof(int));
+	if (pfd == NULL || idx == NULL) {
+		lprintf(LOG_ERR, "ipmisold: malloc failure");
+		free(pfd);
+		free(idx);
+		return;
+	}
+
+	while (!sold_stop) {
+		now = time(NULL);
+		timeout = 1000;
+		n = 0;
+
+		for (i = 0; i < 2; i++) {
+			if (ping_fd[i] < 0)
+				continue;
+			pfd[n].fd = ping_fd[i];
+			pfd[n].events = POLLIN;
+			idx[n++] = -1;
+		}
+		for (i = 0; i < consoles; i++) {
+			c = &console[i];
+			if (c->state == SOLD_PROBE && now >= c->retry) {
+				sold_ping(c);
+				c->retry = now + c->backoff;
+				c->backoff = __min(c->backoff * 2, SOLD_REOPEN_MAX);
+			}
+			if (c->state == SOLD_SETUP)
+				timeout = 0;
+			if (c->state != SOLD_ACTIVE)
+				continue;
+			if (c->intf->session->rxq.count > 0)
+				timeout = 0;
+			pfd[n].fd = c->intf->fd;
+			pfd[n].events = POLLIN;
+			idx[n++] = i;
+		}
+
+		n = poll(pfd, n, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			break;
+		}
+
+		for (i = 0; n > 0 && i < consoles + 2; i++) {
+			if (pfd[i].revents == 0)
+				continue;
+			if (idx[i] < 0)
+				sold_pong(pfd[i].fd);
+			else if (console[idx[i]].state == SOLD_ACTIVE)
+				sold_read(&console[idx[i]]);
+			pfd[i].revents = 0;
+		}
+		for (i = 0; i < consoles; i++) {
+			c = &console[i];
+			if (c->state == SOLD_ACTIVE &&
+			    c->intf->session->rxq.count > 0)
+				sold_read(c);
+		}
+
+		/* one blocking session setup per pass */
+		for (i = 0; i < consoles; i++) {
+			c = &console[(next + i) % consoles];
+			if (c->state != SOLD_SETUP)
+				continue;
+			next = (next + i + 1) % consoles;
+			if (sold_activate(c) < 0) {
+				sold_free(c, 1);
+				c->state = SOLD_PROBE;
+				c->retry = time(NULL) + c->backoff;
+				break;
+			}
+			lprintf(LOG_NOTICE, "%s: SOL activated", c->name);
+			sold_mark(c, "SOL activated");
+			c->state = SOLD_ACTIVE;
+			c->backoff = 1;
+			c->last_rx = ipmi_intf_msec();
+			c->ka_tries = 0;
+			break;
+		}
+
+		now = time(NULL);
+		now_ms = ipmi_intf_msec();
+		for (i = 0; i < consoles; i++) {
+			c = &console[i];
+			if (c->state == SOLD_ACTIVE &&
+			    now_ms - c->last_rx >= SOLD_KEEPALIVE * 1000 &&
+			    now_ms - c->last_ka >= SOLD_KEEPALIVE * 1000) {
+				if (c->ka_tries >= SOL_KEEPALIVE_RETRIES)
+					sold_drop(c, "SOL session lost");
+				else
+					sold_keepalive(c);
+			}
+			if (c->dirty != 0 && now - c->dirty >= SOLD_FLUSH)
+				sold_flush(c);
+		}
+	}
+
+	free(pfd);
+	free(idx);
+}
+
+/* sold_shutdown  -  deactivate SOL, close sessions and flush the logs */
+static void
+sold_shutdown(void)
+{
+	struct sold_console * c;
+	int i;
+
+	for (i = 0; i < consoles; i++) {
+		c = &console[i];
+		if (c->state == SOLD_ACTIVE) {
+			sold_current = c;
+			ipmi_sol_deactivate(c->intf, opt.instance);
+			sold_free(c, 1);
+			sold_mark(c, "SOL deactivated");
+		}
+		sold_flush(c);
+	}
+}
+
+/* sold_read_password  -  first line of a password file */
+static char *
+sold_read_password(const char * file)
+{
+	char buf[64];
+	FILE * fp;
+	char * p = NULL;
+
+	fp = ipmi_open_file_read(file);
+	if (fp == NULL)
+		return NULL;
+	if (fgets(buf, sizeof(buf), fp) != NULL) {
+		buf[strcspn(buf, "\r\n")] = '\0';
+		p = strdup(buf);
+	}
+	fclose(fp);
+	return p;
+}
+
+int
+main(int argc, char ** argv)
+{
+	struct ipmi_intf none;
+	struct sigaction act;
+	char ** hosts = NULL;
+	char * hostspec = NULL;
+	char cwd[PATH_MAX];
+	char * path;
+	const char * name;
+	int argflag, i, daemon = 1;
+	int32_t val;
+	FILE * fp;
+
+	opt.cipher = 3;
+	opt.privlvl = IPMI_SESSION_PRIV_ADMIN;
+	opt.port = SOLD_PORT;
+	opt.timeout = 1;
+	opt.retry = 2;
+	opt.instance = 1;
+	opt.dir = DEFAULT_LOGDIR;
+	opt.rotate_size = (off_t)SOLD_ROTATE_SIZE * 1024;
+	opt.rotate_keep = SOLD_ROTATE_KEEP;
+
+	while ((argflag = getopt(argc, argv, OPTION_STRING)) != -1) {
+		val = 0;
+		switch (argflag) {
+		case 'C':
+		case 'i':
+		case 'N':
+		case 'p':
+		case 'r':
+		case 'R':
+		case 's':
+		case 'u':
+			if (str2int(optarg, &val) != 0 || val < 0) {
+				lprintf(LOG_ERR, "Invalid parameter given or out "
+					"of range for '-%c'.", argflag);
+				return EXIT_FAILURE;
+			}
+			break;
+		}
+
+		switch (argflag) {
+		case 'h':
+			ipmisold_usage();
+			return EXIT_SUCCESS;
+		case 'v':
+			verbose++;
+			break;
+		case 'D':
+			daemon = 0;
+			break;
+		case 'H':
+			hostspec = optarg;
+			break;
+		case 'U':
+			if (strlen(optarg) > 16) {
+				lprintf(LOG_ERR, "Username is too long (> 16 bytes)");
+				return EXIT_FAILURE;
+			}
+			opt.username = optarg;
+			break;
+		case 'P':
+			opt.password = strdup(optarg);
+			/* Prevent password snooping with ps */
+			memset(optarg, 'X', strlen(optarg));
+			break;
+		case 'E':
+			if (getenv("IPMI_PASSWORD") == NULL) {
+				lprintf(LOG_WARN, "Unable to read password "
+					"from environment");
+				return EXIT_FAILURE;
+			}
+			opt.password = strdup(getenv("IPMI_PASSWORD"));
+			break;
+		case 'f':
+			opt.password = sold_read_password(optarg);
+			if (opt.password == NULL) {
+				lprintf(LOG_ERR, "Unable to read password "
+					"from file %s", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'k':
+			opt.kgkey = optarg;
+			break;
+		case 'C':
+			opt.cipher = val;
+			break;
+		case 'L':
+			opt.privlvl = str2val(optarg, ipmi_privlvl_vals);
+			if (opt.privlvl == 0xFF) {
+				lprintf(LOG_ERR, "Invalid privilege level %s", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'N':
+			opt.timeout = __max(val, 1);
+			break;
+		case 'R':
+			opt.retry = __max(val, 1);
+			break;
+		case 'p':
+			opt.port = val;
+			break;
+		case 'i':
+			if (val < 1 || val > 15) {
+				lprintf(LOG_ERR, "Instance must range from 1 to 15");
+				return EXIT_FAILURE;
+			}
+			opt.instance = val;
+			break;
+		case 'u':
+			opt.userid = val;
+			break;
+		case 'd':
+			opt.dir = optarg;
+			break;
+		case 's':
+			opt.rotate_size = (off_t)__max(val, 1) * 1024;
+			break;
+		case 'r':
+			opt.rotate_keep = val;
+			break;
+		default:
+			ipmisold_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	log_init("ipmisold", 0, verbose);
+
+	if (hostspec == NULL) {
+		lprintf(LOG_ERR, "No hosts given, use -H");
+		ipmisold_usage();
+		return EXIT_FAILURE;
+	}
+	if (opt.password != NULL && strlen(opt.password) > 20) {
+		lprintf(LOG_ERR, "lanplus: password is longer than 20 bytes.");
+		return EXIT_FAILURE;
+	}
+	consoles = ipmi_fanout_hosts(hostspec, &hosts);
+	if (consoles <= 0) {
+		if (consoles == 0)
+			lprintf(LOG_ERR, "No hosts found in '%s'", hostspec);
+		return EXIT_FAILURE;
+	}
+
+	/* the daemon runs in / */
+	if (opt.dir[0] != '/') {
+		if (getcwd(cwd, sizeof(cwd)) == NULL) {
+			lperror(LOG_ERR, "getcwd");
+			return EXIT_FAILURE;
+		}
+		path = malloc(strlen(cwd) + strlen(opt.dir) + 2);
+		if (path == NULL) {
+			lprintf(LOG_ERR, "ipmisold: malloc failure");
+			return EXIT_FAILURE;
+		}
+		sprintf(path, "%s/%s", cwd, opt.dir);
+		opt.dir = path;
+	}
+	if (mkdir(opt.dir, 0755) < 0 && errno != EEXIST) {
+		lperror(LOG_ERR, "Unable to create %s", opt.dir);
+		return EXIT_FAILURE;
+	}
+
+	console = calloc(consoles, sizeof(struct sold_console));
+	if (console == NULL) {
+		lprintf(LOG_ERR, "ipmisold: malloc failure");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < consoles; i++) {
+		console[i].name = strdup(hosts[i]);
+		console[i].host = hosts[i];
+		console[i].port = opt.port;
+		console[i].buf = malloc(SOLD_BUF_SIZE);
+		/* the log is named after the -H entry, port included */
+		name = strrchr(hosts[i], '/');
+		name = (name != NULL) ? name + 1 : hosts[i];
+		console[i].path = malloc(strlen(opt.dir) + strlen(name) + 6);
+		if (console[i].name == NULL || console[i].buf == NULL ||
+		    console[i].path == NULL) {
+			lprintf(LOG_ERR, "ipmisold: malloc failure");
+			return EXIT_FAILURE;
+		}
+		sprintf(console[i].path, "%s/%s.log", opt.dir, name);
+
+		/* host:port, a single colon so IPv6 addresses are left alone */
+		path = strchr(hosts[i], ':');
+		if (path != NULL && path == strrchr(hosts[i], ':')) {
+			*path++ = '\0';
+			if (str2int(path, &val) != 0 || val <= 0 || val > 65535) {
+				lprintf(LOG_ERR, "Invalid port in '%s:%s'",
+					hosts[i], path);
+				return EXIT_FAILURE;
+			}
+			console[i].port = val;
+		}
+		console[i].bol = 1;
+		console[i].backoff = 1;
+	}
+	free(hosts);
+
+	if (daemon) {
+		struct stat st1;
+
+		if (lstat(DEFAULT_PIDFILE, &st1) == 0) {
+			lprintf(LOG_ERR, "PID file '%s' already exists.",
+				DEFAULT_PIDFILE);
+			lprintf(LOG_ERR, "Perhaps another instance is already running.");
+			return EXIT_FAILURE;
+		}
+
+		memset(&none, 0, sizeof(none));
+		none.fd = -1;
+		ipmi_start_daemon(&none);
+
+		umask(022);
+		fp = ipmi_open_file_write(DEFAULT_PIDFILE);
+		if (fp == NULL) {
+			log_halt();
+			log_init("ipmisold", daemon, verbose);
+			lprintf(LOG_ERR,
+				"Failed to open PID file '%s' for writing. Check file permission.",
+				DEFAULT_PIDFILE);
+			exit(EXIT_FAILURE);
+		}
+		fprintf(fp, "%d\n", (int)getpid());
+		fclose(fp);
+	}
+
+	log_halt();
+	log_init("ipmisold", daemon, verbose);
+
+	act.sa_handler = sold_catch_signal;
+	act.sa_flags = 0;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGQUIT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	lprintf(LOG_NOTICE, "Capturing %d SOL console%s to %s", consoles,
+		consoles > 1 ? "s" : "", opt.dir);
+
+	sold_serve();
+	sold_shutdown();
+
+	if (daemon)
+		(void)unlink(DEFAULT_PIDFILE);
+	lprintf(LOG_NOTICE, "Shutting down");
+	return EXIT_SUCCESS;
+}
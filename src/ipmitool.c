@@ -66,6 +66,7 @@
 #include <ipmitool/ipmi_ime.h>
 #include <ipmitool/ipmi_dcmi.h>
 #include <ipmitool/ipmi_tploem.h>
+#include <ipmitool/ipmi_stats.h>
 
 #ifdef HAVE_CONFIG_H
 # include <config.h>
@@ -93,7 +94,7 @@ struct ipmi_cmd ipmitool_cmd_list[] = {
 	{ ipmi_mc_main,      "mc",      "Management Controller status and global enables" },
 	{ ipmi_mc_main,      "bmc",     NULL },	/* for backwards compatibility */
 	{ ipmi_sdr_main,     "sdr",     "Print Sensor Data Repository entries and readings" },
-	{ ipmi_sensor_main,  "sensor",  "Print detailed sensor information" },
+	{ ipmi_sensor_main,  "sensor",  "Print detailed sensor information", ipmi_sensor_offline },
 	{ ipmi_fru_main,     "fru",     "Print built-in FRU and scan SDR for FRU locators" },
 	{ ipmi_gendev_main,  "gendev",  "Read/Write Device associated with Generic Device locators sdr" },
 	{ ipmi_sel_main,     "sel",     "Print System Event Log (SEL)" },
@@ -118,6 +119,7 @@ struct ipmi_cmd ipmitool_cmd_list[] = {
 	{ ipmi_exec_main,    "exec",    "Run list of commands from file" },
 	{ ipmi_set_main,     "set",     "Set runtime variable for shell and exec" },
 	{ ipmi_echo_main,    "echo",    NULL }, /* for echoing lines to stdout in scripts */
+	{ ipmi_stats_main,   "stats",   "Print request latency and transport statistics" },
 	{ ipmi_hpmfwupg_main,"hpm", "Update HPM components using PICMG HPM.1 file"},
 	{ ipmi_ekanalyzer_main,"ekanalyzer", "run FRU-Ekeying analyzer using FRU files"},
 	{ ipmi_ime_main,          "ime", "Update Intel Manageability Engine Firmware"},
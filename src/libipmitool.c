@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_strings.h>
+#include <ipmitool/ipmi_sol.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/libipmitool.h>
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+/* defined by the ipmitool programs, the library has its own */
+int verbose = 0;
+int csv_output = 0;
+
+/* ipmitool_init  -  set up logging, call once before anything else
+ *
+ * @level:	verbosity, as with -v
+ *
+ * returns 0
+ */
+int
+ipmitool_init(int level)
+{
+	verbose = level;
+	log_init("libipmitool", 0, level);
+	return 0;
+}
+
+/* ipmitool_new  -  create a handle for an interface
+ *
+ * @intfname:	interface name, NULL for the default one
+ *
+ * returns NULL on error
+ */
+struct ipmi_intf *
+ipmitool_new(const char * intfname)
+{
+	struct ipmi_intf * intf;
+
+	intf = ipmi_intf_new(intfname);
+	if (intf == NULL) {
+		lprintf(LOG_ERR, "Error loading interface %s",
+			intfname ? intfname : "(default)");
+		return NULL;
+	}
+
+	/* the defaults of the ipmitool command line */
+	ipmi_intf_session_set_privlvl(intf, IPMI_SESSION_PRIV_ADMIN);
+	ipmi_intf_session_set_lookupbit(intf, 0x10);
+	ipmi_intf_session_set_cipher_suite_id(intf, 3);
+	ipmi_intf_session_set_sol_escape_char(intf, SOL_ESCAPE_CHARACTER_DEFAULT);
+	intf->my_addr = IPMI_BMC_SLAVE_ADDR;
+
+	return intf;
+}
+
+/* ipmitool_set  -  set a session option before ipmitool_open()
+ *
+ * @intf:	handle
+ * @opt:	one of IPMITOOL_OPT_*
+ * @value:	option value as it would be given on the command line
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmitool_set(struct ipmi_intf * intf, int opt, const char * value)
+{
+	uint32_t num = 0;
+	uint16_t lvl;
+
+	if (intf == NULL || value == NULL)
+		return -1;
+
+	switch (opt) {
+	case IPMITOOL_OPT_HOSTNAME:
+		ipmi_intf_session_set_hostname(intf, (char *)value);
+		return 0;
+	case IPMITOOL_OPT_USERNAME:
+		ipmi_intf_session_set_username(intf, (char *)value);
+		return 0;
+	case IPMITOOL_OPT_PASSWORD:
+		ipmi_intf_session_set_password(intf, (char *)value);
+		return 0;
+	case IPMITOOL_OPT_KGKEY:
+		ipmi_intf_session_set_kgkey(intf, (char *)value);
+		return 0;
+	case IPMITOOL_OPT_PRIVLVL:
+		lvl = str2val(value, ipmi_privlvl_vals);
+		if (lvl == 0xFF)
+			return -1;
+		ipmi_intf_session_set_privlvl(intf, (uint8_t)lvl);
+		return 0;
+	case IPMITOOL_OPT_DEVICE:
+		if (strcmp(intf->name, "open") == 0) {
+			if (str2uint(value, &num) != 0 || num > 0xff)
+				return -1;
+			intf->devnum = (uint8_t)num;
+			return 0;
+		}
+		if (intf->devfile != NULL)
+			free(intf->devfile);
+		intf->devfile = strdup(value);
+		return (intf->devfile == NULL) ? -1 : 0;
+	}
+
+	/* the rest are numbers */
+	if (str2uint(value, &num) != 0)
+		return -1;
+
+	switch (opt) {
+	case IPMITOOL_OPT_PORT:
+		ipmi_intf_session_set_port(intf, (int)num);
+		return 0;
+	case IPMITOOL_OPT_CIPHER:
+		ipmi_intf_session_set_cipher_suite_id(intf, (uint8_t)num);
+		return 0;
+	case IPMITOOL_OPT_TIMEOUT:
+		ipmi_intf_session_set_timeout_ms(intf, num);
+		return 0;
+	case IPMITOOL_OPT_RETRY:
+		ipmi_intf_session_set_retry(intf, (int)num);
+		return 0;
+	case IPMITOOL_OPT_WINDOW:
+		ipmi_intf_session_set_window(intf, (int)num);
+		return 0;
+	case IPMITOOL_OPT_TARGET:
+		intf->target_addr = num;
+		return 0;
+	case IPMITOOL_OPT_CHANNEL:
+		intf->target_channel = (uint8_t)num;
+		return 0;
+	}
+
+	return -1;
+}
+
+/* ipmitool_open  -  open the interface and set up the session
+ *
+ * @intf:	handle
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmitool_open(struct ipmi_intf * intf)
+{
+	if (intf == NULL)
+		return -1;
+	if (intf->opened || intf->open == NULL)
+		return 0;
+
+	return (intf->open(intf) < 0) ? -1 : 0;
+}
+
+/* ipmitool_free  -  close the session and release the handle
+ *
+ * Requests still outstanding are completed with a NULL response.
+ *
+ * @intf:	handle
+ */
+void
+ipmitool_free(struct ipmi_intf * intf)
+{
+	if (intf == NULL)
+		return;
+
+	if (intf->devfile != NULL)
+		free(intf->devfile);
+	intf->devfile = NULL;
+	ipmi_intf_free(intf);
+}
+
+/* ipmitool_copy_rsp  -  completion code and data into a caller buffer
+ *
+ * returns the number of bytes copied
+ */
+static int
+ipmitool_copy_rsp(struct ipmi_rs * rsp, uint8_t * buf, int size)
+{
+	int len;
+
+	if (size < 1)
+		return 0;
+
+	buf[0] = rsp->ccode;
+	len = __max(__min(rsp->data_len, size - 1), 0);
+	memcpy(buf + 1, rsp->data, len);
+
+	return len + 1;
+}
+
+/* ipmitool_raw  -  send a request and wait for the response
+ *
+ * @intf:	handle
+ * @netfn:	network function
+ * @cmd:	command
+ * @data:	request data
+ * @data_len:	request data length
+ * @rsp:	response buffer, completion code first
+ * @rsp_size:	size of @rsp
+ *
+ * returns the number of bytes copied to @rsp
+ * returns -1 if there was no response
+ */
+int
+ipmitool_raw(struct ipmi_intf * intf, uint8_t netfn, uint8_t cmd,
+		const uint8_t * data, int data_len, uint8_t * rsp, int rsp_size)
+{
+	struct ipmi_rq req;
+	struct ipmi_rs * r;
+
+	if (intf == NULL || data_len < 0)
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	req.msg.netfn = netfn;
+	req.msg.cmd = cmd;
+	req.msg.data = (uint8_t *)data;
+	req.msg.data_len = data_len;
+
+	r = intf->sendrecv(intf, &req);
+	if (r == NULL)
+		return -1;
+
+	return ipmitool_copy_rsp(r, rsp, rsp_size);
+}
+
+/* ipmitool_submit_rq  -  request queued by ipmitool_submit()
+ */
+struct ipmitool_submit_rq {
+	struct ipmi_rq req;
+	void (*done)(void * ctx, const uint8_t * rsp, int rsp_len);
+	void * ctx;
+	uint8_t data[1];
+};
+
+static void
+ipmitool_submit_done(struct ipmi_intf * intf, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, void * ctx)
+{
+	struct ipmitool_submit_rq * s = (struct ipmitool_submit_rq *)ctx;
+	uint8_t buf[IPMI_BUF_SIZE + 1];
+
+	if (rsp == NULL)
+		s->done(s->ctx, NULL, 0);
+	else
+		s->done(s->ctx, buf, ipmitool_copy_rsp(rsp, buf, sizeof(buf)));
+
+	free(s);
+}
+
+/* ipmitool_submit  -  queue a request, see ipmi_intf_submit()
+ *
+ * @intf:	handle
+ * @netfn:	network function
+ * @cmd:	command
+ * @data:	request data, copied
+ * @data_len:	request data length
+ * @done:	called from ipmitool_poll() with the response, completion
+ *		code first, or with NULL if the request failed
+ * @ctx:	opaque pointer handed to done()
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmitool_submit(struct ipmi_intf * intf, uint8_t netfn, uint8_t cmd,
+		const uint8_t * data, int data_len,
+		void (*done)(void * ctx, const uint8_t * rsp, int rsp_len),
+		void * ctx)
+{
+	struct ipmitool_submit_rq * s;
+
+	if (intf == NULL || done == NULL || data_len < 0 ||
+	    data_len > IPMI_BUF_SIZE)
+		return -1;
+
+	s = malloc(sizeof(struct ipmitool_submit_rq) + data_len);
+	if (s == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	memset(&s->req, 0, sizeof(s->req));
+	if (data_len > 0)
+		memcpy(s->data, data, data_len);
+	s->req.msg.netfn = netfn;
+	s->req.msg.cmd = cmd;
+	s->req.msg.data = s->data;
+	s->req.msg.data_len = data_len;
+	s->done = done;
+	s->ctx = ctx;
+
+	if (ipmi_intf_submit(intf, &s->req, ipmitool_submit_done, s) < 0) {
+		free(s);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+ipmitool_poll(struct ipmi_intf * intf, int timeout)
+{
+	return ipmi_intf_poll(intf, timeout);
+}
+
+int
+ipmitool_pending(struct ipmi_intf * intf)
+{
+	return ipmi_intf_pending(intf);
+}
+
+int
+ipmitool_get_fd(struct ipmi_intf * intf)
+{
+	return ipmi_intf_get_fd(intf);
+}
+
+int
+ipmitool_get_timeout(struct ipmi_intf * intf)
+{
+	return ipmi_intf_get_timeout(intf);
+}
+
+/* ipmitool_ccode_str  -  describe a completion code */
+const char *
+ipmitool_ccode_str(uint8_t ccode)
+{
+	return val2str(ccode, completion_code_vals);
+}
@@ -131,8 +131,8 @@ static struct ipmi_rs *
 ipmi_bmc_send_cmd_ioctl(struct ipmi_intf *intf, struct ipmi_rq *req)
 {
 	struct strioctl istr;
-	static struct bmc_reqrsp reqrsp;
-	static struct ipmi_rs rsp;
+	struct bmc_reqrsp reqrsp;
+	struct ipmi_rs * rsp = &intf->rsp;
 
 	memset(&reqrsp, 0, sizeof (reqrsp));
 	reqrsp.req.fn = req->msg.netfn;
@@ -163,17 +163,17 @@ ipmi_bmc_send_cmd_ioctl(struct ipmi_intf *intf, struct ipmi_rq *req)
 		printf("--\n");
 	}
 
-	memset(&rsp, 0, sizeof (struct ipmi_rs));
-	rsp.ccode = reqrsp.rsp.ccode;
-	rsp.data_len = reqrsp.rsp.datalength;
+	memset(rsp, 0, sizeof (struct ipmi_rs));
+	rsp->ccode = reqrsp.rsp.ccode;
+	rsp->data_len = reqrsp.rsp.datalength;
 
 	/* Decrement for sizeof lun, cmd and ccode */
-	rsp.data_len -= 3;
+	rsp->data_len -= 3;
 
-	if (!rsp.ccode && (rsp.data_len > 0))
-		memcpy(rsp.data, reqrsp.rsp.data, rsp.data_len);
+	if (!rsp->ccode && (rsp->data_len > 0))
+		memcpy(rsp->data, reqrsp.rsp.data, rsp->data_len);
 
-	return (&rsp);
+	return rsp;
 }
 
 static struct ipmi_rs *
@@ -195,7 +195,7 @@ ipmi_bmc_send_cmd_putmsg(struct ipmi_intf *intf, struct ipmi_rq *req)
 	bmc_msg_t *msg = malloc(msgsz);
 	bmc_req_t *request = (bmc_req_t *)&msg->msg[0];
 	bmc_rsp_t *response;
-	static struct ipmi_rs rsp;
+	struct ipmi_rs * rsp = &intf->rsp;
 	struct ipmi_rs *ret = NULL;
 
 	msg->m_type = BMC_MSG_REQUEST;
@@ -253,14 +253,14 @@ ipmi_bmc_send_cmd_putmsg(struct ipmi_intf *intf, struct ipmi_rq *req)
 			printf("--\n");
 		}
 
-		memset(&rsp, 0, sizeof (struct ipmi_rs));
-		rsp.ccode = response->ccode;
-		rsp.data_len = response->datalength;
+		memset(rsp, 0, sizeof (struct ipmi_rs));
+		rsp->ccode = response->ccode;
+		rsp->data_len = response->datalength;
 
-		if (!rsp.ccode && (rsp.data_len > 0))
-			memcpy(rsp.data, response->data, rsp.data_len);
+		if (!rsp->ccode && (rsp->data_len > 0))
+			memcpy(rsp->data, response->data, rsp->data_len);
 
-		ret = &rsp;
+		ret = rsp;
 		break;
 
 	case BMC_MSG_ERROR:
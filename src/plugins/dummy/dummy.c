@@ -209,7 +209,7 @@ ipmi_dummyipmi_open(struct ipmi_intf *intf)
 static struct ipmi_rs*
 ipmi_dummyipmi_send_cmd(struct ipmi_intf *intf, struct ipmi_rq *req)
 {
-	static struct ipmi_rs rsp;
+	struct ipmi_rs * rsp = &intf->rsp;
 	struct dummy_rq req_dummy;
 	struct dummy_rs rsp_dummy;
 	if (intf == NULL || intf->fd < 0 || intf->opened != 1) {
@@ -251,28 +251,28 @@ ipmi_dummyipmi_send_cmd(struct ipmi_intf *intf, struct ipmi_rq *req)
 		return NULL;
 	}
 	if (rsp_dummy.data_len > 0) {
-		if (data_read(intf->fd, (uint8_t *)&rsp.data,
+		if (data_read(intf->fd, (uint8_t *)rsp->data,
 					rsp_dummy.data_len) != 0) {
 			return NULL;
 		}
 	}
-	rsp.ccode = rsp_dummy.ccode;
-	rsp.data_len = rsp_dummy.data_len;
-	rsp.msg.netfn = rsp_dummy.msg.netfn;
-	rsp.msg.cmd = rsp_dummy.msg.cmd;
-	rsp.msg.seq = rsp_dummy.msg.seq;
-	rsp.msg.lun = rsp_dummy.msg.lun;
+	rsp->ccode = rsp_dummy.ccode;
+	rsp->data_len = rsp_dummy.data_len;
+	rsp->msg.netfn = rsp_dummy.msg.netfn;
+	rsp->msg.cmd = rsp_dummy.msg.cmd;
+	rsp->msg.seq = rsp_dummy.msg.seq;
+	rsp->msg.lun = rsp_dummy.msg.lun;
 	if (verbose) {
 		lprintf(LOG_NOTICE, "<<< IPMI rsp");
-		lprintf(LOG_NOTICE, "ccode: %x", rsp.ccode);
-		lprintf(LOG_NOTICE, "data_len: %i", rsp.data_len);
-		lprintf(LOG_NOTICE, "msg.netfn: %x", rsp.msg.netfn);
-		lprintf(LOG_NOTICE, "msg.cmd: %x", rsp.msg.cmd);
-		lprintf(LOG_NOTICE, "msg.seq: %x", rsp.msg.seq);
-		lprintf(LOG_NOTICE, "msg.lun: %x", rsp.msg.lun);
+		lprintf(LOG_NOTICE, "ccode: %x", rsp->ccode);
+		lprintf(LOG_NOTICE, "data_len: %i", rsp->data_len);
+		lprintf(LOG_NOTICE, "msg.netfn: %x", rsp->msg.netfn);
+		lprintf(LOG_NOTICE, "msg.cmd: %x", rsp->msg.cmd);
+		lprintf(LOG_NOTICE, "msg.seq: %x", rsp->msg.seq);
+		lprintf(LOG_NOTICE, "msg.lun: %x", rsp->msg.lun);
 		lprintf(LOG_NOTICE, "<<<");
 	}
-	return &rsp;
+	return rsp;
 }
 
 struct ipmi_intf ipmi_dummy_intf = {
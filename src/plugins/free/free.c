@@ -211,7 +211,7 @@ static struct ipmi_rs * ipmi_free_send_cmd(struct ipmi_intf * intf, struct ipmi_
         u_int32_t rs_buf_len = IPMI_BUF_SIZE;
         int32_t rs_len;
 
-	static struct ipmi_rs rsp;	
+	struct ipmi_rs * rsp = &intf->rsp;
 
         /* achu: FreeIPMI requests have the cmd as the first byte of
          * the data.  Responses have cmd as the first byte and
@@ -297,14 +297,14 @@ static struct ipmi_rs * ipmi_free_send_cmd(struct ipmi_intf * intf, struct ipmi_
                 }
         }
 
-        memset(&rsp, 0, sizeof(struct ipmi_rs));
-	rsp.ccode = (unsigned char)rs_buf[1];
-	rsp.data_len = (int)rs_len - 2;
+        memset(rsp, 0, sizeof(struct ipmi_rs));
+	rsp->ccode = (unsigned char)rs_buf[1];
+	rsp->data_len = (int)rs_len - 2;
 
-	if (!rsp.ccode && rsp.data_len)
-		memcpy(rsp.data, rs_buf + 2, rsp.data_len);
+	if (!rsp->ccode && rsp->data_len)
+		memcpy(rsp->data, rs_buf + 2, rsp->data_len);
 
-	return &rsp;
+	return rsp;
 }
 
 struct ipmi_intf ipmi_free_intf = {
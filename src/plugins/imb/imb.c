@@ -77,7 +77,7 @@ static void ipmi_imb_close(struct ipmi_intf * intf)
 static struct ipmi_rs * ipmi_imb_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 {
 	IMBPREQUESTDATA imbreq;
-	static struct ipmi_rs rsp;	
+	struct ipmi_rs * rsp = &intf->rsp;
 	int status, i;
 	unsigned char ccode;
 
@@ -97,17 +97,17 @@ static struct ipmi_rs * ipmi_imb_send_cmd(struct ipmi_intf * intf, struct ipmi_r
 		printf("IMB dataLength : %d\n", imbreq.dataLength);
 	}
 
-	rsp.data_len = IPMI_IMB_BUF_SIZE;
-	memset(rsp.data, 0, rsp.data_len);
+	rsp->data_len = IPMI_IMB_BUF_SIZE;
+	memset(rsp->data, 0, rsp->data_len);
 
 	for (i=0; i<IPMI_IMB_MAX_RETRY; i++) {
 		if (verbose > 2)
 			printbuf(imbreq.data, imbreq.dataLength, "ipmi_imb request");
 		status = SendTimedImbpRequest(&imbreq, IPMI_IMB_TIMEOUT,
-					      rsp.data, &rsp.data_len, &ccode);
+					      rsp->data, &rsp->data_len, &ccode);
 		if (status == 0) {
 			if (verbose > 2)
-				printbuf(rsp.data, rsp.data_len, "ipmi_imb response");
+				printbuf(rsp->data, rsp->data_len, "ipmi_imb response");
 			break;
 		}
 		/* error */
@@ -115,9 +115,9 @@ static struct ipmi_rs * ipmi_imb_send_cmd(struct ipmi_intf * intf, struct ipmi_r
 		       status, ccode);
 	}
 
-	rsp.ccode = ccode;
+	rsp->ccode = ccode;
 
-	return &rsp;
+	return rsp;
 }
 
 struct ipmi_intf ipmi_imb_intf = {
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #if defined(HAVE_CONFIG_H)
 # include <config.h>
 #endif
@@ -49,8 +50,10 @@
 
 
 #include <ipmitool/ipmi_intf.h>
+#include <ipmitool/helper.h>
 #include <ipmitool/ipmi.h>
 #include <ipmitool/ipmi_sdr.h>
+#include <ipmitool/ipmi_stats.h>
 #include <ipmitool/log.h>
 
 #define IPMI_DEFAULT_PAYLOAD_SIZE   25
@@ -83,6 +86,9 @@ extern struct ipmi_intf ipmi_serial_bm_intf;
 #ifdef IPMI_INTF_DUMMY
 extern struct ipmi_intf ipmi_dummy_intf;
 #endif
+#ifdef IPMI_INTF_PROXY
+extern struct ipmi_intf ipmi_proxy_intf;
+#endif
 
 struct ipmi_intf * ipmi_intf_table[] = {
 #ifdef IPMI_INTF_OPEN
@@ -112,6 +118,9 @@ struct ipmi_intf * ipmi_intf_table[] = {
 #endif
 #ifdef IPMI_INTF_DUMMY
 	&ipmi_dummy_intf,
+#endif
+#ifdef IPMI_INTF_PROXY
+	&ipmi_proxy_intf,
 #endif
 	NULL
 };
@@ -191,6 +200,71 @@ struct ipmi_intf * ipmi_intf_load(char * name)
 	return NULL;
 }
 
+/* ipmi_intf_new  -  Create a private instance of an interface
+ *
+ * ipmi_intf_load() hands out the one shared instance of each
+ * interface.  Instances created here carry their own session and
+ * state, so several of them can be used at once, each from one
+ * thread at a time.
+ *
+ * @name:	interface name, NULL for the first entry of the table
+ *
+ * returns pointer to the new interface, release with ipmi_intf_free()
+ * returns NULL on error
+ */
+struct ipmi_intf *
+ipmi_intf_new(const char * name)
+{
+	struct ipmi_intf ** intf;
+	struct ipmi_intf * i;
+
+	for (intf = ipmi_intf_table; intf != NULL && *intf != NULL; intf++) {
+		if (name == NULL ||
+		    strncmp(name, (*intf)->name, strlen(name)) == 0)
+			break;
+	}
+	if (intf == NULL || *intf == NULL)
+		return NULL;
+
+	i = malloc(sizeof(struct ipmi_intf));
+	if (i == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return NULL;
+	}
+	memcpy(i, *intf, sizeof(struct ipmi_intf));
+	i->session = NULL;
+	i->stats = NULL;
+	i->async = NULL;
+	i->priv = NULL;
+	memset(&i->sdr, 0, sizeof(i->sdr));
+
+	if (i->setup != NULL && i->setup(i) < 0) {
+		lprintf(LOG_ERR, "Unable to setup interface %s", i->name);
+		ipmi_intf_free(i);
+		return NULL;
+	}
+
+	return i;
+}
+
+/* ipmi_intf_free  -  Close and release an interface from ipmi_intf_new()
+ *
+ * @intf:	ipmi interface
+ */
+void
+ipmi_intf_free(struct ipmi_intf * intf)
+{
+	if (intf == NULL)
+		return;
+
+	ipmi_cleanup(intf);
+	if (intf->opened && intf->close != NULL)
+		intf->close(intf);
+	ipmi_intf_session_cleanup(intf);
+	ipmi_stats_free(intf);
+	free(intf);
+}
+
 void
 ipmi_intf_session_set_hostname(struct ipmi_intf * intf, char * hostname)
 {
@@ -204,6 +278,19 @@ ipmi_intf_session_set_hostname(struct ipmi_intf * intf, char * hostname)
 	intf->session->hostname = strdup(hostname);
 }
 
+void
+ipmi_intf_session_set_cachefile(struct ipmi_intf * intf, char * cachefile)
+{
+	if (intf->session == NULL || cachefile == NULL) {
+		return;
+	}
+	if (intf->session->cachefile != NULL) {
+		free(intf->session->cachefile);
+		intf->session->cachefile = NULL;
+	}
+	intf->session->cachefile = strdup(cachefile);
+}
+
 void
 ipmi_intf_session_set_username(struct ipmi_intf * intf, char * username)
 {
@@ -320,6 +407,16 @@ ipmi_intf_session_set_timeout(struct ipmi_intf * intf, uint32_t timeout)
 	intf->session->timeout = timeout;
 }
 
+void
+ipmi_intf_session_set_timeout_ms(struct ipmi_intf * intf, uint32_t timeout_ms)
+{
+	if (intf->session == NULL)
+		return;
+
+	intf->session->timeout_ms = timeout_ms;
+	intf->session->timeout = (timeout_ms + 999) / 1000;
+}
+
 void
 ipmi_intf_session_set_retry(struct ipmi_intf * intf, int retry)
 {
@@ -329,6 +426,15 @@ ipmi_intf_session_set_retry(struct ipmi_intf * intf, int retry)
 	intf->session->retry = retry;
 }
 
+void
+ipmi_intf_session_set_window(struct ipmi_intf * intf, int window)
+{
+	if (intf->session == NULL)
+		return;
+
+	intf->session->window = window;
+}
+
 void
 ipmi_intf_session_cleanup(struct ipmi_intf *intf)
 {
@@ -339,6 +445,10 @@ ipmi_intf_session_cleanup(struct ipmi_intf *intf)
 		free(intf->session->hostname);
 		intf->session->hostname = NULL;
 	}
+	if (intf->session->cachefile != NULL) {
+		free(intf->session->cachefile);
+		intf->session->cachefile = NULL;
+	}
 	free(intf->session);
 	intf->session = NULL;
 }
@@ -346,7 +456,797 @@ ipmi_intf_session_cleanup(struct ipmi_intf *intf)
 void
 ipmi_cleanup(struct ipmi_intf * intf)
 {
+	ipmi_intf_async_cleanup(intf);
 	ipmi_sdr_list_empty(intf);
+	if (intf->sdr.cache_dir != NULL) {
+		free(intf->sdr.cache_dir);
+		intf->sdr.cache_dir = NULL;
+	}
+}
+
+/* ipmi_req_add_entry  -  claim the request table slot for a sequence number
+ *
+ * Slots live in the session and are indexed by the 6-bit rq_seq, so
+ * tracking a request costs no allocation and no list walk.  A slot
+ * that is still in use (a retry with the same sequence number) is
+ * reinitialized.  The slot generation is bumped so holders of a stale
+ * entry pointer can tell it has been handed out again.  msg_data is
+ * the slot's transmit buffer in the session, the message is built
+ * straight into it.
+ *
+ * @intf:	ipmi interface
+ * @req:	request to track
+ * @req_seq:	IPMI request sequence number
+ *
+ * returns pointer to the entry, NULL if there is no session
+ */
+struct ipmi_rq_entry *
+ipmi_req_add_entry(struct ipmi_intf * intf, struct ipmi_rq * req, uint8_t req_seq)
+{
+	struct ipmi_rq_entry * e;
+	uint32_t gen;
+
+	if (intf->session == NULL)
+		return NULL;
+
+	e = &intf->session->rq_entries[req_seq % IPMI_RQ_SEQ_MAX];
+	gen = e->gen;
+
+	memset(e, 0, sizeof(struct ipmi_rq_entry));
+	memcpy(&e->req, req, sizeof(struct ipmi_rq));
+
+	e->intf = intf;
+	e->rq_seq = req_seq % IPMI_RQ_SEQ_MAX;
+	e->msg_data = intf->session->txbuf[e->rq_seq];
+	e->in_use = 1;
+	e->gen = gen + 1;
+
+	lprintf(LOG_DEBUG+3, "added table entry seq=0x%02x cmd=0x%02x gen=%u",
+		e->rq_seq, e->req.msg.cmd, e->gen);
+	return e;
+}
+
+/* ipmi_req_match_entry  -  does a response command match this entry
+ *
+ * A bridged request is also answered by the Send Message (0x34)
+ * response from the BMC while its bridging_level is non-zero.
+ */
+static int
+ipmi_req_match_entry(struct ipmi_rq_entry * e, uint8_t cmd)
+{
+	if (!e->in_use)
+		return 0;
+	if (e->req.msg.cmd == cmd)
+		return 1;
+	return (e->bridging_level > 0 && cmd == 0x34);
+}
+
+/* ipmi_req_lookup_entry  -  find the outstanding request for a response
+ *
+ * @intf:	ipmi interface
+ * @seq:	rq_seq from the response header
+ * @cmd:	command from the response header
+ *
+ * returns pointer to the entry, NULL if no request is waiting for it
+ */
+struct ipmi_rq_entry *
+ipmi_req_lookup_entry(struct ipmi_intf * intf, uint8_t seq, uint8_t cmd)
+{
+	struct ipmi_rq_entry * e;
+
+	if (intf->session == NULL)
+		return NULL;
+
+	e = &intf->session->rq_entries[seq % IPMI_RQ_SEQ_MAX];
+	if (!ipmi_req_match_entry(e, cmd))
+		return NULL;
+	return e;
+}
+
+/* ipmi_req_move_entry  -  re-key an entry under a new sequence number
+ *
+ * Used when a bridged response turns out to carry a different rq_seq
+ * than the encapsulating Send Message.
+ *
+ * returns pointer to the entry in its new slot
+ */
+struct ipmi_rq_entry *
+ipmi_req_move_entry(struct ipmi_intf * intf, struct ipmi_rq_entry * e, uint8_t seq)
+{
+	struct ipmi_rq_entry * n;
+	uint32_t gen;
+
+	seq %= IPMI_RQ_SEQ_MAX;
+	if (intf->session == NULL || e->rq_seq == seq)
+		return e;
+
+	n = &intf->session->rq_entries[seq];
+	gen = n->gen;
+
+	memcpy(n, e, sizeof(struct ipmi_rq_entry));
+	n->rq_seq = seq;
+	n->gen = gen + 1;
+	n->msg_data = intf->session->txbuf[seq];
+	memcpy(n->msg_data, e->msg_data, e->msg_len);
+
+	e->in_use = 0;
+	e->gen++;
+
+	lprintf(LOG_DEBUG+3, "moved table entry seq=0x%02x to seq=0x%02x",
+		e->rq_seq, seq);
+	return n;
+}
+
+/* ipmi_req_remove_entry  -  release the slot of an answered request
+ *
+ * Removing the Send Message (0x34) half of a bridged request only
+ * drops one bridging level, the slot stays claimed for the response
+ * of the target command.
+ *
+ * @intf:	ipmi interface
+ * @seq:	IPMI request sequence number
+ * @cmd:	command
+ */
+void
+ipmi_req_remove_entry(struct ipmi_intf * intf, uint8_t seq, uint8_t cmd)
+{
+	struct ipmi_rq_entry * e;
+
+	e = ipmi_req_lookup_entry(intf, seq, cmd);
+	if (e == NULL)
+		return;
+
+	if (cmd != e->req.msg.cmd) {
+		e->bridging_level--;
+		return;
+	}
+
+	lprintf(LOG_DEBUG+3, "removed table entry seq=0x%02x cmd=0x%02x",
+		seq, cmd);
+	e->in_use = 0;
+	e->gen++;
+}
+
+/* ipmi_req_clear_entries  -  release all outstanding requests
+ *
+ * @intf:	ipmi interface
+ */
+void
+ipmi_req_clear_entries(struct ipmi_intf * intf)
+{
+	struct ipmi_rq_entry * e;
+	int i;
+
+	if (intf->session == NULL)
+		return;
+
+	for (i = 0; i < IPMI_RQ_SEQ_MAX; i++) {
+		e = &intf->session->rq_entries[i];
+		if (e->in_use) {
+			lprintf(LOG_DEBUG+3, "cleared table entry seq=0x%02x cmd=0x%02x",
+				e->rq_seq, e->req.msg.cmd);
+			e->in_use = 0;
+			e->gen++;
+		}
+	}
+}
+
+/* ipmi_intf_get_window  -  number of requests the interface may keep
+ *                         outstanding in ipmi_intf_sendrecv_window()
+ *
+ * In-band interfaces with a poll hook have no session to set a window
+ * on; the driver queues their requests, and poll limits how many.
+ *
+ * @intf:	ipmi interface
+ *
+ * returns 1 if the interface only supports one request at a time
+ */
+int
+ipmi_intf_get_window(struct ipmi_intf * intf)
+{
+	if (intf->poll != NULL && intf->session == NULL)
+		return IPMI_RQ_SEQ_MAX;
+	if ((intf->sendrecv_window == NULL && intf->poll == NULL) ||
+	    intf->session == NULL || intf->session->window < 1)
+		return 1;
+
+	return intf->session->window;
+}
+
+/* sendrecv_window_ctx  -  state shared with sendrecv_window_done()
+ */
+struct sendrecv_window_ctx {
+	struct ipmi_rq * reqs;
+	int left;
+	void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, void * ctx);
+	void * ctx;
+};
+
+static void
+sendrecv_window_done(struct ipmi_intf * intf, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, void * ctx)
+{
+	struct sendrecv_window_ctx * wc = (struct sendrecv_window_ctx *)ctx;
+
+	wc->left--;
+	wc->done(intf, req - wc->reqs, req, rsp, wc->ctx);
+}
+
+/* ipmi_intf_sendrecv_window  -  send a batch of requests
+ *
+ * Interfaces that implement poll or sendrecv_window keep several
+ * requests in flight at once and may complete them out of order, all
+ * others get one sendrecv() per request.  done() is called once for
+ * every request with its index into @reqs and the response, or NULL if
+ * the request failed.  The response is only valid until done() returns.
+ *
+ * @intf:	ipmi interface
+ * @reqs:	array of requests
+ * @count:	number of requests in @reqs
+ * @done:	completion callback
+ * @ctx:	opaque pointer handed to done()
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_intf_sendrecv_window(struct ipmi_intf * intf, struct ipmi_rq * reqs, int count,
+		void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx)
+{
+	struct sendrecv_window_ctx wc;
+	struct ipmi_rs * rsp;
+	int i, rc = 0;
+
+	if (ipmi_intf_get_window(intf) > 1 && count > 1 && intf->poll != NULL) {
+		wc.reqs = reqs;
+		wc.left = 0;
+		wc.done = done;
+		wc.ctx = ctx;
+		for (i = 0; i < count; i++) {
+			if (ipmi_intf_submit(intf, &reqs[i],
+					sendrecv_window_done, &wc) < 0) {
+				done(intf, i, &reqs[i], NULL, ctx);
+				rc = -1;
+				continue;
+			}
+			wc.left++;
+		}
+		while (wc.left > 0)
+			if (ipmi_intf_poll(intf, -1) < 0)
+				rc = -1;
+		return rc;
+	}
+
+	if (ipmi_intf_get_window(intf) > 1 && count > 1)
+		return intf->sendrecv_window(intf, reqs, count, done, ctx);
+
+	for (i = 0; i < count; i++) {
+		rsp = intf->sendrecv(intf, &reqs[i]);
+		done(intf, i, &reqs[i], rsp, ctx);
+	}
+
+	return 0;
+}
+
+/* ipmi_intf_submit  -  queue a request without waiting for the response
+ *
+ * The request goes out on the next ipmi_intf_poll(), which also calls
+ * done() once the response arrives, or with a NULL response if the
+ * request failed.  @req and its data must stay valid until then, the
+ * response only until done() returns.  done() may submit further
+ * requests but must not call sendrecv() on the same interface.
+ *
+ * The IPMB target set on the interface is recorded with the request,
+ * and every transport sends the request to that target whatever the
+ * interface is set to when it is polled.  The open interface keeps
+ * requests to several satellite controllers in flight at once.
+ *
+ * @intf:	ipmi interface
+ * @req:	the request
+ * @done:	completion callback
+ * @ctx:	opaque pointer handed to done()
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_intf_submit(struct ipmi_intf * intf, struct ipmi_rq * req,
+		void (*done)(struct ipmi_intf * intf, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_rq * e;
+
+	if (async == NULL) {
+		async = malloc(sizeof(struct ipmi_async));
+		if (async == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+		memset(async, 0, sizeof(struct ipmi_async));
+		async->tail = &async->head;
+		async->timeout = -1;
+		intf->async = async;
+	}
+	if (async->aborting)
+		return -1;
+
+	e = async->free;
+	if (e != NULL) {
+		async->free = e->next;
+	} else {
+		e = malloc(sizeof(struct ipmi_async_rq));
+		if (e == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+	}
+	memset(e, 0, sizeof(struct ipmi_async_rq));
+	e->req = req;
+	e->done = done;
+	e->ctx = ctx;
+	ipmi_intf_get_target(intf, &e->to);
+
+	*async->tail = e;
+	async->tail = &e->next;
+	async->queued++;
+	async->timeout = 0;
+	async->stamp = ipmi_intf_msec();
+
+	return 0;
+}
+
+/*
+ * A batch of submitted requests handed to sendrecv_window()
+ */
+struct ipmi_async_batch {
+	struct ipmi_async_rq * e[IPMI_RQ_SEQ_MAX];
+	struct ipmi_rq_target saved;	/* target of the caller */
+	struct ipmi_rq_target to;	/* target of the batch */
+};
+
+/* ipmi_async_target_done  -  complete a request sent to another target
+ *
+ * The callback sees the target its caller set, and any change it
+ * makes to it is kept for after the poll.
+ */
+static void
+ipmi_async_target_done(struct ipmi_intf * intf, struct ipmi_async_rq * e,
+		struct ipmi_rs * rsp, struct ipmi_rq_target * saved,
+		struct ipmi_rq_target * to)
+{
+	ipmi_intf_set_target(intf, saved);
+	ipmi_async_done(intf, e, rsp);
+	ipmi_intf_get_target(intf, saved);
+	ipmi_intf_set_target(intf, to);
+}
+
+/* ipmi_async_window_done  -  sendrecv_window() callback for ipmi_intf_poll()
+ */
+static void
+ipmi_async_window_done(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+		struct ipmi_rs * rsp, void * ctx)
+{
+	struct ipmi_async_batch * b = (struct ipmi_async_batch *)ctx;
+
+	ipmi_async_target_done(intf, b->e[idx], rsp, &b->saved, &b->to);
+}
+
+/* ipmi_intf_poll  -  make progress on submitted requests
+ *
+ * Sends queued requests, handles responses and retransmissions and
+ * calls the completion callbacks.  Interfaces without a poll hook are
+ * emulated with sendrecv_window() or sendrecv(), which complete every
+ * queued request before returning, whatever @timeout says.
+ *
+ * An external event loop waits for ipmi_intf_get_fd() to become
+ * readable, for at most ipmi_intf_get_timeout() milliseconds, and
+ * calls this with a zero timeout.
+ *
+ * @intf:	ipmi interface
+ * @timeout:	milliseconds to wait for responses, -1 to wait until at
+ *		least one request completes
+ *
+ * returns the number of requests completed
+ * returns -1 on error, every outstanding request has been failed
+ */
+int
+ipmi_intf_poll(struct ipmi_intf * intf, int timeout)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_batch b;
+	struct ipmi_async_rq * e;
+	struct ipmi_rq reqs[IPMI_RQ_SEQ_MAX];
+	struct ipmi_rs * rsp;
+	int n, window, done = 0;
+
+	if (async == NULL || async->queued + async->inflight == 0)
+		return 0;
+
+	if (intf->poll != NULL)
+		return intf->poll(intf, timeout);
+
+	/*
+	 * Callbacks may submit more, keep going until the queue is empty.
+	 * A batch only takes requests submitted for the same target.
+	 */
+	ipmi_intf_get_target(intf, &b.saved);
+	window = __min(ipmi_intf_get_window(intf), IPMI_RQ_SEQ_MAX);
+	while (async->head != NULL) {
+		b.to = async->head->to;
+		ipmi_intf_set_target(intf, &b.to);
+		if (window > 1 && async->queued > 1) {
+			for (n = 0; n < window && async->head != NULL &&
+			     ipmi_intf_same_target(&async->head->to, &b.to); n++) {
+				b.e[n] = ipmi_async_next(intf);
+				reqs[n] = *b.e[n]->req;
+			}
+			async->inflight += n;
+			intf->sendrecv_window(intf, reqs, n,
+				ipmi_async_window_done, &b);
+			done += n;
+			continue;
+		}
+		e = ipmi_async_next(intf);
+		async->inflight++;
+		rsp = intf->sendrecv(intf, e->req);
+		ipmi_async_target_done(intf, e, rsp, &b.saved, &b.to);
+		done++;
+	}
+	ipmi_intf_set_target(intf, &b.saved);
+	async->timeout = -1;
+
+	return done;
+}
+
+/* ipmi_intf_get_target  -  IPMB target requests are currently sent to
+ *
+ * @intf:	ipmi interface
+ * @to:		filled in from the target and transit fields of @intf
+ */
+void
+ipmi_intf_get_target(struct ipmi_intf * intf, struct ipmi_rq_target * to)
+{
+	to->target_addr = intf->target_addr;
+	to->target_channel = intf->target_channel;
+	to->transit_addr = intf->transit_addr;
+	to->transit_channel = intf->transit_channel;
+}
+
+/* ipmi_intf_set_target  -  route the following requests to a target
+ *
+ * Transports send a request submitted with ipmi_intf_submit() to the
+ * target it was submitted for by setting it around the send and
+ * restoring the previous one afterwards.
+ *
+ * @intf:	ipmi interface
+ * @to:		target and transit fields to copy into @intf
+ */
+void
+ipmi_intf_set_target(struct ipmi_intf * intf, struct ipmi_rq_target * to)
+{
+	intf->target_addr = to->target_addr;
+	intf->target_channel = to->target_channel;
+	intf->transit_addr = to->transit_addr;
+	intf->transit_channel = to->transit_channel;
+}
+
+/* ipmi_intf_same_target  -  compare two IPMB targets
+ *
+ * returns 1 if requests to @a and @b are routed alike, 0 if not
+ */
+int
+ipmi_intf_same_target(struct ipmi_rq_target * a, struct ipmi_rq_target * b)
+{
+	return a->target_addr == b->target_addr &&
+		a->target_channel == b->target_channel &&
+		a->transit_addr == b->transit_addr &&
+		a->transit_channel == b->transit_channel;
+}
+
+/* ipmi_intf_pending  -  number of submitted requests not completed yet
+ *
+ * @intf:	ipmi interface
+ */
+int
+ipmi_intf_pending(struct ipmi_intf * intf)
+{
+	if (intf->async == NULL)
+		return 0;
+
+	return intf->async->queued + intf->async->inflight;
+}
+
+/* ipmi_intf_get_fd  -  descriptor to watch for responses
+ *
+ * @intf:	ipmi interface
+ *
+ * returns the descriptor, or -1 if the interface is not open or can
+ * only be driven by calling ipmi_intf_poll()
+ */
+int
+ipmi_intf_get_fd(struct ipmi_intf * intf)
+{
+	if (intf->poll == NULL || !intf->opened)
+		return -1;
+
+	return intf->fd;
+}
+
+/* ipmi_intf_get_timeout  -  time until ipmi_intf_poll() is due
+ *
+ * @intf:	ipmi interface
+ *
+ * returns milliseconds until the next retransmission or a request
+ * that can be sent, -1 if only a response can make progress
+ */
+int
+ipmi_intf_get_timeout(struct ipmi_intf * intf)
+{
+	struct ipmi_async * async = intf->async;
+	uint32_t elapsed;
+
+	if (async == NULL || async->timeout < 0)
+		return -1;
+	if (async->head != NULL && intf->poll == NULL)
+		return 0;
+
+	elapsed = ipmi_intf_msec() - async->stamp;
+	if (elapsed >= (uint32_t)async->timeout)
+		return 0;
+
+	return async->timeout - elapsed;
+}
+
+/* ipmi_intf_async_cleanup  -  fail outstanding requests and free them
+ *
+ * @intf:	ipmi interface
+ */
+void
+ipmi_intf_async_cleanup(struct ipmi_intf * intf)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_rq * e;
+
+	if (async == NULL)
+		return;
+
+	ipmi_async_abort(intf);
+	while ((e = async->free) != NULL) {
+		async->free = e->next;
+		free(e);
+	}
+	free(async);
+	intf->async = NULL;
+}
+
+/* ipmi_async_next  -  take the oldest submitted request off the queue
+ *
+ * For poll hooks.  The caller owns the request until it passes it to
+ * ipmi_async_done(), and accounts for it in async->inflight.
+ *
+ * @intf:	ipmi interface
+ *
+ * returns NULL if the queue is empty
+ */
+struct ipmi_async_rq *
+ipmi_async_next(struct ipmi_intf * intf)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_rq * e;
+
+	if (async == NULL || async->head == NULL)
+		return NULL;
+
+	e = async->head;
+	async->head = e->next;
+	if (async->head == NULL)
+		async->tail = &async->head;
+	async->queued--;
+	e->next = NULL;
+
+	return e;
+}
+
+/* ipmi_async_done  -  complete a request taken with ipmi_async_next()
+ *
+ * @intf:	ipmi interface
+ * @e:		the request, no longer in a slot
+ * @rsp:	its response, NULL if it failed
+ */
+void
+ipmi_async_done(struct ipmi_intf * intf, struct ipmi_async_rq * e,
+		struct ipmi_rs * rsp)
+{
+	struct ipmi_async * async = intf->async;
+
+	async->inflight--;
+	e->done(intf, e->req, rsp, e->ctx);
+
+	e->next = async->free;
+	async->free = e;
+}
+
+/* ipmi_async_abort  -  fail every request in a slot or in the queue
+ *
+ * For poll hooks that lost their transport, and on cleanup.  Requests
+ * submitted by the callbacks meanwhile are refused.
+ *
+ * @intf:	ipmi interface
+ *
+ * returns the number of requests failed
+ */
+int
+ipmi_async_abort(struct ipmi_intf * intf)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_rq * e;
+	int seq, n = 0;
+
+	if (async == NULL)
+		return 0;
+
+	async->aborting = 1;
+	for (seq = 0; seq < IPMI_RQ_SEQ_MAX; seq++) {
+		e = async->slot[seq];
+		if (e == NULL)
+			continue;
+		async->slot[seq] = NULL;
+		ipmi_stats_record(intf, e->req, NULL, 0);
+		ipmi_async_done(intf, e, NULL);
+		n++;
+	}
+	while ((e = ipmi_async_next(intf)) != NULL) {
+		async->inflight++;
+		ipmi_stats_record(intf, e->req, NULL, 0);
+		ipmi_async_done(intf, e, NULL);
+		n++;
+	}
+	async->aborting = 0;
+	async->timeout = -1;
+
+	return n;
+}
+
+/* ipmi_async_set_timeout  -  note when a poll hook needs to run again
+ *
+ * @intf:	ipmi interface
+ * @timeout:	milliseconds from now, -1 if only a response is awaited
+ */
+void
+ipmi_async_set_timeout(struct ipmi_intf * intf, int timeout)
+{
+	if (intf->async == NULL)
+		return;
+
+	intf->async->timeout = timeout;
+	intf->async->stamp = ipmi_intf_msec();
+}
+
+/* ipmi_intf_msec  -  millisecond clock for retransmission timers
+ *
+ * Only differences between two values are meaningful.  The clock is
+ * monotonic, so setting the time of day neither stalls nor fires the
+ * timers built on it.
+ */
+uint32_t
+ipmi_intf_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ipmi_intf_session_timeout_ms  -  session timeout in milliseconds
+ *
+ * A millisecond timeout given with -N is only used while the whole
+ * second timeout still matches it, so code that assigns
+ * session->timeout directly keeps working.
+ *
+ * @intf:	ipmi interface
+ */
+uint32_t
+ipmi_intf_session_timeout_ms(struct ipmi_intf * intf)
+{
+	struct ipmi_session * s = intf->session;
+
+	if (s->timeout_ms && (s->timeout_ms + 999) / 1000 == s->timeout)
+		return s->timeout_ms;
+
+	return s->timeout * 1000;
+}
+
+/* ipmi_intf_session_wait  -  how long a receive may block, in milliseconds
+ *
+ * @intf:	ipmi interface
+ */
+uint32_t
+ipmi_intf_session_wait(struct ipmi_intf * intf)
+{
+	if (intf->session->rtt.wait)
+		return intf->session->rtt.wait;
+
+	return ipmi_intf_session_timeout_ms(intf);
+}
+
+/* ipmi_intf_session_rto  -  retransmission timeout for a request
+ *
+ * The first try waits srtt + 4 * rttvar, or the session timeout until
+ * a round trip has been measured.  Each retry doubles the previous
+ * wait, capped at the session timeout.  The last try waits out
+ * whatever is left of retry * timeout, so a slow BMC is given as long
+ * as it always was and only lost packets are resent earlier.
+ *
+ * @intf:	ipmi interface
+ * @try:	number of times the request has been resent
+ *
+ * returns the wait in milliseconds
+ */
+uint32_t
+ipmi_intf_session_rto(struct ipmi_intf * intf, int try)
+{
+	struct ipmi_session * s = intf->session;
+	uint32_t max = ipmi_intf_session_timeout_ms(intf);
+	uint32_t rto, spent = 0;
+	int i;
+
+	if (s->rtt.srtt == 0)
+		rto = max;
+	else
+		rto = (s->rtt.srtt >> 3) + s->rtt.rttvar;
+
+	if (rto < IPMI_INTF_RTO_MIN)
+		rto = IPMI_INTF_RTO_MIN;
+	if (rto > max)
+		rto = max;
+
+	for (i = 0; i < try; i++) {
+		spent += rto;
+		rto = __min(rto << 1, max);
+	}
+
+	if (try >= s->retry - 1 && spent + rto < max * s->retry)
+		rto = max * s->retry - spent;
+
+	return rto;
+}
+
+/* ipmi_intf_session_rtt_sample  -  feed a measured round trip time
+ *
+ * Only requests that were sent once may be sampled, a response to a
+ * resent request cannot be matched to one transmission (Karn).
+ *
+ * @intf:	ipmi interface
+ * @rtt:	round trip time in milliseconds
+ */
+void
+ipmi_intf_session_rtt_sample(struct ipmi_intf * intf, uint32_t rtt)
+{
+	struct ipmi_session * s = intf->session;
+	int32_t delta;
+
+	if (rtt == 0)
+		rtt = 1;
+
+	if (s->rtt.srtt == 0) {
+		s->rtt.srtt = rtt << 3;
+		s->rtt.rttvar = rtt << 1;
+		return;
+	}
+
+	delta = (int32_t)rtt - (int32_t)(s->rtt.srtt >> 3);
+	s->rtt.srtt += delta;
+	if (delta < 0)
+		delta = -delta;
+	s->rtt.rttvar += delta - (int32_t)(s->rtt.rttvar >> 2);
+
+	lprintf(LOG_DEBUG+2, "rtt %u ms, srtt %u ms, rttvar %u ms",
+		rtt, s->rtt.srtt >> 3, s->rtt.rttvar >> 2);
 }
 
 #if defined(IPMI_INTF_LAN) || defined (IPMI_INTF_LANPLUS)
@@ -66,7 +66,7 @@ uint8_t * ipmi_auth_md5(struct ipmi_session * s, uint8_t * data, int data_len)
 {
 #ifdef HAVE_CRYPTO_MD5
 	MD5_CTX ctx;
-	static uint8_t md[16];
+	static IPMI_TLS uint8_t md[16];
 	uint32_t temp;
 
 #if WORDS_BIGENDIAN
@@ -91,7 +91,7 @@ uint8_t * ipmi_auth_md5(struct ipmi_session * s, uint8_t * data, int data_len)
 	return md;
 #else /*HAVE_CRYPTO_MD5*/
 	md5_state_t state;
-	static md5_byte_t digest[16];
+	static IPMI_TLS md5_byte_t digest[16];
 	uint32_t temp;
 
 	memset(digest, 0, 16);
@@ -130,7 +130,7 @@ uint8_t * ipmi_auth_md2(struct ipmi_session * s, uint8_t * data, int data_len)
 {
 #ifdef HAVE_CRYPTO_MD2
 	MD2_CTX ctx;
-	static uint8_t md[16];
+	static IPMI_TLS uint8_t md[16];
 	uint32_t temp;
 
 #if WORDS_BIGENDIAN
@@ -154,7 +154,7 @@ uint8_t * ipmi_auth_md2(struct ipmi_session * s, uint8_t * data, int data_len)
 
 	return md;
 #else /*HAVE_CRYPTO_MD2*/
-	static uint8_t md[16];
+	static IPMI_TLS uint8_t md[16];
 	memset(md, 0, 16);
 	printf("WARNING: No internal support for MD2!  "
 	       "Please re-compile with OpenSSL.\n");
@@ -167,7 +167,7 @@ uint8_t * ipmi_auth_special(struct ipmi_session * s)
 {
 #ifdef HAVE_CRYPTO_MD5
 	MD5_CTX ctx;
-	static uint8_t md[16];
+	static IPMI_TLS uint8_t md[16];
 	uint8_t challenge[16];
 	int i;
 
@@ -193,7 +193,7 @@ uint8_t * ipmi_auth_special(struct ipmi_session * s)
 #else  /*HAVE_CRYPTO_MD5*/
 	int i;
 	md5_state_t state;
-	static md5_byte_t digest[16];
+	static IPMI_TLS md5_byte_t digest[16];
 	uint8_t challenge[16];
 
 	memset(challenge, 0, 16);
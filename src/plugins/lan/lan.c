@@ -42,6 +42,7 @@
 #include <unistd.h>
 #include <netdb.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include <ipmitool/helper.h>
 #include <ipmitool/log.h>
@@ -53,6 +54,7 @@
 #include <ipmitool/ipmi_strings.h>
 #include <ipmitool/ipmi_constants.h>
 #include <ipmitool/hpm2.h>
+#include <ipmitool/ipmi_stats.h>
 
 #if HAVE_CONFIG_H
 # include <config.h>
@@ -79,9 +81,6 @@ extern const struct valstr ipmi_privlvl_vals[];
 extern const struct valstr ipmi_authtype_session_vals[];
 extern int verbose;
 
-struct ipmi_rq_entry * ipmi_req_entries;
-static struct ipmi_rq_entry * ipmi_req_entries_tail;
-static uint8_t bridge_possible = 0;
 
 static int ipmi_lan_send_packet(struct ipmi_intf * intf, uint8_t * data, int data_len);
 static struct ipmi_rs * ipmi_lan_recv_packet(struct ipmi_intf * intf);
@@ -115,107 +114,6 @@ struct ipmi_intf ipmi_lan_intf = {
 	target_addr:	IPMI_BMC_SLAVE_ADDR,
 };
 
-static struct ipmi_rq_entry *
-ipmi_req_add_entry(struct ipmi_intf * intf, struct ipmi_rq * req, uint8_t req_seq)
-{
-	struct ipmi_rq_entry * e;
-
-	e = malloc(sizeof(struct ipmi_rq_entry));
-	if (e == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return NULL;
-	}
-
-	memset(e, 0, sizeof(struct ipmi_rq_entry));
-	memcpy(&e->req, req, sizeof(struct ipmi_rq));
-
-	e->intf = intf;
-	e->rq_seq = req_seq;
-
-	if (ipmi_req_entries == NULL)
-		ipmi_req_entries = e;
-	else
-		ipmi_req_entries_tail->next = e;
-
-	ipmi_req_entries_tail = e;
-	lprintf(LOG_DEBUG+3, "added list entry seq=0x%02x cmd=0x%02x",
-		e->rq_seq, e->req.msg.cmd);
-	return e;
-}
-
-static struct ipmi_rq_entry *
-ipmi_req_lookup_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * e = ipmi_req_entries;
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		if (e->next == NULL || e == e->next)
-			return NULL;
-		e = e->next;
-	}
-	return e;
-}
-
-static void
-ipmi_req_remove_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * p, * e, * saved_next_entry;
-
-	e = p = ipmi_req_entries;
-
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		p = e;
-		e = e->next;
-	}
-	if (e) {
-		lprintf(LOG_DEBUG+3, "removed list entry seq=0x%02x cmd=0x%02x",
-			seq, cmd);
-		saved_next_entry = e->next;
-		p->next = (p->next == e->next) ? NULL : e->next;
-		/* If entry being removed is first in list, fix up list head */
-		if (ipmi_req_entries == e) {
-			if (ipmi_req_entries != p)
-				ipmi_req_entries = p;
-			else
-				ipmi_req_entries = saved_next_entry;
-		}
-		/* If entry being removed is last in list, fix up list tail */
-		if (ipmi_req_entries_tail == e) {
-			if (ipmi_req_entries_tail != p)
-				ipmi_req_entries_tail = p;
-			else
-				ipmi_req_entries_tail = NULL;
-		}
-		if (e->msg_data) {
-			free(e->msg_data);
-			e->msg_data = NULL;
-		}
-		free(e);
-		e = NULL;
-	}
-}
-
-static void
-ipmi_req_clear_entries(void)
-{
-	struct ipmi_rq_entry * p, * e;
-
-	e = ipmi_req_entries;
-	while (e) {
-		lprintf(LOG_DEBUG+3, "cleared list entry seq=0x%02x cmd=0x%02x",
-			e->rq_seq, e->req.msg.cmd);
-		if (e->next != NULL) {
-			p = e->next;
-			free(e);
-			e = p;
-		} else {
-			free(e);
-			e = NULL;
-			break;
-		}
-	}
-	ipmi_req_entries = NULL;
-}
-
 static int
 get_random(void *data, int len)
 {
@@ -238,31 +136,32 @@ get_random(void *data, int len)
 static int
 ipmi_lan_send_packet(struct ipmi_intf * intf, uint8_t * data, int data_len)
 {
+	int ret;
+
 	if (verbose > 2)
 		printbuf(data, data_len, "send_packet");
 
-	return send(intf->fd, data, data_len, 0);
+	ret = send(intf->fd, data, data_len, 0);
+	if (ret > 0) {
+		IPMI_STATS_ADD(intf, tx_packets, 1);
+		IPMI_STATS_ADD(intf, tx_bytes, ret);
+	}
+	return ret;
 }
 
 static struct ipmi_rs *
 ipmi_lan_recv_packet(struct ipmi_intf * intf)
 {
-	static struct ipmi_rs rsp;
-	fd_set read_set, err_set;
-	struct timeval tmout;
+	struct ipmi_rs * rsp = &intf->session->rsp;
+	struct pollfd pfd;
 	int ret;
 
-	FD_ZERO(&read_set);
-	FD_SET(intf->fd, &read_set);
-
-	FD_ZERO(&err_set);
-	FD_SET(intf->fd, &err_set);
-
-	tmout.tv_sec = intf->session->timeout;
-	tmout.tv_usec = 0;
+	pfd.fd = intf->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
 
-	ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
-	if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
+	ret = poll(&pfd, 1, ipmi_intf_session_wait(intf));
+	if (ret <= 0 || !(pfd.revents & (POLLIN | POLLERR)))
 		return NULL;
 
 	/* the first read may return ECONNREFUSED because the rmcp ping
@@ -275,23 +174,18 @@ ipmi_lan_recv_packet(struct ipmi_intf * intf)
 	 * regardless of the order they were sent out.  (unless the
 	 * response is read before the connection refused is returned)
 	 */
-	ret = recv(intf->fd, &rsp.data, IPMI_BUF_SIZE, 0);
+	ret = recv(intf->fd, rsp->data, IPMI_BUF_SIZE, 0);
 
 	if (ret < 0) {
-		FD_ZERO(&read_set);
-		FD_SET(intf->fd, &read_set);
+		pfd.fd = intf->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
 
-		FD_ZERO(&err_set);
-		FD_SET(intf->fd, &err_set);
-
-		tmout.tv_sec = intf->session->timeout;
-		tmout.tv_usec = 0;
-
-		ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
-		if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
+		ret = poll(&pfd, 1, ipmi_intf_session_wait(intf));
+		if (ret <= 0 || !(pfd.revents & (POLLIN | POLLERR)))
 			return NULL;
 
-		ret = recv(intf->fd, &rsp.data, IPMI_BUF_SIZE, 0);
+		ret = recv(intf->fd, rsp->data, IPMI_BUF_SIZE, 0);
 		if (ret < 0)
 			return NULL;
 	}
@@ -299,13 +193,16 @@ ipmi_lan_recv_packet(struct ipmi_intf * intf)
 	if (ret == 0)
 		return NULL;
 
-	rsp.data[ret] = '\0';
-	rsp.data_len = ret;
+	rsp->data[ret] = '\0';
+	rsp->data_len = ret;
+
+	IPMI_STATS_ADD(intf, rx_packets, 1);
+	IPMI_STATS_ADD(intf, rx_bytes, ret);
 
 	if (verbose > 2)
-		printbuf(rsp.data, rsp.data_len, "recv_packet");
+		printbuf(rsp->data, rsp->data_len, "recv_packet");
 
-	return &rsp;
+	return rsp;
 }
 
 /*
@@ -588,11 +485,11 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 				rsp->ccode);
 			
 			/* now see if we have outstanding entry in request list */
-			entry = ipmi_req_lookup_entry(rsp->payload.ipmi_response.rq_seq,
+			entry = ipmi_req_lookup_entry(intf, rsp->payload.ipmi_response.rq_seq,
 						      rsp->payload.ipmi_response.cmd);
 			if (entry) {
 				lprintf(LOG_DEBUG+2, "IPMI Request Match found");
-				if ((intf->target_addr != our_address) && bridge_possible) {
+				if ((intf->target_addr != our_address) && intf->session->bridge_possible) {
 					if ((rsp->data_len) && (rsp->payload.ipmi_response.netfn == 7) &&
 					    (rsp->payload.ipmi_response.cmd != 0x34)) {
 						if (verbose > 2)
@@ -609,7 +506,7 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 							if (!entry->bridging_level)
 								entry->req.msg.cmd = entry->req.msg.target_cmd;
 							if (rsp == NULL) {
-								ipmi_req_remove_entry(entry->rq_seq, entry->req.msg.cmd);
+								ipmi_req_remove_entry(intf, entry->rq_seq, entry->req.msg.cmd);
 							}
 							continue;
 						} else {
@@ -619,7 +516,8 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 								rsp->data_len - x - 1);
 							rsp->data[x - 8] -= 8;
 							rsp->data_len -= 8;
-							entry->rq_seq = rsp->data[x - 3] >> 2;
+							entry = ipmi_req_move_entry(intf, entry,
+									rsp->data[x - 3] >> 2);
 							if (!entry->bridging_level)
 								entry->req.msg.cmd = entry->req.msg.target_cmd;
 							continue;
@@ -632,7 +530,7 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 								rsp->data[x-1]);
 					}
 				}
-				ipmi_req_remove_entry(rsp->payload.ipmi_response.rq_seq,
+				ipmi_req_remove_entry(intf, rsp->payload.ipmi_response.rq_seq,
 						      rsp->payload.ipmi_response.cmd);
 			} else {
 				lprintf(LOG_INFO, "IPMI Request Match NOT FOUND");
@@ -699,55 +597,31 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 	int cs2 = 0, cs3 = 0;
 	struct ipmi_rq_entry * entry;
 	struct ipmi_session * s = intf->session;
-	static int curr_seq = 0;
 	uint8_t our_address = intf->my_addr;
 
 	if (our_address == 0)
 		our_address = IPMI_BMC_SLAVE_ADDR;
 
 	if (isRetry == 0)
-		curr_seq++;
-
-	if (curr_seq >= 64)
-		curr_seq = 0;
-
-	// Bug in the existing code where it keeps on adding same command/seq pair 
-	// in the lookup entry list.
-	// Check if we have cmd,seq pair already in our list. As we are not changing 
-	// the seq number we have to re-use the node which has existing
-	// command and sequence number. If we add then we will have redundant node with
-	// same cmd,seq pair
-	entry = ipmi_req_lookup_entry(curr_seq, req->msg.cmd);
-	if (entry)
-	{
-		// This indicates that we have already same command and seq in list
-		// No need to add once again and we will re-use the existing node.
-		// Only thing we have to do is clear the msg_data as we create
-		// a new one below in the code for it.
-		if (entry->msg_data) {
-			free(entry->msg_data);
-			entry->msg_data = NULL;
-		}
-	}
-	else
-	{
-		// We dont have this request in the list so we can add it 
-		// to the list
-		entry = ipmi_req_add_entry(intf, req, curr_seq);
-		if (entry == NULL)
-			return NULL;
-	}
+		s->rq_seq = (s->rq_seq + 1) & 0x3f;
+
+	// A retry keeps the seq number, so this re-uses the table slot
+	// and transmit buffer of the previous attempt.
+	entry = ipmi_req_add_entry(intf, req, s->rq_seq);
+	if (entry == NULL)
+		return NULL;
  
 	len = req->msg.data_len + 29;
 	if (s->active && s->authtype)
 		len += 16;
 	if (intf->transit_addr != intf->my_addr && intf->transit_addr != 0)
 		len += 8;
-	msg = malloc(len);
-	if (msg == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
+	if (len > IPMI_BUF_SIZE) {
+		lprintf(LOG_ERR, "Request too large for transmit buffer");
+		ipmi_req_remove_entry(intf, entry->rq_seq, req->msg.cmd);
 		return NULL;
 	}
+	msg = entry->msg_data;
 	memset(msg, 0, len);
 
 	/* rmcp header */
@@ -772,7 +646,7 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 	}
 
 	/* message length */
-	if ((intf->target_addr == our_address) || !bridge_possible) {
+	if ((intf->target_addr == our_address) || !intf->session->bridge_possible) {
 		entry->bridging_level = 0;
 		msg[len++] = req->msg.data_len + 7;
 		cs = mp = len;
@@ -788,7 +662,7 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 		msg[len++] = ipmi_csum(msg+cs, tmp);
 		cs2 = len;
 		msg[len++] = IPMI_REMOTE_SWID;
-		msg[len++] = curr_seq << 2;
+		msg[len++] = s->rq_seq << 2;
 		msg[len++] = 0x34;			/* Send Message rqst */
 		entry->req.msg.target_cmd = entry->req.msg.cmd;	/* Save target command */
 		entry->req.msg.cmd = 0x34;		/* (fixup request entry) */
@@ -805,7 +679,7 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 			msg[len++] = ipmi_csum(msg+cs, tmp);
 			cs3 = len;
 			msg[len++] = intf->my_addr;
-			msg[len++] = curr_seq << 2;
+			msg[len++] = s->rq_seq << 2;
 			msg[len++] = 0x34;			/* Send Message rqst */
 			msg[len++] = (0x40|intf->target_channel); /* Track request */
 		}
@@ -825,7 +699,7 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 	else if (entry->bridging_level) 
 		msg[len++] = intf->my_addr;
    
-	entry->rq_seq = curr_seq;
+	entry->rq_seq = s->rq_seq;
 	msg[len++] = entry->rq_seq << 2;
 	msg[len++] = req->msg.cmd;
 
@@ -888,7 +762,6 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 	}
 
 	entry->msg_len = len;
-	entry->msg_data = msg;
 
 	return entry;
 }
@@ -900,6 +773,7 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	struct ipmi_rs * rsp = NULL;
 	int try = 0;
 	int isRetry = 0;
+	uint32_t sent;
 
 	lprintf(LOG_DEBUG, "ipmi_lan_send_cmd:opened=[%d], open=[%d]",
 		intf->opened, intf->open);
@@ -925,14 +799,19 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 		if (ipmi_lan_send_packet(intf, entry->msg_data, entry->msg_len) < 0) {
 			try++;
 			usleep(5000);
-			ipmi_req_remove_entry(entry->rq_seq, entry->req.msg.target_cmd);	
+			ipmi_req_remove_entry(intf, entry->rq_seq, entry->req.msg.target_cmd);	
 			continue;
 		}
+		sent = ipmi_intf_msec();
+		if (try > 0)
+			IPMI_STATS_ADD(intf, retransmits, 1);
 
 		/* if we are set to noanswer we do not expect response */
 		if (intf->noanswer)
 			break;
 
+		intf->session->rtt.wait = ipmi_intf_session_rto(intf, try);
+
 		if (ipmi_oem_active(intf, "intelwv2"))
 			ipmi_lan_thump(intf);
 
@@ -947,15 +826,19 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 			rsp = ipmi_lan_poll_recv(intf);
 		}
 		
-		if (rsp)
+		if (rsp) {
+			if (try == 0)
+				ipmi_intf_session_rtt_sample(intf, ipmi_intf_msec() - sent);
 			break;
+		}
 
-		usleep(5000);
+		IPMI_STATS_ADD(intf, timeouts, 1);
 		if (++try >= intf->session->retry) {
 			lprintf(LOG_DEBUG, "  No response from remote controller");
 			break;
 		}
 	}
+	intf->session->rtt.wait = 0;
 
 	// We need to cleanup the existing entries from the list. Because if we 
 	// keep it and then when we send the new command and if the response is for
@@ -979,7 +862,7 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	//                   <-- [23, 10]
 	//  here if we maintain 23,10 in the list then it will get matched and consider
 	//  23 response as response for 2D.   
-	ipmi_req_clear_entries();
+	ipmi_req_clear_entries(intf);
  
 	return rsp;
 }
@@ -1157,11 +1040,12 @@ uint8_t * ipmi_lan_build_sol_msg(struct ipmi_intf * intf,
 		5                                            +  // SOL header
 		payload->payload.sol_packet.character_count;    // The actual payload
 
-	msg = malloc(len);
-	if (msg == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
+	if (len > IPMI_BUF_SIZE) {
+		lprintf(LOG_ERR, "SOL payload too large for transmit buffer");
 		return NULL;
 	}
+	/* SOL packets are not kept in the request table */
+	msg = session->txbuf[IPMI_RQ_SEQ_MAX];
 	memset(msg, 0, len);
 
 	/* rmcp header */
@@ -1257,12 +1141,8 @@ ipmi_lan_send_sol_payload(struct ipmi_intf * intf,
 	}
 
 	msg = ipmi_lan_build_sol_msg(intf, payload, &len);
-	if (len <= 0 || msg == NULL) {
+	if (msg == NULL || len <= 0) {
 		lprintf(LOG_ERR, "Invalid SOL payload packet");
-		if (msg != NULL) {
-			free(msg);
-			msg = NULL;
-		}
 		return NULL;
 	}
 
@@ -1307,10 +1187,6 @@ ipmi_lan_send_sol_payload(struct ipmi_intf * intf,
 		}
 	}
 
-	if (msg != NULL) {
-		free(msg);
-		msg = NULL;
-	}
 	return rsp;
 }
 
@@ -1440,9 +1316,8 @@ static int
 check_sol_packet_for_new_data(struct ipmi_intf * intf,
 			      struct ipmi_rs *rsp)
 {
-	static uint8_t last_received_sequence_number = 0;
-	static uint8_t last_received_byte_count      = 0;
-	int new_data_size                            = 0;
+	struct ipmi_session * session = intf->session;
+	int new_data_size = 0;
 
 	if (rsp &&
 	    (rsp->session.payloadtype == IPMI_PAYLOAD_TYPE_SOL))
@@ -1450,13 +1325,13 @@ check_sol_packet_for_new_data(struct ipmi_intf * intf,
 	{
 		uint8_t unaltered_data_len = rsp->data_len;
 		if (rsp->payload.sol_packet.packet_sequence_number ==
-		    last_received_sequence_number)
+		    session->sol_data.last_received_sequence_number)
 		{
 			/*
 			 * This is the same as the last packet, but may include
 			 * extra data
 			 */
-			new_data_size = rsp->data_len - last_received_byte_count;
+			new_data_size = rsp->data_len - session->sol_data.last_received_byte_count;
 			
 			if (new_data_size > 0)
 			{
@@ -1475,9 +1350,9 @@ check_sol_packet_for_new_data(struct ipmi_intf * intf,
 		 */
 		if (rsp && rsp->payload.sol_packet.packet_sequence_number)
 		{
-			last_received_sequence_number =
+			session->sol_data.last_received_sequence_number =
 				rsp->payload.sol_packet.packet_sequence_number;
-			last_received_byte_count = unaltered_data_len;
+			session->sol_data.last_received_byte_count = unaltered_data_len;
 		}
 	}
 
@@ -1831,7 +1706,7 @@ ipmi_activate_session_cmd(struct ipmi_intf * intf)
 		return -1;
 	}
 
-	bridge_possible = 1;
+	intf->session->bridge_possible = 1;
 
 	lprintf(LOG_DEBUG, "\nSession Activated");
 	lprintf(LOG_DEBUG, "  Auth Type       : %s",
@@ -1854,7 +1729,7 @@ ipmi_set_session_privlvl_cmd(struct ipmi_intf * intf)
 	struct ipmi_rs * rsp;
 	struct ipmi_rq req;
 	uint8_t privlvl = intf->session->privlvl;
-	uint8_t backup_bridge_possible = bridge_possible;
+	uint8_t backup_bridge_possible = intf->session->bridge_possible;
 
 	if (privlvl <= IPMI_SESSION_PRIV_USER)
 		return 0;	/* no need to set higher */
@@ -1865,9 +1740,9 @@ ipmi_set_session_privlvl_cmd(struct ipmi_intf * intf)
 	req.msg.data		= &privlvl;
 	req.msg.data_len	= 1;
 
-	bridge_possible = 0;
+	intf->session->bridge_possible = 0;
 	rsp = intf->sendrecv(intf, &req);
-	bridge_possible = backup_bridge_possible;
+	intf->session->bridge_possible = backup_bridge_possible;
 
 	if (rsp == NULL) {
 		lprintf(LOG_ERR, "Set Session Privilege Level to %s failed",
@@ -1902,7 +1777,7 @@ ipmi_close_session_cmd(struct ipmi_intf * intf)
 		return -1;
 
 	intf->target_addr = IPMI_BMC_SLAVE_ADDR;
-	bridge_possible = 0;  /* Not a bridge message */
+	intf->session->bridge_possible = 0;  /* Not a bridge message */
 
 	memcpy(&msg_data, &session_id, 4);
 
@@ -2004,7 +1879,7 @@ ipmi_lan_close(struct ipmi_intf * intf)
 	if (intf->fd >= 0)
 		close(intf->fd);
 
-	ipmi_req_clear_entries();
+	ipmi_req_clear_entries(intf);
 	ipmi_intf_session_cleanup(intf);
 	intf->opened = 0;
 	intf->manufacturer_id = IPMI_OEM_UNKNOWN;
@@ -2037,6 +1912,10 @@ ipmi_lan_open(struct ipmi_intf * intf)
 
 	intf->abort = 1;
 
+	s->active = 0;
+	s->session_id = 0;
+	s->in_seq = 0;
+	s->out_seq = 0;
 	intf->session->sol_data.sequence_number = 1;
 	
 	if (ipmi_intf_socket_connect (intf) == -1) {
@@ -24,6 +24,14 @@ escape sequences can suspend or deactivate the SOL session and so that data
 can be broken into chunks no greater than N bytes.  This maximum is
 specified by the BMC in the response to the Activate Payload command.
 
+The loop never blocks waiting for an ack.  Only one packet of user input
+is outstanding at a time, as the spec requires; whatever is typed while
+it is in flight collects in a buffer and goes out as the next packet once
+the ack arrives (or is resent, with the same sequence number, when the
+session timeout expires).  Data from the BMC is read in bursts and written
+to the terminal with one write() per burst.  Keep alive packets are only
+sent when the BMC has been silent and nothing is in flight.
+
 User input to the BMC is handled in ipmitool/src/plugins/lanplus/lanplus.c.
 Every SOL packet (with one exception) traveling in either direction causes
 the recipient to return an acknowledgement packet, though acks themself are
@@ -56,8 +64,15 @@ The standard code path for SOL logic follows:
         
         processSolUserInput (ipmi_sol.c):
             Process possible escape sequences (~., ~B, etc.)
-            Send (with retries) user data to the BMC
+            Buffer user data for the next packet
+
+        sol_send_data, sol_resend_data (ipmi_sol.c):
             Partial creation of packet payload
+            Resend on timeout
+
+        sol_handle_ack (ipmi_sol.c):
+            Match acks against the packet in flight
+            Requeue the rest of a partially acked packet
 
                 ipmi_lanplus_send_sol (lanplus.c):
                     Completion of packet payload
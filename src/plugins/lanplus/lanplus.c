@@ -30,19 +30,24 @@
  * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
  */
 
+#define _GNU_SOURCE	/* sendmmsg, recvmmsg */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <unistd.h>
 #include <netdb.h>
 #include <time.h>
+#include <sys/time.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <assert.h>
 
 #ifdef HAVE_CONFIG_H
@@ -54,15 +59,18 @@
 #include <ipmitool/ipmi_lanp.h>
 #include <ipmitool/ipmi_channel.h>
 #include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_mc.h>
 #include <ipmitool/ipmi_strings.h>
 #include <ipmitool/hpm2.h>
 #include <ipmitool/bswap.h>
+#include <ipmitool/ipmi_stats.h>
 #include <openssl/rand.h>
 
 #include "lanplus.h"
 #include "lanplus_crypt.h"
 #include "lanplus_crypt_impl.h"
 #include "lanplus_dump.h"
+#include "lanplus_cache.h"
 #include "rmcp.h"
 #include "asf.h"
 
@@ -79,8 +87,6 @@ extern const struct valstr ipmi_auth_algorithms[];
 extern const struct valstr ipmi_integrity_algorithms[];
 extern const struct valstr ipmi_encryption_algorithms[];
 
-static struct ipmi_rq_entry * ipmi_req_entries;
-static struct ipmi_rq_entry * ipmi_req_entries_tail;
 
 
 static int ipmi_lanplus_setup(struct ipmi_intf * intf);
@@ -89,6 +95,7 @@ static int ipmi_lan_send_packet(struct ipmi_intf * intf, uint8_t * data, int dat
 static struct ipmi_rs * ipmi_lan_recv_packet(struct ipmi_intf * intf);
 static struct ipmi_rs * ipmi_lan_poll_recv(struct ipmi_intf * intf);
 static struct ipmi_rs * ipmi_lanplus_send_ipmi_cmd(struct ipmi_intf * intf, struct ipmi_rq * req);
+static int ipmi_lanplus_poll(struct ipmi_intf * intf, int timeout);
 static struct ipmi_rs * ipmi_lanplus_send_payload(struct ipmi_intf * intf,
 												  struct ipmi_v2_payload * payload);
 static void getIpmiPayloadWireRep(
@@ -123,8 +130,6 @@ static void ack_sol_packet(
 static void ipmi_lanp_set_max_rq_data_size(struct ipmi_intf * intf, uint16_t size);
 static void ipmi_lanp_set_max_rp_data_size(struct ipmi_intf * intf, uint16_t size);
 
-static uint8_t bridgePossible = 0;
-
 struct ipmi_intf ipmi_lanplus_intf = {
 	name:		"lanplus",
 	desc:		"IPMI v2.0 RMCP+ LAN Interface",
@@ -132,6 +137,7 @@ struct ipmi_intf ipmi_lanplus_intf = {
 	open:		ipmi_lanplus_open,
 	close:		ipmi_lanplus_close,
 	sendrecv:	ipmi_lanplus_send_ipmi_cmd,
+	poll:		ipmi_lanplus_poll,
 	recv_sol:	ipmi_lanplus_recv_sol,
 	send_sol:	ipmi_lanplus_send_sol,
 	keepalive:	ipmi_lanplus_keepalive,
@@ -288,180 +294,194 @@ static const struct valstr plus_payload_types_vals[] = {
 };
 
 
-static struct ipmi_rq_entry *
-ipmi_req_add_entry(struct ipmi_intf * intf, struct ipmi_rq * req, uint8_t req_seq)
+int
+ipmi_lan_send_packet(
+					 struct ipmi_intf * intf,
+					 uint8_t * data, int
+					 data_len)
 {
-	struct ipmi_rq_entry * e;
+	int ret;
 
-	e = malloc(sizeof(struct ipmi_rq_entry));
-	if (e == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return NULL;
-	}
+	if (verbose >= 5)
+		printbuf(data, data_len, ">> sending packet");
 
-	memset(e, 0, sizeof(struct ipmi_rq_entry));
-	memcpy(&e->req, req, sizeof(struct ipmi_rq));
+	ret = send(intf->fd, data, data_len, 0);
+	if (ret > 0) {
+		IPMI_STATS_ADD(intf, tx_packets, 1);
+		IPMI_STATS_ADD(intf, tx_bytes, ret);
+	}
+	return ret;
+}
 
-	e->intf = intf;
-	e->rq_seq = req_seq;
 
-	if (ipmi_req_entries == NULL)
-		ipmi_req_entries = e;
-	else
-		ipmi_req_entries_tail->next = e;
 
-	ipmi_req_entries_tail = e;
-	lprintf(LOG_DEBUG+3, "added list entry seq=0x%02x cmd=0x%02x",
-		e->rq_seq, e->req.msg.cmd);     
-	return e;
-}
+/*
+ * ipmi_lan_send_packets
+ *
+ * Send several datagrams, with a single sendmmsg() where available.
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+ipmi_lan_send_packets(struct ipmi_intf * intf, struct iovec * iov, int count)
+{
+	int i, ret;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[IPMI_LAN_WINDOW_MAX];
 
+	if (count > IPMI_LAN_WINDOW_MAX)
+		return -1;
 
-static struct ipmi_rq_entry *
-ipmi_req_lookup_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * e = ipmi_req_entries;
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < count; i++) {
+		if (verbose >= 5)
+			printbuf(iov[i].iov_base, iov[i].iov_len, ">> sending packet");
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
 
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		if (e == e->next)
-			return NULL;
-		e = e->next;
+	for (i = 0; i < count; i += ret) {
+		ret = sendmmsg(intf->fd, &msgs[i], count - i, 0);
+		if (ret <= 0)
+			return -1;
 	}
-	return e;
+	IPMI_STATS_ADD(intf, tx_packets, count);
+	for (i = 0; i < count; i++)
+		IPMI_STATS_ADD(intf, tx_bytes, msgs[i].msg_len);
+#else
+	for (i = 0; i < count; i++) {
+		ret = ipmi_lan_send_packet(intf, iov[i].iov_base, iov[i].iov_len);
+		if (ret < 0)
+			return -1;
+	}
+#endif
+	return 0;
 }
 
-static void
-ipmi_req_remove_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * p, * e, * saved_next_entry;
-
-	e = p = ipmi_req_entries;
-
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		p = e;
-		e = e->next;
-	}
-	if (e) {
-		lprintf(LOG_DEBUG+3, "removed list entry seq=0x%02x cmd=0x%02x",
-			seq, cmd);
-		saved_next_entry = e->next;
-		p->next = (p->next == e->next) ? NULL : e->next;
-		/* If entry being removed is first in list, fix up list head */
-		if (ipmi_req_entries == e) {
-			if (ipmi_req_entries != p)
-				ipmi_req_entries = p;
-			else
-				ipmi_req_entries = saved_next_entry;
-		}
-		/* If entry being removed is last in list, fix up list tail */
-		if (ipmi_req_entries_tail == e) {
-			if (ipmi_req_entries_tail != p)
-				ipmi_req_entries_tail = p;
-			else
-				ipmi_req_entries_tail = NULL;
-		}
 
-		if (e->msg_data) {
-			free(e->msg_data);
-			e->msg_data = NULL;
-		}
-		free(e);
-		e = NULL;
-	}
-}
 
-static void
-ipmi_req_clear_entries(void)
+/*
+ * ipmi_lan_wait_packet
+ *
+ * Wait up to the session receive timeout for the socket to become
+ * readable.
+ *
+ * returns 0 if a datagram (or a pending socket error) can be read
+ * returns -1 on timeout or error
+ */
+static int
+ipmi_lan_wait_packet(struct ipmi_intf * intf)
 {
-	struct ipmi_rq_entry * p, * e;
-
-	e = ipmi_req_entries;
-	while (e) {
-		lprintf(LOG_DEBUG+3, "cleared list entry seq=0x%02x cmd=0x%02x",
-			e->rq_seq, e->req.msg.cmd);
-		p = e->next;
-		free(e);
-		e = p;
-	}
-}
+	struct pollfd pfd;
 
+	pfd.fd = intf->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
 
-int
-ipmi_lan_send_packet(
-					 struct ipmi_intf * intf,
-					 uint8_t * data, int
-					 data_len)
-{
-	if (verbose >= 5)
-		printbuf(data, data_len, ">> sending packet");
+	if (poll(&pfd, 1, ipmi_intf_session_wait(intf)) <= 0 ||
+		!(pfd.revents & (POLLIN | POLLERR)))
+		return -1;
 
-	return send(intf->fd, data, data_len, 0);
+	return 0;
 }
 
 
 
-struct ipmi_rs *
-ipmi_lan_recv_packet(struct ipmi_intf * intf)
+/*
+ * ipmi_lan_read_packets
+ *
+ * Read every datagram that is already queued on the socket, up to
+ * IPMI_LAN_RXQ_LEN, into the session receive queue with one
+ * recvmmsg().  Without recvmmsg() a single datagram is read.
+ *
+ * returns the number of datagrams read, -1 on error
+ */
+static int
+ipmi_lan_read_packets(struct ipmi_intf * intf)
 {
-	static struct ipmi_rs rsp;
-	fd_set read_set, err_set;
-	struct timeval tmout;
-	int ret;
-
-	FD_ZERO(&read_set);
-	FD_SET(intf->fd, &read_set);
+	struct ipmi_session * session = intf->session;
+	int i, ret;
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr msgs[IPMI_LAN_RXQ_LEN];
+	struct iovec iov[IPMI_LAN_RXQ_LEN];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < IPMI_LAN_RXQ_LEN; i++) {
+		iov[i].iov_base = session->rxq.data[i];
+		iov[i].iov_len = IPMI_BUF_SIZE;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
 
-	FD_ZERO(&err_set);
-	FD_SET(intf->fd, &err_set);
+	ret = recvmmsg(intf->fd, msgs, IPMI_LAN_RXQ_LEN, MSG_DONTWAIT, NULL);
+	if (ret < 0)
+		return -1;
 
-	tmout.tv_sec = intf->session->timeout;
-	tmout.tv_usec = 0;
+	for (i = 0; i < ret; i++)
+		session->rxq.len[i] = msgs[i].msg_len;
+#else
+	ret = recv(intf->fd, session->rxq.data[0], IPMI_BUF_SIZE, MSG_DONTWAIT);
+	if (ret < 0)
+		return -1;
 
-	ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
-	if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
-		return NULL;
+	session->rxq.len[0] = ret;
+	ret = 1;
+#endif
+	session->rxq.head = 0;
+	session->rxq.count = ret;
 
-	/* the first read may return ECONNREFUSED because the rmcp ping
-	 * packet--sent to UDP port 623--will be processed by both the
-	 * BMC and the OS.
-	 *
-	 * The problem with this is that the ECONNREFUSED takes
-	 * priority over any other received datagram; that means that
-	 * the Connection Refused shows up _before_ the response packet,
-	 * regardless of the order they were sent out.  (unless the
-	 * response is read before the connection refused is returned)
-	 */
-	ret = recv(intf->fd, &rsp.data, IPMI_BUF_SIZE, 0);
+	return ret;
+}
 
-	if (ret < 0) {
-		FD_ZERO(&read_set);
-		FD_SET(intf->fd, &read_set);
 
-		FD_ZERO(&err_set);
-		FD_SET(intf->fd, &err_set);
 
-		tmout.tv_sec = intf->session->timeout;
-		tmout.tv_usec = 0;
+struct ipmi_rs *
+ipmi_lan_recv_packet(struct ipmi_intf * intf)
+{
+	struct ipmi_session * session = intf->session;
+	struct ipmi_rs * rsp = &session->rsp;
+	int ret;
 
-		ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
-		if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
+	if (session->rxq.count == 0) {
+		if (ipmi_lan_wait_packet(intf) < 0)
 			return NULL;
 
-		ret = recv(intf->fd, &rsp.data, IPMI_BUF_SIZE, 0);
-		if (ret < 0)
-			return NULL;
+		/* the first read may return ECONNREFUSED because the rmcp ping
+		 * packet--sent to UDP port 623--will be processed by both the
+		 * BMC and the OS.
+		 *
+		 * The problem with this is that the ECONNREFUSED takes
+		 * priority over any other received datagram; that means that
+		 * the Connection Refused shows up _before_ the response packet,
+		 * regardless of the order they were sent out.  (unless the
+		 * response is read before the connection refused is returned)
+		 */
+		if (ipmi_lan_read_packets(intf) < 0) {
+			if (ipmi_lan_wait_packet(intf) < 0)
+				return NULL;
+			if (ipmi_lan_read_packets(intf) < 0)
+				return NULL;
+		}
 	}
 
+	ret = session->rxq.len[session->rxq.head];
+	memcpy(rsp->data, session->rxq.data[session->rxq.head], ret);
+	session->rxq.head++;
+	session->rxq.count--;
+
 	if (ret == 0)
 		return NULL;
 
-	rsp.data[ret] = '\0';
-	rsp.data_len = ret;
+	rsp->data[ret] = '\0';
+	rsp->data_len = ret;
+
+	IPMI_STATS_ADD(intf, rx_packets, 1);
+	IPMI_STATS_ADD(intf, rx_bytes, ret);
 
 	if (verbose >= 5)
-		printbuf(rsp.data, rsp.data_len, "<< received packet");
+		printbuf(rsp->data, rsp->data_len, "<< received packet");
 
-	return &rsp;
+	return rsp;
 }
 
 
@@ -679,6 +699,7 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 		{
 			lanplus_decrypt_payload(session->v2_data.crypt_alg,
 						session->v2_data.k2,
+						session->v2_data.crypt_ctx,
 						rsp->data + offset,
 						rsp->session.msglen,
 						rsp->data + offset,
@@ -728,13 +749,13 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 				rsp->ccode);
 
 			/* Are we expecting this packet? */
-			entry = ipmi_req_lookup_entry(rsp->payload.ipmi_response.rq_seq,
+			entry = ipmi_req_lookup_entry(intf, rsp->payload.ipmi_response.rq_seq,
 								rsp->payload.ipmi_response.cmd);
 
 			if (entry != NULL) {
 				lprintf(LOG_DEBUG+2, "IPMI Request Match found");
 				if ( intf->target_addr != intf->my_addr &&
-				     bridgePossible &&
+				     intf->session->bridge_possible &&
 				     rsp->data_len &&
 				     rsp->payload.ipmi_response.cmd == 0x34 &&
 				     (rsp->payload.ipmi_response.netfn == 0x06 ||
@@ -746,8 +767,7 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 					{
 						lprintf(LOG_DEBUG, "Bridged command answer,"
 						     " waiting for next answer... ");
-						ipmi_req_remove_entry(
-							rsp->payload.ipmi_response.rq_seq,
+						ipmi_req_remove_entry(intf, rsp->payload.ipmi_response.rq_seq,
 							rsp->payload.ipmi_response.cmd);
 						return ipmi_lan_poll_recv(intf);
 					}
@@ -769,7 +789,7 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 					}
 				}
 
-				ipmi_req_remove_entry(rsp->payload.ipmi_response.rq_seq,
+				ipmi_req_remove_entry(intf, rsp->payload.ipmi_response.rq_seq,
 								rsp->payload.ipmi_response.cmd);
 			} else {
 				lprintf(LOG_INFO, "IPMI Request Match NOT FOUND");
@@ -1368,7 +1388,7 @@ void getIpmiPayloadWireRep(
 	len = 0;
 
 	/* IPMI Message Header -- Figure 13-4 of the IPMI v2.0 spec */
-	if ((intf->target_addr == ourAddress) || (!bridgePossible)) {
+	if ((intf->target_addr == ourAddress) || (!intf->session->bridge_possible)) {
 		cs = len;
 	} else {
 		bridgedRequest = 1;
@@ -1426,7 +1446,7 @@ void getIpmiPayloadWireRep(
 		bridgedRequest ? "Bridging" : "Local",
 		intf->my_addr, intf->transit_addr, intf->transit_channel,
 		intf->target_addr, intf->target_channel,
-		bridgePossible);
+		intf->session->bridge_possible);
 
 	/* rsAddr */
 	msg[len++] = intf->target_addr; /* IPMI_BMC_SLAVE_ADDR; */
@@ -1581,13 +1601,19 @@ void getSolPayloadWireRep(
  * +----------------------+
  * | Authcode             | var (possibly absent)
  * +----------------------+
+ *
+ * The message is built in msg, which must hold IPMI_BUF_SIZE bytes.
+ * An encrypted payload is written right behind the room left for the
+ * confidentiality header and encrypted in place.
+ *
+ * returns 0 on success, -1 if the message does not fit
  */
-void
+int
 ipmi_lanplus_build_v2x_msg(
 							struct ipmi_intf       * intf,     /* in  */
 							struct ipmi_v2_payload * payload,  /* in  */
 							int                    * msg_len,  /* out */
-							uint8_t         ** msg_data, /* out */
+							uint8_t                * msg,      /* out */
 							uint8_t curr_seq)
 {
 	uint32_t session_trailer_length = 0;
@@ -1598,8 +1624,8 @@ ipmi_lanplus_build_v2x_msg(
 		.seq		= 0xff,
 	};
 
-	/* msg will hold the entire message to be sent */
-	uint8_t * msg;
+	/* where the (clear text) payload goes */
+	uint8_t * payload_out = msg + IPMI_LANPLUS_OFFSET_PAYLOAD;
 	int len = 0;
 
 
@@ -1607,20 +1633,26 @@ ipmi_lanplus_build_v2x_msg(
 		sizeof(rmcp)                +  // RMCP Header (4)
 		10                          +  // IPMI Session Header
 		2                           +  // Message length
+		IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE + // Confidentiality Header
 		payload->payload_length     +  // The actual payload
+		16                          +  // Bridging (Send Message)
+		IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE + // Confidentiality Trailer
 		IPMI_MAX_INTEGRITY_PAD_SIZE +  // Integrity Pad
 		1                           +  // Pad Length
 		1                           +  // Next Header
 		IPMI_MAX_AUTH_CODE_SIZE;       // Authcode
 
-
-	msg = malloc(len);
-	if (msg == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return;
+	if (len > IPMI_BUF_SIZE) {
+		lprintf(LOG_ERR, "Payload too large for transmit buffer");
+		*msg_len = 0;
+		return -1;
 	}
 	memset(msg, 0, len);
 
+	if (session->v2_data.session_state == LANPLUS_STATE_ACTIVE &&
+		session->v2_data.crypt_alg != IPMI_CRYPT_NONE)
+		payload_out += IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE;
+
 	/*
 	 *------------------------------------------
 	 * RMCP HEADER
@@ -1684,7 +1716,7 @@ ipmi_lanplus_build_v2x_msg(
 	case IPMI_PAYLOAD_TYPE_IPMI:
 		getIpmiPayloadWireRep(intf,
 							  payload,  /* in  */
-							  msg + IPMI_LANPLUS_OFFSET_PAYLOAD,
+							  payload_out,
 							  payload->payload.ipmi_request.request,
 							  payload->payload.ipmi_request.rq_seq,
 							  curr_seq);
@@ -1692,11 +1724,11 @@ ipmi_lanplus_build_v2x_msg(
 
 	case IPMI_PAYLOAD_TYPE_SOL: 
 		getSolPayloadWireRep(intf,
-							 msg + IPMI_LANPLUS_OFFSET_PAYLOAD,
+							 payload_out,
 							 payload);
 
 		if (verbose >= 5)
-			printbuf(msg + IPMI_LANPLUS_OFFSET_PAYLOAD, 4, "SOL MSG TO BMC");
+			printbuf(payload_out, 4, "SOL MSG TO BMC");
 
 		len += payload->payload_length;
 
@@ -1729,8 +1761,6 @@ ipmi_lanplus_build_v2x_msg(
 	default:
 		lprintf(LOG_ERR, "unsupported payload type 0x%x",
 			payload->payload_type);
-		free(msg);
-		msg = NULL;
 		assert(0);
 		break;
 	}
@@ -1746,7 +1776,8 @@ ipmi_lanplus_build_v2x_msg(
 		/* Payload len is adjusted as necessary by lanplus_encrypt_payload */
 		lanplus_encrypt_payload(session->v2_data.crypt_alg,        /* input  */
 								session->v2_data.k2,               /* input  */
-								msg + IPMI_LANPLUS_OFFSET_PAYLOAD, /* input  */
+								session->v2_data.crypt_ctx,        /* input  */
+								payload_out,                       /* input  */
 								payload->payload_length,           /* input  */
 								msg + IPMI_LANPLUS_OFFSET_PAYLOAD, /* output */
 								&(payload->payload_length));       /* output */
@@ -1824,7 +1855,14 @@ ipmi_lanplus_build_v2x_msg(
 
 
 		/* Auth Code */
-		lanplus_HMAC(session->v2_data.integrity_alg,
+		if (session->v2_data.crypt_ctx != NULL)
+			lanplus_HMAC_ctx(session->v2_data.crypt_ctx,  /* K1 keyed   */
+					 msg + IPMI_LANPLUS_OFFSET_AUTHTYPE, /* hmac input */
+					 hmac_input_size,
+					 hmac_output,
+					 &hmac_length);
+		else
+			lanplus_HMAC(session->v2_data.integrity_alg,
 					 session->v2_data.k1,                /* key        */
 					 20,                                 /* key length */
 					 msg + IPMI_LANPLUS_OFFSET_AUTHTYPE, /* hmac input */
@@ -1853,84 +1891,86 @@ ipmi_lanplus_build_v2x_msg(
 		IPMI_LANPLUS_OFFSET_PAYLOAD +
 		payload->payload_length     +
 		session_trailer_length;
-	*msg_data = msg;
+	return 0;
 }
 
 
 
 /*
- * ipmi_lanplus_build_v2x_ipmi_cmd
+ * ipmi_lanplus_build_v2x_ipmi_cmd_seq
  *
  * Wraps ipmi_lanplus_build_v2x_msg and returns a new entry object for the
- * command
+ * command, using the given IPMI request sequence number
  *
  */
 static struct ipmi_rq_entry *
-ipmi_lanplus_build_v2x_ipmi_cmd(
+ipmi_lanplus_build_v2x_ipmi_cmd_seq(
 								struct ipmi_intf * intf,
 								struct ipmi_rq * req,
-								int isRetry)
+								uint8_t curr_seq)
 {
 	struct ipmi_v2_payload v2_payload;
 	struct ipmi_rq_entry * entry;
 
-	/*
-	 * We have a problem.  we need to know the sequence number here,
-	 * because we use it in our stored entry.  But we also need to
-	 * know the sequence number when we generate our IPMI
-	 * representation far below.
-	 */
-	static uint8_t curr_seq = 0;
-
-	if( isRetry == 0 )
-		curr_seq += 1;
-
-	if (curr_seq >= 64)
-		curr_seq = 0;
-
-
 	/* IPMI Message Header -- Figure 13-4 of the IPMI v2.0 spec */
-	if ((intf->target_addr == intf->my_addr) || (!bridgePossible))
-   {
 	entry = ipmi_req_add_entry(intf, req, curr_seq);
-   }
-   else /* it's a bridge command */
-   {
-      unsigned char backup_cmd;
-
-      /* Add entry for cmd */
-   	entry = ipmi_req_add_entry(intf, req, curr_seq);
-
-      if(entry)
-      {
-         /* Add entry for bridge cmd */
-         backup_cmd = req->msg.cmd;
-         req->msg.cmd = 0x34;
-   	   entry = ipmi_req_add_entry(intf, req, curr_seq);
-         req->msg.cmd = backup_cmd;
-      }
-   }   
-
 	if (entry == NULL)
 		return NULL;
 
+	/* a bridged command is also answered by the Send Message (0x34) */
+	if ((intf->target_addr != intf->my_addr) && intf->session->bridge_possible)
+		entry->bridging_level = 1;
+
 	// Build our payload
 	v2_payload.payload_type                 = IPMI_PAYLOAD_TYPE_IPMI;
 	v2_payload.payload_length               = req->msg.data_len + 7;
 	v2_payload.payload.ipmi_request.request = req;
 	v2_payload.payload.ipmi_request.rq_seq  = curr_seq;
 
-	ipmi_lanplus_build_v2x_msg(intf,                // in
+	if (ipmi_lanplus_build_v2x_msg(intf,                // in
 					&v2_payload,         // in
 					&(entry->msg_len),   // out
-					&(entry->msg_data),  // out
-					curr_seq); 		// in
+					entry->msg_data,     // out
+					curr_seq) < 0) {	// in
+		ipmi_req_remove_entry(intf, entry->rq_seq, req->msg.cmd);
+		return NULL;
+	}
 
 	return entry;
 }
 
 
 
+/*
+ * ipmi_lanplus_build_v2x_ipmi_cmd
+ *
+ * Build a command with the next IPMI request sequence number, or with
+ * the previous one if this is a retry
+ *
+ */
+static struct ipmi_rq_entry *
+ipmi_lanplus_build_v2x_ipmi_cmd(
+								struct ipmi_intf * intf,
+								struct ipmi_rq * req,
+								int isRetry)
+{
+	/*
+	 * We have a problem.  we need to know the sequence number here,
+	 * because we use it in our stored entry.  But we also need to
+	 * know the sequence number when we generate our IPMI
+	 * representation far below.
+	 */
+	if( isRetry == 0 )
+		intf->session->rq_seq += 1;
+
+	if (intf->session->rq_seq >= IPMI_RQ_SEQ_MAX)
+		intf->session->rq_seq = 0;
+
+	return ipmi_lanplus_build_v2x_ipmi_cmd_seq(intf, req, intf->session->rq_seq);
+}
+
+
+
 
 
 /*
@@ -1982,11 +2022,12 @@ ipmi_lanplus_build_v15_ipmi_cmd(
 
 	len = req->msg.data_len + 21;
 
-	msg = malloc(len);
-	if (msg == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
+	if (len > IPMI_BUF_SIZE) {
+		lprintf(LOG_ERR, "Request too large for transmit buffer");
+		ipmi_req_remove_entry(intf, entry->rq_seq, req->msg.cmd);
 		return NULL;
 	}
+	msg = entry->msg_data;
 	memset(msg, 0, len);
 
 	/* rmcp header */
@@ -2061,7 +2102,6 @@ ipmi_lanplus_build_v15_ipmi_cmd(
 	msg[len++] = ipmi_csum(msg+cs, tmp);
 
 	entry->msg_len = len;
-	entry->msg_data = msg;
 
 	return entry;
 }
@@ -2112,25 +2152,18 @@ ipmi_lanplus_send_payload(
 	int                   msg_length;
 	struct ipmi_session * session = intf->session;
 	struct ipmi_rq_entry * entry = NULL;
+	uint32_t              entry_gen = 0;
 	int                   try = 0;
 	int                   xmit = 1;
-	time_t                ltime;
-	uint32_t	      saved_timeout;
+	uint32_t              sent = 0;
+	uint32_t              rto = 0;
+	uint32_t              elapsed;
 
 	if (!intf->opened && intf->open && intf->open(intf) < 0)
 		return NULL;
 
-	/*
-	 * The session timeout is initialized in the above interface open,
-	 * so it will only be valid after the open completes.
-	 */
-	saved_timeout = session->timeout;
 	while (try < session->retry) {
-		//ltime = time(NULL);
-
 		if (xmit) {
-			ltime = time(NULL);
-
 			if (payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI)
 			{
 				/*
@@ -2181,6 +2214,7 @@ ipmi_lanplus_send_payload(
 
 				msg_data   = entry->msg_data;
 				msg_length = entry->msg_len;
+				entry_gen  = entry->gen;
 			}
 
 			else if (payload->payload_type == IPMI_PAYLOAD_TYPE_RMCP_OPEN_REQUEST)
@@ -2189,11 +2223,14 @@ ipmi_lanplus_send_payload(
 				assert(session->v2_data.session_state == LANPLUS_STATE_PRESESSION
 						|| session->v2_data.session_state == LANPLUS_STATE_OPEN_SESSION_SENT);
 
-				ipmi_lanplus_build_v2x_msg(intf,        /* in  */
+				/* not kept in the request table */
+				msg_data = session->txbuf[IPMI_RQ_SEQ_MAX];
+				if (ipmi_lanplus_build_v2x_msg(intf,        /* in  */
 								payload,     /* in  */
 								&msg_length, /* out */
-								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								msg_data,    /* out */
+								0) < 0)  /* irrelevant for this msg*/
+					return NULL;
 
 			}
 
@@ -2203,11 +2240,14 @@ ipmi_lanplus_send_payload(
 				assert(session->v2_data.session_state ==
 						 LANPLUS_STATE_OPEN_SESSION_RECEIEVED);
 
-				ipmi_lanplus_build_v2x_msg(intf,        /* in  */
+				/* not kept in the request table */
+				msg_data = session->txbuf[IPMI_RQ_SEQ_MAX];
+				if (ipmi_lanplus_build_v2x_msg(intf,        /* in  */
 								payload,     /* in  */
 								&msg_length, /* out */
-								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								msg_data,    /* out */
+								0) < 0)  /* irrelevant for this msg*/
+					return NULL;
 
 			}
 
@@ -2217,11 +2257,14 @@ ipmi_lanplus_send_payload(
 				assert(session->v2_data.session_state ==
 						 LANPLUS_STATE_RAKP_2_RECEIVED);
 
-				ipmi_lanplus_build_v2x_msg(intf,        /* in  */
+				/* not kept in the request table */
+				msg_data = session->txbuf[IPMI_RQ_SEQ_MAX];
+				if (ipmi_lanplus_build_v2x_msg(intf,        /* in  */
 								payload,     /* in  */
 								&msg_length, /* out */
-								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								msg_data,    /* out */
+								0) < 0)  /* irrelevant for this msg*/
+					return NULL;
 
 			}
 
@@ -2230,11 +2273,14 @@ ipmi_lanplus_send_payload(
 				lprintf(LOG_DEBUG, ">> SENDING A SOL MESSAGE\n");
 				assert(session->v2_data.session_state == LANPLUS_STATE_ACTIVE);
 
-				ipmi_lanplus_build_v2x_msg(intf,        /* in  */
+				/* not kept in the request table */
+				msg_data = session->txbuf[IPMI_RQ_SEQ_MAX];
+				if (ipmi_lanplus_build_v2x_msg(intf,        /* in  */
 								payload,     /* in  */
 								&msg_length, /* out */
-								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								msg_data,    /* out */
+								0) < 0)  /* irrelevant for this msg*/
+					return NULL;
 			}
 
 			else
@@ -2249,6 +2295,19 @@ ipmi_lanplus_send_payload(
 				lprintf(LOG_ERR, "IPMI LAN send command failed");
 				return NULL;
 			}
+			sent = ipmi_intf_msec();
+			if (try > 0)
+				IPMI_STATS_ADD(intf, retransmits, 1);
+
+			/*
+			 * IPMI requests are resent on the adaptive retransmission
+			 * timer, everything else waits the full session timeout.
+			 */
+			if (payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI)
+				rto = ipmi_intf_session_rto(intf, try);
+			else
+				rto = ipmi_intf_session_timeout_ms(intf);
+			session->rtt.wait = rto;
 		}
 
 		/* if we are set to noanswer we do not expect response */
@@ -2321,37 +2380,36 @@ ipmi_lanplus_send_payload(
 				rsp = ipmi_lan_poll_recv(intf);
 			}
 
-			if (rsp)
+			if (rsp) {
+				if (payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI &&
+				    try == 0)
+					ipmi_intf_session_rtt_sample(intf,
+						ipmi_intf_msec() - sent);
 				break;
-			/* This payload type is retryable for timeouts. */
-			if ((payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI) && entry) {
-				ipmi_req_remove_entry( entry->rq_seq, entry->req.msg.cmd);
 			}
 		}
 
-		/* only timeout if time exceeds the timeout value */
-		xmit = ((time(NULL) - ltime) >= session->timeout);
-
-		usleep(5000);
+		/*
+		 * Only resend once the retransmission timer has expired,
+		 * otherwise keep waiting out the rest of it.
+		 */
+		elapsed = ipmi_intf_msec() - sent;
+		xmit = (elapsed >= rto);
+		if (!xmit) {
+			session->rtt.wait = rto - elapsed;
+			continue;
+		}
 
-		if (xmit) {
-			/* increment session timeout by 1 second each retry */
-			session->timeout++;
+		/* This payload type is retryable for timeouts. */
+		if ((payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI) && entry &&
+		    entry->in_use && entry->gen == entry_gen) {
+			ipmi_req_remove_entry(intf, entry->rq_seq, entry->req.msg.cmd);
 		}
 
+		IPMI_STATS_ADD(intf, timeouts, 1);
 		try++;
 	}
-	session->timeout = saved_timeout;
-
-	/* IPMI messages are deleted under ipmi_lan_poll_recv() */
-	switch (payload->payload_type) {
-	case IPMI_PAYLOAD_TYPE_RMCP_OPEN_REQUEST:
-	case IPMI_PAYLOAD_TYPE_RAKP_1:
-	case IPMI_PAYLOAD_TYPE_RAKP_3:
-		free(msg_data);
-		msg_data = NULL;
-		break;
-	}
+	session->rtt.wait = 0;
 
 	return rsp;
 }
@@ -2504,8 +2562,7 @@ check_sol_packet_for_new_data(
 							  struct ipmi_intf * intf,
 							  struct ipmi_rs *rsp)
 {
-	static uint8_t last_received_sequence_number = 0;
-	static uint8_t last_received_byte_count      = 0;
+	struct ipmi_session * session = intf->session;
 	int new_data_size                                  = 0;
 
 
@@ -2517,14 +2574,15 @@ check_sol_packet_for_new_data(
 		uint8_t unaltered_data_len = rsp->data_len;
 
 		if (rsp->payload.sol_packet.packet_sequence_number ==
-			last_received_sequence_number)
+			session->sol_data.last_received_sequence_number)
 		{
 
 			/*
 			 * This is the same as the last packet, but may include
 			 * extra data
 			 */
-			new_data_size = rsp->data_len - last_received_byte_count;
+			new_data_size = rsp->data_len -
+				session->sol_data.last_received_byte_count;
 
 			if (new_data_size > 0)
 			{
@@ -2544,10 +2602,10 @@ check_sol_packet_for_new_data(
 		 */
 		if (rsp->payload.sol_packet.packet_sequence_number)
 		{
-			last_received_sequence_number =
+			session->sol_data.last_received_sequence_number =
 				rsp->payload.sol_packet.packet_sequence_number;
 
-			last_received_byte_count = unaltered_data_len;
+			session->sol_data.last_received_byte_count = unaltered_data_len;
 		}
 	}
 
@@ -2643,6 +2701,327 @@ ipmi_lanplus_send_ipmi_cmd(
 }
 
 
+/*
+ * ipmi_lanplus_async_bridged
+ *
+ * returns 1 if a submitted request has to be bridged to its target, so
+ * it can't share the window
+ */
+static int
+ipmi_lanplus_async_bridged(struct ipmi_intf * intf, struct ipmi_async_rq * e)
+{
+	uint8_t ourAddress = intf->my_addr ? intf->my_addr : IPMI_BMC_SLAVE_ADDR;
+
+	return e->to.target_addr != ourAddress && intf->session->bridge_possible;
+}
+
+
+
+/*
+ * ipmi_lanplus_async_build
+ *
+ * Build a submitted request for the target it was submitted for
+ */
+static struct ipmi_rq_entry *
+ipmi_lanplus_async_build(struct ipmi_intf * intf, struct ipmi_async_rq * e,
+		int seq)
+{
+	struct ipmi_rq_target saved;
+	struct ipmi_rq_entry * entry;
+
+	ipmi_intf_get_target(intf, &saved);
+	ipmi_intf_set_target(intf, &e->to);
+	if (seq < 0)
+		entry = ipmi_lanplus_build_v2x_ipmi_cmd(intf, e->req, 0);
+	else
+		entry = ipmi_lanplus_build_v2x_ipmi_cmd_seq(intf, e->req, seq);
+	ipmi_intf_set_target(intf, &saved);
+
+	return entry;
+}
+
+
+
+/*
+ * ipmi_lanplus_async_fill
+ *
+ * Move requests from the ipmi_intf_submit() queue into the window, as
+ * long as it has room and up to the next bridged request, and send
+ * them with a single ipmi_lan_send_packets() call.
+ *
+ * returns 0 on success, -1 if the window had to be aborted
+ */
+static int
+ipmi_lanplus_async_fill(struct ipmi_intf * intf, int window)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_session * session = intf->session;
+	struct ipmi_async_rq * e;
+	struct ipmi_rq_entry * entry;
+	struct iovec iov[IPMI_LAN_WINDOW_MAX];
+	int seq, niov = 0;
+
+	while (async->head != NULL && async->inflight < window &&
+			!ipmi_lanplus_async_bridged(intf, async->head)) {
+		seq = (session->rq_seq + 1) & 0x3f;
+		if (async->slot[seq] != NULL)
+			break;	/* wrapped onto a request still outstanding */
+
+		e = ipmi_async_next(intf);
+		async->inflight++;
+		entry = ipmi_lanplus_async_build(intf, e, -1);
+		if (entry == NULL) {
+			lprintf(LOG_ERR, "Aborting send command, unable to build");
+			ipmi_stats_record(intf, e->req, NULL, 0);
+			ipmi_async_done(intf, e, NULL);
+			return -1;
+		}
+		lprintf(LOG_DEBUG+2, "window: sending request as rq_seq 0x%02x", seq);
+		iov[niov].iov_base = entry->msg_data;
+		iov[niov++].iov_len = entry->msg_len;
+		async->slot[seq] = e;
+		e->tries = 1;
+		e->sent = ipmi_intf_msec();
+		e->start = ipmi_stats_usec();
+	}
+	if (niov > 0 && ipmi_lan_send_packets(intf, iov, niov) < 0) {
+		lprintf(LOG_ERR, "IPMI LAN send command failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * ipmi_lanplus_async_wait
+ *
+ * How long the window may wait for a response before a retransmission
+ * timer expires.
+ *
+ * returns milliseconds, -1 if nothing is outstanding
+ */
+static int
+ipmi_lanplus_async_wait(struct ipmi_intf * intf)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_rq * e;
+	uint32_t now, rto;
+	int seq, wait = -1;
+
+	now = ipmi_intf_msec();
+	for (seq = 0; seq < IPMI_RQ_SEQ_MAX; seq++) {
+		e = async->slot[seq];
+		if (e == NULL)
+			continue;
+		rto = ipmi_intf_session_rto(intf, e->tries - 1);
+		if (now - e->sent >= rto)
+			return 0;
+		if (wait < 0 || rto - (now - e->sent) < (uint32_t)wait)
+			wait = rto - (now - e->sent);
+	}
+
+	return wait;
+}
+
+
+
+/*
+ * ipmi_lan_readable
+ *
+ * returns 1 if a datagram can be read without blocking
+ */
+static int
+ipmi_lan_readable(struct ipmi_intf * intf)
+{
+	struct pollfd pfd;
+
+	if (intf->session->rxq.count > 0)
+		return 1;
+
+	pfd.fd = intf->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLIN | POLLERR));
+}
+
+
+
+/*
+ * ipmi_lanplus_poll
+ *
+ * Drive the requests queued with ipmi_intf_submit(), keeping up to
+ * session->window of them outstanding.  Responses are matched back to
+ * their request by rq_seq and completed in the order they arrive.  A
+ * request that is not answered before its retransmission timer expires
+ * is rebuilt with a fresh session sequence number and sent again, up
+ * to session->retry times.  The requests sent in one pass go out with
+ * a single ipmi_lan_send_packets() call.
+ *
+ * Bridged requests and requests sent before the session is active go
+ * through intf->sendrecv() one at a time, once nothing else is
+ * outstanding.  Every request goes to the target it was submitted
+ * for.  Requests completed here are accounted for with
+ * ipmi_stats_record().
+ *
+ * param timeout is how long to wait for responses in milliseconds, or
+ *       -1 to wait until at least one request completes
+ *
+ * returns the number of requests completed, -1 if the window had to
+ *         be aborted
+ */
+static int
+ipmi_lanplus_poll(struct ipmi_intf * intf, int timeout)
+{
+	struct ipmi_async * async = intf->async;
+	struct ipmi_session * session;
+	struct ipmi_async_rq * e;
+	struct ipmi_rq_entry * entry;
+	struct ipmi_rq_target saved;
+	struct ipmi_rs * rsp;
+	struct iovec iov[IPMI_LAN_WINDOW_MAX];
+	int window, serial, niov, seq, wait, done = 0;
+	uint32_t begin, now;
+
+	if (!intf->opened && intf->open && intf->open(intf) < 0) {
+		ipmi_async_abort(intf);
+		return -1;
+	}
+
+	session = intf->session;
+	window = __max(__min(session->window, IPMI_LAN_WINDOW_MAX), 1);
+	begin = ipmi_intf_msec();
+
+	for (;;) {
+		serial = intf->noanswer ||
+			session->v2_data.session_state != LANPLUS_STATE_ACTIVE;
+
+		if (async->inflight == 0 && async->head != NULL &&
+				(serial || ipmi_lanplus_async_bridged(intf, async->head))) {
+			/*
+			 * Callbacks may submit more, keep going until none is left
+			 * or the next one can use the window.  The callbacks see
+			 * the target their caller set.
+			 */
+			ipmi_intf_get_target(intf, &saved);
+			while (async->head != NULL && (serial ||
+					ipmi_lanplus_async_bridged(intf, async->head))) {
+				e = ipmi_async_next(intf);
+				async->inflight++;
+				ipmi_intf_set_target(intf, &e->to);
+				rsp = intf->sendrecv(intf, e->req);
+				ipmi_intf_set_target(intf, &saved);
+				ipmi_async_done(intf, e, rsp);
+				ipmi_intf_get_target(intf, &saved);
+				done++;
+			}
+			if (async->head == NULL)
+				break;
+		}
+		if (!serial && ipmi_lanplus_async_fill(intf, window) < 0)
+			goto abort;
+		if (async->inflight == 0)
+			break;
+
+		/* Wait no longer than the first retransmission timer */
+		wait = ipmi_lanplus_async_wait(intf);
+		if (timeout >= 0) {
+			now = ipmi_intf_msec() - begin;
+			wait = __min(wait, (now < (uint32_t)timeout) ? (int)(timeout - now) : 0);
+		}
+
+		rsp = NULL;
+		if (wait > 0 || ipmi_lan_readable(intf)) {
+			session->rtt.wait = __max(wait, 1);
+			rsp = ipmi_lan_poll_recv(intf);
+		}
+
+		if (rsp != NULL &&
+			rsp->session.payloadtype == IPMI_PAYLOAD_TYPE_IPMI &&
+			async->slot[rsp->payload.ipmi_response.rq_seq & 0x3f] != NULL)
+		{
+			seq = rsp->payload.ipmi_response.rq_seq & 0x3f;
+			e = async->slot[seq];
+
+			/*
+			 * Duplicate Request ccode most likely indicates a response
+			 * to a previous retry.  The slot times out and is resent.
+			 */
+			if (rsp->ccode != 0xcf) {
+				if (e->tries == 1)
+					ipmi_intf_session_rtt_sample(intf,
+						ipmi_intf_msec() - e->sent);
+				async->slot[seq] = NULL;
+				ipmi_stats_record(intf, e->req, rsp,
+					ipmi_stats_usec() - e->start);
+				ipmi_async_done(intf, e, rsp);
+				done++;
+			}
+		}
+
+		/* Retransmit or give up on whatever has timed out */
+		now = ipmi_intf_msec();
+		niov = 0;
+		for (seq = 0; seq < IPMI_RQ_SEQ_MAX; seq++) {
+			e = async->slot[seq];
+			if (e == NULL || (now - e->sent) <
+				ipmi_intf_session_rto(intf, e->tries - 1))
+				continue;
+
+			ipmi_req_remove_entry(intf, seq, e->req->msg.cmd);
+			IPMI_STATS_ADD(intf, timeouts, 1);
+
+			if (e->tries >= session->retry) {
+				lprintf(LOG_DEBUG, "No response to rq_seq 0x%02x", seq);
+				async->slot[seq] = NULL;
+				ipmi_stats_record(intf, e->req, NULL, 0);
+				ipmi_async_done(intf, e, NULL);
+				done++;
+				continue;
+			}
+
+			entry = ipmi_lanplus_async_build(intf, e, seq);
+			if (entry == NULL) {
+				lprintf(LOG_ERR, "Aborting send command, unable to build");
+				goto abort;
+			}
+			lprintf(LOG_DEBUG+2, "window: resending rq_seq 0x%02x", seq);
+			iov[niov].iov_base = entry->msg_data;
+			iov[niov++].iov_len = entry->msg_len;
+			e->tries++;
+			e->sent = now;
+			IPMI_STATS_ADD(intf, retransmits, 1);
+		}
+		if (niov > 0 && ipmi_lan_send_packets(intf, iov, niov) < 0) {
+			lprintf(LOG_ERR, "IPMI LAN send command failed");
+			goto abort;
+		}
+
+		if (timeout < 0 ? done > 0 : ipmi_intf_msec() - begin >= (uint32_t)timeout)
+			break;
+	}
+
+	/* Put whatever the callbacks submitted on the wire before returning */
+	if (!serial && ipmi_lanplus_async_fill(intf, window) < 0)
+		goto abort;
+
+	session->rtt.wait = 0;
+	ipmi_async_set_timeout(intf, ipmi_lanplus_async_wait(intf));
+	return done;
+
+ abort:
+	session->rtt.wait = 0;
+	for (seq = 0; seq < IPMI_RQ_SEQ_MAX; seq++)
+		if (async->slot[seq] != NULL)
+			ipmi_req_remove_entry(intf, seq, async->slot[seq]->req->msg.cmd);
+	ipmi_async_abort(intf);
+	return -1;
+}
+
+
+
 /*
  * ipmi_get_auth_capabilities_cmd
  *
@@ -2672,9 +3051,9 @@ ipmi_get_auth_capabilities_cmd(
 	uint8_t msg_data[2];
 	uint8_t backupBridgePossible;
 
-	backupBridgePossible = bridgePossible;
+	backupBridgePossible = intf->session->bridge_possible;
 
-	bridgePossible = 0;
+	intf->session->bridge_possible = 0;
 
 	msg_data[0] = IPMI_LAN_CHANNEL_E | 0x80; // Ask for IPMI v2 data as well
 	msg_data[1] = intf->session->privlvl;
@@ -2712,7 +3091,7 @@ ipmi_get_auth_capabilities_cmd(
 			rsp->data,
 			sizeof(struct get_channel_auth_cap_rsp));
 
-	bridgePossible = backupBridgePossible;
+	intf->session->bridge_possible = backupBridgePossible;
 
 	return 0;
 }
@@ -2731,10 +3110,10 @@ ipmi_close_session_cmd(struct ipmi_intf * intf)
 	if (intf->session->v2_data.session_state != LANPLUS_STATE_ACTIVE)
 		return -1;
 
-	backupBridgePossible = bridgePossible;
+	backupBridgePossible = intf->session->bridge_possible;
 
 	intf->target_addr = IPMI_BMC_SLAVE_ADDR;
-	bridgePossible = 0;
+	intf->session->bridge_possible = 0;
 
 	bmc_session_lsbf = intf->session->v2_data.bmc_id;
 #if WORDS_BIGENDIAN
@@ -2773,7 +3152,7 @@ ipmi_close_session_cmd(struct ipmi_intf * intf)
 	lprintf(LOG_DEBUG, "Closed Session %08lx\n",
 		(long)intf->session->v2_data.bmc_id);
 
-	bridgePossible = backupBridgePossible;
+	intf->session->bridge_possible = backupBridgePossible;
 
 	return 0;
 }
@@ -3215,6 +3594,14 @@ ipmi_lanplus_rakp3(struct ipmi_intf * intf)
 			msg = NULL;
 			return 1;
 		}
+		else if (lanplus_generate_crypt_ctx(session))
+		{
+			/* Error */
+			lprintf(LOG_INFO, "> Error setting up K1/K2 crypto context");
+			free(msg);
+			msg = NULL;
+			return 1;
+		}
 	}
 	
 
@@ -3278,19 +3665,89 @@ ipmi_lanplus_rakp3(struct ipmi_intf * intf)
 
 
 
+/**
+ * ipmi_lanplus_resume
+ *
+ * Pick up a session left open by an earlier invocation, see -F.  A
+ * single Get Device ID tells whether the BMC still accepts it.
+ *
+ * returns 0 if the session is usable, -1 if a new one must be opened
+ */
+static int
+ipmi_lanplus_resume(struct ipmi_intf * intf)
+{
+	struct ipmi_session * session = intf->session;
+	struct ipmi_rs * rsp = NULL;
+	struct ipmi_rq req;
+	int retry = session->retry;
+
+	if (lanplus_cache_load(intf) < 0)
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	req.msg.netfn = IPMI_NETFN_APP;
+	req.msg.cmd   = BMC_GET_DEVICE_ID;
+
+	/* a BMC silently drops packets for sessions it doesn't know */
+	if (lanplus_generate_crypt_ctx(session) == 0) {
+		session->retry = 1;
+		rsp = ipmi_lanplus_send_ipmi_cmd(intf, &req);
+		session->retry = retry;
+	}
+
+	if (rsp == NULL || rsp->ccode > 0) {
+		lprintf(LOG_DEBUG, "Cached session rejected, opening a new one");
+		lanplus_cache_drop(intf);
+		ipmi_req_clear_entries(intf);
+		session->v2_data.session_state = LANPLUS_STATE_PRESESSION;
+		session->v2_data.auth_alg      = IPMI_AUTH_RAKP_NONE;
+		session->v2_data.integrity_alg = IPMI_INTEGRITY_NONE;
+		session->v2_data.crypt_alg     = IPMI_CRYPT_NONE;
+		session->v2_data.console_id    = 0x00;
+		session->v2_data.bmc_id        = 0x00;
+		session->out_seq               = 0;
+		lanplus_crypt_ctx_free(session->v2_data.crypt_ctx);
+		session->v2_data.crypt_ctx     = NULL;
+		intf->max_request_data_size    = 0;
+		intf->max_response_data_size   = 0;
+		intf->manufacturer_id          = IPMI_OEM_UNKNOWN;
+		return -1;
+	}
+
+	intf->abort = 0;
+	session->bridge_possible = 1;
+	return 0;
+}
+
+
+
 /**
  * ipmi_lan_close
  */
 void
 ipmi_lanplus_close(struct ipmi_intf * intf)
 {
-	if (!intf->abort)
+	ipmi_async_abort(intf);
+
+	/* A cached session is left open for the next invocation */
+	if (intf->session->cachefile != NULL) {
+		if (!intf->abort && intf->session->v2_data.session_state ==
+				LANPLUS_STATE_ACTIVE)
+			lanplus_cache_store(intf);
+		else
+			lanplus_cache_drop(intf);
+	} else if (!intf->abort) {
 		ipmi_close_session_cmd(intf);
+	}
 
 	if (intf->fd >= 0)
 		close(intf->fd);
 
-	ipmi_req_clear_entries();
+	ipmi_req_clear_entries(intf);
+	intf->session->rxq.head = 0;
+	intf->session->rxq.count = 0;
+	lanplus_crypt_ctx_free(intf->session->v2_data.crypt_ctx);
+	intf->session->v2_data.crypt_ctx = NULL;
 	ipmi_intf_session_cleanup(intf);
 	intf->session = NULL;
 	intf->opened = 0;
@@ -3311,9 +3768,9 @@ ipmi_set_session_privlvl_cmd(struct ipmi_intf * intf)
 	if (privlvl <= IPMI_SESSION_PRIV_USER)
 		return 0;	/* no need to set higher */
 
-	backupBridgePossible = bridgePossible;
+	backupBridgePossible = intf->session->bridge_possible;
 
-	bridgePossible = 0;
+	intf->session->bridge_possible = 0;
 
 	memset(&req, 0, sizeof(req));
 	req.msg.netfn		= IPMI_NETFN_APP;
@@ -3325,7 +3782,7 @@ ipmi_set_session_privlvl_cmd(struct ipmi_intf * intf)
 	if (rsp == NULL) {
 		lprintf(LOG_ERR, "Set Session Privilege Level to %s failed",
 			val2str(privlvl, ipmi_privlvl_vals));
-		bridgePossible = backupBridgePossible;
+		intf->session->bridge_possible = backupBridgePossible;
 		return -1;
 	}
 	if (verbose > 2)
@@ -3335,14 +3792,14 @@ ipmi_set_session_privlvl_cmd(struct ipmi_intf * intf)
 		lprintf(LOG_ERR, "Set Session Privilege Level to %s failed: %s",
 			val2str(privlvl, ipmi_privlvl_vals),
 			val2str(rsp->ccode, completion_code_vals));
-		bridgePossible = backupBridgePossible;
+		intf->session->bridge_possible = backupBridgePossible;
 		return -1;
 	}
 
 	lprintf(LOG_DEBUG, "Set Session Privilege Level to %s\n",
 		val2str(rsp->data[0], ipmi_privlvl_vals));
 
-	bridgePossible = backupBridgePossible;
+	intf->session->bridge_possible = backupBridgePossible;
 
 	return 0;
 }
@@ -3380,18 +3837,27 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 
 
 	/* Setup our lanplus session state */
+	session->active                   = 0;
+	session->session_id               = 0;
+	session->in_seq                   = 0;
+	session->out_seq                  = 0;
+	session->v2_data.session_state    = LANPLUS_STATE_PRESESSION;
 	session->v2_data.auth_alg         = IPMI_AUTH_RAKP_NONE;
 	session->v2_data.crypt_alg        = IPMI_CRYPT_NONE;
 	session->v2_data.console_id       = 0x00;
 	session->v2_data.bmc_id           = 0x00;
 	session->sol_data.sequence_number = 1;
-	//session->sol_data.last_received_sequence_number = 0;
-	//session->sol_data.last_received_byte_count      = 0;
+	session->sol_data.last_received_sequence_number = 0;
+	session->sol_data.last_received_byte_count      = 0;
 	memset(session->v2_data.sik, 0, IPMI_SIK_BUFFER_SIZE);
 
 	/* Kg is set in ipmi_intf */
 	//memset(session->v2_data.kg,  0, IPMI_KG_BUFFER_SIZE);
 
+	/* Datagrams read ahead from an earlier socket belong to another session */
+	session->rxq.head = 0;
+	session->rxq.count = 0;
+
 	if (ipmi_intf_socket_connect (intf) == -1) {
 		lprintf(LOG_ERR, "Could not open socket!");
 		return -1;
@@ -3406,6 +3872,9 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 
 	intf->opened = 1;
 
+	if (session->cachefile != NULL && ipmi_lanplus_resume(intf) == 0)
+		return intf->fd;
+
 	/*
 	 *
 	 * Make sure the BMC supports IPMI v2 / RMCP+
@@ -3473,7 +3942,7 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 		}
 	}
 	intf->manufacturer_id = ipmi_get_oem(intf);
-	bridgePossible = 1;
+	intf->session->bridge_possible = 1;
 
 	/* automatically detect interface request and response sizes */
 	hpm2_detect_max_payload_size(intf);
@@ -3508,6 +3977,7 @@ void test_crypt1(void)
 
 	if (lanplus_encrypt_payload(IPMI_CRYPT_AES_CBC_128,
 								key,
+								NULL,
 								data,
 								sizeof(data),
 								encrypt_buffer,
@@ -3521,6 +3991,7 @@ void test_crypt1(void)
 
 	if (lanplus_decrypt_payload(IPMI_CRYPT_AES_CBC_128,
 								key,
+								NULL,
 								encrypt_buffer,
 								bytes_encrypted,
 								decrypt_buffer,
@@ -3575,6 +4046,7 @@ void test_crypt2(void)
 }
 
 
+
 /**
  * send a get device id command to keep session active
  */
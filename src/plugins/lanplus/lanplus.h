@@ -68,6 +68,7 @@
 
 #define IPMI_LAN_TIMEOUT	1
 #define IPMI_LAN_RETRY		4
+#define IPMI_LAN_WINDOW_MAX	32	/* half the rq_seq space */
 
 #define IPMI_PRIV_CALLBACK 1
 #define IPMI_PRIV_USER     2
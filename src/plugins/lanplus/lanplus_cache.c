@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_CONFIG_H)
+# include <config.h>
+#endif
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi_constants.h>
+#include "lanplus.h"
+#include "lanplus_cache.h"
+#include "lanplus_crypt_impl.h"
+
+/*
+ * The cache file holds one line per session:
+ *
+ *   key stamp bmc_id console_id auth integrity crypt max_priv out_seq
+ *   rq_seq max_rq max_rs manufacturer sik k1 k2
+ *
+ * where key is host:port:user:cipher:privlvl:tag, user is hex encoded
+ * and tag is an HMAC of the Kg key under the password, so a changed
+ * password never resumes an old session.  Keys and tag are hex.
+ */
+#define LANPLUS_CACHE_LINE	512
+#define LANPLUS_CACHE_KEY	256
+
+static void
+lanplus_cache_hex(char * out, const uint8_t * buf, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		sprintf(out + 2 * i, "%02x", buf[i]);
+	out[2 * len] = '\0';
+}
+
+static int
+lanplus_cache_unhex(uint8_t * buf, const char * in, int len)
+{
+	unsigned int b;
+	int i;
+
+	if (strlen(in) != (size_t)(2 * len))
+		return -1;
+	for (i = 0; i < len; i++) {
+		if (sscanf(in + 2 * i, "%2x", &b) != 1)
+			return -1;
+		buf[i] = (uint8_t)b;
+	}
+	return 0;
+}
+
+
+
+/*
+ * lanplus_cache_key
+ *
+ * Build the lookup key for the session we are about to open
+ */
+static int
+lanplus_cache_key(struct ipmi_session * session, char * key)
+{
+	char user[2 * 16 + 1];
+	char tag[2 * 20 + 1];
+	uint8_t md[20];
+	uint32_t md_len = 0;
+
+	lanplus_cache_hex(user, session->username,
+			strlen((const char *)session->username));
+
+	if (lanplus_HMAC(IPMI_AUTH_RAKP_HMAC_SHA1, session->authcode,
+				IPMI_AUTHCODE_BUFFER_SIZE, session->v2_data.kg,
+				IPMI_KG_BUFFER_SIZE, md, &md_len) == NULL || md_len != 20)
+		return -1;
+	lanplus_cache_hex(tag, md, 20);
+
+	snprintf(key, LANPLUS_CACHE_KEY, "%s:%d:%s:%d:%d:%s",
+			session->hostname, session->port, user[0] ? user : "-",
+			session->cipher_suite_id, session->privlvl, tag);
+	return 0;
+}
+
+
+
+/*
+ * lanplus_cache_open
+ *
+ * Open and lock the cache file.  The file must belong to us and must
+ * not be accessible by anybody else, it holds live session keys.
+ *
+ * returns a stdio stream, or NULL if the cache can't be used
+ */
+static FILE *
+lanplus_cache_open(struct ipmi_session * session)
+{
+	struct flock lock;
+	struct stat st;
+	FILE * fp;
+	int fd;
+
+	fd = open(session->cachefile, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		lperror(LOG_INFO, "Session cache %s", session->cachefile);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+			st.st_uid != geteuid() || (st.st_mode & 077)) {
+		lprintf(LOG_WARN, "Session cache %s must be a regular file "
+				"with mode 0600, ignored", session->cachefile);
+		close(fd);
+		return NULL;
+	}
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	while (fcntl(fd, F_SETLKW, &lock) < 0) {
+		if (errno != EINTR) {
+			lperror(LOG_INFO, "Session cache %s lock", session->cachefile);
+			close(fd);
+			return NULL;
+		}
+	}
+
+	fp = fdopen(fd, "r+");
+	if (fp == NULL)
+		close(fd);
+	return fp;
+}
+
+
+
+/*
+ * lanplus_cache_update
+ *
+ * Rewrite the cache file without our entry, appending the current
+ * session state if add is set.  Expired entries are dropped.  If
+ * claim is given, the entry that was removed is copied there, so a
+ * session is handed to one invocation only.
+ *
+ * returns 0 if an entry was claimed, -1 otherwise
+ */
+static int
+lanplus_cache_update(struct ipmi_intf * intf, int add, char * claim)
+{
+	struct ipmi_session * session = intf->session;
+	char key[LANPLUS_CACHE_KEY], name[LANPLUS_CACHE_KEY];
+	char line[LANPLUS_CACHE_LINE];
+	char sik[41], k1[41], k2[41];
+	unsigned long stamp;
+	char * keep = NULL, * tmp;
+	size_t len = 0, size = 0, n;
+	time_t now = time(NULL);
+	FILE * fp;
+	int rc = -1;
+
+	if (session->cachefile == NULL || lanplus_cache_key(session, key) < 0)
+		return -1;
+
+	fp = lanplus_cache_open(session);
+	if (fp == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%255s %lu", name, &stamp) != 2 ||
+				(unsigned long)now - stamp > IPMI_LANPLUS_CACHE_TTL)
+			continue;
+		if (strcmp(name, key) == 0) {
+			if (claim != NULL && rc < 0) {
+				strcpy(claim, line);
+				rc = 0;
+			}
+			continue;
+		}
+
+		n = strlen(line);
+		if (len + n + 1 > size) {
+			size = (size + n + 1) * 2;
+			tmp = realloc(keep, size);
+			if (tmp == NULL) {
+				lprintf(LOG_ERR, "ipmitool: malloc failure");
+				goto out;
+			}
+			keep = tmp;
+		}
+		memcpy(keep + len, line, n);
+		len += n;
+	}
+
+	rewind(fp);
+	if (len > 0)
+		fwrite(keep, 1, len, fp);
+
+	if (add) {
+		lanplus_cache_hex(sik, session->v2_data.sik, 20);
+		lanplus_cache_hex(k1, session->v2_data.k1, 20);
+		lanplus_cache_hex(k2, session->v2_data.k2, 20);
+		fprintf(fp, "%s %lu %08lx %08lx %02x %02x %02x %02x %08lx %02x "
+				"%u %u %u %s %s %s\n", key, (unsigned long)now,
+				(unsigned long)session->v2_data.bmc_id,
+				(unsigned long)session->v2_data.console_id,
+				session->v2_data.auth_alg,
+				session->v2_data.integrity_alg,
+				session->v2_data.crypt_alg,
+				session->v2_data.max_priv_level,
+				(unsigned long)session->out_seq,
+				session->rq_seq,
+				intf->max_request_data_size,
+				intf->max_response_data_size,
+				(unsigned int)intf->manufacturer_id,
+				sik, k1, k2);
+	}
+
+	fflush(fp);
+	if (ftruncate(fileno(fp), ftell(fp)) < 0)
+		lperror(LOG_INFO, "Session cache %s", session->cachefile);
+
+ out:
+	if (keep != NULL)
+		free(keep);
+	fclose(fp);
+	return rc;
+}
+
+
+
+/*
+ * lanplus_cache_load
+ *
+ * Look up a live session for this host, user and cipher suite and
+ * restore its state.  The entry is taken out of the cache file, so
+ * concurrent invocations never share a session and its sequence
+ * numbers; lanplus_cache_store puts it back on close.  The caller has
+ * to check that the BMC still accepts it.
+ *
+ * returns 0 if a session was restored, -1 otherwise
+ */
+int
+lanplus_cache_load(struct ipmi_intf * intf)
+{
+	struct ipmi_session * session = intf->session;
+	char key[LANPLUS_CACHE_KEY], name[LANPLUS_CACHE_KEY];
+	char line[LANPLUS_CACHE_LINE];
+	char sik[64], k1[64], k2[64];
+	unsigned int auth, integ, crypt, priv, rq_seq, max_rq, max_rs, mfg;
+	unsigned long stamp, bmc_id, console_id, out_seq;
+
+	if (session->cachefile == NULL || lanplus_cache_key(session, key) < 0)
+		return -1;
+
+	if (lanplus_cache_update(intf, 0, line) < 0)
+		return -1;
+
+	if (sscanf(line, "%255s %lu %lx %lx %x %x %x %x %lx %x %u %u %u "
+				"%63s %63s %63s", name, &stamp, &bmc_id,
+				&console_id, &auth, &integ, &crypt, &priv,
+				&out_seq, &rq_seq, &max_rq, &max_rs, &mfg,
+				sik, k1, k2) != 16)
+		return -1;
+
+	if (lanplus_cache_unhex(session->v2_data.sik, sik, 20) < 0 ||
+			lanplus_cache_unhex(session->v2_data.k1, k1, 20) < 0 ||
+			lanplus_cache_unhex(session->v2_data.k2, k2, 20) < 0)
+		return -1;
+
+	session->v2_data.bmc_id         = bmc_id;
+	session->v2_data.console_id     = console_id;
+	session->v2_data.auth_alg       = auth;
+	session->v2_data.integrity_alg  = integ;
+	session->v2_data.crypt_alg      = crypt;
+	session->v2_data.max_priv_level = priv;
+	session->v2_data.session_state  = LANPLUS_STATE_ACTIVE;
+	session->out_seq                = out_seq;
+	session->rq_seq                 = rq_seq % IPMI_RQ_SEQ_MAX;
+	intf->max_request_data_size     = max_rq;
+	intf->max_response_data_size    = max_rs;
+	intf->manufacturer_id           = mfg;
+
+	lprintf(LOG_DEBUG, "Resuming session 0x%08lx from %s",
+			bmc_id, session->cachefile);
+	return 0;
+}
+
+
+
+/*
+ * lanplus_cache_store
+ *
+ * Save the state of the active session so the next invocation can
+ * pick it up instead of opening a new one.
+ */
+void
+lanplus_cache_store(struct ipmi_intf * intf)
+{
+	lanplus_cache_update(intf, 1, NULL);
+}
+
+
+
+/*
+ * lanplus_cache_drop
+ *
+ * Forget the cached session, e.g. because the BMC no longer knows it
+ */
+void
+lanplus_cache_drop(struct ipmi_intf * intf)
+{
+	lanplus_cache_update(intf, 0, NULL);
+}
@@ -674,6 +674,31 @@ lanplus_generate_k2(struct ipmi_session * session)
 
 
 
+/*
+ * lanplus_generate_crypt_ctx
+ *
+ * Key the per session cipher and HMAC contexts with K1 and K2, so that
+ * the per packet work is limited to resetting them.
+ *
+ * param session [in/out].  K1 and K2 must already be set.
+ *
+ * returns 0 on success
+ *         1 on failure
+ */
+int
+lanplus_generate_crypt_ctx(struct ipmi_session * session)
+{
+	lanplus_crypt_ctx_free(session->v2_data.crypt_ctx);
+	session->v2_data.crypt_ctx =
+		lanplus_crypt_ctx_new(session->v2_data.k1,
+							  IPMI_AUTHCODE_BUFFER_SIZE,
+							  session->v2_data.k2);
+
+	return (session->v2_data.crypt_ctx == NULL);
+}
+
+
+
 /*
  * lanplus_encrypt_payload
  *
@@ -681,10 +706,15 @@ lanplus_generate_k2(struct ipmi_session * session)
  * data to output, including the required confidentiality header and trailer.
  * If the crypt_alg is IPMI_CRYPT_NONE, simply copy the input to the output and
  * set bytes_written to input_length.
+ *
+ * If input starts right behind the room for the IV in output, the payload
+ * is padded and encrypted in place; output must then have space for the
+ * confidentiality trailer.
  * 
  * param crypt_alg specifies the encryption algorithm (from table 13-19 of the
  *       IPMI v2 spec)
  * param key is the used as input to the encryption algorithmf
+ * param ctx is the session's keyed context, used instead of key if not NULL
  * param input is the input data to be encrypted
  * param input_length is the length of the input data to be encrypted
  * param output is the cipher text generated by the encryption process
@@ -696,7 +726,8 @@ lanplus_generate_k2(struct ipmi_session * session)
  */
 int
 lanplus_encrypt_payload(uint8_t crypt_alg,
-		const uint8_t * key, const uint8_t * input,
+		const uint8_t * key, struct lanplus_crypt_ctx * ctx,
+		const uint8_t * input,
 		uint32_t input_length, uint8_t * output,
 		uint16_t * bytes_written)
 {
@@ -725,12 +756,16 @@ lanplus_encrypt_payload(uint8_t crypt_alg,
 	if (mod)
 		pad_length = IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE - mod;
 
-	padded_input = (uint8_t*)malloc(input_length + pad_length + 1);
-	if (padded_input == NULL) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return 1;
+	if (input == output + IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE) {
+		padded_input = output + IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE;
+	} else {
+		padded_input = (uint8_t*)malloc(input_length + pad_length + 1);
+		if (padded_input == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return 1;
+		}
+		memcpy(padded_input, input, input_length);
 	}
-	memcpy(padded_input, input, input_length);
 
 	/* add the pad */
 	for (i = 0; i < pad_length; ++i)
@@ -743,7 +778,7 @@ lanplus_encrypt_payload(uint8_t crypt_alg,
 	if (lanplus_rand(output, IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE))
 	{
 		lprintf(LOG_ERR, "lanplus_encrypt_payload: Error generating IV");
-		if (padded_input != NULL) {
+		if (padded_input != input) {
 			free(padded_input);
 			padded_input = NULL;
 		}
@@ -755,7 +790,15 @@ lanplus_encrypt_payload(uint8_t crypt_alg,
 
 
 
-	lanplus_encrypt_aes_cbc_128(output,                                     /* IV              */
+	if (ctx != NULL)
+		lanplus_encrypt_aes_cbc_128_ctx(ctx,
+								output,                                     /* IV              */
+								padded_input,                               /* Data to encrypt */
+								input_length + pad_length + 1,              /* Input length    */
+								output + IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE, /* output          */
+								&bytes_encrypted);                          /* bytes written   */
+	else
+		lanplus_encrypt_aes_cbc_128(output,                                     /* IV              */
 								key,                                        /* K2              */
 								padded_input,                               /* Data to encrypt */
 								input_length + pad_length + 1,              /* Input length    */
@@ -766,7 +809,8 @@ lanplus_encrypt_payload(uint8_t crypt_alg,
 		IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE + /* IV */
 		bytes_encrypted;
 
-	free(padded_input);
+	if (padded_input != input)
+		free(padded_input);
 	padded_input = NULL;
 
 	return 0;
@@ -819,7 +863,14 @@ lanplus_has_valid_auth_code(struct ipmi_rs * rs, struct ipmi_session * session)
 	 */
 	bmc_authcode = rs->data + (rs->data_len - IPMI_SHA1_AUTHCODE_SIZE);
 
-	lanplus_HMAC(session->v2_data.integrity_alg,
+	if (session->v2_data.crypt_ctx != NULL)
+		lanplus_HMAC_ctx(session->v2_data.crypt_ctx,
+				 rs->data + IPMI_LANPLUS_OFFSET_AUTHTYPE,
+				 rs->data_len - IPMI_LANPLUS_OFFSET_AUTHTYPE - IPMI_SHA1_AUTHCODE_SIZE,
+				 generated_authcode,
+				 &generated_authcode_length);
+	else
+		lanplus_HMAC(session->v2_data.integrity_alg,
 				 session->v2_data.k1,
 				 IPMI_AUTHCODE_BUFFER_SIZE,
 				 rs->data + IPMI_LANPLUS_OFFSET_AUTHTYPE,
@@ -859,7 +910,7 @@ lanplus_has_valid_auth_code(struct ipmi_rs * rs, struct ipmi_session * session)
  */
 int
 lanplus_decrypt_payload(uint8_t crypt_alg, const uint8_t * key,
-		const uint8_t * input, uint32_t input_length,
+		struct lanplus_crypt_ctx * ctx, const uint8_t * input, uint32_t input_length,
 		uint8_t * output, uint16_t * payload_size)
 {
 	uint8_t * decrypted_payload;
@@ -883,7 +934,17 @@ lanplus_decrypt_payload(uint8_t crypt_alg, const uint8_t * key,
 	}
 
 
-	lanplus_decrypt_aes_cbc_128(input,                                /* IV              */
+	if (ctx != NULL)
+		lanplus_decrypt_aes_cbc_128_ctx(ctx,
+								input,                                /* IV              */
+								input                        +
+								IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE,    /* Data to decrypt */
+								input_length -
+								IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE,    /* Input length    */
+								decrypted_payload,                    /* output          */
+								&bytes_decrypted);                    /* bytes written   */
+	else
+		lanplus_decrypt_aes_cbc_128(input,                                /* IV              */
 								key,                                  /* Key             */
 								input                        +
 								IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE,    /* Data to decrypt */
@@ -54,14 +54,17 @@ int lanplus_generate_rakp3_authcode(uint8_t                      * buffer,
 int lanplus_generate_sik(struct ipmi_session * session, struct ipmi_intf * intf);
 int lanplus_generate_k1(struct ipmi_session * session);
 int lanplus_generate_k2(struct ipmi_session * session);
+int lanplus_generate_crypt_ctx(struct ipmi_session * session);
 int lanplus_encrypt_payload(uint8_t         crypt_alg,
 							const uint8_t * key,
+							struct lanplus_crypt_ctx * ctx,
 							const uint8_t * input,
 							uint32_t          input_length,
 							uint8_t       * output,
 							uint16_t      * bytesWritten);
 int lanplus_decrypt_payload(uint8_t         crypt_alg,
 							const uint8_t * key,
+							struct lanplus_crypt_ctx * ctx,
 							const uint8_t * input,
 							uint32_t          input_length,
 							uint8_t       * output,
@@ -39,6 +39,8 @@
 #include <openssl/rand.h>
 #include <openssl/err.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 
@@ -133,6 +135,215 @@ lanplus_HMAC(uint8_t        mac,
 }
 
 
+/*
+ * Keyed cipher and HMAC state for one session.  The AES key schedule and
+ * the HMAC inner and outer pads are computed once, when K1 and K2 are
+ * known; each packet only resets the IV or copies the keyed digest state.
+ */
+struct lanplus_crypt_ctx {
+	EVP_CIPHER_CTX * enc;
+	EVP_CIPHER_CTX * dec;
+	EVP_MD_CTX     * hmac_inner;	/* SHA1 state after (K1 ^ ipad) */
+	EVP_MD_CTX     * hmac_outer;	/* SHA1 state after (K1 ^ opad) */
+	EVP_MD_CTX     * md;		/* per packet scratch state */
+};
+
+#define LANPLUS_HMAC_BLOCK_SIZE	64	/* SHA1 input block */
+
+
+
+/*
+ * lanplus_crypt_ctx_new
+ *
+ * Set up the keyed contexts for a session
+ *
+ * param k1 is the integrity key, used for HMAC-SHA1-96 authcodes
+ * param k1_len is the length of k1, at most one SHA1 block
+ * param k2 is the confidentiality key, the first 16 bytes are used for AES
+ *
+ * returns the new context, or NULL on failure
+ */
+struct lanplus_crypt_ctx *
+lanplus_crypt_ctx_new(const uint8_t * k1, int k1_len, const uint8_t * k2)
+{
+	struct lanplus_crypt_ctx * ctx;
+	uint8_t ipad[LANPLUS_HMAC_BLOCK_SIZE];
+	uint8_t opad[LANPLUS_HMAC_BLOCK_SIZE];
+	int i;
+
+	assert(k1_len <= LANPLUS_HMAC_BLOCK_SIZE);
+
+	ctx = calloc(1, sizeof(struct lanplus_crypt_ctx));
+	if (ctx == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return NULL;
+	}
+
+	ctx->enc        = EVP_CIPHER_CTX_new();
+	ctx->dec        = EVP_CIPHER_CTX_new();
+	ctx->hmac_inner = EVP_MD_CTX_create();
+	ctx->hmac_outer = EVP_MD_CTX_create();
+	ctx->md         = EVP_MD_CTX_create();
+	if (ctx->enc == NULL || ctx->dec == NULL || ctx->hmac_inner == NULL ||
+		ctx->hmac_outer == NULL || ctx->md == NULL)
+		goto fail;
+
+	if (!EVP_EncryptInit_ex(ctx->enc, EVP_aes_128_cbc(), NULL, k2, NULL) ||
+		!EVP_DecryptInit_ex(ctx->dec, EVP_aes_128_cbc(), NULL, k2, NULL))
+		goto fail;
+	EVP_CIPHER_CTX_set_padding(ctx->enc, 0);
+	EVP_CIPHER_CTX_set_padding(ctx->dec, 0);
+
+	memset(ipad, 0x36, sizeof(ipad));
+	memset(opad, 0x5c, sizeof(opad));
+	for (i = 0; i < k1_len; ++i) {
+		ipad[i] ^= k1[i];
+		opad[i] ^= k1[i];
+	}
+
+	if (!EVP_DigestInit_ex(ctx->hmac_inner, EVP_sha1(), NULL) ||
+		!EVP_DigestUpdate(ctx->hmac_inner, ipad, sizeof(ipad)) ||
+		!EVP_DigestInit_ex(ctx->hmac_outer, EVP_sha1(), NULL) ||
+		!EVP_DigestUpdate(ctx->hmac_outer, opad, sizeof(opad)))
+		goto fail;
+
+	memset(ipad, 0, sizeof(ipad));
+	memset(opad, 0, sizeof(opad));
+	return ctx;
+
+ fail:
+	lprintf(LOG_ERR, "lanplus: unable to set up crypto context");
+	memset(ipad, 0, sizeof(ipad));
+	memset(opad, 0, sizeof(opad));
+	lanplus_crypt_ctx_free(ctx);
+	return NULL;
+}
+
+
+
+/*
+ * lanplus_crypt_ctx_free
+ *
+ * Release the keyed contexts of a session
+ */
+void
+lanplus_crypt_ctx_free(struct lanplus_crypt_ctx * ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	if (ctx->enc != NULL)
+		EVP_CIPHER_CTX_free(ctx->enc);
+	if (ctx->dec != NULL)
+		EVP_CIPHER_CTX_free(ctx->dec);
+	if (ctx->hmac_inner != NULL)
+		EVP_MD_CTX_destroy(ctx->hmac_inner);
+	if (ctx->hmac_outer != NULL)
+		EVP_MD_CTX_destroy(ctx->hmac_outer);
+	if (ctx->md != NULL)
+		EVP_MD_CTX_destroy(ctx->md);
+	free(ctx);
+}
+
+
+
+/*
+ * lanplus_HMAC_ctx
+ *
+ * HMAC-SHA1 keyed with the session's K1, without re-deriving the pads
+ *
+ * param ctx is the session crypto context
+ * param d is the data to be MAC'd
+ * param n is the length of the data at d
+ * param md is the result of the HMAC algorithm, 20 bytes
+ * param md_len is the length of md
+ *
+ * returns a pointer to md, NULL on failure
+ */
+uint8_t *
+lanplus_HMAC_ctx(struct lanplus_crypt_ctx * ctx,
+				 const uint8_t * d,
+				 int             n,
+				 uint8_t       * md,
+				 uint32_t      * md_len)
+{
+	uint8_t inner[EVP_MAX_MD_SIZE];
+	unsigned int inner_len, len;
+
+	*md_len = 0;
+
+	if (!EVP_MD_CTX_copy_ex(ctx->md, ctx->hmac_inner) ||
+		!EVP_DigestUpdate(ctx->md, d, n) ||
+		!EVP_DigestFinal_ex(ctx->md, inner, &inner_len) ||
+		!EVP_MD_CTX_copy_ex(ctx->md, ctx->hmac_outer) ||
+		!EVP_DigestUpdate(ctx->md, inner, inner_len) ||
+		!EVP_DigestFinal_ex(ctx->md, md, &len))
+		return NULL;
+
+	*md_len = len;
+	return md;
+}
+
+
+
+/*
+ * lanplus_aes_cbc_128
+ *
+ * Run a prepared AES-CBC-128 context over input with the given IV.
+ * Shared by the one-shot and the per-session variants below.
+ */
+static void
+lanplus_aes_cbc_128(EVP_CIPHER_CTX * ctx,
+					int               encrypt,
+					const uint8_t   * iv,
+					const uint8_t   * input,
+					uint32_t          input_length,
+					uint8_t         * output,
+					uint32_t        * bytes_written)
+{
+	int len = 0, tmplen = 0;
+
+	*bytes_written = 0;
+
+	if (input_length == 0)
+		return;
+
+	/*
+	 * The default implementation adds a whole block of padding if the input
+	 * data is perfectly aligned.  We would like to keep that from happening.
+	 * We have made a point to have our input perfectly padded.
+	 */
+	assert((input_length % IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE) == 0);
+
+	/* keep the key schedule, only load the new IV */
+	if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, encrypt))
+		return;
+	EVP_CIPHER_CTX_set_padding(ctx, 0);
+
+	if (!EVP_CipherUpdate(ctx, output, &len, input, input_length))
+	{
+		/* Error */
+		lprintf(LOG_DEBUG, "ERROR: %scrypt update failed",
+			encrypt ? "en" : "de");
+		return;
+	}
+
+	if (!EVP_CipherFinal_ex(ctx, output + len, &tmplen))
+	{
+		char buffer[1000];
+		ERR_error_string(ERR_get_error(), buffer);
+		lprintf(LOG_DEBUG, "the ERR error %s", buffer);
+		lprintf(LOG_DEBUG, "ERROR: %scrypt final failed",
+			encrypt ? "en" : "de");
+		return; /* Error */
+	}
+
+	/* Success */
+	*bytes_written = len + tmplen;
+}
+
+
+
 /*
  * lanplus_encrypt_aes_cbc_128
  *
@@ -155,17 +366,10 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
 							uint8_t       * output,
 							uint32_t        * bytes_written)
 {
-	EVP_CIPHER_CTX ctx;
-	EVP_CIPHER_CTX_init(&ctx);
-	EVP_EncryptInit_ex(&ctx, EVP_aes_128_cbc(), NULL, key, iv);
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
-	
+	EVP_CIPHER_CTX * ctx;
 
 	*bytes_written = 0;
 
-	if (input_length == 0)
-		return;
-
 	if (verbose >= 5)
 	{
 		printbuf(iv,  16, "encrypting with this IV");
@@ -173,37 +377,15 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
 		printbuf(input, input_length, "encrypting this data");
 	}
 
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL)
+		return;
 
-	/*
-	 * The default implementation adds a whole block of padding if the input
-	 * data is perfectly aligned.  We would like to keep that from happening.
-	 * We have made a point to have our input perfectly padded.
-	 */
-	assert((input_length % IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE) == 0);
-
+	if (EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv))
+		lanplus_aes_cbc_128(ctx, 1, iv, input, input_length,
+				output, bytes_written);
 
-	if(!EVP_EncryptUpdate(&ctx, output, (int *)bytes_written, input, input_length))
-	{
-		/* Error */
-		*bytes_written = 0;
-		return;
-	}
-	else
-	{
-		uint32_t tmplen;
-
-		if(!EVP_EncryptFinal_ex(&ctx, output + *bytes_written, (int *)&tmplen))
-		{
-			*bytes_written = 0;
-			return; /* Error */
-		}
-		else
-		{
-			/* Success */
-			*bytes_written += tmplen;
-			EVP_CIPHER_CTX_cleanup(&ctx);
-		}
-	}
+	EVP_CIPHER_CTX_free(ctx);
 }
 
 
@@ -230,11 +412,9 @@ lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
 							uint8_t       * output,
 							uint32_t        * bytes_written)
 {
-	EVP_CIPHER_CTX ctx;
-	EVP_CIPHER_CTX_init(&ctx);
-	EVP_DecryptInit_ex(&ctx, EVP_aes_128_cbc(), NULL, key, iv);
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
+	EVP_CIPHER_CTX * ctx;
 
+	*bytes_written = 0;
 
 	if (verbose >= 5)
 	{
@@ -243,51 +423,57 @@ lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
 		printbuf(input, input_length, "decrypting this data");
 	}
 
-
-	*bytes_written = 0;
-
-	if (input_length == 0)
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL)
 		return;
 
-	/*
-	 * The default implementation adds a whole block of padding if the input
-	 * data is perfectly aligned.  We would like to keep that from happening.
-	 * We have made a point to have our input perfectly padded.
-	 */
-	assert((input_length % IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE) == 0);
+	if (EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv))
+		lanplus_aes_cbc_128(ctx, 0, iv, input, input_length,
+				output, bytes_written);
 
+	EVP_CIPHER_CTX_free(ctx);
 
-	if (!EVP_DecryptUpdate(&ctx, output, (int *)bytes_written, input, input_length))
-	{
-		/* Error */
-		lprintf(LOG_DEBUG, "ERROR: decrypt update failed");
-		*bytes_written = 0;
-		return;
-	}
-	else
-	{
-		uint32_t tmplen;
-
-		if (!EVP_DecryptFinal_ex(&ctx, output + *bytes_written, (int *)&tmplen))
-		{
-			char buffer[1000];
-			ERR_error_string(ERR_get_error(), buffer);
-			lprintf(LOG_DEBUG, "the ERR error %s", buffer);
-			lprintf(LOG_DEBUG, "ERROR: decrypt final failed");
-			*bytes_written = 0;
-			return; /* Error */
-		}
-		else
-		{
-			/* Success */
-			*bytes_written += tmplen;
-			EVP_CIPHER_CTX_cleanup(&ctx);
-		}
-	}
-
-	if (verbose >= 5)
+	if (verbose >= 5 && *bytes_written)
 	{
 		lprintf(LOG_DEBUG, "Decrypted %d encrypted bytes", input_length);
 		printbuf(output, *bytes_written, "Decrypted this data");
 	}
 }
+
+
+
+/*
+ * lanplus_encrypt_aes_cbc_128_ctx
+ *
+ * Same as lanplus_encrypt_aes_cbc_128, using the session's keyed context
+ */
+void
+lanplus_encrypt_aes_cbc_128_ctx(struct lanplus_crypt_ctx * ctx,
+								const uint8_t * iv,
+								const uint8_t * input,
+								uint32_t          input_length,
+								uint8_t       * output,
+								uint32_t        * bytes_written)
+{
+	lanplus_aes_cbc_128(ctx->enc, 1, iv, input, input_length,
+			output, bytes_written);
+}
+
+
+
+/*
+ * lanplus_decrypt_aes_cbc_128_ctx
+ *
+ * Same as lanplus_decrypt_aes_cbc_128, using the session's keyed context
+ */
+void
+lanplus_decrypt_aes_cbc_128_ctx(struct lanplus_crypt_ctx * ctx,
+								const uint8_t * iv,
+								const uint8_t * input,
+								uint32_t          input_length,
+								uint8_t       * output,
+								uint32_t        * bytes_written)
+{
+	lanplus_aes_cbc_128(ctx->dec, 0, iv, input, input_length,
+			output, bytes_written);
+}
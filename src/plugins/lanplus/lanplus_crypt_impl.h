@@ -33,6 +33,7 @@
 #ifndef IPMI_LANPLUS_CRYPT_IMPL_H
 #define IPMI_LANPLUS_CRYPT_IMPL_H
 
+#include <ipmitool/ipmi_intf.h>
 
 int
 lanplus_seed_prng(uint32_t bytes);
@@ -63,4 +64,32 @@ lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
 							uint32_t        * bytes_written);
 
 
+struct lanplus_crypt_ctx *
+lanplus_crypt_ctx_new(const uint8_t * k1, int k1_len, const uint8_t * k2);
+
+void
+lanplus_crypt_ctx_free(struct lanplus_crypt_ctx * ctx);
+
+uint8_t *
+lanplus_HMAC_ctx(struct lanplus_crypt_ctx * ctx,
+				 const uint8_t * d, int n, uint8_t * md,
+				 uint32_t * md_len);
+
+void
+lanplus_encrypt_aes_cbc_128_ctx(struct lanplus_crypt_ctx * ctx,
+								const uint8_t * iv,
+								const uint8_t * input,
+								uint32_t          input_length,
+								uint8_t       * output,
+								uint32_t        * bytes_written);
+
+void
+lanplus_decrypt_aes_cbc_128_ctx(struct lanplus_crypt_ctx * ctx,
+								const uint8_t * iv,
+								const uint8_t * input,
+								uint32_t          input_length,
+								uint8_t       * output,
+								uint32_t        * bytes_written);
+
+
 #endif /* IPMI_LANPLUS_CRYPT_IMPL_H */
@@ -73,8 +73,8 @@ static void ipmi_lipmi_close(struct ipmi_intf * intf)
 static struct ipmi_rs * ipmi_lipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 {
 	struct strioctl istr;
-	static struct lipmi_reqrsp reqrsp;
-	static struct ipmi_rs rsp;	
+	struct lipmi_reqrsp reqrsp;
+	struct ipmi_rs * rsp = &intf->rsp;
 	static int curr_seq = 0;
 
 	if (!intf || !req)
@@ -108,14 +108,14 @@ static struct ipmi_rs * ipmi_lipmi_send_cmd(struct ipmi_intf * intf, struct ipmi
 		return NULL;
 	}
 
-	memset(&rsp, 0, sizeof(struct ipmi_rs));
-	rsp.ccode = reqrsp.rsp.ccode;
-	rsp.data_len = reqrsp.rsp.datalength;
+	memset(rsp, 0, sizeof(struct ipmi_rs));
+	rsp->ccode = reqrsp.rsp.ccode;
+	rsp->data_len = reqrsp.rsp.datalength;
 
-	if (!rsp.ccode && rsp.data_len)
-		memcpy(rsp.data, reqrsp.rsp.data, rsp.data_len);
+	if (!rsp->ccode && rsp->data_len)
+		memcpy(rsp->data, reqrsp.rsp.data, rsp->data_len);
 
-	return &rsp;
+	return rsp;
 }
 
 struct ipmi_intf ipmi_lipmi_intf = {
@@ -39,9 +39,11 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <poll.h>
 
 #include <ipmitool/ipmi.h>
 #include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_stats.h>
 #include <ipmitool/helper.h>
 #include <ipmitool/log.h>
 
@@ -81,8 +83,31 @@
  */
 #define IPMI_OPENIPMI_MAX_RS_DATA_SIZE 35
 
+/*
+ * Requests kept outstanding in the driver by ipmi_openipmi_poll()
+ */
+#define IPMI_OPENIPMI_WINDOW 32
+
 extern int verbose;
 
+/*
+ * Per interface state, hung off intf->priv while the device is open
+ */
+struct ipmi_openipmi_state {
+	long curr_seq;				/* msgid of the next request */
+	long slot_msgid[IPMI_RQ_SEQ_MAX];	/* msgid of async->slot[] */
+};
+
+/*
+ * Double bridged requests are wrapped in a Send Message to the transit
+ * controller by ipmitool; for single bridging the driver does it.
+ */
+static int
+ipmi_openipmi_double_bridged(struct ipmi_intf * intf, struct ipmi_rq_target * to)
+{
+	return to->transit_addr != 0 && to->transit_addr != intf->my_addr;
+}
+
 static int
 ipmi_openipmi_open(struct ipmi_intf * intf)
 {
@@ -118,6 +143,16 @@ ipmi_openipmi_open(struct ipmi_intf * intf)
 		lperror(LOG_ERR, "Could not enable event receiver");
 		return -1;
 	}
+
+	if (intf->priv == NULL) {
+		intf->priv = calloc(1, sizeof(struct ipmi_openipmi_state));
+		if (intf->priv == NULL) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			close(intf->fd);
+			intf->fd = -1;
+			return -1;
+		}
+	}
  
 	intf->opened = 1;
 
@@ -149,20 +184,42 @@ ipmi_openipmi_set_my_addr(struct ipmi_intf *intf, uint8_t addr)
 static void
 ipmi_openipmi_close(struct ipmi_intf * intf)
 {
+	ipmi_async_abort(intf);
+
 	if (intf->fd >= 0) {
 		close(intf->fd);
 		intf->fd = -1;
 	}
 
+	if (intf->priv != NULL) {
+		free(intf->priv);
+		intf->priv = NULL;
+	}
+
 	intf->opened = 0;
 	intf->manufacturer_id = IPMI_OEM_UNKNOWN;
 }
 
-static struct ipmi_rs *
-ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
+/*
+ * ipmi_openipmi_send_req  -  hand a request to the driver
+ *
+ * Requests for another IPMB controller are addressed to it directly,
+ * or wrapped in a Send Message to the transit controller for double
+ * bridging.  The driver copies the message, so nothing has to outlive
+ * this call.
+ *
+ * @intf:	ipmi interface
+ * @req:	the request
+ * @to:		IPMB target of the request
+ * @msgid:	id the driver hands back with the response
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_openipmi_send_req(struct ipmi_intf * intf, struct ipmi_rq * req,
+		struct ipmi_rq_target * to, long msgid)
 {
-	struct ipmi_recv recv;
-	struct ipmi_addr addr;
 	struct ipmi_system_interface_addr bmc_addr = {
 		addr_type:	IPMI_SYSTEM_INTERFACE_ADDR_TYPE,
 		channel:	IPMI_BMC_CHANNEL,
@@ -171,22 +228,12 @@ ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 		addr_type:	IPMI_IPMB_ADDR_TYPE,
 	};
 	struct ipmi_req _req;
-	static struct ipmi_rs rsp;
-	static int curr_seq = 0;
-	fd_set rset;
 
 	uint8_t * data = NULL;
 	int data_len = 0;
+	int rc;
 
-
-	if (intf == NULL || req == NULL)
-		return NULL;
-
-	ipmb_addr.channel = intf->target_channel & 0x0f;
-
-	if (intf->opened == 0 && intf->open != NULL)
-		if (intf->open(intf) < 0)
-			return NULL;
+	ipmb_addr.channel = to->target_channel & 0x0f;
 
 	if (verbose > 2) {
 		fprintf(stderr, "OpenIPMI Request Message Header:\n");
@@ -203,25 +250,25 @@ ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 
 	memset(&_req, 0, sizeof(struct ipmi_req));
 
-	if (intf->target_addr != 0 &&
-	    intf->target_addr != intf->my_addr) {
+	if (to->target_addr != 0 &&
+	    to->target_addr != intf->my_addr) {
 		/* use IPMB address if needed */
-		ipmb_addr.slave_addr = intf->target_addr;
+		ipmb_addr.slave_addr = to->target_addr;
 		ipmb_addr.lun = req->msg.lun;
 		lprintf(LOG_DEBUG, "Sending request 0x%x to "
 			"IPMB target @ 0x%x:0x%x (from 0x%x)", 
 			req->msg.cmd,
-			intf->target_addr,intf->target_channel, intf->my_addr);
+			to->target_addr, to->target_channel, intf->my_addr);
 
-		if(intf->transit_addr != 0 && intf->transit_addr != intf->my_addr) { 
+		if (ipmi_openipmi_double_bridged(intf, to)) {
 		   uint8_t index = 0;
       
 		   lprintf(LOG_DEBUG, "Encapsulating data sent to "
 			   "end target [0x%02x,0x%02x] using transit [0x%02x,0x%02x] from 0x%x ",
-			   (0x40 | intf->target_channel),
-			   intf->target_addr,
-			   intf->transit_channel,
-			   intf->transit_addr,
+			   (0x40 | to->target_channel),
+			   to->target_addr,
+			   to->transit_channel,
+			   to->transit_addr,
 			   intf->my_addr
 			   );      
 
@@ -240,21 +287,21 @@ ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 		   }
 
 		   /* Modify target address to use 'transit' instead */
-		   ipmb_addr.slave_addr = intf->transit_addr;
-		   ipmb_addr.channel    = intf->transit_channel;
+		   ipmb_addr.slave_addr = to->transit_addr;
+		   ipmb_addr.channel    = to->transit_channel;
 
 		   /* FIXME backup "My address" */
 		   data_len = req->msg.data_len + 8;
 		   data = malloc(data_len);
 		   if (data == NULL) {
 		      lprintf(LOG_ERR, "ipmitool: malloc failure");
-		      return NULL;
+		      return -1;
 		   }
 
 		   memset(data, 0, data_len);
 
-		   data[index++] = (0x40|intf->target_channel);
-		   data[index++] = intf->target_addr;
+		   data[index++] = (0x40|to->target_channel);
+		   data[index++] = to->target_addr;
 		   data[index++] = (  req->msg.netfn << 2 ) |  req->msg.lun ;
 		   data[index++] = ipmi_csum(data+1, 2);
 		   data[index++] = 0xFF;    /* normally 0x20 , overwritten by IPMC  */
@@ -286,7 +333,7 @@ ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	   _req.addr_len = sizeof(bmc_addr);
 	}
 
-	_req.msgid = curr_seq++;
+	_req.msgid = msgid;
 
 	/* In case of a bridge request */
 	if( data != NULL && data_len != 0 ) {
@@ -302,63 +349,51 @@ ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	   _req.msg.cmd = req->msg.cmd;
 	}
    
-	if (ioctl(intf->fd, IPMICTL_SEND_COMMAND, &_req) < 0) {
+	rc = ioctl(intf->fd, IPMICTL_SEND_COMMAND, &_req);
+	if (rc < 0)
 	   lperror(LOG_ERR, "Unable to send command");
-	   if (data != NULL) {
-	      free(data);
-				data = NULL;
-		 }
-	   return NULL;
-	}
 
-	/*
-	 * wait for and retrieve response
-	 */
-
-	if (intf->noanswer) {
-	   if (data != NULL) {
-	      free(data);
-				data = NULL;
-		 }
-	   return NULL;
+	if (data != NULL) {
+	   free(data);
+	   data = NULL;
 	}
 
-	FD_ZERO(&rset);
-	FD_SET(intf->fd, &rset);
+	return (rc < 0) ? -1 : 0;
+}
 
-	if (select(intf->fd+1, &rset, NULL, NULL, NULL) < 0) {
-	   lperror(LOG_ERR, "I/O Error");
-	   if (data != NULL) {
-	      free(data);
-				data = NULL;
-		 }
-	   return NULL;
-	}
-	if (FD_ISSET(intf->fd, &rset) == 0) {
-	   lprintf(LOG_ERR, "No data available");
-	   if (data != NULL) {
-	      free(data);
-				data = NULL;
-		 }
-	   return NULL;
-	}
+/*
+ * ipmi_openipmi_recv_rsp  -  read the next message from the driver
+ *
+ * The message is left in @rsp as the driver delivered it, completion
+ * code included, for ipmi_openipmi_decode_rsp().
+ *
+ * @intf:	ipmi interface
+ * @rsp:	response buffer to fill in
+ * @msgid:	set to the id the request was sent with
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_openipmi_recv_rsp(struct ipmi_intf * intf, struct ipmi_rs * rsp,
+		long * msgid)
+{
+	struct ipmi_recv recv;
+	struct ipmi_addr addr;
 
 	recv.addr = (unsigned char *) &addr;
 	recv.addr_len = sizeof(addr);
-	recv.msg.data = rsp.data;
-	recv.msg.data_len = sizeof(rsp.data);
+	recv.msg.data = rsp->data;
+	recv.msg.data_len = sizeof(rsp->data);
 
 	/* get data */
 	if (ioctl(intf->fd, IPMICTL_RECEIVE_MSG_TRUNC, &recv) < 0) {
 	   lperror(LOG_ERR, "Error receiving message");
-	   if (errno != EMSGSIZE) {
-	      if (data != NULL) {
-					free(data);
-					data = NULL;
-				}
-	      return NULL;
-	   }
+	   if (errno != EMSGSIZE)
+	      return -1;
 	}
+	*msgid = recv.msgid;
+	rsp->data_len = recv.msg.data_len;
 
 	if (verbose > 4) {
 	   fprintf(stderr, "Got message:");
@@ -374,52 +409,226 @@ ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	   }
 	}
 
-	if(intf->transit_addr != 0 && intf->transit_addr != intf->my_addr) {
-	   uint8_t index = 0;
-     
-	   /* ipmb_addr.transit_slave_addr = intf->transit_addr; */
+	return 0;
+}
+
+/*
+ * ipmi_openipmi_decode_rsp  -  split off the completion code
+ *
+ * The response to a double bridged request is the transit controller's
+ * Send Message response, with the target's response wrapped inside.
+ *
+ * @intf:	ipmi interface
+ * @rsp:	message from ipmi_openipmi_recv_rsp()
+ * @to:		IPMB target the request was sent to
+ */
+static void
+ipmi_openipmi_decode_rsp(struct ipmi_intf * intf, struct ipmi_rs * rsp,
+		struct ipmi_rq_target * to)
+{
+	if (ipmi_openipmi_double_bridged(intf, to)) {
 	   lprintf(LOG_DEBUG, "Decapsulating data received from transit "
-		   "IPMB target @ 0x%x", intf->transit_addr);
+		   "IPMB target @ 0x%x", to->transit_addr);
 
 	   /* comp code */
 	   /* Check data */
 
-	   if( recv.msg.data[0] == 0 ) {
-	      recv.msg.netfn = recv.msg.data[2] >> 2;
-	      recv.msg.cmd   = recv.msg.data[6];
-
-	      recv.msg.data = memmove(recv.msg.data ,recv.msg.data+7 , recv.msg.data_len - 7);
-	      recv.msg.data_len -=8;
-       
-	      if (verbose > 4) {   
+	   if (rsp->data[0] == 0 && rsp->data_len >= 8) {
+	      if (verbose > 4) {
 		 fprintf(stderr, "Decapsulated  message:\n");
-		 fprintf(stderr, "  netfn     = 0x%x\n",   recv.msg.netfn );
-		 fprintf(stderr, "  cmd       = 0x%x\n",  recv.msg.cmd);
-		 if (recv.msg.data && recv.msg.data_len) {
-		    fprintf(stderr, "  data_len  = %d\n",  recv.msg.data_len);
-		    fprintf(stderr, "  data      = %s\n",
-			    buf2str(recv.msg.data,recv.msg.data_len));
-		 }
+		 fprintf(stderr, "  netfn     = 0x%x\n", rsp->data[2] >> 2);
+		 fprintf(stderr, "  cmd       = 0x%x\n", rsp->data[6]);
 	      }
+	      memmove(rsp->data, rsp->data + 7, rsp->data_len - 7);
+	      rsp->data_len -= 8;
 	   }
 	}
 
 	/* save completion code */
-	rsp.ccode = recv.msg.data[0];
-	rsp.data_len = recv.msg.data_len - 1;
+	rsp->ccode = rsp->data[0];
+	rsp->data_len = (rsp->data_len > 0) ? rsp->data_len - 1 : 0;
 
 	/* save response data for caller */
-	if (rsp.ccode == 0 && rsp.data_len > 0) {
-	   memmove(rsp.data, rsp.data + 1, rsp.data_len);
-	   rsp.data[rsp.data_len] = 0;
+	if (rsp->ccode == 0 && rsp->data_len > 0) {
+	   memmove(rsp->data, rsp->data + 1, rsp->data_len);
+	   rsp->data[rsp->data_len] = 0;
 	}
+}
 
-	if (data != NULL) {
-	   free(data);
-		 data = NULL;
+/*
+ * ipmi_openipmi_complete  -  finish a request of ipmi_intf_submit()
+ *
+ * @intf:	ipmi interface
+ * @rsp:	message from ipmi_openipmi_recv_rsp()
+ * @msgid:	id the message came with
+ *
+ * returns 1 if the message belonged to a submitted request, 0 if not
+ */
+static int
+ipmi_openipmi_complete(struct ipmi_intf * intf, struct ipmi_rs * rsp,
+		long msgid)
+{
+	struct ipmi_openipmi_state * st = intf->priv;
+	struct ipmi_async * async = intf->async;
+	struct ipmi_async_rq * e;
+	int idx = msgid & (IPMI_RQ_SEQ_MAX - 1);
+
+	if (async == NULL || (e = async->slot[idx]) == NULL ||
+	    st->slot_msgid[idx] != msgid)
+		return 0;
+
+	async->slot[idx] = NULL;
+	ipmi_openipmi_decode_rsp(intf, rsp, &e->to);
+	ipmi_stats_record(intf, e->req, rsp, ipmi_stats_usec() - e->start);
+	ipmi_async_done(intf, e, rsp);
+	return 1;
+}
+
+static struct ipmi_rs *
+ipmi_openipmi_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
+{
+	struct ipmi_rs * rsp = &intf->rsp;
+	struct ipmi_rq_target to;
+	struct pollfd pfd;
+	long msgid, got;
+
+	if (intf == NULL || req == NULL)
+		return NULL;
+
+	if (intf->opened == 0 && intf->open != NULL)
+		if (intf->open(intf) < 0)
+			return NULL;
+
+	ipmi_intf_get_target(intf, &to);
+	msgid = ((struct ipmi_openipmi_state *)intf->priv)->curr_seq++;
+	if (ipmi_openipmi_send_req(intf, req, &to, msgid) < 0)
+		return NULL;
+
+	/*
+	 * wait for and retrieve response
+	 */
+
+	if (intf->noanswer)
+	   return NULL;
+
+	/*
+	 * Responses to submitted requests may arrive first, and so may the
+	 * late response to a request whose caller gave up on it.  The
+	 * driver times out every request itself, so ours always comes.
+	 */
+	for (;;) {
+		pfd.fd = intf->fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "I/O Error");
+			return NULL;
+		}
+		if (ipmi_openipmi_recv_rsp(intf, rsp, &got) < 0)
+			return NULL;
+		if (got == msgid)
+			break;
+		if (!ipmi_openipmi_complete(intf, rsp, got))
+			lprintf(LOG_DEBUG, "Discarding response with "
+				"unknown msgid %ld", got);
+	}
+
+	ipmi_openipmi_decode_rsp(intf, rsp, &to);
+	return rsp;
+}
+
+/*
+ * ipmi_openipmi_poll  -  drive requests queued with ipmi_intf_submit()
+ *
+ * Up to IPMI_OPENIPMI_WINDOW requests are handed to the driver at once
+ * and matched back by msgid; the driver times them out itself.  Each
+ * request goes to the IPMB target it was submitted for, and double
+ * bridged ones are wrapped in their own Send Message, so a sweep over
+ * satellite controllers keeps all of them busy.
+ *
+ * @intf:	ipmi interface
+ * @timeout:	milliseconds to wait for responses, -1 to wait until at
+ *		least one request completes
+ *
+ * returns the number of requests completed
+ * returns -1 on error
+ */
+static int
+ipmi_openipmi_poll(struct ipmi_intf * intf, int timeout)
+{
+	struct ipmi_rs * rsp = &intf->rsp;
+	struct ipmi_async * async = intf->async;
+	struct ipmi_openipmi_state * st;
+	struct ipmi_async_rq * e;
+	struct pollfd pfd;
+	uint32_t begin, elapsed;
+	long msgid;
+	int idx, wait, done = 0;
+
+	if (intf->opened == 0 && intf->open != NULL && intf->open(intf) < 0) {
+		ipmi_async_abort(intf);
+		return -1;
+	}
+	st = intf->priv;
+
+	begin = ipmi_intf_msec();
+
+	for (;;) {
+		idx = st->curr_seq & (IPMI_RQ_SEQ_MAX - 1);
+		while (async->head != NULL &&
+		       async->inflight < IPMI_OPENIPMI_WINDOW &&
+		       async->slot[idx] == NULL) {
+			e = ipmi_async_next(intf);
+			async->inflight++;
+			if (ipmi_openipmi_send_req(intf, e->req, &e->to,
+					st->curr_seq) < 0) {
+				ipmi_async_done(intf, e, NULL);
+				done++;
+				/* the callback may have sent, moving curr_seq */
+				idx = st->curr_seq & (IPMI_RQ_SEQ_MAX - 1);
+				continue;
+			}
+			e->start = ipmi_stats_usec();
+			async->slot[idx] = e;
+			st->slot_msgid[idx] = st->curr_seq++;
+			idx = st->curr_seq & (IPMI_RQ_SEQ_MAX - 1);
+		}
+		if (async->inflight == 0)
+			break;
+
+		wait = -1;
+		if (timeout >= 0) {
+			elapsed = ipmi_intf_msec() - begin;
+			wait = (elapsed < (uint32_t)timeout) ? (int)(timeout - elapsed) : 0;
+		}
+
+		pfd.fd = intf->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, wait) < 0 && errno != EINTR) {
+			lperror(LOG_ERR, "I/O Error");
+			ipmi_async_abort(intf);
+			return -1;
+		}
+
+		if (pfd.revents & POLLIN &&
+		    ipmi_openipmi_recv_rsp(intf, rsp, &msgid) == 0) {
+			if (ipmi_openipmi_complete(intf, rsp, msgid))
+				done++;
+			else
+				lprintf(LOG_DEBUG, "Discarding response with "
+					"unknown msgid %ld", msgid);
+		}
+
+		if (timeout < 0 ? done > 0 :
+		    ipmi_intf_msec() - begin >= (uint32_t)timeout)
+			break;
 	}
 
-	return &rsp;
+	ipmi_async_set_timeout(intf, (async->head != NULL &&
+		async->inflight < IPMI_OPENIPMI_WINDOW) ? 0 : -1);
+	return done;
 }
 
 int ipmi_openipmi_setup(struct ipmi_intf * intf)
@@ -438,6 +647,7 @@ struct ipmi_intf ipmi_open_intf = {
 	open:		ipmi_openipmi_open,
 	close:		ipmi_openipmi_close,
 	sendrecv:	ipmi_openipmi_send_cmd,
+	poll:		ipmi_openipmi_poll,
 	set_my_addr:	ipmi_openipmi_set_my_addr,
 	my_addr:	IPMI_BMC_SLAVE_ADDR,
 	target_addr:	0, /* init so -m local_addr does not cause bridging */
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2003 Sun Microsystems, Inc.  All Rights Reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of Sun Microsystems, Inc. or the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * 
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * SUN MICROSYSTEMS, INC. ("SUN") AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * SUN OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE, PROFIT OR DATA,
+ * OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL, INCIDENTAL OR
+ * PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE THEORY OF
+ * LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS SOFTWARE,
+ * EVEN IF SUN HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_proxy.h>
+#include <ipmitool/ipmi_stats.h>
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+
+#if defined(HAVE_CONFIG_H)
+# include <config.h>
+#endif
+
+#define IPMI_PROXY_WINDOW	16	/* default requests in flight */
+#define IPMI_PROXY_TIMEOUT	60	/* seconds to wait for ipmiproxyd */
+
+extern int verbose;
+
+/* proxy_io  -  read or write a whole buffer
+ *
+ * @fd:		socket to ipmiproxyd
+ * @buf:	data
+ * @len:	number of bytes
+ * @out:	1 to write, 0 to read
+ *
+ * returns 0 on success, -1 on error, timeout or end of file
+ */
+static int
+proxy_io(int fd, void * buf, size_t len, int out)
+{
+	struct pollfd pfd;
+	uint8_t * p = buf;
+	ssize_t ret;
+
+	while (len > 0) {
+		pfd.fd = fd;
+		pfd.events = out ? POLLOUT : POLLIN;
+		pfd.revents = 0;
+
+		ret = poll(&pfd, 1, IPMI_PROXY_TIMEOUT * 1000);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			lprintf(LOG_ERR, "No answer from ipmiproxyd");
+			return -1;
+		}
+
+		if (out)
+			ret = send(fd, p, len, MSG_NOSIGNAL);
+		else
+			ret = recv(fd, p, len, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			if (ret < 0)
+				lperror(LOG_ERR, "ipmiproxyd connection");
+			else
+				lprintf(LOG_ERR, "ipmiproxyd closed the connection");
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/* proxy_send  -  send one request to ipmiproxyd
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+proxy_send(struct ipmi_intf * intf, struct ipmi_rq * req, uint32_t id)
+{
+	struct ipmi_proxy_rq hdr;
+	uint8_t frame[sizeof(hdr) + IPMI_BUF_SIZE];
+
+	if (req->msg.data_len > IPMI_BUF_SIZE) {
+		lprintf(LOG_ERR, "Request is too long: %d bytes",
+			req->msg.data_len);
+		return -1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.id = id;
+	hdr.netfn = req->msg.netfn;
+	hdr.lun = req->msg.lun;
+	hdr.cmd = req->msg.cmd;
+	hdr.target_addr = intf->target_addr;
+	hdr.target_channel = intf->target_channel;
+	hdr.transit_addr = intf->transit_addr;
+	hdr.transit_channel = intf->transit_channel;
+	hdr.data_len = req->msg.data_len;
+
+	if (verbose > 2)
+		lprintf(LOG_DEBUG, ">> proxy request %u: netfn 0x%02x cmd 0x%02x, %d bytes",
+			id, hdr.netfn, hdr.cmd, hdr.data_len);
+
+	memcpy(frame, &hdr, sizeof(hdr));
+	if (hdr.data_len > 0)
+		memcpy(frame + sizeof(hdr), req->msg.data, hdr.data_len);
+
+	return proxy_io(intf->fd, frame, sizeof(hdr) + hdr.data_len, 1);
+}
+
+/* proxy_recv  -  read the next response from ipmiproxyd
+ *
+ * @intf:	ipmi interface
+ * @id:		filled in with the id of the request it answers
+ *
+ * returns pointer to the response, with data_len set to -1 if the BMC
+ * did not answer
+ * returns NULL on error
+ */
+static struct ipmi_rs *
+proxy_recv(struct ipmi_intf * intf, uint32_t * id)
+{
+	struct ipmi_rs * rsp = &intf->rsp;
+	struct ipmi_proxy_rs hdr;
+
+	if (proxy_io(intf->fd, &hdr, sizeof(hdr), 0) < 0)
+		return NULL;
+
+	if (hdr.data_len > IPMI_BUF_SIZE) {
+		lprintf(LOG_ERR, "Malformed response from ipmiproxyd");
+		return NULL;
+	}
+
+	memset(rsp, 0, sizeof(*rsp));
+	if (hdr.data_len > 0 &&
+	    proxy_io(intf->fd, rsp->data, hdr.data_len, 0) < 0)
+		return NULL;
+
+	*id = hdr.id;
+	rsp->ccode = hdr.ccode;
+	rsp->data_len = hdr.data_len;
+	if (hdr.status != IPMI_PROXY_OK)
+		rsp->data_len = -1;
+
+	if (verbose > 2)
+		lprintf(LOG_DEBUG, "<< proxy response %u: status %d ccode 0x%02x, %d bytes",
+			hdr.id, hdr.status, hdr.ccode, hdr.data_len);
+
+	return rsp;
+}
+
+/* ipmi_proxy_close  -  disconnect from ipmiproxyd
+ *
+ * The BMC session stays open in the daemon for the next client.
+ */
+static void
+ipmi_proxy_close(struct ipmi_intf * intf)
+{
+	if (intf->fd >= 0)
+		close(intf->fd);
+
+	intf->fd = -1;
+	intf->opened = 0;
+	ipmi_intf_session_cleanup(intf);
+}
+
+/* ipmi_proxy_open  -  connect to ipmiproxyd
+ *
+ * The socket is <dir>/<hostname> for -H hostname and <dir>/local
+ * without it.  <dir> is IPMI_PROXY_DIR unless -D names a directory,
+ * -D naming anything else is taken as the path of the socket.
+ *
+ * returns socket descriptor, -1 on error
+ */
+static int
+ipmi_proxy_open(struct ipmi_intf * intf)
+{
+	struct ipmi_proxy_hello hello;
+	struct sockaddr_un addr;
+	struct stat st;
+	const char * dir = IPMI_PROXY_DIR;
+	const char * name = IPMI_PROXY_LOCAL;
+
+	if (intf->opened)
+		return intf->fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (intf->session != NULL && intf->session->hostname != NULL)
+		name = intf->session->hostname;
+	if (intf->devfile != NULL && stat(intf->devfile, &st) == 0 &&
+	    S_ISDIR(st.st_mode))
+		dir = intf->devfile;
+	if (intf->devfile != NULL && dir != intf->devfile)
+		snprintf(addr.sun_path, sizeof(addr.sun_path), "%s",
+			 intf->devfile);
+	else
+		snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s",
+			 dir, name);
+
+	intf->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (intf->fd < 0) {
+		lperror(LOG_ERR, "socket");
+		return -1;
+	}
+
+	if (connect(intf->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		lperror(LOG_ERR, "Unable to connect to ipmiproxyd at %s",
+			addr.sun_path);
+		close(intf->fd);
+		intf->fd = -1;
+		return -1;
+	}
+
+	if (proxy_io(intf->fd, &hello, sizeof(hello), 0) < 0) {
+		close(intf->fd);
+		intf->fd = -1;
+		return -1;
+	}
+	if (hello.version != IPMI_PROXY_VERSION) {
+		lprintf(LOG_ERR, "ipmiproxyd protocol version %u is not supported",
+			hello.version);
+		close(intf->fd);
+		intf->fd = -1;
+		return -1;
+	}
+
+	/* the daemon knows what its session to the BMC can carry */
+	intf->max_request_data_size = hello.max_request_data_size;
+	intf->max_response_data_size = hello.max_response_data_size;
+
+	intf->opened = 1;
+	return intf->fd;
+}
+
+/* ipmi_proxy_send_cmd  -  send a request through ipmiproxyd and wait
+ *                         for its response
+ *
+ * @intf:	ipmi interface
+ * @req:	request
+ *
+ * returns pointer to response, NULL if there was none
+ */
+static struct ipmi_rs *
+ipmi_proxy_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
+{
+	struct ipmi_rs * rsp;
+	uint32_t id;
+
+	if (!intf->opened && intf->open(intf) < 0)
+		return NULL;
+
+	if (proxy_send(intf, req, ++intf->session->out_seq) < 0)
+		return NULL;
+
+	do {
+		rsp = proxy_recv(intf, &id);
+	} while (rsp != NULL && id != intf->session->out_seq);
+
+	if (rsp == NULL || rsp->data_len < 0)
+		return NULL;
+
+	return rsp;
+}
+
+/* ipmi_proxy_sendrecv_window  -  pipeline a batch of requests
+ *
+ * Keeps up to session->window requests outstanding on the socket.
+ * The daemon may answer them in any order; ids are handed out
+ * consecutively from session->out_seq, so a response's id maps
+ * straight back to its index.  Every completion is accounted with
+ * ipmi_stats_record().
+ *
+ * returns 0 on success, -1 if the connection failed
+ */
+static int
+ipmi_proxy_sendrecv_window(struct ipmi_intf * intf, struct ipmi_rq * reqs,
+		int count,
+		void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx)
+{
+	struct ipmi_rs * rsp;
+	uint32_t base, id;
+	uint64_t * start;
+	int next = 0, inflight = 0, i;
+	char * pending;
+
+	if (!intf->opened && intf->open(intf) < 0)
+		return -1;
+
+	pending = calloc(count, 1);
+	start = calloc(count, sizeof(uint64_t));
+	if (pending == NULL || start == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		free(pending);
+		free(start);
+		return -1;
+	}
+
+	base = intf->session->out_seq + 1;
+	intf->session->out_seq += count;
+
+	while (next < count || inflight > 0) {
+		while (next < count && inflight < intf->session->window) {
+			start[next] = ipmi_stats_usec();
+			if (proxy_send(intf, &reqs[next], base + next) < 0)
+				goto abort;
+			pending[next++] = 1;
+			inflight++;
+		}
+
+		rsp = proxy_recv(intf, &id);
+		if (rsp == NULL)
+			goto abort;
+
+		i = id - base;
+		if (i < 0 || i >= next || !pending[i])
+			continue;	/* left over from an earlier call */
+		pending[i] = 0;
+		inflight--;
+		if (rsp->data_len < 0)
+			rsp = NULL;
+		ipmi_stats_record(intf, &reqs[i], rsp,
+				  ipmi_stats_usec() - start[i]);
+		done(intf, i, &reqs[i], rsp, ctx);
+	}
+
+	free(pending);
+	free(start);
+	return 0;
+
+ abort:
+	for (i = 0; i < count; i++) {
+		if (i >= next || pending[i]) {
+			ipmi_stats_record(intf, &reqs[i], NULL, 0);
+			done(intf, i, &reqs[i], NULL, ctx);
+		}
+	}
+	free(pending);
+	free(start);
+	return -1;
+}
+
+static int
+ipmi_proxy_setup(struct ipmi_intf * intf)
+{
+	intf->session = malloc(sizeof(struct ipmi_session));
+	if (intf->session == NULL) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	memset(intf->session, 0, sizeof(struct ipmi_session));
+	intf->session->window = IPMI_PROXY_WINDOW;
+	intf->fd = -1;
+
+	return 0;
+}
+
+struct ipmi_intf ipmi_proxy_intf = {
+	name:		"proxy",
+	desc:		"Shared session through ipmiproxyd",
+	setup:		ipmi_proxy_setup,
+	open:		ipmi_proxy_open,
+	close:		ipmi_proxy_close,
+	sendrecv:	ipmi_proxy_send_cmd,
+	sendrecv_window: ipmi_proxy_sendrecv_window,
+	my_addr:	IPMI_BMC_SLAVE_ADDR,
+	target_addr:	IPMI_BMC_SLAVE_ADDR,
+};
@@ -48,6 +48,7 @@
 
 #include <ipmitool/ipmi.h>
 #include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_stats.h>
 #include <ipmitool/helper.h>
 #include <ipmitool/log.h>
 
@@ -61,6 +62,7 @@
 #define	SERIAL_BM_TIMEOUT	5
 #define SERIAL_BM_RETRY_COUNT	5
 #define SERIAL_BM_MAX_BUFFER_SIZE 250
+#define SERIAL_BM_MAX_WINDOW	32	/* requests in flight, half the seq space */
 
 #define BM_START		0xA0
 #define BM_STOP			0xA5
@@ -175,14 +177,44 @@ static const struct {
 	{ 0x1B, 0x3B }			/* escape */
 };
 
+/*
+ *	Lookup tables built from characters[]: the escaped form of each
+ *	special character, the original of each escaped form (0 when the
+ *	byte is not one) and the framing characters of the receive side.
+ */
+static uint8_t bm_escape[256];
+static uint8_t bm_unescape[256];
+static uint8_t bm_framing[256];
+
 static int is_system;
 
+/*
+ *	Fill in the escape tables
+ */
+static void
+serial_bm_init_tables(void)
+{
+	int i;
+
+	for (i = 0; i < sizeof(characters) / sizeof(characters[0]); i++) {
+		bm_escape[characters[i].character] = characters[i].escape;
+		bm_unescape[characters[i].escape] = characters[i].character;
+	}
+
+	bm_framing[BM_START] = 1;
+	bm_framing[BM_STOP] = 1;
+	bm_framing[BM_HANDSHAKE] = 1;
+	bm_framing[BM_ESCAPE] = 1;
+}
+
 /*
  *	Setup serial interface
  */
 static int
 serial_bm_setup(struct ipmi_intf * intf)
 {
+	serial_bm_init_tables();
+
 	intf->session = malloc(sizeof(struct ipmi_session));
 	if (intf->session == NULL) {
 		lprintf(LOG_ERR, "ipmitool: malloc failure");
@@ -337,48 +369,15 @@ serial_bm_flush(struct ipmi_intf * intf)
 #endif
 }
 
-/*
- *	Return escaped character for the given one
- */
-static inline uint8_t
-serial_bm_get_escaped_char(uint8_t c)
-{
-	int i;
-
-	for (i = 0; i < 5; i++) {
-		if (characters[i].character == c) {
-			return characters[i].escape;
-		}
-	}
-
-	return c;
-}
-
-/*
- *	Return unescaped character for the given one
- */
-static inline uint8_t
-serial_bm_get_unescaped_char(uint8_t c)
-{
-	int i;
-
-	for (i = 0; i < 5; i++) {
-		if (characters[i].escape == c) {
-			return characters[i].character;
-		}
-	}
-
-	return c;
-}
-
 /*
  *	Send message to serial port
  */
 static int
 serial_bm_send_msg(struct ipmi_intf * intf, uint8_t * msg, int msg_len)
 {
-	int i, size, tmp = 0;
-	uint8_t * buf, * data;
+	uint8_t data[SERIAL_BM_MAX_MSG_SIZE * 2 + 2];
+	struct pollfd pfd;
+	int i, size = 0, tmp;
 
 	if (verbose > 3) {
 		fprintf(stderr, "Sending request:\n");
@@ -399,48 +398,53 @@ serial_bm_send_msg(struct ipmi_intf * intf, uint8_t * msg, int msg_len)
 		fprintf(stderr, " %s\n", buf2str(msg, msg_len));
 	}
 
-	/* calculate escaped characters number */
-	for (i = 0; i < msg_len; i++) {
-		if (serial_bm_get_escaped_char(msg[i]) != msg[i]) {
-			tmp++;
-		}
-	}
-
-	/* calculate required buffer size */
-	size = msg_len + tmp + 2;
-
-	/* allocate buffer for output data */
-	buf = data = (uint8_t *) alloca(size);
-
-	if (!buf) {
-		lperror(LOG_ERR, "ipmitool: alloca error");
+	if (msg_len > SERIAL_BM_MAX_MSG_SIZE) {
+		lprintf(LOG_ERR, "ipmitool: Message data is too long");
 		return -1;
 	}
 
 	/* start character */
-	*buf++ = 0xA0;
+	data[size++] = BM_START;
 
+	/* escape the whole message in one pass */
 	for (i = 0; i < msg_len; i++) {
-		tmp = serial_bm_get_escaped_char(msg[i]);
-		if (tmp != msg[i]) {
-			*buf++ = 0xAA;
+		if (bm_escape[msg[i]]) {
+			data[size++] = BM_ESCAPE;
+			data[size++] = bm_escape[msg[i]];
+		} else {
+			data[size++] = msg[i];
 		}
-
-		*buf++ = tmp;
 	}
 
 	/* stop character */
-	*buf++ = 0xA5;
+	data[size++] = BM_STOP;
 
 	if (verbose > 5) {
 		fprintf(stderr, "Sent serial data:\n %s\n", buf2str(data, size));
 	}
 
-	/* write data to serial port */
-	tmp = write(intf->fd, data, size);
-	if (tmp <= 0) {
-		lperror(LOG_ERR, "ipmitool: write error");
-		return -1;
+	/* write data to serial port, the port is non-blocking */
+	for (i = 0; i < size; i += tmp) {
+		tmp = write(intf->fd, data + i, size - i);
+		if (tmp < 0 && errno == EAGAIN) {
+			pfd.fd = intf->fd;
+			pfd.events = POLLOUT;
+			tmp = poll(&pfd, 1, intf->session->timeout * 1000);
+			if (tmp == 0) {
+				lprintf(LOG_ERR, "ipmitool: write timed out");
+				return -1;
+			}
+			if (tmp < 0 && errno != EINTR) {
+				lperror(LOG_ERR, "ipmitool: poll error");
+				return -1;
+			}
+			tmp = 0;
+			continue;
+		}
+		if (tmp <= 0) {
+			lperror(LOG_ERR, "ipmitool: write error");
+			return -1;
+		}
 	}
 
 	return 0;
@@ -470,13 +474,14 @@ serial_bm_wait_for_data(struct ipmi_intf * intf)
 }
 
 /*
- *	This function parses incoming data in basic mode format to IPMB message
+ *	This function parses incoming data in basic mode format to IPMB message.
+ *	Runs of plain data between framing characters are copied whole.
  */
 static int
 serial_bm_parse_buffer(const uint8_t * data, int data_len,
 		struct serial_bm_parse_ctx * ctx)
 {
-	int i, tmp;
+	int i, run;
 
 	for (i = 0; i < data_len; i++) {
 		/* check for start of new message */
@@ -489,12 +494,9 @@ serial_bm_parse_buffer(const uint8_t * data, int data_len,
 			/* skip character */
 			continue;
 		/* continue escape sequence */
-		} else	if (ctx->escape) {
-			/* get original character */
-			tmp = serial_bm_get_unescaped_char(data[i]);
-
+		} else if (ctx->escape) {
 			/* check if not special character */
-			if (tmp == data[i]) {
+			if (!bm_unescape[data[i]]) {
 				lprintf(LOG_ERR, "ipmitool: bad response");
 				/* reset message state */
 				ctx->state = MSG_NONE;
@@ -510,14 +512,13 @@ serial_bm_parse_buffer(const uint8_t * data, int data_len,
 			}
 
 			/* add parsed character */
-			ctx->msg[ctx->msg_len++] = tmp;
+			ctx->msg[ctx->msg_len++] = bm_unescape[data[i]];
 
 			/* clear escape flag */
 			ctx->escape = 0;
 		/* check for escape character */
 		} else if (data[i] == BM_ESCAPE) {
 			ctx->escape = 1;
-			continue;
 		/* check for stop character */
 		} else if (data[i] == BM_STOP) {
 			ctx->state = MSG_DONE;
@@ -527,14 +528,24 @@ serial_bm_parse_buffer(const uint8_t * data, int data_len,
 			/* just skip it */
 			continue;
 		} else {
+			/* measure the run of plain data */
+			for (run = 1; i + run < data_len &&
+					!bm_framing[data[i + run]]; run++)
+				;
+
 			/* check message length */
-			if (ctx->msg_len >= ctx->max_len) {
+			if (ctx->msg_len + run > ctx->max_len) {
 				lprintf(LOG_ERR, "ipmitool: response is too long");
-				return -1;
+				/* reset message state */
+				ctx->state = MSG_NONE;
+				i += run - 1;
+				continue;
 			}
 
-			/* add parsed character */
-			ctx->msg[ctx->msg_len++] = data[i];
+			/* add parsed characters */
+			memcpy(ctx->msg + ctx->msg_len, data + i, run);
+			ctx->msg_len += run;
+			i += run - 1;
 		}
 	}
 
@@ -555,30 +566,44 @@ serial_bm_recv_msg(struct ipmi_intf * intf,
 
 	parse_ctx.state = MSG_NONE;
 	parse_ctx.msg = msg_data;
+	parse_ctx.msg_len = 0;
 	parse_ctx.max_len = msg_len;
+	parse_ctx.escape = 0;
 
 	do {
-		/* wait for data in the port */
-		if (serial_bm_wait_for_data(intf)) {
-			return 0;
-		}
+		/*
+		 * Only the data after the last message is left in the buffer,
+		 * responses to windowed requests often arrive back to back.
+		 */
+		if (recv_ctx->buffer_size == 0) {
+			/* wait for data in the port */
+			if (serial_bm_wait_for_data(intf)) {
+				return 0;
+			}
 
-		/* read data into buffer */
-		rv = read(intf->fd, recv_ctx->buffer + recv_ctx->buffer_size,
-				recv_ctx->max_buffer_size - recv_ctx->buffer_size);
+			/* read data into buffer */
+			rv = read(intf->fd, recv_ctx->buffer,
+					recv_ctx->max_buffer_size);
 
-		if (rv < 0) {
-			lperror(LOG_ERR, "ipmitool: read error");
-			return -1;
-		}
+			if (rv < 0 && errno == EAGAIN) {
+				continue;
+			}
+			if (rv == 0) {
+				return 0;
+			}
+			if (rv < 0) {
+				lperror(LOG_ERR, "ipmitool: read error");
+				return -1;
+			}
 
-		if (verbose > 5) {
-			fprintf(stderr, "Received serial data:\n %s\n",
-					buf2str(recv_ctx->buffer + recv_ctx->buffer_size, rv));
-		}
+			if (verbose > 5) {
+				fprintf(stderr, "Received serial data:\n %s\n",
+						buf2str((uint8_t *)recv_ctx->buffer, rv));
+			}
 
-		/* increment buffer size */
-		recv_ctx->buffer_size += rv;
+			/* set buffer size */
+			recv_ctx->buffer_size = rv;
+		}
 
 		/* parse buffer */
 		rv = serial_bm_parse_buffer(recv_ctx->buffer,
@@ -746,6 +771,54 @@ serial_bm_build_msg(const struct ipmi_intf * intf,
 	return bridging_level;
 }
 
+/*
+ *	Validate the size and checksums of a received message
+ */
+static int
+serial_bm_check_response(const uint8_t * msg, int msg_len)
+{
+	/* validate message size */
+	if (msg_len < 8) {
+		lprintf(LOG_ERR, "ipmitool: response is too short");
+		return -1;
+	}
+
+	/* validate checksum 1 */
+	if (ipmi_csum((uint8_t *)msg, 3)) {
+		lprintf(LOG_ERR, "ipmitool: bad checksum 1");
+		return -1;
+	}
+
+	/* validate checksum 2 */
+	if (ipmi_csum((uint8_t *)msg + 3, msg_len - 3)) {
+		lprintf(LOG_ERR, "ipmitool: bad checksum 2");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ *	Check if a received message answers the given request
+ */
+static int
+serial_bm_match_response(const struct serial_bm_request_ctx * req_ctx,
+		const uint8_t * msg)
+{
+	const struct ipmb_msg_hdr * hdr = (const struct ipmb_msg_hdr *) msg;
+	int netFn, rqSeq;
+
+	/* swap requester and responder LUNs */
+	netFn = ((req_ctx->netFn|4) & ~3) | (req_ctx->rqSeq & 3);
+	rqSeq = (req_ctx->rqSeq & ~3) | (req_ctx->netFn & 3);
+
+	return hdr->rsSA == req_ctx->rqSA
+			&& hdr->netFn == netFn
+			&& hdr->rqSA == req_ctx->rsSA
+			&& hdr->rqSeq == rqSeq
+			&& hdr->cmd == req_ctx->cmd;
+}
+
 /*
  *	Wait for request response
  */
@@ -754,39 +827,16 @@ serial_bm_wait_response(struct ipmi_intf * intf,
 		struct serial_bm_request_ctx * req_ctx, struct serial_bm_recv_ctx * read_ctx,
 		uint8_t * msg, size_t max_len)
 {
-	struct ipmb_msg_hdr * hdr = (struct ipmb_msg_hdr *) msg;
-	int msg_len, netFn, rqSeq;
+	int msg_len;
 
 	/* receive and match message */
 	while ((msg_len = serial_bm_recv_msg(intf, read_ctx, msg, max_len)) > 0) {
-		/* validate message size */
-		if (msg_len < 8) {
-			lprintf(LOG_ERR, "ipmitool: response is too short");
+		if (serial_bm_check_response(msg, msg_len) < 0) {
 			continue;
 		}
 
-		/* validate checksum 1 */
-		if (ipmi_csum(msg, 3)) {
-			lprintf(LOG_ERR, "ipmitool: bad checksum 1");
-			continue;
-		}
-
-		/* validate checksum 2 */
-		if (ipmi_csum(msg + 3, msg_len - 3)) {
-			lprintf(LOG_ERR, "ipmitool: bad checksum 2");
-			continue;
-		}
-
-		/* swap requester and responder LUNs */
-		netFn = ((req_ctx->netFn|4) & ~3) | (req_ctx->rqSeq & 3);
-		rqSeq = (req_ctx->rqSeq & ~3) | (req_ctx->netFn & 3);
-
 		/* check for the waited response */
-		if (hdr->rsSA == req_ctx->rqSA
-				&& hdr->netFn == netFn
-				&& hdr->rqSA == req_ctx->rsSA
-				&& hdr->rqSeq == rqSeq
-				&& hdr->cmd == req_ctx->cmd) {
+		if (serial_bm_match_response(req_ctx, msg)) {
 			/* check if something new has been parsed */
 			if (verbose > 3) {
 				fprintf(stderr, "Got response:\n");
@@ -804,10 +854,11 @@ serial_bm_wait_response(struct ipmi_intf * intf,
 			}
 
 			/* copy only completion and response data */
-			memmove(msg, hdr + 1, msg_len - sizeof (*hdr) - 1);
+			memmove(msg, msg + sizeof (struct ipmb_msg_hdr),
+					msg_len - sizeof (struct ipmb_msg_hdr) - 1);
 
 			/* update message length */
-			msg_len -= sizeof (*hdr) + 1;
+			msg_len -= sizeof (struct ipmb_msg_hdr) + 1;
 
 			/* the waited one */
 			break;
@@ -895,7 +946,7 @@ serial_bm_get_message(struct ipmi_intf * intf,
 static struct ipmi_rs *
 serial_bm_send_request(struct ipmi_intf * intf, struct ipmi_rq * req)
 {
-	static struct ipmi_rs rsp;
+	struct ipmi_rs * rsp = &intf->rsp;
 	uint8_t msg[SERIAL_BM_MAX_MSG_SIZE], * resp = msg;
 	struct serial_bm_request_ctx req_ctx[3];
 	struct serial_bm_recv_ctx read_ctx;
@@ -986,23 +1037,191 @@ serial_bm_send_request(struct ipmi_intf * intf, struct ipmi_rq * req)
 		/* check for double bridging */
 		if (bridging_level == 2 && resp[0] == 0) {
 			/* get completion code */
-			rsp.ccode = resp[7];
-			rsp.data_len = rv - 9;
-			memcpy(rsp.data, resp + 8, rsp.data_len);
+			rsp->ccode = resp[7];
+			rsp->data_len = rv - 9;
+			memcpy(rsp->data, resp + 8, rsp->data_len);
 		} else {
-			rsp.ccode = resp[0];
-			rsp.data_len = rv - 1;
-			memcpy(rsp.data, resp + 1, rsp.data_len);
+			rsp->ccode = resp[0];
+			rsp->data_len = rv - 1;
+			memcpy(rsp->data, resp + 1, rsp->data_len);
 		}
 
 		/* return response */
-		return &rsp;
+		return rsp;
 	}
 
 	/* no valid response */
 	return NULL;
 }
 
+/*
+ *	Fail the requests of a window that did not complete
+ */
+static void
+serial_bm_window_fail(struct ipmi_intf * intf, struct ipmi_rq * reqs,
+		int from, int count, const int * pending,
+		void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx)
+{
+	int i;
+
+	for (i = 0; i < SERIAL_BM_MAX_WINDOW; i++) {
+		if (pending[i] >= 0) {
+			ipmi_stats_record(intf, &reqs[pending[i]], NULL, 0);
+			done(intf, pending[i], &reqs[pending[i]], NULL, ctx);
+		}
+	}
+	for (i = from; i < count; i++) {
+		ipmi_stats_record(intf, &reqs[i], NULL, 0);
+		done(intf, i, &reqs[i], NULL, ctx);
+	}
+}
+
+/*
+ *	Send a batch of requests with up to session->window of them waiting
+ *	for a response.  Responses carry the sequence number of their request,
+ *	so they are matched in whatever order the BMC answers.  The window is
+ *	only used when set with -W, as not every BMC buffers requests on the
+ *	serial port.  Bridged requests need the Send Message and Get Message
+ *	exchange and are sent one at a time.  Every completion is accounted
+ *	with ipmi_stats_record().
+ */
+static int
+serial_bm_sendrecv_window(struct ipmi_intf * intf, struct ipmi_rq * reqs,
+		int count,
+		void (*done)(struct ipmi_intf * intf, int idx, struct ipmi_rq * req,
+			struct ipmi_rs * rsp, void * ctx),
+		void * ctx)
+{
+	struct {
+		int tries;
+		time_t sent;
+		uint64_t start;
+		int msg_len;
+		uint8_t msg[SERIAL_BM_MAX_MSG_SIZE];
+		struct serial_bm_request_ctx req_ctx[3];
+	} slot[SERIAL_BM_MAX_WINDOW];
+	int pending[SERIAL_BM_MAX_WINDOW];	/* index into reqs, -1 if free */
+	struct ipmi_rs * rsp = &intf->rsp;
+	uint8_t msg[SERIAL_BM_MAX_MSG_SIZE];
+	struct serial_bm_recv_ctx read_ctx;
+	struct ipmi_rs * brsp;
+	int window, next = 0, inflight = 0, i, rv;
+	uint64_t start;
+	time_t now;
+
+	for (i = 0; i < SERIAL_BM_MAX_WINDOW; i++) {
+		pending[i] = -1;
+	}
+
+	if (!intf->opened && intf->open && intf->open(intf) < 0) {
+		serial_bm_window_fail(intf, reqs, 0, count, pending, done, ctx);
+		return -1;
+	}
+
+	/* bridged requests go one by one */
+	if (intf->target_addr && intf->target_addr != intf->my_addr) {
+		for (i = 0; i < count; i++) {
+			start = ipmi_stats_usec();
+			brsp = serial_bm_send_request(intf, &reqs[i]);
+			ipmi_stats_record(intf, &reqs[i], brsp,
+					ipmi_stats_usec() - start);
+			done(intf, i, &reqs[i], brsp, ctx);
+		}
+		return 0;
+	}
+
+	window = __min(intf->session->window, SERIAL_BM_MAX_WINDOW);
+
+	/* reset receive context */
+	read_ctx.buffer_size = 0;
+	read_ctx.max_buffer_size = SERIAL_BM_MAX_BUFFER_SIZE;
+
+	serial_bm_flush(intf);
+
+	while (next < count || inflight > 0) {
+		/* fill up the window */
+		for (i = 0; i < window && next < count; i++) {
+			if (pending[i] >= 0) {
+				continue;
+			}
+			if (serial_bm_build_msg(intf, &reqs[next], slot[i].msg,
+					sizeof (slot[i].msg), slot[i].req_ctx,
+					&slot[i].msg_len) < 0) {
+				ipmi_stats_record(intf, &reqs[next], NULL, 0);
+				done(intf, next, &reqs[next], NULL, ctx);
+				next++;
+				i--;
+				continue;
+			}
+			slot[i].start = ipmi_stats_usec();
+			if (serial_bm_send_msg(intf, slot[i].msg, slot[i].msg_len) < 0) {
+				serial_bm_window_fail(intf, reqs, next, count,
+						pending, done, ctx);
+				return -1;
+			}
+			pending[i] = next++;
+			slot[i].tries = 1;
+			slot[i].sent = time(NULL);
+			inflight++;
+		}
+
+		/* receive and match message */
+		rv = serial_bm_recv_msg(intf, &read_ctx, msg, sizeof (msg));
+		if (rv < 0) {
+			serial_bm_window_fail(intf, reqs, next, count,
+					pending, done, ctx);
+			return -1;
+		}
+		if (rv > 0 && serial_bm_check_response(msg, rv) == 0) {
+			for (i = 0; i < window; i++) {
+				if (pending[i] >= 0 && serial_bm_match_response(
+						&slot[i].req_ctx[0], msg)) {
+					break;
+				}
+			}
+			if (i < window) {
+				/* skip header, keep completion and response data */
+				rsp->ccode = msg[6];
+				rsp->data_len = rv - 8;
+				memcpy(rsp->data, msg + 7, rsp->data_len);
+
+				rv = pending[i];
+				pending[i] = -1;
+				inflight--;
+				ipmi_stats_record(intf, &reqs[rv], rsp,
+						ipmi_stats_usec() - slot[i].start);
+				done(intf, rv, &reqs[rv], rsp, ctx);
+			}
+		}
+
+		/* send again what has not been answered in time */
+		now = time(NULL);
+		for (i = 0; i < window; i++) {
+			if (pending[i] < 0 ||
+					now - slot[i].sent < intf->session->timeout) {
+				continue;
+			}
+			if (slot[i].tries >= intf->session->retry) {
+				rv = pending[i];
+				pending[i] = -1;
+				inflight--;
+				ipmi_stats_record(intf, &reqs[rv], NULL, 0);
+				done(intf, rv, &reqs[rv], NULL, ctx);
+				continue;
+			}
+			lprintf(LOG_DEBUG, "Resending request seq 0x%x",
+					slot[i].req_ctx[0].rqSeq >> 2);
+			serial_bm_send_msg(intf, slot[i].msg, slot[i].msg_len);
+			slot[i].tries++;
+			slot[i].sent = now;
+		}
+	}
+
+	return 0;
+}
+
 int
 serial_bm_set_my_addr(struct ipmi_intf * intf, uint8_t addr)
 {
@@ -1020,5 +1239,6 @@ struct ipmi_intf ipmi_serial_bm_intf = {
 	open:		serial_bm_open,
 	close:		serial_bm_close,
 	sendrecv:	serial_bm_send_request,
+	sendrecv_window: serial_bm_sendrecv_window,
 	set_my_addr:serial_bm_set_my_addr
 };
@@ -777,7 +777,7 @@ serial_term_get_message(struct ipmi_intf * intf,
 static struct ipmi_rs *
 ipmi_serial_term_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 {
-	static struct ipmi_rs rsp;
+	struct ipmi_rs * rsp = &intf->rsp;
 	uint8_t msg[IPMI_SERIAL_MAX_RESPONSE], * resp = msg;
 	struct serial_term_request_ctx req_ctx[2];
 	int retry, rv, msg_len, bridging_level;
@@ -862,17 +862,17 @@ ipmi_serial_term_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 		/* check for double bridging */
 		if (bridging_level == 2 && resp[0] == 0) {
 			/* get completion code */
-			rsp.ccode = resp[7];
-			rsp.data_len = rv - 9;
-			memcpy(rsp.data, resp + 8, rsp.data_len);
+			rsp->ccode = resp[7];
+			rsp->data_len = rv - 9;
+			memcpy(rsp->data, resp + 8, rsp->data_len);
 		} else {
-			rsp.ccode = resp[0];
-			rsp.data_len = rv - 1;
-			memcpy(rsp.data, resp + 1, rsp.data_len);
+			rsp->ccode = resp[0];
+			rsp->data_len = rv - 1;
+			memcpy(rsp->data, resp + 1, rsp->data_len);
 		}
 
 		/* return response */
-		return &rsp;
+		return rsp;
 	}
 
 	/* no valid response */